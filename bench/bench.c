@@ -0,0 +1,782 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "distance.h"
+#include "k_means.h"
+#include "linear_regression.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include "quantized_models.h"
+#include "rng.h"
+
+/*
+ * The version of the JSON document the benchmark emits, bumped whenever a field changes meaning.
+ */
+#define BENCH_FORMAT_VERSION 1
+
+/*
+ * The seed every synthetic dataset is generated from, so that every build benchmarks the same data.
+ */
+#define BENCH_SEED 20240601
+
+/*
+ * The maximum number of iterations of each k-means fit.
+ */
+#define BENCH_KMEANS_ITERATIONS 20
+
+/*
+ * The number of epochs of each linear regression training run.
+ */
+#define BENCH_LINEAR_REGRESSION_EPOCHS 5
+
+/*
+ * The batch size of each parallel linear regression training run.
+ */
+#define BENCH_LINEAR_REGRESSION_BATCH 256
+
+/*
+ * The largest number of values any sweep dimension may hold.
+ */
+#define BENCH_MAX_SWEEP 8
+
+/*
+ * Define a typed struct describing a single benchmark case.
+ * The k field is only meaningful for the k-means benchmarks.
+ */
+typedef struct {
+    const char* name;
+    int n;
+    int d;
+    int k;
+    int num_threads;
+} BenchCase;
+
+/*
+ * Define a typed struct holding the measurements of a single benchmark case.
+ * The time of a case is the median of its repeats, alongside the fastest repeat.
+ * The flops field counts the nominal floating-point operations of one repeat, and peak_rss_kb the peak resident memory of the process that ran the case.
+ */
+typedef struct {
+    int ok;
+    int iterations;
+    double seconds;
+    double min_seconds;
+    double flops;
+    long peak_rss_kb;
+} BenchResult;
+
+/*
+ * Define a typed struct holding a benchmark's sweep and output options.
+ */
+typedef struct {
+    int sizes[BENCH_MAX_SWEEP];
+    int num_sizes;
+    int dimensions[BENCH_MAX_SWEEP];
+    int num_dimensions;
+    int clusters[BENCH_MAX_SWEEP];
+    int num_clusters;
+    int threads[BENCH_MAX_SWEEP];
+    int num_threads;
+    int repeats;
+    const char* filter;
+    const char* output;
+} BenchOptions;
+
+/*
+ * Define a typed struct describing a benchmark: how to run one repeat of a case, and whether it sweeps the cluster count.
+ */
+typedef struct {
+    const char* name;
+    int (*run)(const BenchCase* c, double* seconds, int* iterations, double* flops);
+    int sweeps_clusters;
+} Benchmark;
+
+
+/*
+ * Helper function to draw a standard normal value with the Box-Muller transform.
+ */
+static double rng_normal(CMLRandom* rng) {
+    double u = rng_uniform(rng);
+    double v = rng_uniform(rng);
+
+    return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+}
+
+
+/*
+ * Generates n samples of d dimensions scattered in unit-variance Gaussian blobs around k centers drawn uniformly from [-10, 10]^d.
+ * Returns a pointer to the new sample matrix on success and NULL on failure.
+ */
+static CMLMatrix* make_blobs(int n, int d, int k) {
+    CMLMatrix* X = create_matrix(n, d);
+    double* centers = (double*) malloc((size_t) k * (size_t) d * sizeof(double));
+    CMLRandom rng;
+
+    if (X == NULL || centers == NULL) {
+        free_matrix(X);
+        free(centers);
+
+        return NULL;
+    }
+
+    seed_rng(&rng, BENCH_SEED);
+
+    for (size_t i = 0; i < (size_t) k * (size_t) d; i++) {
+        centers[i] = rng_uniform(&rng) * 20.0 - 10.0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        const double* center = centers + (size_t) rng_below(&rng, (uint64_t) k) * (size_t) d;
+        double* x = matrix_row(X, i);
+
+        for (int j = 0; j < d; j++) {
+            x[j] = center[j] + rng_normal(&rng);
+        }
+    }
+
+    free(centers);
+
+    return X;
+}
+
+
+/*
+ * Generates n standard normal samples of d dimensions, with targets from fixed random weights plus Gaussian noise of deviation 0.1.
+ * Returns a pointer to the new sample matrix on success, storing the new targets in y, and NULL on failure.
+ */
+static CMLMatrix* make_linear(int n, int d, double** y) {
+    CMLMatrix* X = create_matrix(n, d);
+    double* weights = (double*) malloc((size_t) d * sizeof(double));
+    CMLRandom rng;
+
+    *y = (double*) malloc((size_t) n * sizeof(double));
+
+    if (X == NULL || weights == NULL || *y == NULL) {
+        free_matrix(X);
+        free(weights);
+        free(*y);
+
+        return NULL;
+    }
+
+    seed_rng(&rng, BENCH_SEED);
+
+    for (int j = 0; j < d; j++) {
+        weights[j] = rng_uniform(&rng) * 2.0 - 1.0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        double* x = matrix_row(X, i);
+        double target = 0.1 * rng_normal(&rng);
+
+        for (int j = 0; j < d; j++) {
+            x[j] = rng_normal(&rng);
+            target += weights[j] * x[j];
+        }
+
+        (*y)[i] = target;
+    }
+
+    free(weights);
+
+    return X;
+}
+
+
+/*
+ * Helper function to create a k-means model over blob data whose centroids have been seeded with k-means++.
+ * Returns a pointer to the new model on success and NULL on failure.
+ */
+static KMeans* seeded_k_means(const BenchCase* c, const CMLMatrix* X) {
+    KMeans* km = create_k_means_seeded(c->k, c->d, 1.0, BENCH_SEED);
+
+    if (km == NULL) return NULL;
+
+    km->num_threads = c->num_threads;
+    km->init = KMEANS_INIT_PLUS_PLUS;
+
+    if (init_k_means(km, X) != EXIT_SUCCESS) {
+        free_k_means(km);
+        return NULL;
+    }
+
+    return km;
+}
+
+
+/*
+ * Times a Lloyd's fit of k-means to blob data, from centroids already seeded with k-means++.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Each iteration nominally costs 3nkd operations to measure distances and nd to accumulate the cluster sums.
+ */
+static int bench_fit_k_means(const BenchCase* c, double* seconds, int* iterations, double* flops) {
+    CMLMatrix* X = make_blobs(c->n, c->d, c->k);
+    KMeans* km = X != NULL ? seeded_k_means(c, X) : NULL;
+    KMeansReport* report = create_k_means_report(0);
+    int status = EXIT_FAILURE;
+
+    if (km != NULL && report != NULL) {
+        double start = wall_time();
+
+        status = fit_k_means(km, X, BENCH_KMEANS_ITERATIONS, report);
+        *seconds = wall_time() - start;
+        *iterations = report->num_iterations;
+        *flops = (3.0 * c->k + 1.0) * c->d * (double) c->n * report->num_iterations;
+    }
+
+    free_k_means_report(report);
+    free_k_means(km);
+    free_matrix(X);
+
+    return status;
+}
+
+
+/*
+ * Times a Lloyd's fit of k-means to blob data on an execution context created before timing starts, from centroids already seeded with k-means++.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Every iteration runs two parallel jobs, so against fit_k_means this measures the thread creation the context saves.
+ * It is credited with the same operations as fit_k_means.
+ */
+static int bench_fit_k_means_context(const BenchCase* c, double* seconds, int* iterations, double* flops) {
+    CMLMatrix* X = make_blobs(c->n, c->d, c->k);
+    KMeans* km = X != NULL ? seeded_k_means(c, X) : NULL;
+    KMeansReport* report = create_k_means_report(0);
+    CMLContext* context = create_context(c->num_threads, CML_PLACEMENT_ANY);
+    int status = EXIT_FAILURE;
+
+    if (km != NULL && report != NULL && context != NULL) {
+        km->context = context;
+
+        double start = wall_time();
+
+        status = fit_k_means(km, X, BENCH_KMEANS_ITERATIONS, report);
+        *seconds = wall_time() - start;
+        *iterations = report->num_iterations;
+        *flops = (3.0 * c->k + 1.0) * c->d * (double) c->n * report->num_iterations;
+    }
+
+    free_k_means_report(report);
+    free_k_means(km);
+    free_context(context);
+    free_matrix(X);
+
+    return status;
+}
+
+
+/*
+ * Times a Lloyd's fit of k-means streamed from a raw sample file of blob data, from centroids already seeded with k-means++.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The file is written before timing starts and is likely to stay in the page cache, so this measures the overhead of chunking and
+ * prefetching against fit_k_means rather than disk bandwidth. It is credited with the same operations as fit_k_means.
+ */
+static int bench_fit_k_means_file(const BenchCase* c, double* seconds, int* iterations, double* flops) {
+    char path[64];
+    CMLMatrix* X = make_blobs(c->n, c->d, c->k);
+    KMeans* km = X != NULL ? seeded_k_means(c, X) : NULL;
+    KMeansReport* report = create_k_means_report(0);
+    FILE* file = NULL;
+    int status = EXIT_FAILURE;
+
+    snprintf(path, sizeof(path), "/tmp/cml_bench_%d.bin", (int) getpid());
+
+    if (km != NULL && report != NULL && (file = fopen(path, "wb")) != NULL) {
+        size_t values = (size_t) c->n * (size_t) c->d;
+        int written = fwrite(X->data, sizeof(double), values, file) == values;
+
+        if (fclose(file) == 0 && written) {
+            double start = wall_time();
+
+            status = fit_k_means_file(km, path, 0, BENCH_KMEANS_ITERATIONS, report);
+            *seconds = wall_time() - start;
+            *iterations = report->num_iterations;
+            *flops = (3.0 * c->k + 1.0) * c->d * (double) c->n * report->num_iterations;
+        }
+
+        remove(path);
+    }
+
+    free_k_means_report(report);
+    free_k_means(km);
+    free_matrix(X);
+
+    return status;
+}
+
+
+/*
+ * Times labelling blob data against centroids seeded with k-means++.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The blocked search nominally costs 2nkd operations for the dot products of every row with every centroid.
+ */
+static int bench_predict_k_means(const BenchCase* c, double* seconds, int* iterations, double* flops) {
+    CMLMatrix* X = make_blobs(c->n, c->d, c->k);
+    KMeans* km = X != NULL ? seeded_k_means(c, X) : NULL;
+    int* labels = (int*) malloc((size_t) c->n * sizeof(int));
+    int status = EXIT_FAILURE;
+
+    if (km != NULL && labels != NULL) {
+        double start = wall_time();
+
+        predict_k_means_batch(km, X, labels);
+        *seconds = wall_time() - start;
+        *iterations = 1;
+        *flops = 2.0 * c->k * c->d * (double) c->n;
+        status = EXIT_SUCCESS;
+    }
+
+    free(labels);
+    free_k_means(km);
+    free_matrix(X);
+
+    return status;
+}
+
+
+/*
+ * Times labelling blob data through an exact IVF index over centroids seeded with k-means++, excluding the index build.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The labelling is credited with the 2nkd operations of a full scan, so its rate against predict_k_means shows the index's speed-up.
+ */
+static int bench_predict_k_means_indexed(const BenchCase* c, double* seconds, int* iterations, double* flops) {
+    CMLMatrix* X = make_blobs(c->n, c->d, c->k);
+    KMeans* km = X != NULL ? seeded_k_means(c, X) : NULL;
+    int* labels = (int*) malloc((size_t) c->n * sizeof(int));
+    int status = EXIT_FAILURE;
+
+    if (km != NULL && labels != NULL && build_k_means_index(km, CENTROID_INDEX_IVF, 0) == EXIT_SUCCESS) {
+        double start = wall_time();
+
+        predict_k_means_batch(km, X, labels);
+        *seconds = wall_time() - start;
+        *iterations = 1;
+        *flops = 2.0 * c->k * c->d * (double) c->n;
+        status = EXIT_SUCCESS;
+    }
+
+    free(labels);
+    free_k_means(km);
+    free_matrix(X);
+
+    return status;
+}
+
+
+/*
+ * Times labelling blob data with an int8 quantized copy of centroids seeded with k-means++, excluding the quantization.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The labelling is credited with the 2nkd operations of a full double-precision scan, so its rate against predict_k_means shows the speed-up.
+ */
+static int bench_predict_k_means_q8(const BenchCase* c, double* seconds, int* iterations, double* flops) {
+    CMLMatrix* X = make_blobs(c->n, c->d, c->k);
+    KMeans* km = X != NULL ? seeded_k_means(c, X) : NULL;
+    KMeansQ8* qkm = km != NULL ? quantize_k_means(km, 0) : NULL;
+    int* labels = (int*) malloc((size_t) c->n * sizeof(int));
+    int status = EXIT_FAILURE;
+
+    if (qkm != NULL && labels != NULL) {
+        double start = wall_time();
+
+        predict_k_means_batch_q8(qkm, X, labels);
+        *seconds = wall_time() - start;
+        *iterations = 1;
+        *flops = 2.0 * c->k * c->d * (double) c->n;
+        status = EXIT_SUCCESS;
+    }
+
+    free(labels);
+    free_k_means_q8(qkm);
+    free_k_means(km);
+    free_matrix(X);
+
+    return status;
+}
+
+
+/*
+ * Times sequential stochastic gradient descent of linear regression over linear data.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Each sample of each epoch nominally costs 2d operations to predict and 2d to update the weights.
+ */
+static int bench_train_linear_regression(const BenchCase* c, double* seconds, int* iterations, double* flops) {
+    double* y = NULL;
+    CMLMatrix* X = make_linear(c->n, c->d, &y);
+    LinearRegression* lr = X != NULL ? new_linear_regression(c->d) : NULL;
+    int status = EXIT_FAILURE;
+
+    if (lr != NULL) {
+        double start = wall_time();
+
+        train_linear_regression(lr, X, y, 1e-3, BENCH_LINEAR_REGRESSION_EPOCHS);
+        *seconds = wall_time() - start;
+        *iterations = BENCH_LINEAR_REGRESSION_EPOCHS;
+        *flops = 4.0 * c->d * (double) c->n * BENCH_LINEAR_REGRESSION_EPOCHS;
+        status = EXIT_SUCCESS;
+    }
+
+    free_linear_regression(lr);
+    free_matrix(X);
+    free(y);
+
+    return status;
+}
+
+
+/*
+ * Times parallel mini-batch gradient descent of linear regression over linear data.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Each sample of each epoch nominally costs 2d operations for its error and 2d to accumulate its gradient.
+ */
+static int bench_train_linear_regression_parallel(const BenchCase* c, double* seconds, int* iterations, double* flops) {
+    double* y = NULL;
+    CMLMatrix* X = make_linear(c->n, c->d, &y);
+    LinearRegression* lr = X != NULL ? new_linear_regression(c->d) : NULL;
+    int status = EXIT_FAILURE;
+
+    if (lr != NULL) {
+        lr->num_threads = c->num_threads;
+        lr->batch_size = BENCH_LINEAR_REGRESSION_BATCH;
+
+        double start = wall_time();
+
+        status = train_linear_regression_parallel(lr, X, y, 1e-2, BENCH_LINEAR_REGRESSION_EPOCHS, NULL);
+        *seconds = wall_time() - start;
+        *iterations = BENCH_LINEAR_REGRESSION_EPOCHS;
+        *flops = 4.0 * c->d * (double) c->n * BENCH_LINEAR_REGRESSION_EPOCHS;
+    }
+
+    free_linear_regression(lr);
+    free_matrix(X);
+    free(y);
+
+    return status;
+}
+
+
+/*
+ * Times predicting the targets of linear data with a closed-form fitted linear regression.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Each sample nominally costs 2d operations for its dot product with the weights.
+ */
+static int bench_predict_linear_regression(const BenchCase* c, double* seconds, int* iterations, double* flops) {
+    double* y = NULL;
+    CMLMatrix* X = make_linear(c->n, c->d, &y);
+    LinearRegression* lr = X != NULL ? new_linear_regression(c->d) : NULL;
+    double* predictions = (double*) malloc((size_t) c->n * sizeof(double));
+    int status = EXIT_FAILURE;
+
+    if (lr != NULL && predictions != NULL && fit_linear_regression(lr, X, y, 0.0) == EXIT_SUCCESS) {
+        double start = wall_time();
+
+        predict_linear_regression_batch(lr, X, predictions);
+        *seconds = wall_time() - start;
+        *iterations = 1;
+        *flops = 2.0 * c->d * (double) c->n;
+        status = EXIT_SUCCESS;
+    }
+
+    free(predictions);
+    free_linear_regression(lr);
+    free_matrix(X);
+    free(y);
+
+    return status;
+}
+
+
+/*
+ * The benchmarks in the order they are run.
+ */
+static const Benchmark benchmarks[] = {
+    {"fit_k_means", bench_fit_k_means, 1},
+    {"fit_k_means_context", bench_fit_k_means_context, 1},
+    {"fit_k_means_file", bench_fit_k_means_file, 1},
+    {"predict_k_means", bench_predict_k_means, 1},
+    {"predict_k_means_indexed", bench_predict_k_means_indexed, 1},
+    {"predict_k_means_q8", bench_predict_k_means_q8, 1},
+    {"train_linear_regression", bench_train_linear_regression, 0},
+    {"train_linear_regression_parallel", bench_train_linear_regression_parallel, 0},
+    {"predict_linear_regression", bench_predict_linear_regression, 0}
+};
+
+
+/*
+ * Helper function to order two doubles for qsort.
+ */
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/*
+ * Runs every repeat of a benchmark case in a forked child process, so that each case's peak RSS is measured on its own.
+ * Returns EXIT_SUCCESS on success, filling in result, and EXIT_FAILURE otherwise.
+ *
+ * The child sends its measurements back over a pipe, taking the median and fastest of the repeats' times.
+ * A case that fails or crashes is reported as such, without stopping the rest of the sweep.
+ */
+static int run_case(const Benchmark* benchmark, const BenchCase* c, int repeats, BenchResult* result) {
+    int channel[2];
+
+    memset(result, 0, sizeof(*result));
+
+    if (pipe(channel) != 0) return EXIT_FAILURE;
+
+    fflush(NULL);
+
+    pid_t child = fork();
+
+    if (child == 0) {
+        double times[64];
+        BenchResult measured = {0};
+
+        if (repeats > 64) repeats = 64;
+
+        measured.ok = 1;
+
+        for (int r = 0; r < repeats && measured.ok; r++) {
+            measured.ok = benchmark->run(c, &times[r], &measured.iterations, &measured.flops) == EXIT_SUCCESS;
+        }
+
+        if (measured.ok) {
+            struct rusage usage;
+
+            qsort(times, repeats, sizeof(double), compare_doubles);
+            measured.seconds = repeats % 2 == 1 ? times[repeats / 2] : 0.5 * (times[repeats / 2 - 1] + times[repeats / 2]);
+            measured.min_seconds = times[0];
+
+            getrusage(RUSAGE_SELF, &usage);
+            measured.peak_rss_kb = usage.ru_maxrss;
+        }
+
+        ssize_t written = write(channel[1], &measured, sizeof(measured));
+        _exit(written == (ssize_t) sizeof(measured) ? 0 : 1);
+    }
+
+    close(channel[1]);
+
+    ssize_t received = child > 0 ? read(channel[0], result, sizeof(*result)) : -1;
+
+    close(channel[0]);
+
+    if (child > 0) waitpid(child, NULL, 0);
+
+    if (received != (ssize_t) sizeof(*result)) result->ok = 0;
+
+    return result->ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*
+ * Helper function to parse a comma-separated list of positive integers into values.
+ * Returns the number of values parsed, or -1 if the list is malformed or too long.
+ */
+static int parse_list(const char* text, int* values) {
+    int count = 0;
+
+    while (*text != '\0') {
+        char* end;
+        long value = strtol(text, &end, 10);
+
+        if (end == text || value <= 0 || value > 0x7FFFFFFF || count == BENCH_MAX_SWEEP) return -1;
+
+        values[count++] = (int) value;
+        text = *end == ',' ? end + 1 : end;
+
+        if (*end != ',' && *end != '\0') return -1;
+    }
+
+    return count;
+}
+
+
+/*
+ * Helper function to name the distance kernel in use.
+ */
+static const char* kernel_name(CMLDistanceKernel kernel) {
+    switch (kernel) {
+        case DISTANCE_KERNEL_SCALAR: return "scalar";
+        case DISTANCE_KERNEL_SSE2: return "sse2";
+        case DISTANCE_KERNEL_AVX2: return "avx2";
+        case DISTANCE_KERNEL_AVX512: return "avx512";
+        default: return "auto";
+    }
+}
+
+
+/*
+ * Helper function to print the usage of the benchmark to stderr.
+ */
+static void print_usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --quick            sweep a small grid, for smoke testing\n"
+            "  --n LIST           comma-separated sample counts\n"
+            "  --d LIST           comma-separated dimensionalities\n"
+            "  --k LIST           comma-separated cluster counts\n"
+            "  --threads LIST     comma-separated thread counts (default: 1 and every online CPU)\n"
+            "  --repeats N        repeats of each case, reporting the median (default: 3)\n"
+            "  --filter NAME      only run benchmarks whose name contains NAME\n"
+            "  --output PATH      write the JSON results to PATH rather than stdout\n",
+            program);
+}
+
+
+/*
+ * Helper function to parse the command line into the benchmark's options.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if an option is unknown or malformed.
+ */
+static int parse_options(int argc, char** argv, BenchOptions* options) {
+    int all_threads = resolve_num_threads(0);
+    BenchOptions defaults = {{10000, 100000}, 2, {8, 32}, 2, {8, 64}, 2, {1, all_threads}, all_threads > 1 ? 2 : 1, 3, NULL, NULL};
+
+    *options = defaults;
+
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        int parsed = 0;
+
+        if (strcmp(argv[i], "--quick") == 0) {
+            int sizes[2] = {2000, 20000};
+            int dimensions[2] = {4, 16};
+            int clusters[2] = {4, 16};
+
+            memcpy(options->sizes, sizes, sizeof(sizes));
+            memcpy(options->dimensions, dimensions, sizeof(dimensions));
+            memcpy(options->clusters, clusters, sizeof(clusters));
+            options->repeats = 1;
+            continue;
+        }
+
+        if (value == NULL) return EXIT_FAILURE;
+
+        if (strcmp(argv[i], "--n") == 0) {
+            parsed = (options->num_sizes = parse_list(value, options->sizes)) > 0;
+        } else if (strcmp(argv[i], "--d") == 0) {
+            parsed = (options->num_dimensions = parse_list(value, options->dimensions)) > 0;
+        } else if (strcmp(argv[i], "--k") == 0) {
+            parsed = (options->num_clusters = parse_list(value, options->clusters)) > 0;
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            parsed = (options->num_threads = parse_list(value, options->threads)) > 0;
+        } else if (strcmp(argv[i], "--repeats") == 0) {
+            options->repeats = atoi(value);
+            parsed = options->repeats > 0 && options->repeats <= 64;
+        } else if (strcmp(argv[i], "--filter") == 0) {
+            options->filter = value;
+            parsed = 1;
+        } else if (strcmp(argv[i], "--output") == 0) {
+            options->output = value;
+            parsed = 1;
+        }
+
+        if (!parsed) return EXIT_FAILURE;
+
+        i++;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Writes the JSON record of a single benchmark case, preceded by a separator unless it is the first record.
+ */
+static void write_result(FILE* output, int first, const char* name, const BenchCase* c, const BenchResult* result) {
+    double samples = (double) c->n * (result->iterations > 0 ? result->iterations : 1);
+
+    fprintf(output, "%s\n    {\"benchmark\": \"%s\", \"n\": %d, \"d\": %d, ", first ? "" : ",", name, c->n, c->d);
+
+    if (c->k > 0) fprintf(output, "\"k\": %d, ", c->k);
+
+    fprintf(output, "\"threads\": %d, \"ok\": %s", c->num_threads, result->ok ? "true" : "false");
+
+    if (result->ok) {
+        fprintf(output, ", \"iterations\": %d, \"seconds\": %.9f, \"min_seconds\": %.9f, \"ns_per_sample\": %.3f, \"gflops\": %.4f, \"peak_rss_kb\": %ld",
+                result->iterations, result->seconds, result->min_seconds, result->seconds * 1e9 / samples,
+                result->seconds > 0.0 ? result->flops / result->seconds * 1e-9 : 0.0, result->peak_rss_kb);
+    }
+
+    fprintf(output, "}");
+}
+
+
+/*
+ * Main function to sweep every benchmark over the configured grid, writing JSON results and a progress line per case to stderr.
+ * Returns zero if every case succeeded, and one otherwise.
+ */
+int main(int argc, char** argv) {
+    BenchOptions options;
+
+    if (parse_options(argc, argv, &options) != EXIT_SUCCESS) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    FILE* output = options.output != NULL ? fopen(options.output, "w") : stdout;
+
+    if (output == NULL) {
+        fprintf(stderr, "Error: Failed to open benchmark output %s\n", options.output);
+        return 1;
+    }
+
+    int first = 1;
+    int failures = 0;
+
+    fprintf(output, "{\n  \"format_version\": %d,\n  \"distance_kernel\": \"%s\",\n  \"online_cpus\": %d,\n  \"compiler\": \"%s\",\n  \"timestamp\": %lld,\n  \"results\": [",
+            BENCH_FORMAT_VERSION, kernel_name(active_distance_kernel()), resolve_num_threads(0), __VERSION__, (long long) time(NULL));
+
+    for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+        const Benchmark* benchmark = &benchmarks[b];
+
+        if (options.filter != NULL && strstr(benchmark->name, options.filter) == NULL) continue;
+
+        // The sequential trainer ignores the thread count, so it only runs single-threaded.
+        int num_threads = benchmark->run == bench_train_linear_regression ? 1 : options.num_threads;
+        int num_clusters = benchmark->sweeps_clusters ? options.num_clusters : 1;
+
+        for (int i = 0; i < options.num_sizes; i++) {
+            for (int j = 0; j < options.num_dimensions; j++) {
+                for (int l = 0; l < num_clusters; l++) {
+                    for (int t = 0; t < num_threads; t++) {
+                        BenchCase c = {benchmark->name, options.sizes[i], options.dimensions[j], benchmark->sweeps_clusters ? options.clusters[l] : 0, options.threads[t]};
+                        BenchResult result;
+
+                        if (run_case(benchmark, &c, options.repeats, &result) != EXIT_SUCCESS) failures++;
+
+                        write_result(output, first, benchmark->name, &c, &result);
+                        first = 0;
+
+                        fprintf(stderr, "%-34s n=%-8d d=%-4d k=%-4d threads=%-3d %s %10.1f ns/sample %8.3f GFLOP/s\n",
+                                benchmark->name, c.n, c.d, c.k, c.num_threads, result.ok ? "ok    " : "FAILED",
+                                result.ok ? result.seconds * 1e9 / ((double) c.n * result.iterations) : 0.0,
+                                result.ok && result.seconds > 0.0 ? result.flops / result.seconds * 1e-9 : 0.0);
+                    }
+                }
+            }
+        }
+    }
+
+    fprintf(output, "\n  ]\n}\n");
+
+    if (output != stdout) fclose(output);
+
+    return failures > 0;
+}
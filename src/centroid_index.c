@@ -0,0 +1,490 @@
+#include "centroid_index.h"
+#include "distance.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * The largest number of points in a k-d tree leaf, which are scanned together once the leaf is reached.
+ */
+#define CENTROID_INDEX_LEAF_SIZE 8
+
+/*
+ * The largest number of inverted lists an IVF index may have, bounding the per-query scratch kept on the stack.
+ */
+#define CENTROID_INDEX_MAX_LISTS 1024
+
+/*
+ * The number of Lloyd iterations used to place the coarse centers of an IVF index.
+ */
+#define CENTROID_INDEX_IVF_ITERATIONS 8
+
+/*
+ * The number of points labelled by each task while placing the coarse centers.
+ */
+#define CENTROID_INDEX_LABEL_BLOCK 1024
+
+/*
+ * The relative margin by which IVF distance bounds are loosened, absorbing the rounding of their square roots.
+ * This keeps a bound from ever pruning the point an exhaustive scan would choose.
+ */
+#define CENTROID_INDEX_BOUND_SLACK 1e-12
+
+
+/*
+ * Helper function to decide whether a candidate beats the best point found so far.
+ * Returns non-zero for a strictly smaller distance, or an equal distance with a lower original row, so ties resolve as a linear scan does.
+ */
+static inline int is_better(double distance, int id, double best, int best_id) {
+    return distance < best || (distance == best && id < best_id);
+}
+
+
+/*
+ * Helper function to partially sort the ids in [start, end) so that the one at mid has the median coordinate along dim.
+ * Every id before mid then has a coordinate at or below it, and every id after mid one at or above it.
+ *
+ * Uses Hoare's quickselect with a middle pivot, which is deterministic and runs in expected linear time.
+ */
+static void select_median(const double* points, int dimensions, int* ids, int start, int end, int mid, int dim) {
+    int low = start;
+    int high = end - 1;
+
+    while (low < high) {
+        double pivot = points[(size_t) ids[low + (high - low) / 2] * dimensions + dim];
+        int i = low;
+        int j = high;
+
+        while (i <= j) {
+            while (points[(size_t) ids[i] * dimensions + dim] < pivot) i++;
+            while (points[(size_t) ids[j] * dimensions + dim] > pivot) j--;
+
+            if (i <= j) {
+                int swap = ids[i];
+                ids[i++] = ids[j];
+                ids[j--] = swap;
+            }
+        }
+
+        if (mid <= j) {
+            high = j;
+        } else if (mid >= i) {
+            low = i;
+        } else {
+            break;
+        }
+    }
+}
+
+
+/*
+ * Helper function to build the subtree of a k-d tree over the ids in [start, end), appending its nodes to the index.
+ * Returns the position of the subtree's root node.
+ *
+ * Ranges of more than CENTROID_INDEX_LEAF_SIZE points are split at the median of the dimension with the widest spread.
+ */
+static int build_kd_node(CMLCentroidIndex* index, const double* points, int start, int end) {
+    int d = index->dimensions;
+    int position = index->num_nodes++;
+    CMLKDNode* node = &index->nodes[position];
+
+    node->start = start;
+    node->end = end;
+    node->left = -1;
+    node->right = -1;
+
+    if (end - start <= CENTROID_INDEX_LEAF_SIZE) return position;
+
+    int widest = 0;
+    double widest_spread = -1.0;
+
+    for (int j = 0; j < d; j++) {
+        double low = INFINITY;
+        double high = -INFINITY;
+
+        for (int i = start; i < end; i++) {
+            double value = points[(size_t) index->ids[i] * d + j];
+
+            if (value < low) low = value;
+            if (value > high) high = value;
+        }
+
+        if (high - low > widest_spread) {
+            widest_spread = high - low;
+            widest = j;
+        }
+    }
+
+    int mid = start + (end - start) / 2;
+
+    select_median(points, d, index->ids, start, end, mid, widest);
+
+    double split_value = points[(size_t) index->ids[mid] * d + widest];
+    int left = build_kd_node(index, points, start, mid);
+    int right = build_kd_node(index, points, mid, end);
+
+    node->split_dim = widest;
+    node->split_value = split_value;
+    node->left = left;
+    node->right = right;
+
+    return position;
+}
+
+
+/*
+ * Helper function to search a k-d subtree for a point nearer to x than the best found so far.
+ *
+ * The child on x's side of the split is searched first.
+ * A point across the split is at least the squared gap to the split plane away, so the far child is skipped whenever that gap exceeds the best distance.
+ * The gap is computed with the same rounded subtraction as the distances, so the pruning is exact.
+ */
+static void search_kd_node(const CMLCentroidIndex* index, int position, const double* x, double* best, int* best_id) {
+    const CMLKDNode* node = &index->nodes[position];
+
+    if (node->left < 0) {
+        for (int i = node->start; i < node->end; i++) {
+            double distance = squared_distance(x, index->points + (size_t) i * index->dimensions, index->dimensions);
+
+            if (is_better(distance, index->ids[i], *best, *best_id)) {
+                *best = distance;
+                *best_id = index->ids[i];
+            }
+        }
+
+        return;
+    }
+
+    double gap = x[node->split_dim] - node->split_value;
+
+    search_kd_node(index, gap < 0.0 ? node->left : node->right, x, best, best_id);
+
+    if (gap * gap <= *best) search_kd_node(index, gap < 0.0 ? node->right : node->left, x, best, best_id);
+}
+
+
+/*
+ * Define a typed struct describing a labelling of the points against the coarse centers of an IVF index, shared by every block task.
+ */
+typedef struct {
+    const double* points;
+    int num_points;
+    int dimensions;
+    const double* centers;
+    int num_lists;
+    int* labels;
+} CoarseLabelling;
+
+
+/*
+ * Labels a block of CENTROID_INDEX_LABEL_BLOCK points with their nearest coarse center.
+ * Runs as a parallel_for task, so it only writes to the labels of its own points.
+ */
+static void label_coarse_block(void* arg, int block) {
+    CoarseLabelling* labelling = (CoarseLabelling*) arg;
+    int start = block * CENTROID_INDEX_LABEL_BLOCK;
+    int end = start + CENTROID_INDEX_LABEL_BLOCK < labelling->num_points ? start + CENTROID_INDEX_LABEL_BLOCK : labelling->num_points;
+
+    for (int i = start; i < end; i++) {
+        const double* point = labelling->points + (size_t) i * labelling->dimensions;
+
+        labelling->labels[i] = nearest_point(point, labelling->centers, labelling->num_lists, labelling->dimensions, NULL);
+    }
+}
+
+
+/*
+ * Helper function to build the inverted lists of an IVF index.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The coarse centers start at evenly strided points and are refined by CENTROID_INDEX_IVF_ITERATIONS Lloyd iterations, so a build is deterministic.
+ * The points are then grouped by list with a counting sort, keeping ascending original rows within each list, and their radii measured.
+ */
+static int build_ivf_lists(CMLCentroidIndex* index, const double* points, int num_threads) {
+    int n = index->num_points;
+    int d = index->dimensions;
+    int num_lists = index->num_lists;
+    int* labels = (int*) malloc((size_t) n * sizeof(int));
+    int* counts = (int*) malloc((size_t) num_lists * sizeof(int));
+
+    if (labels == NULL || counts == NULL) {
+        free(labels);
+        free(counts);
+
+        return EXIT_FAILURE;
+    }
+
+    for (int l = 0; l < num_lists; l++) {
+        memcpy(index->list_centers + (size_t) l * d, points + (size_t) ((long long) l * n / num_lists) * d, (size_t) d * sizeof(double));
+    }
+
+    CoarseLabelling labelling = {points, n, d, index->list_centers, num_lists, labels};
+    int num_blocks = (n + CENTROID_INDEX_LABEL_BLOCK - 1) / CENTROID_INDEX_LABEL_BLOCK;
+
+    for (int iteration = 0; iteration <= CENTROID_INDEX_IVF_ITERATIONS; iteration++) {
+        parallel_for(num_blocks, num_threads, label_coarse_block, &labelling);
+
+        if (iteration == CENTROID_INDEX_IVF_ITERATIONS) break;
+
+        // Move each coarse center to the mean of its points, leaving the centers of empty lists in place.
+        memset(counts, 0, (size_t) num_lists * sizeof(int));
+
+        for (int i = 0; i < n; i++) {
+            double* center = index->list_centers + (size_t) labels[i] * d;
+
+            if (counts[labels[i]]++ == 0) memset(center, 0, (size_t) d * sizeof(double));
+
+            for (int j = 0; j < d; j++) {
+                center[j] += points[(size_t) i * d + j];
+            }
+        }
+
+        for (int l = 0; l < num_lists; l++) {
+            for (int j = 0; counts[l] > 0 && j < d; j++) {
+                index->list_centers[(size_t) l * d + j] /= counts[l];
+            }
+        }
+    }
+
+    memset(index->list_starts, 0, (size_t) (num_lists + 1) * sizeof(int));
+
+    for (int i = 0; i < n; i++) {
+        index->list_starts[labels[i] + 1]++;
+    }
+
+    for (int l = 0; l < num_lists; l++) {
+        index->list_starts[l + 1] += index->list_starts[l];
+        counts[l] = index->list_starts[l];
+        index->list_radii[l] = 0.0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        int l = labels[i];
+        int position = counts[l]++;
+        double radius = sqrt(squared_distance(points + (size_t) i * d, index->list_centers + (size_t) l * d, d));
+
+        index->ids[position] = i;
+        index->radii[position] = radius;
+
+        if (radius > index->list_radii[l]) index->list_radii[l] = radius;
+    }
+
+    free(labels);
+    free(counts);
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Creates a new index over num_points row-major points of a given dimensionality, using up to num_threads threads to build it.
+ * For an IVF index, num_lists sets the number of inverted lists, where a non-positive value uses the square root of the number of points.
+ * Returns a pointer to a new CMLCentroidIndex on success and NULL on failure.
+ *
+ * Ensures that the points are non-null and that the dimensions are positive.
+ * A k-d tree takes O(n d log n) to build, and an IVF index O(n d num_lists) per Lloyd iteration.
+ * The number of lists is capped at both the number of points and CENTROID_INDEX_MAX_LISTS, and the index starts with an exact num_probes of zero.
+ * Either way the points are copied in their leaf or list order, so each query streams through contiguous memory.
+ * A NULL is returned if any dynamic allocation fails, with any already allocated memory freed.
+ */
+CMLCentroidIndex* create_centroid_index(const double* points, int num_points, int dimensions, CMLCentroidIndexType type, int num_lists, int num_threads) {
+    if (points == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to create_centroid_index\n");
+        return NULL;
+    }
+
+    if (num_points <= 0 || dimensions <= 0) {
+        fprintf(stderr, "Error: Centroid index dimensions must be positive values\n");
+        return NULL;
+    }
+
+    CMLCentroidIndex* index = (CMLCentroidIndex*) calloc(1, sizeof(CMLCentroidIndex));
+
+    if (index == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for centroid index\n");
+        return NULL;
+    }
+
+    index->type = type;
+    index->num_points = num_points;
+    index->dimensions = dimensions;
+    index->points = (double*) malloc((size_t) num_points * (size_t) dimensions * sizeof(double));
+    index->ids = (int*) malloc((size_t) num_points * sizeof(int));
+
+    int failed = index->points == NULL || index->ids == NULL;
+
+    if (!failed && type == CENTROID_INDEX_KD_TREE) {
+        // Every inner node splits its range into two non-empty halves, so there are fewer than 2n nodes.
+        index->nodes = (CMLKDNode*) malloc((size_t) 2 * (size_t) num_points * sizeof(CMLKDNode));
+        failed = index->nodes == NULL;
+
+        if (!failed) {
+            for (int i = 0; i < num_points; i++) {
+                index->ids[i] = i;
+            }
+
+            build_kd_node(index, points, 0, num_points);
+        }
+    } else if (!failed) {
+        if (num_lists <= 0) num_lists = (int) lround(sqrt((double) num_points));
+        if (num_lists > CENTROID_INDEX_MAX_LISTS) num_lists = CENTROID_INDEX_MAX_LISTS;
+        if (num_lists > num_points) num_lists = num_points;
+        if (num_lists < 1) num_lists = 1;
+
+        index->num_lists = num_lists;
+        index->list_centers = (double*) malloc((size_t) num_lists * (size_t) dimensions * sizeof(double));
+        index->list_starts = (int*) malloc((size_t) (num_lists + 1) * sizeof(int));
+        index->radii = (double*) malloc((size_t) num_points * sizeof(double));
+        index->list_radii = (double*) malloc((size_t) num_lists * sizeof(double));
+
+        failed = index->list_centers == NULL || index->list_starts == NULL || index->radii == NULL || index->list_radii == NULL
+                 || build_ivf_lists(index, points, resolve_num_threads(num_threads)) != EXIT_SUCCESS;
+    }
+
+    if (failed) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for centroid index\n");
+        free_centroid_index(index);
+
+        return NULL;
+    }
+
+    for (int i = 0; i < num_points; i++) {
+        memcpy(index->points + (size_t) i * dimensions, points + (size_t) index->ids[i] * dimensions, (size_t) dimensions * sizeof(double));
+    }
+
+    return index;
+}
+
+
+/*
+ * Define a typed struct describing an inverted list's place in the probing order of a single query.
+ */
+typedef struct {
+    double key;
+    double center_distance;
+    int list;
+} ListProbe;
+
+
+/*
+ * Helper function to order list probes by ascending key, breaking ties by list so that the order is deterministic.
+ * Returns a negative, zero or positive value as qsort expects.
+ */
+static int compare_probes(const void* a, const void* b) {
+    const ListProbe* first = (const ListProbe*) a;
+    const ListProbe* second = (const ListProbe*) b;
+
+    if (first->key != second->key) return first->key < second->key ? -1 : 1;
+
+    return first->list - second->list;
+}
+
+
+/*
+ * Helper function to search an IVF index for the point nearest to x.
+ * Returns the original row of the nearest point found, storing its squared distance in best.
+ *
+ * By the triangle inequality a point is at least |c - r| from x, with c the distance from x to its list's center and r the point's radius.
+ * An approximate search probes the num_probes non-empty lists with the nearest centers, skipping any point or list whose bound already exceeds the best.
+ * An exact search instead probes lists in order of their bound c - list radius, and stops at the first list that cannot hold a nearer point.
+ */
+static int search_ivf(const CMLCentroidIndex* index, const double* x, double* best) {
+    ListProbe probes[CENTROID_INDEX_MAX_LISTS];
+    int d = index->dimensions;
+    int is_exact = index->num_probes <= 0 || index->num_probes >= index->num_lists;
+    int limit = is_exact ? index->num_lists : index->num_probes;
+    int best_id = -1;
+
+    for (int l = 0; l < index->num_lists; l++) {
+        double center_distance = sqrt(squared_distance(x, index->list_centers + (size_t) l * d, d));
+        double bound = center_distance - index->list_radii[l];
+
+        probes[l].key = is_exact ? (bound > 0.0 ? bound : 0.0) : center_distance;
+        probes[l].center_distance = center_distance;
+        probes[l].list = l;
+    }
+
+    qsort(probes, (size_t) index->num_lists, sizeof(ListProbe), compare_probes);
+
+    *best = INFINITY;
+
+    // Empty lists are passed over without counting as probes, so that every probe scans some points.
+    for (int probe = 0, probed = 0; probe < index->num_lists && probed < limit; probe++) {
+        int l = probes[probe].list;
+        double center_distance = probes[probe].center_distance;
+        double list_bound = center_distance - index->list_radii[l];
+
+        if (index->list_starts[l] == index->list_starts[l + 1]) continue;
+
+        probed++;
+
+        if (list_bound > 0.0 && list_bound * list_bound * (1.0 - CENTROID_INDEX_BOUND_SLACK) > *best) {
+            if (is_exact) break;
+            continue;
+        }
+
+        for (int i = index->list_starts[l]; i < index->list_starts[l + 1]; i++) {
+            double bound = center_distance - index->radii[i];
+
+            if (bound * bound * (1.0 - CENTROID_INDEX_BOUND_SLACK) > *best) continue;
+
+            double distance = squared_distance(x, index->points + (size_t) i * d, d);
+
+            if (is_better(distance, index->ids[i], *best, best_id)) {
+                *best = distance;
+                best_id = index->ids[i];
+            }
+        }
+    }
+
+    return best_id;
+}
+
+
+/*
+ * Locates the indexed point nearest to x.
+ * Returns the original row of the nearest point found, storing its squared distance in min_distance if it is non-null.
+ *
+ * A k-d tree and an exact IVF search always find the point a linear scan would, with ties going to the lowest original row.
+ * An IVF search limited by num_probes may return a further point, trading recall for scanning fewer lists.
+ */
+int centroid_index_nearest(const CMLCentroidIndex* index, const double* x, double* min_distance) {
+    if (index == NULL || x == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to centroid_index_nearest\n");
+        return -1;
+    }
+
+    double best = INFINITY;
+    int best_id = -1;
+
+    if (index->type == CENTROID_INDEX_KD_TREE) {
+        search_kd_node(index, 0, x, &best, &best_id);
+    } else {
+        best_id = search_ivf(index, x, &best);
+    }
+
+    if (min_distance != NULL) *min_distance = best;
+
+    return best_id;
+}
+
+
+/*
+ * Frees the dynamically allocated memory used by a centroid index.
+ *
+ * Ensures that the index is non-null and deallocates its point copy and search structures, followed by the index itself.
+ */
+void free_centroid_index(CMLCentroidIndex* index) {
+    if (index == NULL) return;
+
+    free(index->points);
+    free(index->ids);
+    free(index->nodes);
+    free(index->list_centers);
+    free(index->list_starts);
+    free(index->radii);
+    free(index->list_radii);
+    free(index);
+}
@@ -0,0 +1,73 @@
+#ifndef CENTROID_INDEX_H
+#define CENTROID_INDEX_H
+
+/*
+ * Define an enumeration of the search structures a centroid index can be built as.
+ * CENTROID_INDEX_KD_TREE is an exact k-d tree, which prunes best in low dimensions.
+ * CENTROID_INDEX_IVF groups the points into inverted lists around coarse centers, which suits high dimensions.
+ */
+typedef enum {
+    CENTROID_INDEX_KD_TREE,
+    CENTROID_INDEX_IVF
+} CMLCentroidIndexType;
+
+/*
+ * Define a typed struct describing a node of a k-d tree over the index's reordered points [start, end).
+ * Inner nodes split on split_dim at split_value, with every point of the left child at or below it and every point of the right child at or above it.
+ * Leaves have children of -1.
+ */
+typedef struct {
+    int start;
+    int end;
+    int split_dim;
+    double split_value;
+    int left;
+    int right;
+} CMLKDNode;
+
+/*
+ * Define a typed struct to encapsulate a nearest-point index over a fixed set of points.
+ * The index keeps its own copy of the points, reordered so that each leaf or list is contiguous, with ids mapping them back to their original rows.
+ * A k-d tree keeps its nodes, with the root first.
+ * An IVF index keeps num_lists coarse centers, the range of reordered points each list holds (list_starts), each point's distance to its
+ * list's center (radii) and the largest such distance per list (list_radii).
+ * Queries of an IVF index scan at most num_probes lists, nearest center first, where a non-positive num_probes scans as many as an exact search needs.
+ * Queries only read the index, so any number of threads may search it at once.
+ */
+typedef struct {
+    CMLCentroidIndexType type;
+    int num_points;
+    int dimensions;
+    double* points;
+    int* ids;
+    CMLKDNode* nodes;
+    int num_nodes;
+    int num_lists;
+    double* list_centers;
+    int* list_starts;
+    double* radii;
+    double* list_radii;
+    int num_probes;
+} CMLCentroidIndex;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Creates a new index over num_points row-major points of a given dimensionality, using up to num_threads threads to build it.
+ * For an IVF index, num_lists sets the number of inverted lists, where a non-positive value uses the square root of the number of points.
+ * Returns a pointer to a new CMLCentroidIndex on success and NULL on failure.
+ */
+CMLCentroidIndex* create_centroid_index(const double* points, int num_points, int dimensions, CMLCentroidIndexType type, int num_lists, int num_threads);
+
+/*
+ * Locates the indexed point nearest to x.
+ * Returns the original row of the nearest point found, storing its squared distance in min_distance if it is non-null.
+ */
+int centroid_index_nearest(const CMLCentroidIndex* index, const double* x, double* min_distance);
+
+/*
+ * Frees the dynamically allocated memory used by a centroid index.
+ */
+void free_centroid_index(CMLCentroidIndex* index);
+
+#endif /* For CENTROID_INDEX_H */
@@ -0,0 +1,625 @@
+#include "csv.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * The number of bytes read from a CSV file at a time, grown only when a single line is longer.
+ */
+#define CSV_BLOCK_BYTES ((size_t) 4 << 20)
+
+/*
+ * The number of lines parsed by each task of a parallel parse.
+ */
+#define CSV_TASK_LINES 1024
+
+/*
+ * The default number of rows handed to a stream_csv callback at a time.
+ */
+#define CSV_DEFAULT_CHUNK_ROWS 65536
+
+/*
+ * The longest field, in bytes, that the fallback parser accepts.
+ */
+#define CSV_MAX_FIELD_BYTES 128
+
+/*
+ * The alignment (in bytes) of sample buffers filled by the reader, matching a typical cache line.
+ */
+#define CSV_ALIGNMENT 64
+
+
+/*
+ * Exact powers of ten, which are all representable as doubles, used by the fast path of parse_double.
+ */
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+/*
+ * Define a typed struct holding the lines of a block and where their parsed values go, shared by every parse task.
+ */
+typedef struct {
+    const CMLCsvReader* reader;
+    const char** line_starts;
+    const char** line_ends;
+    int first_line;
+    int num_lines;
+    double* rows;
+    double* y;
+    int first_row;
+    int num_fields;
+    int num_features;
+    int failed_line;
+} CsvParse;
+
+
+/*
+ * Creates a new CSV reader for comma-separated files without a header or target column, parsing on a single thread.
+ * Returns a pointer to a new CMLCsvReader on success and NULL on failure.
+ *
+ * Dynamically allocates memory for a CMLCsvReader struct, whose fields may be changed before reading.
+ */
+CMLCsvReader* create_csv_reader(void) {
+    CMLCsvReader* reader = (CMLCsvReader*) malloc(sizeof(CMLCsvReader));
+
+    if (reader == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for CSV reader\n");
+        return NULL;
+    }
+
+    reader->delimiter = ',';
+    reader->has_header = 0;
+    reader->target_column = -1;
+    reader->num_threads = 1;
+    reader->chunk_rows = CSV_DEFAULT_CHUNK_ROWS;
+
+    return reader;
+}
+
+
+/*
+ * Helper function to parse a decimal floating-point number starting at p, stopping at end or at the first character that cannot continue it.
+ * Returns a pointer just past the number (and any trailing blanks) on success, and NULL if no number could be parsed.
+ *
+ * Accumulates up to 19 significant digits into an integer mantissa alongside a decimal exponent.
+ * When the mantissa is exactly representable and the exponent is within the range of exact powers of ten,
+ * a single multiplication or division gives the correctly rounded result (Clinger's fast path).
+ * Anything else, such as long mantissas, large exponents, infinities and NaNs, falls back to strtod on a copy of the field.
+ */
+static const char* parse_double(const char* p, const char* end, char delimiter, double* value) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+    const char* start = p;
+    int negative = 0;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    int any_digits = 0;
+    int truncated = 0;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        any_digits = 1;
+
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+            if (mantissa != 0) digits++;
+        } else {
+            exponent++;
+            if (*p != '0') truncated = 1;
+        }
+    }
+
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            any_digits = 1;
+
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+                if (mantissa != 0) digits++;
+                exponent--;
+            } else if (*p != '0') {
+                truncated = 1;
+            }
+        }
+    }
+
+    if (any_digits && p < end && (*p == 'e' || *p == 'E')) {
+        const char* exponent_start = p++;
+        int exponent_negative = 0;
+        int explicit_exponent = 0;
+
+        if (p < end && (*p == '-' || *p == '+')) {
+            exponent_negative = *p == '-';
+            p++;
+        }
+
+        if (p < end && *p >= '0' && *p <= '9') {
+            for (; p < end && *p >= '0' && *p <= '9'; p++) {
+                if (explicit_exponent < 100000) explicit_exponent = explicit_exponent * 10 + (*p - '0');
+            }
+
+            exponent += exponent_negative ? -explicit_exponent : explicit_exponent;
+        } else {
+            p = exponent_start;
+        }
+    }
+
+    const char* number_end = p;
+
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+    if (any_digits && !truncated && (p == end || *p == delimiter) && mantissa <= ((uint64_t) 1 << 53) && exponent >= -22 && exponent <= 22) {
+        double result = (double) mantissa;
+
+        result = exponent < 0 ? result / powers_of_ten[-exponent] : result * powers_of_ten[exponent];
+        *value = negative ? -result : result;
+
+        return p;
+    }
+
+    // Fall back to strtod on a terminated copy of the whole field.
+    const char* field_end = number_end;
+
+    while (field_end < end && *field_end != delimiter) field_end++;
+    while (field_end > start && (field_end[-1] == ' ' || field_end[-1] == '\t')) field_end--;
+
+    size_t length = (size_t) (field_end - start);
+    char field[CSV_MAX_FIELD_BYTES];
+    char* parsed_end;
+
+    if (length == 0 || length >= sizeof(field)) return NULL;
+
+    memcpy(field, start, length);
+    field[length] = '\0';
+    *value = strtod(field, &parsed_end);
+
+    if (parsed_end != field + length) return NULL;
+
+    p = start + length;
+
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+
+    return p;
+}
+
+
+/*
+ * Parses the lines of a single task of a block into their rows of samples and targets.
+ * Runs as a parallel_for task, recording the lowest malformed line of the block in failed_line.
+ *
+ * Every line must hold exactly num_fields delimited numbers; the target column's value is diverted into y.
+ */
+static void parse_lines(void* arg, int task) {
+    CsvParse* parse = (CsvParse*) arg;
+    int start = parse->first_line + task * CSV_TASK_LINES;
+    int end = start + CSV_TASK_LINES < parse->first_line + parse->num_lines ? start + CSV_TASK_LINES : parse->first_line + parse->num_lines;
+    char delimiter = parse->reader->delimiter;
+    int target_column = parse->reader->target_column;
+
+    for (int line = start; line < end; line++) {
+        int row = parse->first_row + (line - parse->first_line);
+        double* x = parse->rows + (size_t) row * (size_t) parse->num_features;
+        const char* p = parse->line_starts[line];
+        const char* line_end = parse->line_ends[line];
+        int feature = 0;
+        int field = 0;
+
+        for (; field < parse->num_fields && p != NULL; field++) {
+            double value;
+
+            if (field > 0) {
+                if (p == line_end || *p != delimiter) break;
+                p++;
+            }
+
+            p = parse_double(p, line_end, delimiter, &value);
+
+            if (p == NULL) break;
+
+            if (field == target_column) {
+                parse->y[row] = value;
+            } else {
+                x[feature++] = value;
+            }
+        }
+
+        if (field != parse->num_fields || p != line_end) {
+            int failed = __atomic_load_n(&parse->failed_line, __ATOMIC_RELAXED);
+
+            while ((failed < 0 || line < failed) && !__atomic_compare_exchange_n(&parse->failed_line, &failed, line, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            }
+
+            return;
+        }
+    }
+}
+
+
+/*
+ * Helper function to append a line to a block's line arrays, growing them as needed.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if the arrays cannot grow.
+ */
+static int push_line(const char*** starts, const char*** ends, int* num_lines, int* capacity, const char* start, const char* end) {
+    if (*num_lines == *capacity) {
+        int new_capacity = *capacity > 0 ? *capacity * 2 : 4096;
+        const char** new_starts = (const char**) realloc(*starts, (size_t) new_capacity * sizeof(const char*));
+
+        if (new_starts == NULL) return EXIT_FAILURE;
+
+        *starts = new_starts;
+
+        const char** new_ends = (const char**) realloc(*ends, (size_t) new_capacity * sizeof(const char*));
+
+        if (new_ends == NULL) return EXIT_FAILURE;
+
+        *ends = new_ends;
+        *capacity = new_capacity;
+    }
+
+    (*starts)[*num_lines] = start;
+    (*ends)[*num_lines] = end;
+    (*num_lines)++;
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Helper function to locate the next newline in [p, end).
+ * Returns a pointer to the newline, or end if there is none.
+ *
+ * Compares sixteen bytes at a time with SSE2 (always available on x86-64), using the comparison mask to jump straight to the newline.
+ */
+static const char* find_newline(const char* p, const char* end) {
+#if defined(__SSE2__)
+    __m128i newline = _mm_set1_epi8('\n');
+
+    for (; p + 16 <= end; p += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) p), newline));
+
+        if (mask != 0) return p + __builtin_ctz((unsigned int) mask);
+    }
+#endif
+
+    for (; p < end; p++) {
+        if (*p == '\n') return p;
+    }
+
+    return end;
+}
+
+
+/*
+ * Helper function to count the fields of a line.
+ * Returns one more than the number of delimiters in the line.
+ */
+static int count_fields(const char* start, const char* end, char delimiter) {
+    int fields = 1;
+
+    for (const char* p = start; p < end; p++) {
+        if (*p == delimiter) fields++;
+    }
+
+    return fields;
+}
+
+
+/*
+ * Streams the rows of a CSV file to a callback in chunks of up to chunk_rows rows, without materialising the whole file.
+ * The chunk and targets passed to the callback are only valid during the call, and a non-zero return from it stops the stream.
+ * Returns EXIT_SUCCESS on success (including when stopped by the callback), and EXIT_FAILURE otherwise.
+ *
+ * The file is read in blocks of CSV_BLOCK_BYTES, carrying any incomplete final line over to the next block.
+ * Each block is split into lines by a vectorised newline scan, skipping blank lines and the header, and trimming carriage returns.
+ * The field count is taken from the first data line, and the lines are then parsed in parallel straight into the chunk's rows,
+ * so the samples handed over are identical whatever the thread count.
+ * At any point, if a line is malformed or a dynamic allocation fails, the memory allocated is freed and the function exits.
+ */
+int stream_csv(const CMLCsvReader* reader, const char* path, int (*callback)(const CMLMatrix* chunk, const double* y, void* arg), void* arg) {
+    if (reader == NULL || path == NULL || callback == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to stream_csv\n");
+        return EXIT_FAILURE;
+    }
+
+    if (reader->chunk_rows <= 0) {
+        fprintf(stderr, "Error: CSV chunk size must be a positive value\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE* file = fopen(path, "rb");
+
+    if (file == NULL) {
+        fprintf(stderr, "Error: Failed to open CSV file %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    int num_threads = resolve_num_threads(reader->num_threads);
+    size_t capacity = CSV_BLOCK_BYTES;
+    size_t length = 0;
+    char* buffer = (char*) malloc(capacity);
+    const char** line_starts = NULL;
+    const char** line_ends = NULL;
+    int line_capacity = 0;
+    double* rows = NULL;
+    double* y = NULL;
+    int skip_header = reader->has_header;
+    int num_fields = 0;
+    int filled = 0;
+    long long rows_done = 0;
+    int end_of_file = 0;
+    int stopped = 0;
+    int status = buffer != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (buffer == NULL) fprintf(stderr, "Error: Failed to allocate sufficient memory for CSV reader\n");
+
+    while (status == EXIT_SUCCESS && !end_of_file && !stopped) {
+        // A line longer than the whole buffer needs a bigger buffer before more can be read.
+        if (length == capacity) {
+            char* grown = (char*) realloc(buffer, capacity * 2);
+
+            if (grown == NULL) {
+                fprintf(stderr, "Error: Failed to allocate sufficient memory for CSV reader\n");
+                status = EXIT_FAILURE;
+                break;
+            }
+
+            buffer = grown;
+            capacity *= 2;
+        }
+
+        size_t read = fread(buffer + length, 1, capacity - length, file);
+
+        length += read;
+
+        if (read == 0) {
+            if (ferror(file)) {
+                fprintf(stderr, "Error: Failed to read CSV file %s\n", path);
+                status = EXIT_FAILURE;
+                break;
+            }
+
+            end_of_file = 1;
+        }
+
+        // Split the block into complete lines, keeping the unterminated tail unless the file has ended.
+        const char* p = buffer;
+        const char* block_end = buffer + length;
+        int num_lines = 0;
+
+        while (p < block_end) {
+            const char* newline = find_newline(p, block_end);
+
+            if (newline == block_end && !end_of_file) break;
+
+            const char* line_end = newline;
+
+            if (line_end > p && line_end[-1] == '\r') line_end--;
+
+            if (line_end > p) {
+                if (skip_header) {
+                    skip_header = 0;
+                } else if (push_line(&line_starts, &line_ends, &num_lines, &line_capacity, p, line_end) != EXIT_SUCCESS) {
+                    fprintf(stderr, "Error: Failed to allocate sufficient memory for CSV reader\n");
+                    status = EXIT_FAILURE;
+                    break;
+                }
+            }
+
+            p = newline < block_end ? newline + 1 : block_end;
+        }
+
+        size_t consumed = (size_t) (p - buffer);
+
+        // Size the chunk from the first data line.
+        if (status == EXIT_SUCCESS && num_lines > 0 && num_fields == 0) {
+            num_fields = count_fields(line_starts[0], line_ends[0], reader->delimiter);
+
+            if (reader->target_column >= num_fields || (reader->target_column >= 0 && num_fields == 1)) {
+                fprintf(stderr, "Error: CSV target column %d is out of range for %d fields\n", reader->target_column, num_fields);
+                status = EXIT_FAILURE;
+            } else {
+                int num_features = num_fields - (reader->target_column >= 0 ? 1 : 0);
+                void* data = NULL;
+
+                if (posix_memalign(&data, CSV_ALIGNMENT, (size_t) reader->chunk_rows * (size_t) num_features * sizeof(double)) != 0) data = NULL;
+
+                rows = (double*) data;
+                y = reader->target_column >= 0 ? (double*) malloc((size_t) reader->chunk_rows * sizeof(double)) : NULL;
+
+                if (rows == NULL || (reader->target_column >= 0 && y == NULL)) {
+                    fprintf(stderr, "Error: Failed to allocate sufficient memory for CSV chunk\n");
+                    status = EXIT_FAILURE;
+                }
+            }
+        }
+
+        // Parse the lines into the chunk, handing each full chunk to the callback.
+        CsvParse parse = {reader, line_starts, line_ends, 0, 0, rows, y, 0, num_fields, num_fields - (reader->target_column >= 0 ? 1 : 0), -1};
+
+        for (int next = 0; status == EXIT_SUCCESS && !stopped && next < num_lines; next += parse.num_lines) {
+            parse.first_line = next;
+            parse.num_lines = num_lines - next < reader->chunk_rows - filled ? num_lines - next : reader->chunk_rows - filled;
+            parse.first_row = filled;
+
+            parallel_for((parse.num_lines + CSV_TASK_LINES - 1) / CSV_TASK_LINES, num_threads, parse_lines, &parse);
+
+            if (parse.failed_line >= 0) {
+                fprintf(stderr, "Error: Malformed CSV row %lld in %s\n", rows_done + filled + (parse.failed_line - next) + 1, path);
+                status = EXIT_FAILURE;
+                break;
+            }
+
+            filled += parse.num_lines;
+
+            if (filled == reader->chunk_rows) {
+                CMLMatrix chunk = matrix_view(rows, filled, parse.num_features, parse.num_features);
+
+                stopped = callback(&chunk, y, arg) != 0;
+                rows_done += filled;
+                filled = 0;
+            }
+        }
+
+        memmove(buffer, buffer + consumed, length - consumed);
+        length -= consumed;
+    }
+
+    if (status == EXIT_SUCCESS && !stopped && filled > 0) {
+        int num_features = num_fields - (reader->target_column >= 0 ? 1 : 0);
+        CMLMatrix chunk = matrix_view(rows, filled, num_features, num_features);
+
+        callback(&chunk, y, arg);
+    }
+
+    fclose(file);
+    free(buffer);
+    free(line_starts);
+    free(line_ends);
+    free(rows);
+    free(y);
+
+    return status;
+}
+
+
+/*
+ * Define a typed struct holding the growing buffers read_csv gathers every chunk into.
+ */
+typedef struct {
+    double* data;
+    double* y;
+    long long num_rows;
+    long long capacity;
+    int num_cols;
+    int failed;
+} CsvGather;
+
+
+/*
+ * Appends a streamed chunk to the gathered samples and targets, doubling the buffers as needed.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE (stopping the stream) if the buffers cannot grow.
+ *
+ * The sample buffer is re-allocated with cache-line alignment rather than with realloc, so that it can become a matrix's data directly.
+ */
+static int gather_chunk(const CMLMatrix* chunk, const double* y, void* arg) {
+    CsvGather* gather = (CsvGather*) arg;
+
+    gather->num_cols = chunk->num_cols;
+
+    if (gather->num_rows + chunk->num_rows > gather->capacity) {
+        long long capacity = gather->capacity > 0 ? gather->capacity : chunk->num_rows;
+
+        while (capacity < gather->num_rows + chunk->num_rows) capacity *= 2;
+
+        void* data = NULL;
+
+        if (posix_memalign(&data, CSV_ALIGNMENT, (size_t) capacity * (size_t) chunk->num_cols * sizeof(double)) != 0) {
+            gather->failed = 1;
+            return EXIT_FAILURE;
+        }
+
+        if (gather->data != NULL) memcpy(data, gather->data, (size_t) gather->num_rows * (size_t) chunk->num_cols * sizeof(double));
+
+        free(gather->data);
+        gather->data = (double*) data;
+
+        if (y != NULL) {
+            double* grown = (double*) realloc(gather->y, (size_t) capacity * sizeof(double));
+
+            if (grown == NULL) {
+                gather->failed = 1;
+                return EXIT_FAILURE;
+            }
+
+            gather->y = grown;
+        }
+
+        gather->capacity = capacity;
+    }
+
+    memcpy(gather->data + (size_t) gather->num_rows * (size_t) chunk->num_cols, chunk->data, (size_t) chunk->num_rows * (size_t) chunk->num_cols * sizeof(double));
+
+    if (y != NULL) memcpy(gather->y + gather->num_rows, y, (size_t) chunk->num_rows * sizeof(double));
+
+    gather->num_rows += chunk->num_rows;
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Reads every row of a CSV file into a single new matrix, writing a new array of targets to y if the reader has a target column.
+ * Returns a pointer to a new CMLMatrix on success and NULL on failure.
+ *
+ * Streams the file through gather_chunk, then adopts the gathered buffer as the matrix's data without a further copy.
+ * The matrix and targets are owned by the caller, to be freed with free_matrix and free respectively.
+ * A NULL is returned if the file cannot be read, holds no rows, or if any dynamic allocation fails, with any already allocated memory freed.
+ */
+CMLMatrix* read_csv(const CMLCsvReader* reader, const char* path, double** y) {
+    if (reader == NULL || path == NULL || (reader->target_column >= 0 && y == NULL)) {
+        fprintf(stderr, "Error: Null pointer passed to read_csv\n");
+        return NULL;
+    }
+
+    CsvGather gather = {NULL, NULL, 0, 0, 0, 0};
+    int status = stream_csv(reader, path, gather_chunk, &gather);
+
+    // A chunk that could not be gathered stops the stream like a callback request would, so it is reported here.
+    if (status == EXIT_SUCCESS && (gather.failed || gather.num_rows > INT_MAX)) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for CSV matrix\n");
+        status = EXIT_FAILURE;
+    } else if (status == EXIT_SUCCESS && gather.num_rows == 0) {
+        fprintf(stderr, "Error: CSV file %s holds no rows\n", path);
+        status = EXIT_FAILURE;
+    }
+
+    CMLMatrix* X = status == EXIT_SUCCESS ? (CMLMatrix*) malloc(sizeof(CMLMatrix)) : NULL;
+
+    if (X == NULL) {
+        if (status == EXIT_SUCCESS) fprintf(stderr, "Error: Failed to allocate sufficient memory for CSV matrix\n");
+        free(gather.data);
+        free(gather.y);
+
+        return NULL;
+    }
+
+    X->data = gather.data;
+    X->num_rows = (int) gather.num_rows;
+    X->num_cols = gather.num_cols;
+    X->stride = gather.num_cols;
+
+    if (y != NULL) {
+        *y = gather.y;
+    } else {
+        free(gather.y);
+    }
+
+    return X;
+}
+
+
+/*
+ * Frees the dynamically allocated memory used by a CSV reader.
+ *
+ * Ensures that the reader is non-null and deallocates it.
+ */
+void free_csv_reader(CMLCsvReader* reader) {
+    if (reader == NULL) return;
+
+    free(reader);
+}
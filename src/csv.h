@@ -0,0 +1,47 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include "matrix.h"
+
+/*
+ * Define a typed struct to encapsulate the configuration of a CSV reader.
+ * The delimiter separates fields, and the first line is skipped as a header when has_header is set.
+ * The field at target_column (if non-negative) is read into a separate target array rather than into the samples.
+ * The num_threads field sets how many threads parse each block of lines, where a non-positive value uses every online CPU.
+ * The chunk_rows field sets how many rows stream_csv hands to its callback at a time.
+ */
+typedef struct {
+    char delimiter;
+    int has_header;
+    int target_column;
+    int num_threads;
+    int chunk_rows;
+} CMLCsvReader;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Creates a new CSV reader for comma-separated files without a header or target column, parsing on a single thread.
+ * Returns a pointer to a new CMLCsvReader on success and NULL on failure.
+ */
+CMLCsvReader* create_csv_reader(void);
+
+/*
+ * Streams the rows of a CSV file to a callback in chunks of up to chunk_rows rows, without materialising the whole file.
+ * The chunk and targets passed to the callback are only valid during the call, and a non-zero return from it stops the stream.
+ * Returns EXIT_SUCCESS on success (including when stopped by the callback), and EXIT_FAILURE otherwise.
+ */
+int stream_csv(const CMLCsvReader* reader, const char* path, int (*callback)(const CMLMatrix* chunk, const double* y, void* arg), void* arg);
+
+/*
+ * Reads every row of a CSV file into a single new matrix, writing a new array of targets to y if the reader has a target column.
+ * Returns a pointer to a new CMLMatrix on success and NULL on failure.
+ */
+CMLMatrix* read_csv(const CMLCsvReader* reader, const char* path, double** y);
+
+/*
+ * Frees the dynamically allocated memory used by a CSV reader.
+ */
+void free_csv_reader(CMLCsvReader* reader);
+
+#endif /* For CSV_H */
@@ -0,0 +1,332 @@
+#include "dataset.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * The magic bytes at the start of every binary dataset file.
+ */
+#define DATASET_MAGIC "CMLDATA"
+
+/*
+ * A value written in the host's byte order, so that a reader on a host of the other byte order can reject the file.
+ */
+#define DATASET_BYTE_ORDER 0x01020304u
+
+/*
+ * The alignment (in bytes) of the sample and target sections within a dataset file, matching a typical cache line.
+ * Page-aligned mappings keep every section aligned in memory too.
+ */
+#define DATASET_ALIGNMENT 64
+
+/*
+ * The dataset header flag marking the presence of a target column.
+ */
+#define DATASET_HAS_TARGETS 1u
+
+
+/*
+ * Define a typed struct describing the fixed 64-byte header at the start of every dataset file.
+ * The samples follow at data_offset as packed row-major values, and the targets (if any) at target_offset.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t flags;
+    uint64_t num_rows;
+    uint64_t num_cols;
+    uint64_t data_offset;
+    uint64_t target_offset;
+    uint8_t reserved[8];
+} DatasetHeader;
+
+
+/*
+ * Helper function to round a file offset up to the next multiple of DATASET_ALIGNMENT.
+ */
+static uint64_t align_offset(uint64_t offset) {
+    return (offset + DATASET_ALIGNMENT - 1) / DATASET_ALIGNMENT * DATASET_ALIGNMENT;
+}
+
+
+/*
+ * Helper function to write zero bytes until a file reaches a given offset.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+static int pad_to(FILE* file, uint64_t offset) {
+    static const char zeros[DATASET_ALIGNMENT] = {0};
+    long position = ftell(file);
+
+    if (position < 0) return EXIT_FAILURE;
+
+    uint64_t padding = offset - (uint64_t) position;
+
+    return fwrite(zeros, 1, padding, file) == padding ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*
+ * Helper function to write a dataset of either element type, given its rows as raw bytes.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Writes the header, then every row (skipping any stride padding), then the targets, each section aligned to DATASET_ALIGNMENT.
+ * The file is written beside the destination and renamed over it once complete, so processes still mapping an old dataset at that path
+ * keep their intact copy rather than faulting on a truncated one. A partially written file is removed on failure.
+ */
+static int write_dataset_bytes(const char* path, CMLDType dtype, const void* data, int num_rows, int num_cols, int stride, const void* y) {
+    size_t element_size = dtype == CML_DTYPE_FLOAT64 ? sizeof(double) : sizeof(float);
+    size_t row_bytes = (size_t) num_cols * element_size;
+    DatasetHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC));
+    header.byte_order = DATASET_BYTE_ORDER;
+    header.version = CML_DATASET_VERSION;
+    header.dtype = (uint32_t) dtype;
+    header.flags = y != NULL ? DATASET_HAS_TARGETS : 0;
+    header.num_rows = (uint64_t) num_rows;
+    header.num_cols = (uint64_t) num_cols;
+    header.data_offset = align_offset(sizeof(DatasetHeader));
+    header.target_offset = y != NULL ? align_offset(header.data_offset + (uint64_t) num_rows * row_bytes) : 0;
+
+    size_t path_length = strlen(path);
+    char* temporary_path = (char*) malloc(path_length + 5);
+
+    if (temporary_path == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory to write dataset\n");
+        return EXIT_FAILURE;
+    }
+
+    memcpy(temporary_path, path, path_length);
+    memcpy(temporary_path + path_length, ".tmp", 5);
+
+    FILE* file = fopen(temporary_path, "wb");
+
+    if (file == NULL) {
+        fprintf(stderr, "Error: Failed to open dataset file %s for writing\n", path);
+        free(temporary_path);
+
+        return EXIT_FAILURE;
+    }
+
+    int status = fwrite(&header, sizeof(header), 1, file) == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (status == EXIT_SUCCESS) status = pad_to(file, header.data_offset);
+
+    for (int i = 0; i < num_rows && status == EXIT_SUCCESS; i++) {
+        const char* row = (const char*) data + (size_t) i * (size_t) stride * element_size;
+
+        if (fwrite(row, 1, row_bytes, file) != row_bytes) status = EXIT_FAILURE;
+    }
+
+    if (y != NULL && status == EXIT_SUCCESS) {
+        status = pad_to(file, header.target_offset);
+
+        if (status == EXIT_SUCCESS && fwrite(y, element_size, (size_t) num_rows, file) != (size_t) num_rows) status = EXIT_FAILURE;
+    }
+
+    if (fclose(file) != 0) status = EXIT_FAILURE;
+
+    if (status == EXIT_SUCCESS && rename(temporary_path, path) != 0) status = EXIT_FAILURE;
+
+    if (status != EXIT_SUCCESS) {
+        fprintf(stderr, "Error: Failed to write dataset file %s\n", path);
+        remove(temporary_path);
+    }
+
+    free(temporary_path);
+
+    return status;
+}
+
+
+/*
+ * Writes a double-precision sample matrix, and optionally its targets, to a binary dataset file, replacing any existing file atomically.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Ensures that the path and matrix are non-null; y may be NULL to write a dataset without a target column.
+ */
+int write_dataset(const char* path, const CMLMatrix* X, const double* y) {
+    if (path == NULL || X == NULL || X->data == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to write_dataset\n");
+        return EXIT_FAILURE;
+    }
+
+    return write_dataset_bytes(path, CML_DTYPE_FLOAT64, X->data, X->num_rows, X->num_cols, X->stride, y);
+}
+
+
+/*
+ * Writes a single-precision sample matrix, and optionally its targets, to a binary dataset file, replacing any existing file atomically.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Ensures that the path and matrix are non-null; y may be NULL to write a dataset without a target column.
+ */
+int write_dataset_f(const char* path, const CMLMatrixF* X, const float* y) {
+    if (path == NULL || X == NULL || X->data == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to write_dataset_f\n");
+        return EXIT_FAILURE;
+    }
+
+    return write_dataset_bytes(path, CML_DTYPE_FLOAT32, X->data, X->num_rows, X->num_cols, X->stride, y);
+}
+
+
+/*
+ * Helper function to check that a mapped header describes a dataset this library can read, which fits within the file.
+ * Returns EXIT_SUCCESS if the header is valid, and EXIT_FAILURE otherwise.
+ */
+static int validate_header(const DatasetHeader* header, size_t file_size) {
+    if (memcmp(header->magic, DATASET_MAGIC, sizeof(DATASET_MAGIC)) != 0) {
+        fprintf(stderr, "Error: File is not a CML dataset\n");
+        return EXIT_FAILURE;
+    }
+
+    if (header->byte_order != DATASET_BYTE_ORDER) {
+        fprintf(stderr, "Error: Dataset was written on a host of a different byte order\n");
+        return EXIT_FAILURE;
+    }
+
+    if (header->version != CML_DATASET_VERSION) {
+        fprintf(stderr, "Error: Unsupported dataset version %u\n", header->version);
+        return EXIT_FAILURE;
+    }
+
+    if (header->dtype != CML_DTYPE_FLOAT64 && header->dtype != CML_DTYPE_FLOAT32) {
+        fprintf(stderr, "Error: Unsupported dataset element type %u\n", header->dtype);
+        return EXIT_FAILURE;
+    }
+
+    if (header->num_rows > INT_MAX || header->num_cols == 0 || header->num_cols > INT_MAX) {
+        fprintf(stderr, "Error: Dataset dimensions are out of range\n");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t element_size = header->dtype == CML_DTYPE_FLOAT64 ? sizeof(double) : sizeof(float);
+
+    // Bound each section by the space left after its offset, so that no size or offset sum can wrap around.
+    if (header->num_rows != 0 && header->num_cols > UINT64_MAX / element_size / header->num_rows) {
+        fprintf(stderr, "Error: Dataset dimensions are out of range\n");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t data_bytes = header->num_rows * header->num_cols * element_size;
+    uint64_t target_bytes = header->num_rows * element_size;
+    int has_targets = (header->flags & DATASET_HAS_TARGETS) != 0;
+
+    if (header->data_offset % DATASET_ALIGNMENT != 0 || header->data_offset < sizeof(DatasetHeader) || header->data_offset > file_size
+        || data_bytes > file_size - header->data_offset) {
+        fprintf(stderr, "Error: Dataset sample section is truncated or misaligned\n");
+        return EXIT_FAILURE;
+    }
+
+    if (has_targets && (header->target_offset % DATASET_ALIGNMENT != 0 || header->target_offset < header->data_offset
+                        || header->target_offset - header->data_offset < data_bytes || header->target_offset > file_size
+                        || target_bytes > file_size - header->target_offset)) {
+        fprintf(stderr, "Error: Dataset target section is truncated or misaligned\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Maps a binary dataset file into memory without copying or parsing its values.
+ * Returns a pointer to a new CMLDataset on success and NULL on failure.
+ *
+ * The file is mapped read-only, so its pages are shared through the page cache with every other process mapping it
+ * and are only read from disk when first touched, making opening near-instant whatever the dataset's size.
+ * A read-only mapping is never charged against the commit limit, so even under strict overcommit a dataset may exceed memory and swap.
+ * The header is validated against the file's size before any view is created, and the file descriptor is closed once mapped.
+ * A NULL is returned if the file cannot be opened or mapped, if its header is invalid, or if the dataset struct cannot be allocated.
+ */
+CMLDataset* open_dataset(const char* path) {
+    if (path == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to open_dataset\n");
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "Error: Failed to open dataset file %s\n", path);
+        return NULL;
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(DatasetHeader)) {
+        fprintf(stderr, "Error: Dataset file %s is too small to hold a header\n", path);
+        close(fd);
+
+        return NULL;
+    }
+
+    size_t size = (size_t) info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Error: Failed to map dataset file %s\n", path);
+        return NULL;
+    }
+
+    const DatasetHeader* header = (const DatasetHeader*) mapping;
+
+    if (validate_header(header, size) != EXIT_SUCCESS) {
+        munmap(mapping, size);
+        return NULL;
+    }
+
+    CMLDataset* dataset = (CMLDataset*) calloc(1, sizeof(CMLDataset));
+
+    if (dataset == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for dataset\n");
+        munmap(mapping, size);
+
+        return NULL;
+    }
+
+    char* base = (char*) mapping;
+    int num_rows = (int) header->num_rows;
+    int num_cols = (int) header->num_cols;
+    int has_targets = (header->flags & DATASET_HAS_TARGETS) != 0;
+
+    dataset->mapping = mapping;
+    dataset->mapping_size = size;
+    dataset->dtype = (CMLDType) header->dtype;
+
+    // Build the views directly, as an empty dataset has no rows for matrix_view to accept.
+    if (dataset->dtype == CML_DTYPE_FLOAT64) {
+        dataset->X = (CMLMatrix) {(double*) (base + header->data_offset), num_rows, num_cols, num_cols};
+        dataset->y = has_targets ? (const double*) (base + header->target_offset) : NULL;
+    } else {
+        dataset->X_f = (CMLMatrixF) {(float*) (base + header->data_offset), num_rows, num_cols, num_cols};
+        dataset->y_f = has_targets ? (const float*) (base + header->target_offset) : NULL;
+    }
+
+    return dataset;
+}
+
+
+/*
+ * Unmaps a binary dataset and frees the memory used by it, invalidating its views.
+ *
+ * Ensures that the dataset is non-null, unmaps the file, then deallocates the dataset itself.
+ */
+void free_dataset(CMLDataset* dataset) {
+    if (dataset == NULL) return;
+
+    munmap(dataset->mapping, dataset->mapping_size);
+    free(dataset);
+}
@@ -0,0 +1,63 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "matrix.h"
+
+/*
+ * The version of the binary dataset format written by this library.
+ */
+#define CML_DATASET_VERSION 1
+
+/*
+ * Define an enumeration of the element types a binary dataset can store.
+ */
+typedef enum {
+    CML_DTYPE_FLOAT64 = 1,
+    CML_DTYPE_FLOAT32 = 2
+} CMLDType;
+
+/*
+ * Define a typed struct to encapsulate a binary dataset mapped into memory.
+ * For a CML_DTYPE_FLOAT64 dataset X and y view the samples and targets, while for CML_DTYPE_FLOAT32 X_f and y_f do.
+ * The views of the other type are empty, and y or y_f is NULL when the dataset has no target column.
+ * The file is mapped read-only, so a dataset larger than memory never counts against the commit limit, and the views are only valid until it is freed.
+ * The views must never be written through, which faults; a caller that needs to modify the samples copies them first.
+ */
+typedef struct {
+    void* mapping;
+    size_t mapping_size;
+    CMLDType dtype;
+    CMLMatrix X;
+    const double* y;
+    CMLMatrixF X_f;
+    const float* y_f;
+} CMLDataset;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Writes a double-precision sample matrix, and optionally its targets, to a binary dataset file, replacing any existing file atomically.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int write_dataset(const char* path, const CMLMatrix* X, const double* y);
+
+/*
+ * Writes a single-precision sample matrix, and optionally its targets, to a binary dataset file, replacing any existing file atomically.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int write_dataset_f(const char* path, const CMLMatrixF* X, const float* y);
+
+/*
+ * Maps a binary dataset file into memory without copying or parsing its values.
+ * Returns a pointer to a new CMLDataset on success and NULL on failure.
+ */
+CMLDataset* open_dataset(const char* path);
+
+/*
+ * Unmaps a binary dataset and frees the memory used by it, invalidating its views.
+ */
+void free_dataset(CMLDataset* dataset);
+
+#endif /* For DATASET_H */
@@ -0,0 +1,868 @@
+#include "distance.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <float.h>
+
+/*
+ * Vectorised kernels are only compiled for x86 targets whose compiler supports per-function target attributes.
+ * Every other target uses the scalar kernel alone.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DISTANCE_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#else
+#define DISTANCE_HAVE_X86_KERNELS 0
+#endif
+
+/*
+ * The number of rows processed together by a blocked nearest point search.
+ */
+#define NEAREST_ROW_TILE 64
+
+/*
+ * The number of bytes of points a blocked nearest point search keeps hot in cache while sweeping a row tile.
+ */
+#define NEAREST_POINT_TILE_BYTES (32 * 1024)
+
+
+/*
+ * Helper macro to define a nearest point search of a given precision around a given squared distance kernel.
+ * Each instruction set and precision gets its own copy so that the kernel is inlined into the search loop.
+ *
+ * Iterates over all points with an initially maximal minimal distance, only replacing the minima on a strictly smaller distance.
+ * This keeps ties resolved in favour of the lowest index, whichever kernel is active.
+ */
+#define DEFINE_NEAREST_POINT(name, real, real_max, distance, attributes) \
+    attributes static int name(const real* x, const real* points, int num_points, int dimensions, real* min_distance) { \
+        real best = real_max; \
+        int index = 0; \
+        \
+        for (int i = 0; i < num_points; i++) { \
+            real d = distance(x, points + (size_t) i * (size_t) dimensions, dimensions); \
+            \
+            if (d < best) { \
+                best = d; \
+                index = i; \
+            } \
+        } \
+        \
+        if (min_distance != NULL) *min_distance = best; \
+        \
+        return index; \
+    }
+
+
+/*
+ * Portable squared distance kernel used when no vectorised kernel is available.
+ * Returns the sum of the squared differences of each dimension.
+ */
+static inline double squared_distance_scalar(const double* a, const double* b, int dimensions) {
+    double sum = 0.0;
+
+    for (int i = 0; i < dimensions; i++) {
+        double diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+
+    return sum;
+}
+
+DEFINE_NEAREST_POINT(nearest_point_scalar, double, DBL_MAX, squared_distance_scalar, )
+
+
+/*
+ * Portable kernel computing the dot products of one vector with four others.
+ * Writes the four dot products to out.
+ */
+static void dot_product_4_scalar(const double* x, const double* p0, const double* p1, const double* p2, const double* p3, int dimensions, double* out) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+
+    for (int i = 0; i < dimensions; i++) {
+        s0 += x[i] * p0[i];
+        s1 += x[i] * p1[i];
+        s2 += x[i] * p2[i];
+        s3 += x[i] * p3[i];
+    }
+
+    out[0] = s0;
+    out[1] = s1;
+    out[2] = s2;
+    out[3] = s3;
+}
+
+
+/*
+ * Portable single-precision squared distance kernel used when no vectorised kernel is available.
+ * Returns the sum of the squared differences of each dimension.
+ */
+static inline float squared_distance_f_scalar(const float* a, const float* b, int dimensions) {
+    float sum = 0.0f;
+
+    for (int i = 0; i < dimensions; i++) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+
+    return sum;
+}
+
+DEFINE_NEAREST_POINT(nearest_point_f_scalar, float, FLT_MAX, squared_distance_f_scalar, )
+
+
+/*
+ * Portable int8 squared distance kernel, measuring x against each of num_points row-major points.
+ * Writes the sum of the squared differences of each dimension for every point to distances.
+ */
+static void squared_distances_i8_scalar(const int8_t* x, const int8_t* points, const int32_t* point_terms, int num_points, int dimensions, int32_t* distances) {
+    (void) point_terms;
+
+    for (int p = 0; p < num_points; p++) {
+        const int8_t* point = points + (size_t) p * (size_t) dimensions;
+        int32_t sum = 0;
+
+        for (int i = 0; i < dimensions; i++) {
+            int32_t diff = (int32_t) x[i] - (int32_t) point[i];
+            sum += diff * diff;
+        }
+
+        distances[p] = sum;
+    }
+}
+
+
+#if DISTANCE_HAVE_X86_KERNELS
+
+/*
+ * SSE2 squared distance kernel processing two dimensions per instruction.
+ * Returns the sum of the squared differences of each dimension.
+ *
+ * Two independent accumulators hide the latency of the additions, with any odd trailing dimension handled in scalar.
+ */
+__attribute__((target("sse2")))
+static inline double squared_distance_sse2(const double* a, const double* b, int dimensions) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    int i = 0;
+
+    for (; i + 4 <= dimensions; i += 4) {
+        __m128d d0 = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+        __m128d d1 = _mm_sub_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2));
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(d0, d0));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(d1, d1));
+    }
+
+    if (i + 2 <= dimensions) {
+        __m128d d0 = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(d0, d0));
+        i += 2;
+    }
+
+    acc0 = _mm_add_pd(acc0, acc1);
+    double sum = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+
+    if (i < dimensions) {
+        double diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+
+    return sum;
+}
+
+DEFINE_NEAREST_POINT(nearest_point_sse2, double, DBL_MAX, squared_distance_sse2, __attribute__((target("sse2"))))
+
+
+/*
+ * SSE2 kernel computing the dot products of one vector with four others.
+ * Writes the four dot products to out.
+ *
+ * Each load of x is reused for all four products, with any odd trailing dimension handled in scalar.
+ */
+__attribute__((target("sse2")))
+static void dot_product_4_sse2(const double* x, const double* p0, const double* p1, const double* p2, const double* p3, int dimensions, double* out) {
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd(), a2 = _mm_setzero_pd(), a3 = _mm_setzero_pd();
+    int i = 0;
+
+    for (; i + 2 <= dimensions; i += 2) {
+        __m128d v = _mm_loadu_pd(x + i);
+        a0 = _mm_add_pd(a0, _mm_mul_pd(v, _mm_loadu_pd(p0 + i)));
+        a1 = _mm_add_pd(a1, _mm_mul_pd(v, _mm_loadu_pd(p1 + i)));
+        a2 = _mm_add_pd(a2, _mm_mul_pd(v, _mm_loadu_pd(p2 + i)));
+        a3 = _mm_add_pd(a3, _mm_mul_pd(v, _mm_loadu_pd(p3 + i)));
+    }
+
+    // Transpose-add the accumulators so that each lane holds one complete dot product.
+    __m128d low = _mm_add_pd(_mm_unpacklo_pd(a0, a1), _mm_unpackhi_pd(a0, a1));
+    __m128d high = _mm_add_pd(_mm_unpacklo_pd(a2, a3), _mm_unpackhi_pd(a2, a3));
+    _mm_storeu_pd(out, low);
+    _mm_storeu_pd(out + 2, high);
+
+    if (i < dimensions) {
+        out[0] += x[i] * p0[i];
+        out[1] += x[i] * p1[i];
+        out[2] += x[i] * p2[i];
+        out[3] += x[i] * p3[i];
+    }
+}
+
+
+/*
+ * SSE2 single-precision squared distance kernel processing four dimensions per instruction.
+ * Returns the sum of the squared differences of each dimension.
+ *
+ * The last few dimensions are handled in scalar.
+ */
+__attribute__((target("sse2")))
+static inline float squared_distance_f_sse2(const float* a, const float* b, int dimensions) {
+    __m128 acc = _mm_setzero_ps();
+    int i = 0;
+
+    for (; i + 4 <= dimensions; i += 4) {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        acc = _mm_add_ps(acc, _mm_mul_ps(d0, d0));
+    }
+
+    __m128 pairs = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    float sum = _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+
+    for (; i < dimensions; i++) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+
+    return sum;
+}
+
+DEFINE_NEAREST_POINT(nearest_point_f_sse2, float, FLT_MAX, squared_distance_f_sse2, __attribute__((target("sse2"))))
+
+
+/*
+ * SSE2 int8 squared distance kernel, measuring x against each of num_points row-major points sixteen dimensions at a time.
+ * Writes the sum of the squared differences of each dimension for every point to distances.
+ *
+ * SSE2 has no sign extension, so each half of the bytes is unpacked against itself and shifted arithmetically into 16-bit lanes.
+ * The differences then fit in 16 bits, and a multiply-add squares and pairs them into 32-bit sums. Any trailing dimensions are handled in scalar.
+ */
+__attribute__((target("sse2")))
+static void squared_distances_i8_sse2(const int8_t* x, const int8_t* points, const int32_t* point_terms, int num_points, int dimensions, int32_t* distances) {
+    (void) point_terms;
+
+    for (int p = 0; p < num_points; p++) {
+        const int8_t* point = points + (size_t) p * (size_t) dimensions;
+        __m128i acc = _mm_setzero_si128();
+        int i = 0;
+
+        for (; i + 16 <= dimensions; i += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i*) (x + i));
+            __m128i b = _mm_loadu_si128((const __m128i*) (point + i));
+            __m128i low = _mm_sub_epi16(_mm_srai_epi16(_mm_unpacklo_epi8(a, a), 8), _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8));
+            __m128i high = _mm_sub_epi16(_mm_srai_epi16(_mm_unpackhi_epi8(a, a), 8), _mm_srai_epi16(_mm_unpackhi_epi8(b, b), 8));
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(low, low), _mm_madd_epi16(high, high)));
+        }
+
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        int32_t sum = _mm_cvtsi128_si32(acc);
+
+        for (; i < dimensions; i++) {
+            int32_t diff = (int32_t) x[i] - (int32_t) point[i];
+            sum += diff * diff;
+        }
+
+        distances[p] = sum;
+    }
+}
+
+
+/*
+ * AVX2 squared distance kernel processing four dimensions per instruction with fused multiply-adds.
+ * Returns the sum of the squared differences of each dimension.
+ *
+ * Two independent accumulators hide the latency of the fused multiply-adds, with the last few dimensions handled in scalar.
+ */
+__attribute__((target("avx2,fma")))
+static inline double squared_distance_avx2(const double* a, const double* b, int dimensions) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    int i = 0;
+
+    for (; i + 8 <= dimensions; i += 8) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm256_fmadd_pd(d1, d1, acc1);
+    }
+
+    if (i + 4 <= dimensions) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        i += 4;
+    }
+
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+
+    for (; i < dimensions; i++) {
+        double diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+
+    return sum;
+}
+
+DEFINE_NEAREST_POINT(nearest_point_avx2, double, DBL_MAX, squared_distance_avx2, __attribute__((target("avx2,fma"))))
+
+
+/*
+ * AVX2 kernel computing the dot products of one vector with four others using fused multiply-adds.
+ * Writes the four dot products to out.
+ *
+ * Each load of x is reused for all four products, and the four accumulators are reduced together with horizontal adds.
+ */
+__attribute__((target("avx2,fma")))
+static void dot_product_4_avx2(const double* x, const double* p0, const double* p1, const double* p2, const double* p3, int dimensions, double* out) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd(), a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+    int i = 0;
+
+    for (; i + 4 <= dimensions; i += 4) {
+        __m256d v = _mm256_loadu_pd(x + i);
+        a0 = _mm256_fmadd_pd(v, _mm256_loadu_pd(p0 + i), a0);
+        a1 = _mm256_fmadd_pd(v, _mm256_loadu_pd(p1 + i), a1);
+        a2 = _mm256_fmadd_pd(v, _mm256_loadu_pd(p2 + i), a2);
+        a3 = _mm256_fmadd_pd(v, _mm256_loadu_pd(p3 + i), a3);
+    }
+
+    __m256d pairs01 = _mm256_hadd_pd(a0, a1);
+    __m256d pairs23 = _mm256_hadd_pd(a2, a3);
+    __m256d sums = _mm256_add_pd(_mm256_permute2f128_pd(pairs01, pairs23, 0x20), _mm256_permute2f128_pd(pairs01, pairs23, 0x31));
+    _mm256_storeu_pd(out, sums);
+
+    for (; i < dimensions; i++) {
+        out[0] += x[i] * p0[i];
+        out[1] += x[i] * p1[i];
+        out[2] += x[i] * p2[i];
+        out[3] += x[i] * p3[i];
+    }
+}
+
+
+/*
+ * AVX2 single-precision squared distance kernel processing eight dimensions per instruction with fused multiply-adds.
+ * Returns the sum of the squared differences of each dimension.
+ *
+ * The last few dimensions are handled in scalar.
+ */
+__attribute__((target("avx2,fma")))
+static inline float squared_distance_f_avx2(const float* a, const float* b, int dimensions) {
+    __m256 acc = _mm256_setzero_ps();
+    int i = 0;
+
+    for (; i + 8 <= dimensions; i += 8) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc = _mm256_fmadd_ps(d0, d0, acc);
+    }
+
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    __m128 pairs = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    float sum = _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+
+    for (; i < dimensions; i++) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+
+    return sum;
+}
+
+DEFINE_NEAREST_POINT(nearest_point_f_avx2, float, FLT_MAX, squared_distance_f_avx2, __attribute__((target("avx2,fma"))))
+
+
+/*
+ * AVX2 int8 squared distance kernel, measuring x against each of num_points row-major points sixteen dimensions per instruction.
+ * Writes the sum of the squared differences of each dimension for every point to distances.
+ *
+ * The bytes are sign extended to 16-bit lanes, subtracted, and squared and paired into 32-bit sums by a single multiply-add.
+ * Each sum is at most 2 * 255^2 per pair, so 32-bit lanes cannot overflow below 32768 dimensions.
+ * Points are measured four at a time, reusing each load of x and reducing the four sums together with horizontal adds.
+ * Any trailing points and dimensions are handled one at a time.
+ */
+__attribute__((target("avx2,fma")))
+static void squared_distances_i8_avx2(const int8_t* x, const int8_t* points, const int32_t* point_terms, int num_points, int dimensions, int32_t* distances) {
+    (void) point_terms;
+
+    size_t stride = (size_t) dimensions;
+    int vector_dimensions = dimensions & ~15;
+    int p = 0;
+
+    for (; p + 4 <= num_points; p += 4) {
+        const int8_t* p0 = points + (size_t) p * stride;
+        __m256i acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+
+        for (int i = 0; i < vector_dimensions; i += 16) {
+            __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (x + i)));
+
+            for (int q = 0; q < 4; q++) {
+                __m256i diff = _mm256_sub_epi16(a, _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (p0 + q * stride + i))));
+                acc[q] = _mm256_add_epi32(acc[q], _mm256_madd_epi16(diff, diff));
+            }
+        }
+
+        __m256i pairs = _mm256_hadd_epi32(_mm256_hadd_epi32(acc[0], acc[1]), _mm256_hadd_epi32(acc[2], acc[3]));
+        __m128i sums = _mm_add_epi32(_mm256_castsi256_si128(pairs), _mm256_extracti128_si256(pairs, 1));
+
+        _mm_storeu_si128((__m128i*) (distances + p), sums);
+
+        for (int q = 0; q < 4; q++) {
+            for (int i = vector_dimensions; i < dimensions; i++) {
+                int32_t diff = (int32_t) x[i] - (int32_t) p0[q * stride + i];
+                distances[p + q] += diff * diff;
+            }
+        }
+    }
+
+    for (; p < num_points; p++) {
+        const int8_t* point = points + (size_t) p * stride;
+        __m256i acc = _mm256_setzero_si256();
+
+        for (int i = 0; i < vector_dimensions; i += 16) {
+            __m256i diff = _mm256_sub_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (x + i))), _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) (point + i))));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(diff, diff));
+        }
+
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+        int32_t sum = _mm_cvtsi128_si32(half);
+
+        for (int i = vector_dimensions; i < dimensions; i++) {
+            int32_t diff = (int32_t) x[i] - (int32_t) point[i];
+            sum += diff * diff;
+        }
+
+        distances[p] = sum;
+    }
+}
+
+
+/*
+ * AVX-512 squared distance kernel processing eight dimensions per instruction.
+ * Returns the sum of the squared differences of each dimension.
+ *
+ * Two independent accumulators hide the latency of the fused multiply-adds, and the remaining dimensions use a masked load.
+ */
+__attribute__((target("avx512f")))
+static inline double squared_distance_avx512(const double* a, const double* b, int dimensions) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    int i = 0;
+
+    for (; i + 16 <= dimensions; i += 16) {
+        __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+        __m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8));
+        acc0 = _mm512_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm512_fmadd_pd(d1, d1, acc1);
+    }
+
+    if (i + 8 <= dimensions) {
+        __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+        acc0 = _mm512_fmadd_pd(d0, d0, acc0);
+        i += 8;
+    }
+
+    if (i < dimensions) {
+        __mmask8 mask = (__mmask8) ((1u << (dimensions - i)) - 1u);
+        __m512d d0 = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, a + i), _mm512_maskz_loadu_pd(mask, b + i));
+        acc1 = _mm512_fmadd_pd(d0, d0, acc1);
+    }
+
+    return _mm512_reduce_add_pd(_mm512_add_pd(acc0, acc1));
+}
+
+DEFINE_NEAREST_POINT(nearest_point_avx512, double, DBL_MAX, squared_distance_avx512, __attribute__((target("avx512f"))))
+
+
+/*
+ * AVX-512 kernel computing the dot products of one vector with four others.
+ * Writes the four dot products to out.
+ *
+ * Each load of x is reused for all four products, and the remaining dimensions use masked loads.
+ */
+__attribute__((target("avx512f")))
+static void dot_product_4_avx512(const double* x, const double* p0, const double* p1, const double* p2, const double* p3, int dimensions, double* out) {
+    __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd(), a2 = _mm512_setzero_pd(), a3 = _mm512_setzero_pd();
+    int i = 0;
+
+    for (; i + 8 <= dimensions; i += 8) {
+        __m512d v = _mm512_loadu_pd(x + i);
+        a0 = _mm512_fmadd_pd(v, _mm512_loadu_pd(p0 + i), a0);
+        a1 = _mm512_fmadd_pd(v, _mm512_loadu_pd(p1 + i), a1);
+        a2 = _mm512_fmadd_pd(v, _mm512_loadu_pd(p2 + i), a2);
+        a3 = _mm512_fmadd_pd(v, _mm512_loadu_pd(p3 + i), a3);
+    }
+
+    if (i < dimensions) {
+        __mmask8 mask = (__mmask8) ((1u << (dimensions - i)) - 1u);
+        __m512d v = _mm512_maskz_loadu_pd(mask, x + i);
+        a0 = _mm512_fmadd_pd(v, _mm512_maskz_loadu_pd(mask, p0 + i), a0);
+        a1 = _mm512_fmadd_pd(v, _mm512_maskz_loadu_pd(mask, p1 + i), a1);
+        a2 = _mm512_fmadd_pd(v, _mm512_maskz_loadu_pd(mask, p2 + i), a2);
+        a3 = _mm512_fmadd_pd(v, _mm512_maskz_loadu_pd(mask, p3 + i), a3);
+    }
+
+    out[0] = _mm512_reduce_add_pd(a0);
+    out[1] = _mm512_reduce_add_pd(a1);
+    out[2] = _mm512_reduce_add_pd(a2);
+    out[3] = _mm512_reduce_add_pd(a3);
+}
+
+
+/*
+ * AVX-512 single-precision squared distance kernel processing sixteen dimensions per instruction.
+ * Returns the sum of the squared differences of each dimension.
+ *
+ * The remaining dimensions are processed with masked loads, so no scalar tail is needed.
+ */
+__attribute__((target("avx512f")))
+static inline float squared_distance_f_avx512(const float* a, const float* b, int dimensions) {
+    __m512 acc = _mm512_setzero_ps();
+    int i = 0;
+
+    for (; i + 16 <= dimensions; i += 16) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        acc = _mm512_fmadd_ps(d0, d0, acc);
+    }
+
+    if (i < dimensions) {
+        __mmask16 mask = (__mmask16) ((1u << (dimensions - i)) - 1u);
+        __m512 d0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+        acc = _mm512_fmadd_ps(d0, d0, acc);
+    }
+
+    return _mm512_reduce_add_ps(acc);
+}
+
+DEFINE_NEAREST_POINT(nearest_point_f_avx512, float, FLT_MAX, squared_distance_f_avx512, __attribute__((target("avx512f"))))
+
+
+/*
+ * AVX-512 VNNI int8 squared distance kernel, measuring x against each of num_points row-major points sixty-four dimensions per instruction.
+ * Writes the sum of the squared differences of each dimension for every point to distances.
+ *
+ * Expands each distance as ||x||^2 - 2 (x + 128).c + (||c||^2 + 256 sum(c)), using the point terms from prepare_points_i8.
+ * Flipping the sign bit of each byte of x gives x + 128 as an unsigned byte, so every product is accumulated by a single
+ * unsigned-by-signed dot product instruction straight into 32-bit lanes, without widening or saturation.
+ * Points are measured four at a time, reusing each load of x, with masked loads covering the trailing dimensions.
+ * The terms are combined in 64 bits, so the result is the same exact integer the other kernels compute.
+ */
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+static void squared_distances_i8_avx512(const int8_t* x, const int8_t* points, const int32_t* point_terms, int num_points, int dimensions, int32_t* distances) {
+    size_t stride = (size_t) dimensions;
+    const __m512i sign_bits = _mm512_set1_epi8((char) 0x80);
+    int64_t x_norm = 0;
+    int p = 0;
+
+    for (int i = 0; i < dimensions; i++) {
+        x_norm += (int32_t) x[i] * (int32_t) x[i];
+    }
+
+    for (; p + 4 <= num_points; p += 4) {
+        const int8_t* p0 = points + (size_t) p * stride;
+        __m512i acc[4] = {_mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512()};
+
+        for (int i = 0; i < dimensions; i += 64) {
+            __mmask64 mask = dimensions - i >= 64 ? ~(__mmask64) 0 : (((__mmask64) 1 << (dimensions - i)) - 1);
+            __m512i a = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, x + i), sign_bits);
+
+            for (int q = 0; q < 4; q++) {
+                acc[q] = _mm512_dpbusd_epi32(acc[q], a, _mm512_maskz_loadu_epi8(mask, p0 + q * stride + i));
+            }
+        }
+
+        for (int q = 0; q < 4; q++) {
+            distances[p + q] = (int32_t) (x_norm - 2 * (int64_t) _mm512_reduce_add_epi32(acc[q]) + point_terms[p + q]);
+        }
+    }
+
+    for (; p < num_points; p++) {
+        const int8_t* point = points + (size_t) p * stride;
+        __m512i acc = _mm512_setzero_si512();
+
+        for (int i = 0; i < dimensions; i += 64) {
+            __mmask64 mask = dimensions - i >= 64 ? ~(__mmask64) 0 : (((__mmask64) 1 << (dimensions - i)) - 1);
+            __m512i a = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, x + i), sign_bits);
+            acc = _mm512_dpbusd_epi32(acc, a, _mm512_maskz_loadu_epi8(mask, point + i));
+        }
+
+        distances[p] = (int32_t) (x_norm - 2 * (int64_t) _mm512_reduce_add_epi32(acc) + point_terms[p]);
+    }
+}
+
+#endif /* For DISTANCE_HAVE_X86_KERNELS */
+
+
+/*
+ * Define a typed struct holding the entry points of a single kernel.
+ */
+typedef struct {
+    CMLDistanceKernel kernel;
+    double (*distance)(const double*, const double*, int);
+    int (*nearest)(const double*, const double*, int, int, double*);
+    void (*dot4)(const double*, const double*, const double*, const double*, const double*, int, double*);
+    float (*distance_f)(const float*, const float*, int);
+    int (*nearest_f)(const float*, const float*, int, int, float*);
+    void (*distances_i8)(const int8_t*, const int8_t*, const int32_t*, int, int, int32_t*);
+} DistanceKernelTable;
+
+/*
+ * The kernel table used by squared_distance and nearest_point.
+ * It starts as the scalar kernel and is upgraded to the best supported kernel when the library is loaded.
+ * The AVX-512 entry only uses the AVX-512 int8 kernel on CPUs with AVX-512BW and VNNI, keeping the AVX2 one otherwise.
+ */
+static DistanceKernelTable active_kernel = {DISTANCE_KERNEL_SCALAR, squared_distance_scalar, nearest_point_scalar, dot_product_4_scalar, squared_distance_f_scalar, nearest_point_f_scalar, squared_distances_i8_scalar};
+
+
+/*
+ * Helper function to check whether the running CPU supports a given kernel.
+ * Returns a non-zero value if the kernel is supported, and zero otherwise.
+ *
+ * Support is detected through CPUID (via the compiler's CPU model builtins), which also accounts for the OS saving the wider registers.
+ */
+static int kernel_is_supported(CMLDistanceKernel kernel) {
+    switch (kernel) {
+        case DISTANCE_KERNEL_SCALAR:
+            return 1;
+#if DISTANCE_HAVE_X86_KERNELS
+        case DISTANCE_KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case DISTANCE_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case DISTANCE_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return 0;
+    }
+}
+
+
+/*
+ * Selects the kernel used by squared_distance and nearest_point for the whole process.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if the running CPU does not support the kernel.
+ *
+ * The automatic selection tries each kernel from the widest to the narrowest and keeps the first that is supported.
+ * The selection is not synchronised, so it should be made before any model is fitted or used for prediction.
+ */
+int select_distance_kernel(CMLDistanceKernel kernel) {
+#if DISTANCE_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+#endif
+
+    if (kernel == DISTANCE_KERNEL_AUTO) {
+        CMLDistanceKernel preferred[] = {DISTANCE_KERNEL_AVX512, DISTANCE_KERNEL_AVX2, DISTANCE_KERNEL_SSE2, DISTANCE_KERNEL_SCALAR};
+
+        for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); i++) {
+            if (kernel_is_supported(preferred[i])) {
+                return select_distance_kernel(preferred[i]);
+            }
+        }
+    }
+
+    if (!kernel_is_supported(kernel)) {
+        return EXIT_FAILURE;
+    }
+
+    switch (kernel) {
+#if DISTANCE_HAVE_X86_KERNELS
+        case DISTANCE_KERNEL_SSE2:
+            active_kernel = (DistanceKernelTable) {kernel, squared_distance_sse2, nearest_point_sse2, dot_product_4_sse2, squared_distance_f_sse2, nearest_point_f_sse2, squared_distances_i8_sse2};
+            break;
+        case DISTANCE_KERNEL_AVX2:
+            active_kernel = (DistanceKernelTable) {kernel, squared_distance_avx2, nearest_point_avx2, dot_product_4_avx2, squared_distance_f_avx2, nearest_point_f_avx2, squared_distances_i8_avx2};
+            break;
+        case DISTANCE_KERNEL_AVX512:
+            active_kernel = (DistanceKernelTable) {kernel, squared_distance_avx512, nearest_point_avx512, dot_product_4_avx512, squared_distance_f_avx512, nearest_point_f_avx512,
+                                                   __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni") ? squared_distances_i8_avx512 : squared_distances_i8_avx2};
+            break;
+#endif
+        default:
+            active_kernel = (DistanceKernelTable) {DISTANCE_KERNEL_SCALAR, squared_distance_scalar, nearest_point_scalar, dot_product_4_scalar, squared_distance_f_scalar, nearest_point_f_scalar, squared_distances_i8_scalar};
+            break;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Load-time constructor that dispatches to the best kernel supported by the running CPU.
+ */
+__attribute__((constructor))
+static void initialise_distance_kernel(void) {
+    select_distance_kernel(DISTANCE_KERNEL_AUTO);
+}
+
+
+/*
+ * Returns the kernel currently used by squared_distance and nearest_point.
+ */
+CMLDistanceKernel active_distance_kernel(void) {
+    return active_kernel.kernel;
+}
+
+
+/*
+ * Calculates the squared Euclidean distance between two points of a given dimensionality.
+ * Returns the sum of the squared differences of each dimension.
+ *
+ * Dispatches to the kernel selected for the running CPU.
+ */
+double squared_distance(const double* a, const double* b, int dimensions) {
+    return active_kernel.distance(a, b, dimensions);
+}
+
+
+/*
+ * Locates the point nearest to x among num_points row-major points of a given dimensionality.
+ * Returns the index of the first point with minimal squared distance, storing that distance in min_distance if it is non-null.
+ *
+ * Dispatches to the search loop of the kernel selected for the running CPU, so there is a single indirect call per query.
+ */
+int nearest_point(const double* x, const double* points, int num_points, int dimensions, double* min_distance) {
+    return active_kernel.nearest(x, points, num_points, dimensions, min_distance);
+}
+
+
+/*
+ * Calculates the squared Euclidean distance between two single-precision points of a given dimensionality.
+ * Returns the sum of the squared differences of each dimension, accumulated in single precision.
+ *
+ * Dispatches to the kernel selected for the running CPU, which processes twice as many dimensions per instruction as squared_distance.
+ */
+float squared_distance_f(const float* a, const float* b, int dimensions) {
+    return active_kernel.distance_f(a, b, dimensions);
+}
+
+
+/*
+ * Locates the single-precision point nearest to x among num_points row-major points of a given dimensionality.
+ * Returns the index of the first point with minimal squared distance, storing that distance in min_distance if it is non-null.
+ *
+ * Dispatches to the search loop of the kernel selected for the running CPU, so there is a single indirect call per query.
+ */
+int nearest_point_f(const float* x, const float* points, int num_points, int dimensions, float* min_distance) {
+    return active_kernel.nearest_f(x, points, num_points, dimensions, min_distance);
+}
+
+
+/*
+ * Computes the term of each of num_points row-major int8 points that squared_distances_i8 needs, ||c||^2 + 256 sum(c).
+ * Writes each point's term to terms, which cannot overflow below 32768 dimensions.
+ */
+void prepare_points_i8(const int8_t* points, int num_points, int dimensions, int32_t* terms) {
+    for (int p = 0; p < num_points; p++) {
+        const int8_t* point = points + (size_t) p * (size_t) dimensions;
+        int32_t norm = 0;
+        int32_t sum = 0;
+
+        for (int i = 0; i < dimensions; i++) {
+            norm += (int32_t) point[i] * (int32_t) point[i];
+            sum += point[i];
+        }
+
+        terms[p] = norm + 256 * sum;
+    }
+}
+
+
+/*
+ * Calculates the squared Euclidean distance from an int8 point to each of num_points row-major int8 points of a given dimensionality.
+ * Writes each exact integer distance to distances, which cannot overflow below 32768 dimensions.
+ *
+ * Dispatches to the kernel selected for the running CPU, so there is a single indirect call per query.
+ * Only the dot product kernel reads the point terms, but they must always be those of prepare_points_i8, so every kernel agrees.
+ */
+void squared_distances_i8(const int8_t* x, const int8_t* points, const int32_t* point_terms, int num_points, int dimensions, int32_t* distances) {
+    active_kernel.distances_i8(x, points, point_terms, num_points, dimensions, distances);
+}
+
+
+/*
+ * Computes the dot products of one vector with four others of the same dimensionality.
+ * Writes the four dot products to out.
+ *
+ * Dispatches to the kernel selected for the running CPU.
+ */
+void dot_product_4(const double* x, const double* p0, const double* p1, const double* p2, const double* p3, int dimensions, double* out) {
+    active_kernel.dot4(x, p0, p1, p2, p3, dimensions, out);
+}
+
+
+/*
+ * Locates the nearest of num_points row-major points for each of num_rows rows, given the squared norm of every point.
+ * Writes the index of each row's nearest point to labels, and its squared distance to min_distances if that is non-null.
+ *
+ * Expands each squared distance as ||x||^2 - 2 x.c + ||c||^2, so the search is a blocked matrix product followed by an argmin.
+ * ||x||^2 is constant per row, so only ||c||^2 - 2 x.c is compared, and it is added back only when distances are requested.
+ * Rows are processed in tiles of NEAREST_ROW_TILE, sweeping tiles of points sized to NEAREST_POINT_TILE_BYTES so that they stay in cache.
+ * Each dot product kernel call computes a row's products with four points, reusing every load of the row.
+ * Points are swept in ascending order with a strict comparison, so ties are resolved in favour of the lowest index.
+ * The expansion can differ from a direct evaluation by rounding, so rows almost equidistant from two points may pick either.
+ */
+void nearest_points_blocked(const double* rows, int row_stride, int num_rows, const double* points, const double* point_norms, int num_points, int dimensions, int* labels, double* min_distances) {
+    int point_tile = (int) (NEAREST_POINT_TILE_BYTES / ((size_t) (dimensions > 0 ? dimensions : 1) * sizeof(double))) & ~3;
+    double best[NEAREST_ROW_TILE];
+    double dots[4];
+
+    if (point_tile < 4) point_tile = 4;
+
+    for (int r0 = 0; r0 < num_rows; r0 += NEAREST_ROW_TILE) {
+        int r1 = r0 + NEAREST_ROW_TILE < num_rows ? r0 + NEAREST_ROW_TILE : num_rows;
+
+        for (int r = r0; r < r1; r++) {
+            best[r - r0] = DBL_MAX;
+            labels[r] = 0;
+        }
+
+        for (int c0 = 0; c0 < num_points; c0 += point_tile) {
+            int c1 = c0 + point_tile < num_points ? c0 + point_tile : num_points;
+
+            for (int r = r0; r < r1; r++) {
+                const double* x = rows + (size_t) r * (size_t) row_stride;
+
+                for (int c = c0; c < c1; c += 4) {
+                    int width = c1 - c < 4 ? c1 - c : 4;
+                    const double* p[4];
+
+                    // Pad a partial group of points by repeating its last point, whose extra products are ignored.
+                    for (int q = 0; q < 4; q++) {
+                        p[q] = points + (size_t) (c + (q < width ? q : width - 1)) * (size_t) dimensions;
+                    }
+
+                    active_kernel.dot4(x, p[0], p[1], p[2], p[3], dimensions, dots);
+
+                    for (int q = 0; q < width; q++) {
+                        double score = point_norms[c + q] - 2.0 * dots[q];
+
+                        if (score < best[r - r0]) {
+                            best[r - r0] = score;
+                            labels[r] = c + q;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (min_distances == NULL) continue;
+
+        for (int r = r0; r < r1; r++) {
+            const double* x = rows + (size_t) r * (size_t) row_stride;
+            double norm = 0.0;
+
+            for (int j = 0; j < dimensions; j++) {
+                norm += x[j] * x[j];
+            }
+
+            min_distances[r] = best[r - r0] + norm > 0.0 ? best[r - r0] + norm : 0.0;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef DISTANCE_H
+#define DISTANCE_H
+
+#include <stdint.h>
+
+/*
+ * Define an enumeration of the squared distance kernels the library can dispatch to.
+ * DISTANCE_KERNEL_AUTO selects the widest instruction set supported by the running CPU.
+ */
+typedef enum {
+    DISTANCE_KERNEL_AUTO,
+    DISTANCE_KERNEL_SCALAR,
+    DISTANCE_KERNEL_SSE2,
+    DISTANCE_KERNEL_AVX2,
+    DISTANCE_KERNEL_AVX512
+} CMLDistanceKernel;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Calculates the squared Euclidean distance between two points of a given dimensionality.
+ * Returns the sum of the squared differences of each dimension.
+ */
+double squared_distance(const double* a, const double* b, int dimensions);
+
+/*
+ * Locates the point nearest to x among num_points row-major points of a given dimensionality.
+ * Returns the index of the first point with minimal squared distance, storing that distance in min_distance if it is non-null.
+ */
+int nearest_point(const double* x, const double* points, int num_points, int dimensions, double* min_distance);
+
+/*
+ * Calculates the squared Euclidean distance between two single-precision points of a given dimensionality.
+ * Returns the sum of the squared differences of each dimension, accumulated in single precision.
+ */
+float squared_distance_f(const float* a, const float* b, int dimensions);
+
+/*
+ * Locates the single-precision point nearest to x among num_points row-major points of a given dimensionality.
+ * Returns the index of the first point with minimal squared distance, storing that distance in min_distance if it is non-null.
+ */
+int nearest_point_f(const float* x, const float* points, int num_points, int dimensions, float* min_distance);
+
+/*
+ * Computes the term of each of num_points row-major int8 points that squared_distances_i8 needs, ||c||^2 + 256 sum(c).
+ * Writes each point's term to terms.
+ */
+void prepare_points_i8(const int8_t* points, int num_points, int dimensions, int32_t* terms);
+
+/*
+ * Calculates the squared Euclidean distance from an int8 point to each of num_points row-major int8 points of a given dimensionality,
+ * given each point's term from prepare_points_i8.
+ * Writes each exact integer distance to distances, which cannot overflow below 32768 dimensions.
+ */
+void squared_distances_i8(const int8_t* x, const int8_t* points, const int32_t* point_terms, int num_points, int dimensions, int32_t* distances);
+
+/*
+ * Computes the dot products of one vector with four others of the same dimensionality.
+ * Writes the four dot products to out.
+ */
+void dot_product_4(const double* x, const double* p0, const double* p1, const double* p2, const double* p3, int dimensions, double* out);
+
+/*
+ * Locates the nearest of num_points row-major points for each of num_rows rows (row_stride values apart), given each point's squared norm.
+ * Writes each row's nearest point index to labels, and its squared distance to min_distances if that is non-null.
+ */
+void nearest_points_blocked(const double* rows, int row_stride, int num_rows, const double* points, const double* point_norms, int num_points, int dimensions, int* labels, double* min_distances);
+
+/*
+ * Selects the kernel used by every distance and dot product function for the whole process.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if the running CPU does not support the kernel.
+ */
+int select_distance_kernel(CMLDistanceKernel kernel);
+
+/*
+ * Returns the kernel currently used by the distance and dot product functions.
+ */
+CMLDistanceKernel active_distance_kernel(void);
+
+#endif /* For DISTANCE_H */
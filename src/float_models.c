@@ -0,0 +1,43 @@
+#include "float_models.h"
+#include "k_means_internal.h"
+#include "distance.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * The number of rows labelled by each task of a batch prediction.
+ */
+#define FLOAT_KMEANS_LABEL_BLOCK 1024
+
+
+/*
+ * Instantiate the single-precision models.
+ */
+#define CML_ACCUM float
+#define CML_SUFFIX _f
+#define CML_KMEANS KMeansF
+#define CML_LINEAR_REGRESSION LinearRegressionF
+#include "k_means_template.inc"
+#include "linear_regression_template.inc"
+#undef CML_ACCUM
+#undef CML_SUFFIX
+#undef CML_KMEANS
+#undef CML_LINEAR_REGRESSION
+
+
+/*
+ * Instantiate the mixed-precision models.
+ */
+#define CML_ACCUM double
+#define CML_SUFFIX _mixed
+#define CML_KMEANS KMeansMixed
+#define CML_LINEAR_REGRESSION LinearRegressionMixed
+#include "k_means_template.inc"
+#include "linear_regression_template.inc"
+#undef CML_ACCUM
+#undef CML_SUFFIX
+#undef CML_KMEANS
+#undef CML_LINEAR_REGRESSION
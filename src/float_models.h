@@ -0,0 +1,49 @@
+#ifndef FLOAT_MODELS_H
+#define FLOAT_MODELS_H
+
+#include <stdint.h>
+#include "matrix.h"
+#include "parallel.h"
+#include "rng.h"
+#include "k_means.h"
+
+/*
+ * Helper macros to append the instantiation's suffix to a function name, expanding the suffix first.
+ * CML_TYPED_NAME gives the suffixed name as a string literal, for error messages.
+ */
+#define CML_CONCAT_(a, b) a##b
+#define CML_CONCAT(a, b) CML_CONCAT_(a, b)
+#define CML_TYPED(name) CML_CONCAT(name, CML_SUFFIX)
+#define CML_STRINGIFY_(name) #name
+#define CML_STRINGIFY(name) CML_STRINGIFY_(name)
+#define CML_TYPED_NAME(name) CML_STRINGIFY(CML_TYPED(name))
+
+/*
+ * Single-precision models, with the _f suffix, store and accumulate everything as floats.
+ */
+#define CML_ACCUM float
+#define CML_SUFFIX _f
+#define CML_KMEANS KMeansF
+#define CML_LINEAR_REGRESSION LinearRegressionF
+#include "k_means_template.h"
+#include "linear_regression_template.h"
+#undef CML_ACCUM
+#undef CML_SUFFIX
+#undef CML_KMEANS
+#undef CML_LINEAR_REGRESSION
+
+/*
+ * Mixed-precision models, with the _mixed suffix, store samples and centroids as floats but accumulate sums and weights as doubles.
+ */
+#define CML_ACCUM double
+#define CML_SUFFIX _mixed
+#define CML_KMEANS KMeansMixed
+#define CML_LINEAR_REGRESSION LinearRegressionMixed
+#include "k_means_template.h"
+#include "linear_regression_template.h"
+#undef CML_ACCUM
+#undef CML_SUFFIX
+#undef CML_KMEANS
+#undef CML_LINEAR_REGRESSION
+
+#endif /* For FLOAT_MODELS_H */
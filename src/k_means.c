@@ -1,25 +1,119 @@
 #include "k_means.h"
+#include "k_means_internal.h"
+#include "distance.h"
+#include "model_file.h"
+#include "perf_counters.h"
+#include "parallel.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
-#include <float.h>
 #include <time.h>
+#include <sys/mman.h>
+
+/*
+ * The number of rows labelled by each task of a labelling pass outside of a full fit.
+ */
+#define KMEANS_LABEL_BLOCK 1024
+
+/*
+ * The relative margin by which the Elkan and Hamerly distance bounds are loosened whenever centroids move.
+ * This absorbs floating-point rounding so that a bound never wrongly prunes the centroid Lloyd's algorithm would choose.
+ */
+#define KMEANS_BOUND_SLACK 1e-12
+
+/*
+ * Define a typed struct holding the state of a single fit, shared by every partition task.
+ * The samples are split into num_partitions fixed row ranges, each owning a private block of k cluster sums and counts.
+ * The remaining arrays are only allocated for the bounded algorithms:
+ * - upper holds an upper bound on each sample's distance to its assigned centroid.
+ * - lower holds k lower bounds per sample for Elkan, or a single bound on the second closest centroid per sample for Hamerly.
+ * - centroid_distances holds the k by k distances between centroids (Elkan only).
+ * - half_separation holds half of each centroid's distance to its nearest other centroid.
+ * - shifts holds how far each centroid moved in the previous update, with the two largest shifts cached for Hamerly.
+ * Each partition also records how many of its labels changed, how many distances it evaluated and its inertia, which is only exact when track_inertia is set.
+ * Every array is carved from the model's workspace, and mark records where to release them back to.
+ */
+typedef struct {
+    KMeans* km;
+    const CMLMatrix* X;
+    int* labels;
+    double* sums;
+    int* counts;
+    int num_partitions;
+    int iteration;
+    int track_inertia;
+    long long* partition_changes;
+    double* partition_inertia;
+    long long* partition_distances;
+    double* upper;
+    double* lower;
+    double* centroid_distances;
+    double* half_separation;
+    double* shifts;
+    double* previous_centroids;
+    int max_shift_index;
+    double max_shift;
+    double second_max_shift;
+    size_t mark;
+} KMeansFit;
+
+
+/*
+ * Helper function to obtain a pointer to the given centroid of a KMeans model.
+ * Returns a pointer to the first value of the centroid within the model's flat centroid buffer.
+ */
+static inline double* centroid_at(const KMeans* km, int cluster) {
+    return km->centroids + (size_t) cluster * (size_t) km->num_variables;
+}
+
+
+/*
+ * Helper function to locate the centroid nearest to a data point.
+ * Returns the index of the closest centroid, storing its squared distance in distance if that is non-null.
+ *
+ * Only the argmin is needed, so squared Euclidean distances are compared and no square roots are taken.
+ * The comparison runs in the vectorised distance kernel selected for the running CPU.
+ * If the model has an index, it is searched instead of scanning every centroid.
+ */
+static int nearest_centroid(const KMeans* km, const double* x, double* distance) {
+    if (km->index != NULL) return centroid_index_nearest(km->index, x, distance);
+
+    return nearest_point(x, km->centroids, km->k, km->num_variables, distance);
+}
+
+
+/*
+ * Define a typed struct describing a labelling of the rows of a matrix, shared by every block task.
+ */
+typedef struct {
+    const KMeans* km;
+    const CMLMatrix* X;
+    int* labels;
+    const double* centroid_norms;
+} KMeansLabelling;
 
 
 /*
- * Helper function to calculate the Euclidean distance between two points of a given dimensionality.
- * Returns the absolute distance between the two points.
+ * Assigns each data point of a single block of KMEANS_LABEL_BLOCK rows to the KMeans model's closest centroid.
+ * Runs as a parallel_for task, so it only writes to the labels of its own rows.
  *
- * Sums the squared difference of each dimension and returns the square root of that summation.
+ * When the labelling carries centroid norms, the block is labelled by the cache-blocked expanded distance search instead.
  */
-static double calculate_distance(double* a, double* b, int dimensions) {
-    double sum = 0.0;
+static void assign_label_block(void* arg, int block) {
+    KMeansLabelling* labelling = (KMeansLabelling*) arg;
+    const KMeans* km = labelling->km;
+    int start = block * KMEANS_LABEL_BLOCK;
+    int end = start + KMEANS_LABEL_BLOCK < labelling->X->num_rows ? start + KMEANS_LABEL_BLOCK : labelling->X->num_rows;
 
-    for (int i = 0; i < dimensions; ++i) {
-        sum += pow(a[i] - b[i], 2);
+    if (labelling->centroid_norms != NULL) {
+        nearest_points_blocked(matrix_row(labelling->X, start), labelling->X->stride, end - start, km->centroids, labelling->centroid_norms, km->k, km->num_variables, labelling->labels + start, NULL);
+        return;
     }
 
-    return sqrt(sum);
+    for (int i = start; i < end; i++) {
+        labelling->labels[i] = nearest_centroid(labelling->km, matrix_row(labelling->X, i), NULL);
+    }
 }
 
 
@@ -27,135 +121,406 @@ static double calculate_distance(double* a, double* b, int dimensions) {
  * Assigns each data point in a given sample to the KMeans model's closest centroid.
  * Updates the labels array with the index of the closest centroid for each data point.
  *
- * Iterates over each data point with an initially infinite minimal distance.
- * The Euclidean distance is calculated between the data point and each centroid to locate the minima.
- * The closest centroid's label is assigned to the data points corresponding position in the labels array.
- */
-static void assign_labels(const KMeans* km, double** X, int num_samples, int* labels) {
-    for (int i = 0; i < num_samples; i++) {
-        // Initially set the minimum distance to the maximum double value (acting as infinity).
-        double min_distance = DBL_MAX;
-        int label = 0;
-
-        // Obtain the minimal cluster index and assign it as the data point's label.
-        for (int j = 0; j < km->k; j++) {
-            double distance = calculate_distance(X[i], km->centroids[j], km->num_variables);
-
-            if (distance < min_distance) {
-                min_distance = distance;
-                label = j;
-            }
+ * Splits the rows of the sample matrix into blocks which are labelled concurrently across the given number of threads.
+ */
+static void assign_labels(const KMeans* km, const CMLMatrix* X, int* labels, int num_threads) {
+    KMeansLabelling labelling = {km, X, labels, NULL};
+    int num_blocks = (X->num_rows + KMEANS_LABEL_BLOCK - 1) / KMEANS_LABEL_BLOCK;
+
+    parallel_for_in(km->context, num_blocks, num_threads, assign_label_block, &labelling);
+}
+
+
+/*
+ * Calculates how many accumulation partitions a fit over num_samples rows uses, given the size of each sum and each count it keeps per centroid.
+ * Returns a partition count that depends only on the problem size, never on the thread count.
+ *
+ * Each partition holds at least KMEANS_PARTITION_ROWS rows, with at most KMEANS_MAX_PARTITIONS partitions in total.
+ * The count is further limited so that the private sums of every partition fit within KMEANS_PARTITION_BUDGET bytes.
+ * Every fit that must match fit_k_means bit for bit, in process or sharded, takes its partitions from here.
+ */
+int count_partitions(long long num_samples, int k, int num_variables, size_t accum_size, size_t count_size) {
+    size_t partition_bytes = (size_t) k * ((size_t) num_variables * accum_size + count_size);
+    size_t max_partitions = KMEANS_PARTITION_BUDGET / partition_bytes;
+    long long partitions = (num_samples + KMEANS_PARTITION_ROWS - 1) / KMEANS_PARTITION_ROWS;
+
+    if (partitions > KMEANS_MAX_PARTITIONS) partitions = KMEANS_MAX_PARTITIONS;
+    if ((size_t) partitions > max_partitions) partitions = (long long) max_partitions;
+
+    return partitions > 0 ? (int) partitions : 1;
+}
+
+
+/*
+ * Calculates the first row of a partition, dividing the rows as evenly as possible in ascending order.
+ * Returns the index of the partition's first row, which is num_samples for partition num_partitions.
+ */
+long long partition_start(long long num_samples, int num_partitions, int partition) {
+    return num_samples * partition / num_partitions;
+}
+
+
+/*
+ * Obtains the half-open row range [start, end) covered by a partition of an in-memory fit.
+ */
+void partition_bounds(int num_samples, int num_partitions, int partition, int* start, int* end) {
+    *start = (int) partition_start(num_samples, num_partitions, partition);
+    *end = (int) partition_start(num_samples, num_partitions, partition + 1);
+}
+
+
+/*
+ * Computes the distances from one centroid to every other centroid, and half the distance to the nearest of them.
+ * Runs as a parallel_for task over centroids, writing only that centroid's row of distances and its half separation.
+ *
+ * The full row is only stored for Elkan, as Hamerly needs nothing beyond the half separation.
+ */
+static void compute_centroid_separation(void* arg, int c) {
+    KMeansFit* fit = (KMeansFit*) arg;
+    const KMeans* km = fit->km;
+    double nearest = INFINITY;
+
+    for (int j = 0; j < km->k; j++) {
+        double distance = j == c ? 0.0 : sqrt(squared_distance(centroid_at(km, c), centroid_at(km, j), km->num_variables));
+
+        if (fit->centroid_distances != NULL) {
+            fit->centroid_distances[(size_t) c * (size_t) km->k + (size_t) j] = distance;
         }
 
-        labels[i] = label;
+        if (j != c && distance < nearest) {
+            nearest = distance;
+        }
     }
+
+    fit->half_separation[c] = 0.5 * nearest;
 }
 
 
 /*
- * Updates the centroids of the KMeans model based on the current cluster assignments.
- * Calculates the new centroids by averaging the data points assigned to a particular cluster.
- * Returns EXIT_SUCCESS on completion, and EXIT_FAILURE otherwise.
- * 
- * Dynamically allocates memory for a summation array that stores the accumulation of a cluster's data points.
- * Also dynamically allocates memory for a counting array that holds the quantity the data points belonging to each cluster.
- * At any point, if a dynamic allocation fails, the allocated memory is freed and the functions returns a failure exit value.
- * Iterates over the samples and accumulates the data points and the quantity of them belonging to each cluster.
- * Computes the new centroid locations by averaging the accumulated summations according to the corresponding quantities.
- * Updates the centroid locations in the KMeans model with these new computed locations.
- * Once the update has completed, the allocated memory is freed and the function returns a success exit value.
- */
-static int update_centroids(KMeans* km, double** X, int num_samples, const int* labels) {
-    // Allocate memory for the summation array.
-    double** sum = (double**) calloc(km->k, sizeof(double*));
-
-    if (sum == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for cluster summation array\n");
-        free(sum);
+ * Assigns a data point to its nearest centroid by evaluating the distance to every centroid, initialising its bounds.
+ * Returns the index of the closest centroid.
+ *
+ * Squared distances are compared in index order with a strict inequality, exactly as Lloyd's assignment does.
+ * Elkan records every distance as a lower bound, while Hamerly records only the distance to the second closest centroid.
+ * Every distance evaluated is added to the count in evaluated.
+ */
+static int assign_exhaustively(KMeansFit* fit, int i, const double* x, long long* evaluated) {
+    const KMeans* km = fit->km;
+    double* lower = km->algorithm == KMEANS_ELKAN ? fit->lower + (size_t) i * (size_t) km->k : NULL;
+    double best = INFINITY;
+    double second = INFINITY;
+    int label = 0;
 
-        return EXIT_FAILURE;
+    for (int j = 0; j < km->k; j++) {
+        double distance = squared_distance(x, centroid_at(km, j), km->num_variables);
+
+        if (lower != NULL) lower[j] = sqrt(distance);
+
+        if (distance < best) {
+            second = best;
+            best = distance;
+            label = j;
+        } else if (distance < second) {
+            second = distance;
+        }
     }
 
-    // Allocate memory for the quantity array.
-    int* count = (int*) calloc(km->k, sizeof(int));
+    fit->upper[i] = sqrt(best);
+    *evaluated += km->k;
 
-    if (count == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for cluster quantity array\n");
-        free(sum);
-        free(count);
+    if (lower == NULL) fit->lower[i] = sqrt(second);
 
-        return EXIT_FAILURE;
+    return label;
+}
+
+
+/*
+ * Assigns a data point to its nearest centroid using Elkan's bounds.
+ * Returns the index of the closest centroid.
+ *
+ * First loosens the point's bounds by how far each centroid moved in the previous update.
+ * The point keeps its label outright if its upper bound is below half its centroid's separation from every other centroid.
+ * Otherwise each other centroid is only evaluated if neither its lower bound nor half its distance to the current centroid rules it out.
+ * The upper bound is tightened to the exact distance at most once, the first time a centroid cannot be ruled out.
+ * Pruning uses strict inequalities and ties go to the lower index, so the chosen centroid matches Lloyd's.
+ * Every distance evaluated is added to the count in evaluated.
+ */
+static int assign_elkan(KMeansFit* fit, int i, const double* x, long long* evaluated) {
+    const KMeans* km = fit->km;
+    int k = km->k;
+    double* lower = fit->lower + (size_t) i * (size_t) k;
+    int label = fit->labels[i];
+    double upper = (fit->upper[i] + fit->shifts[label]) * (1.0 + KMEANS_BOUND_SLACK);
+
+    for (int j = 0; j < k; j++) {
+        double bound = (lower[j] - fit->shifts[j]) * (1.0 - KMEANS_BOUND_SLACK);
+        lower[j] = bound > 0.0 ? bound : 0.0;
     }
 
-    // Populate the summation array with zeroed data point for each cluster.
-    for (int i = 0; i < km->k; i++) {
-        sum[i] = (double*) calloc(km->num_variables, sizeof(double));
+    if (upper < fit->half_separation[label]) {
+        fit->upper[i] = upper;
+        return label;
+    }
 
-        if (sum[i] == NULL) {
-            fprintf(stderr, "Error: Failed to allocate memory for sum %d\n", i);
+    int is_tight = 0;
+    double label_distance = 0.0;
 
-            for (int j = 0; j < i; j++) {
-                free(sum[j]);
-            }
+    for (int j = 0; j < k; j++) {
+        if (j == label) continue;
+
+        double half_gap = 0.5 * fit->centroid_distances[(size_t) label * (size_t) k + (size_t) j];
+        double bound = lower[j] > half_gap ? lower[j] : half_gap;
 
-            free(sum);
-            free(count);
+        if (upper < bound) continue;
 
-            return EXIT_FAILURE;
+        // Tighten the upper bound to the exact distance and check whether that alone rules the centroid out.
+        if (!is_tight) {
+            label_distance = squared_distance(x, centroid_at(km, label), km->num_variables);
+            upper = sqrt(label_distance);
+            (*evaluated)++;
+            lower[label] = upper;
+            is_tight = 1;
+
+            if (upper < bound) continue;
+        }
+
+        double distance = squared_distance(x, centroid_at(km, j), km->num_variables);
+        lower[j] = sqrt(distance);
+        (*evaluated)++;
+
+        if (distance < label_distance || (distance == label_distance && j < label)) {
+            label = j;
+            label_distance = distance;
+            upper = lower[j];
         }
     }
 
-    // Iterate over each data point to accumulate the cluster summations.
-    for (int i = 0; i < num_samples; i++) {
-        int label = labels[i];
+    fit->upper[i] = upper;
 
-        for (int j = 0; j < km->num_variables; j++) {
-            sum[label][j] += X[i][j];
+    return label;
+}
+
+
+/*
+ * Assigns a data point to its nearest centroid using Hamerly's bounds.
+ * Returns the index of the closest centroid.
+ *
+ * First loosens the point's bounds by how far its centroid, and the furthest moving other centroid, moved in the previous update.
+ * The point keeps its label if its upper bound is below both its lower bound and half its centroid's separation.
+ * If not, the upper bound is tightened to the exact distance and checked again before falling back to evaluating every centroid.
+ * Every distance evaluated is added to the count in evaluated.
+ */
+static int assign_hamerly(KMeansFit* fit, int i, const double* x, long long* evaluated) {
+    const KMeans* km = fit->km;
+    int label = fit->labels[i];
+    double other_shift = label == fit->max_shift_index ? fit->second_max_shift : fit->max_shift;
+    double upper = (fit->upper[i] + fit->shifts[label]) * (1.0 + KMEANS_BOUND_SLACK);
+    double lower = (fit->lower[i] - other_shift) * (1.0 - KMEANS_BOUND_SLACK);
+    double bound = lower > fit->half_separation[label] ? lower : fit->half_separation[label];
+
+    fit->lower[i] = lower;
+
+    if (upper < bound) {
+        fit->upper[i] = upper;
+        return label;
+    }
+
+    upper = sqrt(squared_distance(x, centroid_at(km, label), km->num_variables));
+    (*evaluated)++;
+
+    if (upper < bound) {
+        fit->upper[i] = upper;
+        return label;
+    }
+
+    return assign_exhaustively(fit, i, x, evaluated);
+}
+
+
+/*
+ * Helper function to assign a single data point to its nearest centroid with the model's algorithm.
+ * Returns the index of the closest centroid, storing its squared distance in distance when the fit tracks inertia.
+ *
+ * The bounded algorithms evaluate every centroid on the first iteration to initialise their bounds.
+ * Since they rarely know the exact distance to the chosen centroid, they only compute it when the fit tracks inertia.
+ * Every distance evaluated is added to the count in evaluated.
+ */
+static int assign_sample(KMeansFit* fit, int i, const double* x, double* distance, long long* evaluated) {
+    int label;
+
+    switch (fit->km->algorithm) {
+        case KMEANS_ELKAN:
+            label = fit->iteration == 0 ? assign_exhaustively(fit, i, x, evaluated) : assign_elkan(fit, i, x, evaluated);
+            break;
+        case KMEANS_HAMERLY:
+            label = fit->iteration == 0 ? assign_exhaustively(fit, i, x, evaluated) : assign_hamerly(fit, i, x, evaluated);
+            break;
+        default:
+            *evaluated += fit->km->k;
+            return nearest_centroid(fit->km, x, distance);
+    }
+
+    if (fit->track_inertia) {
+        *distance = squared_distance(x, centroid_at(fit->km, label), fit->km->num_variables);
+        (*evaluated)++;
+    }
+
+    return label;
+}
+
+
+/*
+ * Records how far each centroid moved during the latest update, for the bounded algorithms to loosen their bounds by.
+ *
+ * Also caches the largest shift, the centroid it belongs to, and the second largest shift for Hamerly's single lower bound.
+ */
+static void record_centroid_shifts(KMeansFit* fit) {
+    const KMeans* km = fit->km;
+
+    fit->max_shift_index = 0;
+    fit->max_shift = 0.0;
+    fit->second_max_shift = 0.0;
+
+    for (int c = 0; c < km->k; c++) {
+        const double* previous = fit->previous_centroids + (size_t) c * (size_t) km->num_variables;
+        double shift = sqrt(squared_distance(previous, centroid_at(km, c), km->num_variables));
+
+        fit->shifts[c] = shift;
+
+        if (shift > fit->max_shift) {
+            fit->second_max_shift = fit->max_shift;
+            fit->max_shift = shift;
+            fit->max_shift_index = c;
+        } else if (shift > fit->second_max_shift) {
+            fit->second_max_shift = shift;
+        }
+    }
+}
+
+
+/*
+ * Assigns each data point of a single partition to its nearest centroid and accumulates the partition's private cluster sums.
+ * Runs as a parallel_for task, so it only writes to the labels of its own rows and to its own sums and counts.
+ *
+ * Zeroes the partition's summation and quantity arrays before use.
+ * Each data point is labelled with its nearest centroid (found with the model's algorithm) and then added to that cluster's running sum and count.
+ * Fusing the two steps means each row is streamed from memory once per iteration.
+ * The number of changed labels and the partition's inertia (its summed squared distances) are recorded for the convergence checks,
+ * along with the number of distances evaluated for the iteration's statistics.
+ */
+static void assign_and_accumulate(void* arg, int partition) {
+    KMeansFit* fit = (KMeansFit*) arg;
+    const KMeans* km = fit->km;
+    int d = km->num_variables;
+    double* sums = fit->sums + (size_t) partition * (size_t) km->k * (size_t) d;
+    int* counts = fit->counts + (size_t) partition * (size_t) km->k;
+    long long changes = 0;
+    long long evaluated = 0;
+    double inertia = 0.0;
+    int start, end;
+
+    partition_bounds(fit->X->num_rows, fit->num_partitions, partition, &start, &end);
+    memset(sums, 0, (size_t) km->k * (size_t) d * sizeof(double));
+    memset(counts, 0, (size_t) km->k * sizeof(int));
+
+    for (int i = start; i < end; i++) {
+        const double* x = matrix_row(fit->X, i);
+        double distance = 0.0;
+        int label = assign_sample(fit, i, x, &distance, &evaluated);
+        double* cluster_sum = sums + (size_t) label * (size_t) d;
+
+        changes += label != fit->labels[i];
+        inertia += distance;
+        fit->labels[i] = label;
+
+        for (int j = 0; j < d; j++) {
+            cluster_sum[j] += x[j];
         }
 
-        count[label]++;
+        counts[label]++;
     }
 
-    // Update the centroids by calculating and assigning their new locations.
-    for (int i = 0; i < km->k; i++) {
-        if (count[i] > 0) {
-            for (int j = 0; j < km->num_variables; j++) {
-                km->centroids[i][j] = sum[i][j] / count[i];
+    fit->partition_changes[partition] = changes;
+    fit->partition_inertia[partition] = inertia;
+    fit->partition_distances[partition] = evaluated;
+}
+
+
+/*
+ * Reduces the partition sums of a block of KMEANS_CENTROID_BLOCK centroids and moves those centroids to their new means.
+ * Runs as a parallel_for task, so it only writes to the centroids in its own block.
+ *
+ * The partition sums are folded in ascending partition order, which keeps the result independent of the thread count.
+ * Centroids whose clusters are empty keep their previous location.
+ */
+static void reduce_centroid_block(void* arg, int block) {
+    KMeansFit* fit = (KMeansFit*) arg;
+    KMeans* km = fit->km;
+    int d = km->num_variables;
+    int first = block * KMEANS_CENTROID_BLOCK;
+    int last = first + KMEANS_CENTROID_BLOCK < km->k ? first + KMEANS_CENTROID_BLOCK : km->k;
+
+    for (int c = first; c < last; c++) {
+        long long count = 0;
+
+        for (int p = 0; p < fit->num_partitions; p++) {
+            count += fit->counts[(size_t) p * (size_t) km->k + (size_t) c];
+        }
+
+        if (count == 0) continue;
+
+        double* centroid = centroid_at(km, c);
+
+        for (int j = 0; j < d; j++) {
+            centroid[j] = 0.0;
+        }
+
+        for (int p = 0; p < fit->num_partitions; p++) {
+            const double* cluster_sum = fit->sums + ((size_t) p * (size_t) km->k + (size_t) c) * (size_t) d;
+
+            for (int j = 0; j < d; j++) {
+                centroid[j] += cluster_sum[j];
             }
         }
-    }
 
-    // Free the dynamically allocated memory used.
-    for (int i = 0; i < km->k; i++) {
-        free(sum[i]);
+        for (int j = 0; j < d; j++) {
+            centroid[j] /= count;
+        }
     }
+}
 
-    free(sum);
-    free(count);
 
-    return EXIT_SUCCESS;
+/*
+ * Updates the centroids of the KMeans model based on the partition sums accumulated during assignment.
+ * Calculates the new centroids by averaging the data points assigned to a particular cluster.
+ *
+ * The centroids are split into blocks that are reduced concurrently, since each centroid's reduction is independent.
+ */
+static void update_centroids(KMeansFit* fit, int num_threads) {
+    int num_blocks = (fit->km->k + KMEANS_CENTROID_BLOCK - 1) / KMEANS_CENTROID_BLOCK;
+
+    parallel_for_in(fit->km->context, num_blocks, num_threads, reduce_centroid_block, fit);
 }
 
 
 /*
- * Creates a new KMeans for a specified number of clusters and features.
+ * Creates a new KMeans for a specified number of clusters and features, whose randomness is driven by the given seed.
  * Returns a pointer to a new KMeans on success and NULL on failure.
  *
- * Dynamically allocates memory for a KMeans struct and the subsequent centroid array of points.
- * Each centroid's initial value is randomly set within the provided range.
+ * Dynamically allocates memory for a KMeans struct, a single row-major buffer holding every centroid and the zeroed mini-batch cluster counts.
+ * Seeds the model's own generator, then randomly sets each centroid's initial value within the provided range.
+ * The model fits with Lloyd's algorithm on a single thread, keeping its range initialisation, until algorithm, num_threads or init are changed.
+ * Both tolerances start at zero, so fits only stop early once no label changes.
  * A NULL is returned if any dynamic allocations fails, with any already allocated memory freed.
  * A NULL is also returned if the initial centroid range provided is non-positive.
  */
-KMeans* create_k_means(int k, int num_variables, double initial_centroid_range) {
+KMeans* create_k_means_seeded(int k, int num_variables, double initial_centroid_range, uint64_t seed) {
     // Ensure the initial range is positive.
     if (initial_centroid_range <= 0) {
         fprintf(stderr, "Error: Initial centroid range must be a positive value\n");
         return NULL;
     }
 
-    // Seed the random generator using the current system time.
-    srand(time(NULL));
-
     // Allocate memory for a KMeans model.
     KMeans* km = (KMeans*) malloc(sizeof(KMeans));
 
@@ -165,7 +530,7 @@ KMeans* create_k_means(int k, int num_variables, double initial_centroid_range)
     }
 
     // Allocate memory for the KMeans model's centroids.
-    km->centroids = (double**) malloc(k * sizeof(double*));
+    km->centroids = (double*) malloc((size_t) k * (size_t) num_variables * sizeof(double));
 
     if (km->centroids == NULL) {
         fprintf(stderr, "Error: Failed to allocate sufficient memory for KMeans model\n");
@@ -174,68 +539,487 @@ KMeans* create_k_means(int k, int num_variables, double initial_centroid_range)
         return NULL;
     }
 
-    // Allocate each centroid as a random point of the specified dimension.
-    for (int i = 0; i < k; i++) {
-        km->centroids[i] = (double*) malloc(num_variables * sizeof(double));
+    // Allocate memory for the number of samples each centroid has absorbed in mini-batch updates.
+    km->cluster_counts = (long long*) calloc(k, sizeof(long long));
 
-        if (km->centroids[i] == NULL) {
-            fprintf(stderr, "Error: Failed to allocate sufficient memory for KMeans model\n");
+    if (km->cluster_counts == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for KMeans model\n");
+        free(km->centroids);
+        free(km);
 
-            for (int j = 0; j < i; j++) {
-                free(km->centroids[i]);
-            }
+        return NULL;
+    }
 
-            free(km->centroids);
-            free(km);
+    // Seed the model's own random generator.
+    seed_rng(&km->rng, seed);
 
-            return NULL;
-        }
-
-        // Initialise each centroid as a random point within the specified range.
-        for (int j = 0; j < num_variables; j++) {
-            km->centroids[i][j] = (rand() / (double) RAND_MAX) * (2 * initial_centroid_range) - initial_centroid_range;
-        }
+    // Initialise each centroid as a random point within the specified range.
+    for (size_t i = 0; i < (size_t) k * (size_t) num_variables; i++) {
+        km->centroids[i] = rng_uniform(&km->rng) * (2 * initial_centroid_range) - initial_centroid_range;
     }
 
     // Assign the remaning parameters to the KMeans model and return it.
     km->k = k;
     km->num_variables = num_variables;
+    km->num_threads = 1;
+    km->context = NULL;
+    km->algorithm = KMEANS_LLOYD;
+    km->init = KMEANS_INIT_RANGE;
+    km->is_initialised = 0;
+    km->shift_tolerance = 0.0;
+    km->inertia_tolerance = 0.0;
+    km->mapping = NULL;
+    km->mapping_size = 0;
+    km->workspace = NULL;
+    km->callback = NULL;
+    km->callback_arg = NULL;
+    km->perf_counters = 0;
+    km->index = NULL;
 
     return km;
 }
 
 
 /*
- * Fits (trains) the KMeans model to the given data points.
- * Performs the k-means clustering algorithm for a specified number of iterations.
+ * Creates a new KMeans for a specified number of clusters and features.
+ * Returns a pointer to a new KMeans on success and NULL on failure.
+ *
+ * Seeds the model from the current system time mixed with a per-process counter, so models created together still differ.
+ */
+KMeans* create_k_means(int k, int num_variables, double initial_centroid_range) {
+    static uint64_t counter = 0;
+    uint64_t sequence = __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+
+    return create_k_means_seeded(k, num_variables, initial_centroid_range, (uint64_t) time(NULL) ^ (sequence * 0x9E3779B97F4A7C15ULL));
+}
+
+
+/*
+ * Obtains the KMeans model's workspace, creating an empty one on first use.
+ * Returns a pointer to the workspace on success and NULL on failure.
+ */
+CMLWorkspace* model_workspace(KMeans* km) {
+    if (km->workspace == NULL) km->workspace = create_workspace(0, km->num_threads);
+
+    return km->workspace;
+}
+
+
+/*
+ * Helper function to allocate the scratch arrays of a fit for the model's algorithm and stopping criteria.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
  *
- * Dynamically allocates memory for the labels array, which stores the cluster assignment for each data point.
- * Each iteration assigns the data point to the nearest centroid and then updates the centroids based on the current cluster assigments.
- * At any point, if a dynamic allocation fails, the allocated memory is freed and the functions exits.
- * Upon successful fitting, the dynamically allocated labels array is freed.
+ * The labels, partition sums and partition statistics are always needed.
+ * The labels start out invalid, so that every sample counts as changed on the first iteration.
+ * The bounds and centroid distances are only allocated for Elkan and Hamerly, and the centroid shifts also for a shift tolerance.
+ * Every array is carved from the model's workspace, so once it has grown to fit a workload, later fits allocate nothing from the heap.
+ * If any allocation fails, every array allocated so far is released back to the workspace.
  */
-void fit_k_means(KMeans* km, double** X, int num_samples, int num_iterations) {
+static int allocate_fit(KMeansFit* fit) {
+    KMeans* km = fit->km;
+    CMLWorkspace* workspace = model_workspace(km);
+    size_t n = (size_t) fit->X->num_rows;
+    size_t k = (size_t) km->k;
+    int is_bounded = km->algorithm == KMEANS_ELKAN || km->algorithm == KMEANS_HAMERLY;
+
+    if (workspace == NULL) return EXIT_FAILURE;
+
+    fit->mark = workspace_mark(workspace);
+
     // Allocate memory for labels to store the cluster assignment to each data point.
-    int* labels = (int*) malloc(num_samples * sizeof(int));
+    fit->labels = (int*) workspace_alloc(workspace, n * sizeof(int));
+
+    // Allocate memory for the private summation, quantity and statistics arrays of every partition.
+    fit->sums = (double*) workspace_alloc(workspace, (size_t) fit->num_partitions * k * (size_t) km->num_variables * sizeof(double));
+    fit->counts = (int*) workspace_alloc(workspace, (size_t) fit->num_partitions * k * sizeof(int));
+    fit->partition_changes = (long long*) workspace_alloc(workspace, (size_t) fit->num_partitions * sizeof(long long));
+    fit->partition_inertia = (double*) workspace_alloc(workspace, (size_t) fit->num_partitions * sizeof(double));
+    fit->partition_distances = (long long*) workspace_alloc(workspace, (size_t) fit->num_partitions * sizeof(long long));
+
+    int failed = fit->labels == NULL || fit->sums == NULL || fit->counts == NULL || fit->partition_changes == NULL || fit->partition_inertia == NULL
+                 || fit->partition_distances == NULL;
+
+    // Allocate memory for the centroid shifts, used by the bounded algorithms and the shift tolerance.
+    if (is_bounded || km->shift_tolerance > 0.0) {
+        fit->shifts = (double*) workspace_alloc(workspace, k * sizeof(double));
+        fit->previous_centroids = (double*) workspace_alloc(workspace, k * (size_t) km->num_variables * sizeof(double));
+
+        failed = failed || fit->shifts == NULL || fit->previous_centroids == NULL;
+    }
+
+    // Allocate memory for the distance bounds and centroid separations of the bounded algorithms.
+    if (is_bounded) {
+        fit->upper = (double*) workspace_alloc(workspace, n * sizeof(double));
+        fit->lower = (double*) workspace_alloc(workspace, (km->algorithm == KMEANS_ELKAN ? n * k : n) * sizeof(double));
+        fit->half_separation = (double*) workspace_alloc(workspace, k * sizeof(double));
+
+        failed = failed || fit->upper == NULL || fit->lower == NULL || fit->half_separation == NULL;
+
+        if (km->algorithm == KMEANS_ELKAN) {
+            fit->centroid_distances = (double*) workspace_alloc(workspace, k * k * sizeof(double));
+            failed = failed || fit->centroid_distances == NULL;
+        }
+    }
+
+    if (failed) {
+        fprintf(stderr, "Error: Failed to allocate memory for KMeans fit\n");
+        workspace_release(workspace, fit->mark);
+
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        fit->labels[i] = -1;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Fits (trains) the KMeans model to the given data points.
+ * Performs the k-means clustering algorithm for up to a specified number of iterations, stopping early once converged.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Ensures that the model and sample matrix are non-null and that the matrix has one column per model variable.
+ * Initialises the centroids with the model's init method first, if the model has not been initialised yet.
+ * Carves the fit's scratch arrays from the model's workspace once, and reuses them for every iteration.
+ * Each iteration assigns the partitions' data points to their nearest centroids in parallel while accumulating the partition sums.
+ * If no label changed, the centroids are already the means of their clusters, so the update is skipped and the fit has converged.
+ * Otherwise the partition sums are reduced in a fixed order and the centroids are updated, so a fit is deterministic for any thread count.
+ * For Elkan and Hamerly, the centroid separations are computed before each assignment and the centroid shifts after each update.
+ * The fit also stops once the largest centroid shift is within shift_tolerance, or the relative change in inertia is within inertia_tolerance.
+ * If the model has a callback, it is passed each iteration's phase timings, distance counts, label changes and inertia, and can stop the fit.
+ * Without a callback, none of the timers or hardware counters are read.
+ * If a report is given, the iterations run, convergence, final inertia and the wall time of each iteration are written to it.
+ * If allocating the scratch arrays fails, the function exits without updating the model.
+ * Upon successful fitting, the scratch arrays are released back to the workspace for the next fit.
+ */
+int fit_k_means(KMeans* km, const CMLMatrix* X, int num_iterations, KMeansReport* report) {
+    if (km == NULL || X == NULL || X->data == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to fit_k_means\n");
+        return EXIT_FAILURE;
+    }
+
+    if (X->num_cols != km->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the KMeans model expects %d\n", X->num_cols, km->num_variables);
+        return EXIT_FAILURE;
+    }
+
+    // Seed the centroids from the samples if the model has not been initialised yet.
+    if (!km->is_initialised && init_k_means(km, X) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+    // The centroids are about to move, so any index over them is out of date.
+    free_centroid_index(km->index);
+    km->index = NULL;
+
+    int num_threads = resolve_context_threads(km->context, km->num_threads);
+    int is_bounded = km->algorithm == KMEANS_ELKAN || km->algorithm == KMEANS_HAMERLY;
+    int tracks_shifts = is_bounded || km->shift_tolerance > 0.0;
+    int is_instrumented = km->callback != NULL;
+    double previous_inertia = 0.0;
+    KMeansFit fit = {0};
+
+    fit.km = km;
+    fit.X = X;
+    fit.num_partitions = count_partitions(X->num_rows, km->k, km->num_variables, sizeof(double), sizeof(int));
+    fit.track_inertia = report != NULL || km->inertia_tolerance > 0.0 || is_instrumented;
+
+    if (allocate_fit(&fit) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+    // Open the hardware counters only if the callback is there to receive them.
+    CMLPerfCounters counters;
+    CMLPerfReading readings[3];
+    int has_counters = is_instrumented && km->perf_counters && km->context == NULL && open_perf_counters(&counters) == EXIT_SUCCESS;
+
+    if (report != NULL) {
+        report->num_iterations = 0;
+        report->converged = 0;
+        report->stopped = 0;
+        report->inertia = 0.0;
+    }
+
+    // Perform the k-means clustering algorithm for up to the specified iteration count.
+    for (fit.iteration = 0; fit.iteration < num_iterations; fit.iteration++) {
+        double start_time = report != NULL || is_instrumented ? wall_time() : 0.0;
+        double assigned_time = 0.0;
+        long long changes = 0;
+        long long evaluated = 0;
+        double inertia = 0.0;
+        int converged = 0;
+        int stopped = 0;
+
+        if (has_counters) read_perf_counters(&counters, &readings[0]);
+
+        // Measure how well separated the centroids are, which the bounded algorithms prune against.
+        if (is_bounded && fit.iteration > 0) {
+            parallel_for_in(km->context, km->k, num_threads, compute_centroid_separation, &fit);
+        }
+
+        // Assign each data point to its nearest centroid's label, accumulating each partition's cluster sums.
+        parallel_for_in(km->context, fit.num_partitions, num_threads, assign_and_accumulate, &fit);
+
+        if (is_instrumented) assigned_time = wall_time();
+        if (has_counters) read_perf_counters(&counters, &readings[1]);
+
+        for (int p = 0; p < fit.num_partitions; p++) {
+            changes += fit.partition_changes[p];
+            inertia += fit.partition_inertia[p];
+            evaluated += fit.partition_distances[p];
+        }
+
+        if (changes == 0) {
+            // Unchanged labels would reproduce the current centroids exactly, so the update can be skipped.
+            converged = 1;
+        } else {
+            if (tracks_shifts) {
+                memcpy(fit.previous_centroids, km->centroids, (size_t) km->k * (size_t) km->num_variables * sizeof(double));
+            }
+
+            // Reduce the partition sums and update the centroids on the new cluster assignments.
+            update_centroids(&fit, num_threads);
+
+            if (tracks_shifts) {
+                record_centroid_shifts(&fit);
+                converged = km->shift_tolerance > 0.0 && fit.max_shift <= km->shift_tolerance;
+            }
+
+            if (km->inertia_tolerance > 0.0 && fit.iteration > 0) {
+                converged = converged || fabs(previous_inertia - inertia) <= km->inertia_tolerance * previous_inertia;
+            }
+        }
+
+        previous_inertia = inertia;
+
+        // Describe the iteration to the callback, which may ask for the fit to stop here.
+        if (is_instrumented) {
+            KMeansIterationStats stats;
+            long long possible = (long long) X->num_rows * km->k;
+
+            stats.iteration = fit.iteration;
+            stats.assignment_seconds = assigned_time - start_time;
+            stats.update_seconds = wall_time() - assigned_time;
+            stats.distance_computations = evaluated;
+            stats.distances_skipped = possible > evaluated ? possible - evaluated : 0;
+            stats.labels_changed = changes;
+            stats.inertia = inertia;
+            stats.max_shift = tracks_shifts && changes > 0 ? fit.max_shift : 0.0;
+
+            if (has_counters) {
+                read_perf_counters(&counters, &readings[2]);
+                perf_reading_delta(&readings[0], &readings[1], &stats.assignment_counters);
+                perf_reading_delta(&readings[1], &readings[2], &stats.update_counters);
+            } else {
+                memset(&stats.assignment_counters, 0xFF, sizeof(stats.assignment_counters));
+                memset(&stats.update_counters, 0xFF, sizeof(stats.update_counters));
+            }
+
+            stopped = km->callback(&stats, km->callback_arg) != 0;
+        }
+
+        if (report != NULL) {
+            if (fit.iteration < report->max_iterations) {
+                report->iteration_times[fit.iteration] = wall_time() - start_time;
+            }
+
+            report->num_iterations = fit.iteration + 1;
+            report->converged = converged;
+            report->stopped = stopped;
+            report->inertia = inertia;
+        }
+
+        if (converged || stopped) break;
+    }
+
+    if (has_counters) close_perf_counters(&counters);
+
+    workspace_release(km->workspace, fit.mark);
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Creates a new KMeansReport able to record the wall time of up to max_iterations iterations.
+ * Returns a pointer to a new KMeansReport on success and NULL on failure.
+ *
+ * Dynamically allocates memory for a KMeansReport struct and its zeroed iteration time array.
+ * A NULL is returned if the iteration capacity is negative or if either dynamic allocation fails, with any already allocated memory freed.
+ */
+KMeansReport* create_k_means_report(int max_iterations) {
+    if (max_iterations < 0) {
+        fprintf(stderr, "Error: Report iteration capacity must be non-negative\n");
+        return NULL;
+    }
+
+    KMeansReport* report = (KMeansReport*) calloc(1, sizeof(KMeansReport));
+
+    if (report == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for KMeans report\n");
+        return NULL;
+    }
+
+    report->iteration_times = (double*) calloc(max_iterations > 0 ? max_iterations : 1, sizeof(double));
+
+    if (report->iteration_times == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for KMeans report\n");
+        free(report);
+
+        return NULL;
+    }
+
+    report->max_iterations = max_iterations;
+
+    return report;
+}
+
+
+/*
+ * Frees the dynamically allocated memory used by a KMeansReport.
+ *
+ * Ensures that the report is non-null and deallocates its iteration time array, followed by the report itself.
+ */
+void free_k_means_report(KMeansReport* report) {
+    if (report == NULL) return;
+
+    free(report->iteration_times);
+    free(report);
+}
+
+
+/*
+ * Updates the KMeans model's centroids from a single mini-batch of data points.
+ * Can be called repeatedly with batches drawn from a stream, without the full dataset ever being resident.
+ *
+ * Ensures that the model and batch are non-null and that the batch has one column per model variable.
+ * If the model has not been initialised yet, its centroids are first seeded from this batch with the model's init method.
+ * Every point in the batch is first labelled against the centroids as they were before the batch, as in Sculley's algorithm.
+ * The points are then folded into their centroids in row order with a per-centroid learning rate of 1 / count.
+ * The count is the total number of points the centroid has absorbed, so each centroid is the running mean of its points.
+ * The labels are carved from the model's workspace, so streaming batches of a steady size allocates nothing from the heap.
+ * If allocating the labels fails, the function exits without updating the model.
+ */
+void partial_fit_k_means(KMeans* km, const CMLMatrix* batch) {
+    if (km == NULL || batch == NULL || batch->data == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to partial_fit_k_means\n");
+        return;
+    }
+
+    if (batch->num_cols != km->num_variables) {
+        fprintf(stderr, "Error: Batch matrix has %d columns but the KMeans model expects %d\n", batch->num_cols, km->num_variables);
+        return;
+    }
+
+    // Seed the centroids from the first batch if the model has not been initialised yet.
+    if (!km->is_initialised && init_k_means(km, batch) != EXIT_SUCCESS) return;
+
+    // The centroids are about to move, so any index over them is out of date.
+    free_centroid_index(km->index);
+    km->index = NULL;
+
+    CMLWorkspace* workspace = model_workspace(km);
+    size_t mark = workspace_mark(workspace);
+    int* labels = workspace != NULL ? (int*) workspace_alloc(workspace, (size_t) batch->num_rows * sizeof(int)) : NULL;
 
     if (labels == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for labels\n");
         return;
     }
 
-    // Perform the k-means clustering algorithm for the specified iteration count.
-    for (int iteration = 0; iteration < num_iterations; iteration++) {
-        // Assign each data point to its nearest centroid's label.
-        assign_labels(km, X, num_samples, labels);
+    // Label the whole batch against the current centroids.
+    assign_labels(km, batch, labels, resolve_context_threads(km->context, km->num_threads));
+
+    // Move each point's centroid towards it by that centroid's learning rate.
+    for (int i = 0; i < batch->num_rows; i++) {
+        const double* x = matrix_row(batch, i);
+        double* centroid = centroid_at(km, labels[i]);
+        double learning_rate = 1.0 / (double) ++km->cluster_counts[labels[i]];
+
+        for (int j = 0; j < km->num_variables; j++) {
+            centroid[j] += learning_rate * (x[j] - centroid[j]);
+        }
+    }
+
+    workspace_release(workspace, mark);
+}
 
-        // Update the centroids on the new cluster assignments and exit if this fails.
-        if (update_centroids(km, X, num_samples, labels) != EXIT_SUCCESS) {
-            free(labels);
-            return;
+
+/*
+ * Fits the KMeans model to a series of data samples using mini-batch k-means.
+ * Each iteration samples batch_size rows uniformly at random (with replacement) and applies them with partial_fit_k_means.
+ * The rows are drawn from the model's own generator, so a given seed always samples the same batches.
+ *
+ * Ensures that the model and sample matrix are non-null, that the matrix has one column per model variable and that the batch size is positive.
+ * Carves a contiguous batch matrix that the sampled rows are gathered into from the model's workspace, which is reused by every iteration.
+ * If allocating the batch fails, the function exits without updating the model.
+ */
+void fit_k_means_mini_batch(KMeans* km, const CMLMatrix* X, int batch_size, int num_iterations) {
+    if (km == NULL || X == NULL || X->data == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to fit_k_means_mini_batch\n");
+        return;
+    }
+
+    if (X->num_cols != km->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the KMeans model expects %d\n", X->num_cols, km->num_variables);
+        return;
+    }
+
+    if (batch_size <= 0 || X->num_rows <= 0) {
+        fprintf(stderr, "Error: Mini-batch k-means requires a positive batch size and at least one sample\n");
+        return;
+    }
+
+    // Seed the centroids from the whole matrix if the model has not been initialised yet.
+    if (!km->is_initialised && init_k_means(km, X) != EXIT_SUCCESS) return;
+
+    CMLWorkspace* workspace = model_workspace(km);
+    size_t mark = workspace_mark(workspace);
+    double* batch_data = workspace != NULL ? (double*) workspace_alloc(workspace, (size_t) batch_size * (size_t) km->num_variables * sizeof(double)) : NULL;
+
+    if (batch_data == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for mini-batch\n");
+        return;
+    }
+
+    CMLMatrix batch_matrix = matrix_view(batch_data, batch_size, km->num_variables, km->num_variables);
+    CMLMatrix* batch = &batch_matrix;
+
+    for (int iteration = 0; iteration < num_iterations; iteration++) {
+        // Gather a batch of randomly sampled rows into contiguous memory.
+        for (int i = 0; i < batch_size; i++) {
+            memcpy(matrix_row(batch, i), matrix_row(X, (int) rng_below(&km->rng, (uint64_t) X->num_rows)), (size_t) km->num_variables * sizeof(double));
         }
+
+        partial_fit_k_means(km, batch);
     }
 
-    free(labels);
+    workspace_release(workspace, mark);
+}
+
+
+/*
+ * Builds a nearest-centroid index of the given type over the KMeans model's current centroids, replacing any existing index.
+ * For an IVF index, num_lists sets the number of inverted lists (non-positive for the square root of k), and the index's num_probes its recall.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The index copies the centroids, so it stays valid until the model is next fitted or initialised, which frees it.
+ * A k-d tree suits models with few variables, while an IVF index suits many; both are exact until num_probes is set on an IVF index.
+ * The build uses the model's num_threads threads.
+ */
+int build_k_means_index(KMeans* km, CMLCentroidIndexType type, int num_lists) {
+    if (km == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to build_k_means_index\n");
+        return EXIT_FAILURE;
+    }
+
+    CMLCentroidIndex* index = create_centroid_index(km->centroids, km->k, km->num_variables, type, num_lists, km->num_threads);
+
+    if (index == NULL) return EXIT_FAILURE;
+
+    free_centroid_index(km->index);
+    km->index = index;
+
+    return EXIT_SUCCESS;
 }
 
 
@@ -243,41 +1027,170 @@ void fit_k_means(KMeans* km, double** X, int num_samples, int num_iterations) {
  * Predicts the cluster for a data point based on the KMeans model.
  * Returns the index of the cluster nearest the data point.
  *
- * Iterates over all centroidsto find the closest centroid to the supplied data point.
- * The closest centroid is found by calculating the Euclidean distance between each centroid and the data point, and selecting the minima.
- * The index of the centroid with minimal distance from the data point is returned.
+ * The closest centroid is found by calculating the squared Euclidean distance between each centroid and the data point, and selecting the minima.
+ * If the model has an index, it is searched instead, in time sublinear in k.
+ */
+int predict_k_means(KMeans* km, const double* X) {
+    return nearest_centroid(km, X, NULL);
+}
+
+
+/*
+ * Predicts the cluster of each row of a matrix of data points.
+ * Writes the predicted cluster number of each row into the labels array.
+ *
+ * Ensures that the model, matrix and labels array are non-null and that the matrix has one column per model variable.
+ * Blocks of rows are labelled concurrently across the model's threads, on its context if it has one, by a cache-blocked search over the expanded distance, or by the model's index if it has one.
+ * The centroid norms are computed once per call, leaving a dot product per row and centroid as the only per-pair work.
+ * Labels match predict_k_means except for rows within rounding error of equidistant from two centroids.
  */
-int predict_k_means(KMeans* km, double* X) {
-    // Initially set the minimum distance to the maximum double value (acting as infinity).
-    double min_distance = DBL_MAX;
-    int cluster = 0;
+void predict_k_means_batch(KMeans* km, const CMLMatrix* X, int* labels) {
+    if (km == NULL || X == NULL || X->data == NULL || labels == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to predict_k_means_batch\n");
+        return;
+    }
+
+    if (X->num_cols != km->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the KMeans model expects %d\n", X->num_cols, km->num_variables);
+        return;
+    }
+
+    // With an index, each row is searched on its own rather than against every centroid.
+    if (km->index != NULL) {
+        KMeansLabelling indexed = {km, X, labels, NULL};
+        int num_blocks = (X->num_rows + KMEANS_LABEL_BLOCK - 1) / KMEANS_LABEL_BLOCK;
+
+        parallel_for_in(km->context, num_blocks, resolve_context_threads(km->context, km->num_threads), assign_label_block, &indexed);
+        return;
+    }
+
+    double* centroid_norms = (double*) malloc(km->k * sizeof(double));
+
+    if (centroid_norms == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for KMeans centroid norms\n");
+        return;
+    }
 
-    // Obtain the minimal cluster index.
     for (int i = 0; i < km->k; i++) {
-        double distance = calculate_distance(X, km->centroids[i], km->num_variables);
+        const double* centroid = centroid_at(km, i);
+        double norm = 0.0;
 
-        if (distance < min_distance) {
-            min_distance = distance;
-            cluster = i;
+        for (int j = 0; j < km->num_variables; j++) {
+            norm += centroid[j] * centroid[j];
         }
+
+        centroid_norms[i] = norm;
+    }
+
+    KMeansLabelling labelling = {km, X, labels, centroid_norms};
+    int num_blocks = (X->num_rows + KMEANS_LABEL_BLOCK - 1) / KMEANS_LABEL_BLOCK;
+
+    parallel_for_in(km->context, num_blocks, resolve_context_threads(km->context, km->num_threads), assign_label_block, &labelling);
+
+    free(centroid_norms);
+}
+
+
+/*
+ * Saves the KMeans model's centroids and settings to a binary model file.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The centroids form the payload, and the algorithm, init method and stopping tolerances are kept as header parameters.
+ * The tolerances are stored by their bit patterns, so they are restored exactly.
+ */
+int save_k_means(const KMeans* km, const char* path) {
+    if (km == NULL || path == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to save_k_means\n");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t parameters[CML_MODEL_FILE_PARAMETERS] = {(uint64_t) km->algorithm, (uint64_t) km->init, 0, 0, 0, 0};
+
+    memcpy(&parameters[2], &km->shift_tolerance, sizeof(double));
+    memcpy(&parameters[3], &km->inertia_tolerance, sizeof(double));
+
+    return write_model_file(path, CML_MODEL_K_MEANS, (uint64_t) km->k, (uint64_t) km->num_variables, parameters, km->centroids);
+}
+
+
+/*
+ * Loads a KMeans model from a binary model file by mapping it into memory, verifying the centroids' checksum if verify_payload is set.
+ * Returns a pointer to a new, initialised KMeans on success and NULL on failure.
+ *
+ * The centroids are used in place within the private mapping, so loading touches only the header however large the model is.
+ * The model can still be refitted, with its updates landing in copy-on-write pages rather than the file.
+ * Its generator is seeded from the centroids' checksum, so a loaded model behaves the same on every load.
+ * Files naming an algorithm or initialisation outside their enumerations are rejected, as a checksum only guards against corruption.
+ */
+KMeans* load_k_means(const char* path, int verify_payload) {
+    CMLModelFile file;
+
+    if (path == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to load_k_means\n");
+        return NULL;
+    }
+
+    if (map_model_file(path, CML_MODEL_K_MEANS, verify_payload, &file) != EXIT_SUCCESS) return NULL;
+
+    if (file.parameters[0] > KMEANS_HAMERLY || file.parameters[1] > KMEANS_INIT_PARALLEL) {
+        fprintf(stderr, "Error: Model file %s names an unknown KMeans algorithm or initialisation\n", path);
+        munmap(file.mapping, file.mapping_size);
+
+        return NULL;
     }
 
-    return cluster;
+    KMeans* km = (KMeans*) malloc(sizeof(KMeans));
+    long long* cluster_counts = (long long*) calloc(file.num_rows > 0 ? file.num_rows : 1, sizeof(long long));
+
+    if (km == NULL || cluster_counts == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for KMeans model\n");
+        free(km);
+        free(cluster_counts);
+        munmap(file.mapping, file.mapping_size);
+
+        return NULL;
+    }
+
+    km->centroids = file.payload;
+    km->k = (int) file.num_rows;
+    km->num_variables = (int) file.num_cols;
+    km->num_threads = 1;
+    km->context = NULL;
+    km->algorithm = (KMeansAlgorithm) file.parameters[0];
+    km->cluster_counts = cluster_counts;
+    km->init = (KMeansInit) file.parameters[1];
+    km->is_initialised = 1;
+    seed_rng(&km->rng, file.payload_checksum);
+    memcpy(&km->shift_tolerance, &file.parameters[2], sizeof(double));
+    memcpy(&km->inertia_tolerance, &file.parameters[3], sizeof(double));
+    km->mapping = file.mapping;
+    km->mapping_size = file.mapping_size;
+    km->workspace = NULL;
+    km->callback = NULL;
+    km->callback_arg = NULL;
+    km->perf_counters = 0;
+    km->index = NULL;
+
+    return km;
 }
 
 
 /*
  * Frees the dynamically allocated memory used by the KMeans model.
  *
- * Ensures that the model is non-null and deallocates its centroid array, followed by the model itself.
+ * Ensures that the model is non-null and deallocates its centroid buffer (or unmaps the model file holding it), cluster counts, index and workspace, followed by the model itself.
  */
 void free_k_means(KMeans* km) {
     if (km == NULL) return;
 
-    for (int i = 0; i < km->k; ++i) {
-        free(km->centroids[i]);
+    if (km->mapping != NULL) {
+        munmap(km->mapping, km->mapping_size);
+    } else {
+        free(km->centroids);
     }
-    
-    free(km->centroids);
+
+    free(km->cluster_counts);
+    free_centroid_index(km->index);
+    free_workspace(km->workspace);
     free(km);
-}
\ No newline at end of file
+}
@@ -1,15 +1,126 @@
 #ifndef K_MEANS_H
 #define K_MEANS_H
 
+#include "centroid_index.h"
+#include "matrix.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include "rng.h"
+#include "workspace.h"
+
+/*
+ * Define an enumeration of the algorithms a KMeans model can be fitted with.
+ * The Elkan and Hamerly algorithms use the triangle inequality to skip distance evaluations, producing the same clustering as Lloyd's.
+ * Elkan keeps k lower bounds per sample and skips the most work, while Hamerly keeps a single lower bound and needs far less memory.
+ */
+typedef enum {
+    KMEANS_LLOYD,
+    KMEANS_ELKAN,
+    KMEANS_HAMERLY
+} KMeansAlgorithm;
+
+/*
+ * Define an enumeration of the ways a KMeans model's centroids can be initialised.
+ * KMEANS_INIT_RANGE keeps the centroids drawn uniformly within the range given at creation.
+ * KMEANS_INIT_PLUS_PLUS seeds them from the data with k-means++, and KMEANS_INIT_PARALLEL with its scalable k-means|| variant.
+ */
+typedef enum {
+    KMEANS_INIT_RANGE,
+    KMEANS_INIT_PLUS_PLUS,
+    KMEANS_INIT_PARALLEL
+} KMeansInit;
+
+/*
+ * Define a typed struct describing a single iteration of a KMeans fit, as passed to the model's callback.
+ * The assignment phase labels every sample (after measuring centroid separations for Elkan and Hamerly), and the update phase moves the centroids.
+ * The distance_computations field counts the sample-to-centroid distances evaluated, and distances_skipped those Elkan and Hamerly pruned.
+ * The max_shift field is the furthest any centroid moved, which is only measured for Elkan, Hamerly or a shift tolerance (and is zero otherwise).
+ * The counters hold each phase's hardware events when the model's perf_counters field is set, with -1 for any counter that is unavailable.
+ * A model with a context reports every counter as -1, as the counters cannot follow the context's already running workers.
+ * Streamed fits (see fit_k_means_stream) keep no labels, so they report labels_changed as -1.
+ */
+typedef struct {
+    int iteration;
+    double assignment_seconds;
+    double update_seconds;
+    long long distance_computations;
+    long long distances_skipped;
+    long long labels_changed;
+    double inertia;
+    double max_shift;
+    CMLPerfReading assignment_counters;
+    CMLPerfReading update_counters;
+} KMeansIterationStats;
+
+/*
+ * Define the type of a KMeans fit's per-iteration callback, which returns non-zero to stop the fit after that iteration.
+ */
+typedef int (*KMeansCallback)(const KMeansIterationStats* stats, void* arg);
+
+/*
+ * Define the type of a reader streaming samples into an out-of-core KMeans fit.
+ * It fills buffer with up to max_rows samples, row-major with the model's num_variables columns, starting from sample first_row.
+ * Each pass of a streamed fit reads the samples in order from first_row 0, while a sharded fit's worker reads only its own shard's rows, once.
+ * A reader is only ever called from one thread at a time.
+ * Returns the number of rows read, which is only below max_rows at the end of the samples, or -1 on failure.
+ */
+typedef int (*KMeansReader)(double* buffer, long long first_row, int max_rows, void* arg);
+
 /*
  * Define a typed struct to encapsulate KMeans models.
+ * The centroids are stored row-major in a single buffer of k rows by num_variables columns.
+ * The num_threads field sets how many threads a fit uses, where a non-positive value uses every online CPU.
+ * If context is set, fits and predictions run on its shared pool instead, using every one of its threads, so it must outlive its use by the model.
+ * The algorithm field selects how fits assign samples to centroids, defaulting to KMEANS_LLOYD.
+ * The cluster_counts array holds the number of samples each centroid has absorbed through mini-batch updates.
+ * The init field selects how the centroids are initialised, which happens at the start of the first fit unless is_initialised is set.
+ * All of the model's randomness is drawn from its own generator, rng, so models can be fitted concurrently and reproducibly.
+ * A fit always stops once no label changes, and also once the largest centroid shift is within shift_tolerance
+ * or the relative change in inertia between iterations is within inertia_tolerance (a zero tolerance disables its check).
+ * A model loaded from a file keeps its centroids within the file's mapping, which is released when the model is freed.
+ * Fits carve their scratch buffers from the model's workspace, created by the first fit and reused by every later one.
+ * It may be set to a presized workspace before fitting, and is freed with the model either way.
+ * If callback is set, fits call it with callback_arg after every iteration, also reading hardware counters for it if perf_counters is set and context is not.
+ * If index is set (see build_k_means_index), predictions search it rather than scanning every centroid.
+ * It describes the centroids as they were when it was built, so fitting or initialising the model frees it.
  */
 typedef struct {
-    double** centroids;
+    double* centroids;
     int k;
     int num_variables;
+    int num_threads;
+    CMLContext* context;
+    KMeansAlgorithm algorithm;
+    long long* cluster_counts;
+    KMeansInit init;
+    int is_initialised;
+    CMLRandom rng;
+    double shift_tolerance;
+    double inertia_tolerance;
+    void* mapping;
+    size_t mapping_size;
+    CMLWorkspace* workspace;
+    KMeansCallback callback;
+    void* callback_arg;
+    int perf_counters;
+    CMLCentroidIndex* index;
 } KMeans;
 
+/*
+ * Define a typed struct to encapsulate the report of a KMeans fit.
+ * The inertia is the sum of squared distances from each sample to its assigned centroid in the final iteration.
+ * The iteration_times array holds the wall time (in seconds) of the first max_iterations iterations.
+ * The stopped field is set if the model's callback ended the fit.
+ */
+typedef struct {
+    int num_iterations;
+    int converged;
+    int stopped;
+    double inertia;
+    double* iteration_times;
+    int max_iterations;
+} KMeansReport;
+
 /* FUNCTION PROTOTYPES */
 
 /*
@@ -19,16 +130,137 @@ typedef struct {
 KMeans* create_k_means(int k, int num_variables, double initial_centroid_range);
 
 /*
- * Fits the KMeans model to a series of data samples.
+ * Creates a new KMeans for a specified number of clusters and features, whose randomness is driven by the given seed.
+ * Returns a pointer to a new KMeans on success and NULL on failure.
+ */
+KMeans* create_k_means_seeded(int k, int num_variables, double initial_centroid_range, uint64_t seed);
+
+/*
+ * Initialises the KMeans model's centroids from a series of data samples with the model's init method.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int init_k_means(KMeans* km, const CMLMatrix* X);
+
+/*
+ * Fits the KMeans model to a series of data samples, for up to num_iterations iterations.
  * This redistributes the centroids of the model based on the data samples given.
+ * The fitted centroids are identical whatever num_threads is set to.
+ * If report is non-null, it is filled in with the outcome of the fit.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int fit_k_means(KMeans* km, const CMLMatrix* X, int num_iterations, KMeansReport* report);
+
+/*
+ * Creates a new KMeansReport able to record the wall time of up to max_iterations iterations.
+ * Returns a pointer to a new KMeansReport on success and NULL on failure.
+ */
+KMeansReport* create_k_means_report(int max_iterations);
+
+/*
+ * Frees the dynamically allocated memory used by a KMeansReport.
+ */
+void free_k_means_report(KMeansReport* report);
+
+/*
+ * Updates the KMeans model with a single batch of data samples using Sculley's mini-batch k-means.
+ * Batches may be pushed one at a time from a stream, with each centroid's learning rate decaying as it absorbs samples.
+ */
+void partial_fit_k_means(KMeans* km, const CMLMatrix* batch);
+
+/*
+ * Fits the KMeans model to a series of data samples using mini-batch k-means.
+ * Each iteration updates the centroids from batch_size samples drawn at random from the matrix.
+ */
+void fit_k_means_mini_batch(KMeans* km, const CMLMatrix* X, int batch_size, int num_iterations);
+
+/*
+ * Fits the KMeans model with Lloyd's algorithm to samples streamed through a reader in chunks of chunk_rows rows, for up to num_iterations iterations.
+ * Only two chunks are ever held in memory, with the next read in the background while the current one is assigned.
+ * A non-positive chunk_rows picks a chunk of about 32 MiB. The fitted centroids are identical whatever num_threads is set to.
+ * If report is non-null, it is filled in with the outcome of the fit.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int fit_k_means_stream(KMeans* km, KMeansReader reader, void* reader_arg, int chunk_rows, int num_iterations, KMeansReport* report);
+
+/*
+ * Fits the KMeans model to the samples of a raw binary file, holding native doubles row after row with no header, streaming it as fit_k_means_stream does.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int fit_k_means_file(KMeans* km, const char* path, int chunk_rows, int num_iterations, KMeansReport* report);
+
+/*
+ * Fits the KMeans model with Lloyd's algorithm to num_samples samples sharded across num_workers worker processes, for up to num_iterations iterations.
+ * Acts as the coordinator, listening on a Unix domain socket at socket_path for the workers (see serve_k_means_shard) to connect.
+ * Only per-centroid sums and counts cross the socket, and the fitted centroids are identical to those fit_k_means would produce over the same samples.
+ * The model must already be initialised unless it keeps its range initialisation. If report is non-null, it is filled in with the outcome of the fit.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int fit_k_means_sharded(KMeans* km, const char* socket_path, int num_workers, long long num_samples, int num_iterations, KMeansReport* report);
+
+/*
+ * Serves one shard of a sharded KMeans fit as a worker, connecting to the coordinator at socket_path and loading only its shard's rows through the reader.
+ * Each iteration's assignments run across num_threads threads, where a non-positive value uses every online CPU.
+ * Returns EXIT_SUCCESS once the coordinator ends the fit, and EXIT_FAILURE otherwise.
+ */
+int serve_k_means_shard(const char* socket_path, KMeansReader reader, void* reader_arg, int num_threads);
+
+/*
+ * Initialises the KMeans model's centroids as unit vectors from a series of sparse data samples, for spherical k-means.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int init_spherical_k_means(KMeans* km, const CMLSparseMatrix* X);
+
+/*
+ * Fits the KMeans model to a series of sparse data samples with spherical k-means, clustering by cosine similarity.
+ * The centroids are kept as unit vectors, and each iteration costs O(nnz * k) to assign the samples.
+ * The fitted centroids are identical whatever num_threads is set to.
+ * If report is non-null, it is filled in with the outcome of the fit, with inertia measured as the summed cosine distance.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int fit_spherical_k_means(KMeans* km, const CMLSparseMatrix* X, int num_iterations, KMeansReport* report);
+
+/*
+ * Predicts the cluster of a sparse data point given as num_nonzeros column indices and values, by cosine similarity.
+ * Returns the index of the most similar centroid, or -1 on invalid arguments.
+ */
+int predict_spherical_k_means(KMeans* km, const int* indices, const double* values, int num_nonzeros);
+
+/*
+ * Predicts the cluster of each row of a sparse matrix of data points, by cosine similarity.
+ * Writes the predicted cluster number of each row into the labels array.
+ */
+void predict_spherical_k_means_batch(KMeans* km, const CMLSparseMatrix* X, int* labels);
+
+/*
+ * Builds a nearest-centroid index of the given type over the KMeans model's current centroids, replacing any existing index.
+ * For an IVF index, num_lists sets the number of inverted lists (non-positive for the square root of k), and the index's num_probes its recall.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
  */
-void fit_k_means(KMeans* km, double** X, int num_samples, int num_iterations);
+int build_k_means_index(KMeans* km, CMLCentroidIndexType type, int num_lists);
 
 /*
  * Predicts the cluster of a given data point.
  * Returns the predicted cluster number based on the model's centroids.
  */
-int predict_k_means(KMeans* km, double* X);
+int predict_k_means(KMeans* km, const double* X);
+
+/*
+ * Predicts the cluster of each row of a matrix of data points.
+ * Writes the predicted cluster number of each row into the labels array.
+ */
+void predict_k_means_batch(KMeans* km, const CMLMatrix* X, int* labels);
+
+/*
+ * Saves the KMeans model's centroids and settings to a binary model file.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int save_k_means(const KMeans* km, const char* path);
+
+/*
+ * Loads a KMeans model from a binary model file by mapping it into memory, verifying the centroids' checksum if verify_payload is set.
+ * Returns a pointer to a new, initialised KMeans on success and NULL on failure.
+ */
+KMeans* load_k_means(const char* path, int verify_payload);
 
 /*
  * Frees the dynamically allocated memory used by the KMeans model.
@@ -0,0 +1,385 @@
+#include "k_means.h"
+#include "distance.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * The number of rows processed by each task of a seeding pass.
+ */
+#define KMEANS_INIT_BLOCK 1024
+
+/*
+ * The number of sampling rounds k-means|| performs before reclustering its candidates.
+ */
+#define KMEANS_PARALLEL_ROUNDS 5
+
+/*
+ * The expected number of candidates k-means|| samples per round, as a multiple of k.
+ */
+#define KMEANS_OVERSAMPLING_FACTOR 2.0
+
+/*
+ * Define a typed struct holding the state of a seeding pass over a matrix, shared by every block task.
+ * Each row tracks its squared distance to, and the index of, the nearest center chosen so far.
+ * The rows are split into blocks of KMEANS_INIT_BLOCK rows, each keeping its own sum of (weighted) distances.
+ * When sampling for k-means||, each block draws from its own generator seeded from round_seed and the block index.
+ * The blocks run on the model's context, if it has one.
+ */
+typedef struct {
+    CMLContext* context;
+    const CMLMatrix* X;
+    const double* weights;
+    const double* centers;
+    int num_centers;
+    int center_offset;
+    int reset;
+    double* min_distances;
+    int* nearest;
+    double* block_sums;
+    unsigned char* selected;
+    uint64_t round_seed;
+    double sampling_factor;
+} SeedingPass;
+
+
+/*
+ * Helper function to obtain the half-open row range [start, end) covered by a block.
+ */
+static void block_bounds(const SeedingPass* pass, int block, int* start, int* end) {
+    *start = block * KMEANS_INIT_BLOCK;
+    *end = *start + KMEANS_INIT_BLOCK < pass->X->num_rows ? *start + KMEANS_INIT_BLOCK : pass->X->num_rows;
+}
+
+
+/*
+ * Folds a batch of newly chosen centers into the nearest center distances of a single block of rows.
+ * Runs as a parallel_for task, so it only writes to the state of its own rows and its own block sum.
+ *
+ * Each row's distance is only replaced on a strictly smaller distance, so ties keep the earliest center.
+ * The block's sum of weighted distances is recomputed in row order, keeping it independent of the thread count.
+ */
+static void fold_centers_block(void* arg, int block) {
+    SeedingPass* pass = (SeedingPass*) arg;
+    double sum = 0.0;
+    int start, end;
+
+    block_bounds(pass, block, &start, &end);
+
+    for (int i = start; i < end; i++) {
+        double distance;
+        int index = nearest_point(matrix_row(pass->X, i), pass->centers, pass->num_centers, pass->X->num_cols, &distance);
+
+        if (pass->reset || distance < pass->min_distances[i]) {
+            pass->min_distances[i] = distance;
+
+            if (pass->nearest != NULL) pass->nearest[i] = pass->center_offset + index;
+        }
+
+        sum += (pass->weights != NULL ? pass->weights[i] : 1.0) * pass->min_distances[i];
+    }
+
+    pass->block_sums[block] = sum;
+}
+
+
+/*
+ * Folds a batch of newly chosen centers into the nearest center distances of every row.
+ * Returns the total of the weighted squared distances, summed in block order.
+ */
+static double fold_centers(SeedingPass* pass, const double* centers, int num_centers, int center_offset, int num_threads) {
+    int num_blocks = (pass->X->num_rows + KMEANS_INIT_BLOCK - 1) / KMEANS_INIT_BLOCK;
+    double total = 0.0;
+
+    pass->centers = centers;
+    pass->num_centers = num_centers;
+    pass->center_offset = center_offset;
+
+    parallel_for_in(pass->context, num_blocks, num_threads, fold_centers_block, pass);
+    pass->reset = 0;
+
+    for (int b = 0; b < num_blocks; b++) {
+        total += pass->block_sums[b];
+    }
+
+    return total;
+}
+
+
+/*
+ * Helper function to draw a row with probability proportional to its weight, or uniformly if there are no weights.
+ * Returns the index of the drawn row.
+ */
+static int sample_by_weight(const CMLMatrix* X, const double* weights, CMLRandom* rng) {
+    if (weights == NULL) return (int) rng_below(rng, (uint64_t) X->num_rows);
+
+    double total = 0.0;
+
+    for (int i = 0; i < X->num_rows; i++) {
+        total += weights[i];
+    }
+
+    double target = rng_uniform(rng) * total;
+    int last = 0;
+
+    for (int i = 0; i < X->num_rows; i++) {
+        if (weights[i] <= 0.0) continue;
+
+        last = i;
+        target -= weights[i];
+
+        if (target < 0.0) return i;
+    }
+
+    return last;
+}
+
+
+/*
+ * Helper function to draw a row with probability proportional to its weighted squared distance to the nearest chosen center.
+ * Returns the index of the drawn row.
+ *
+ * The block sums locate the block containing the drawn mass, so only that block's rows are scanned.
+ * If every distance is zero (for example when there are fewer distinct rows than clusters), the row is drawn by weight alone.
+ * Should rounding carry the draw past the final row, the last row with positive mass is returned.
+ */
+static int sample_by_distance(const SeedingPass* pass, double total, CMLRandom* rng) {
+    if (!(total > 0.0)) return sample_by_weight(pass->X, pass->weights, rng);
+
+    int num_blocks = (pass->X->num_rows + KMEANS_INIT_BLOCK - 1) / KMEANS_INIT_BLOCK;
+    double target = rng_uniform(rng) * total;
+    int last = 0;
+
+    for (int b = 0; b < num_blocks; b++) {
+        if (target >= pass->block_sums[b] && b < num_blocks - 1) {
+            target -= pass->block_sums[b];
+            continue;
+        }
+
+        int start, end;
+        block_bounds(pass, b, &start, &end);
+
+        for (int i = start; i < end; i++) {
+            double mass = (pass->weights != NULL ? pass->weights[i] : 1.0) * pass->min_distances[i];
+
+            if (mass <= 0.0) continue;
+
+            last = i;
+            target -= mass;
+
+            if (target < 0.0) return i;
+        }
+    }
+
+    return last;
+}
+
+
+/*
+ * Chooses k centers from the rows of a matrix with (optionally weighted) k-means++ seeding.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The first center is drawn by weight, and each following center with probability proportional to its weighted squared distance to the nearest center so far.
+ * After each draw the new center is folded into every row's nearest distance in parallel, on the given context if it is non-null.
+ * Dynamically allocates the per-row distances and block sums, freeing them before returning.
+ */
+static int seed_plus_plus(CMLContext* context, const CMLMatrix* X, const double* weights, int k, CMLRandom* rng, double* centers, int num_threads) {
+    int d = X->num_cols;
+    int num_blocks = (X->num_rows + KMEANS_INIT_BLOCK - 1) / KMEANS_INIT_BLOCK;
+    SeedingPass pass = {0};
+
+    pass.context = context;
+    pass.X = X;
+    pass.weights = weights;
+    pass.reset = 1;
+    pass.min_distances = (double*) malloc((size_t) X->num_rows * sizeof(double));
+    pass.block_sums = (double*) malloc((size_t) num_blocks * sizeof(double));
+
+    if (pass.min_distances == NULL || pass.block_sums == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for k-means++ seeding\n");
+        free(pass.min_distances);
+        free(pass.block_sums);
+
+        return EXIT_FAILURE;
+    }
+
+    int row = sample_by_weight(X, weights, rng);
+
+    for (int c = 0; c < k; c++) {
+        double* center = centers + (size_t) c * (size_t) d;
+        memcpy(center, matrix_row(X, row), (size_t) d * sizeof(double));
+
+        double total = fold_centers(&pass, center, 1, c, num_threads);
+
+        if (c + 1 < k) row = sample_by_distance(&pass, total, rng);
+    }
+
+    free(pass.min_distances);
+    free(pass.block_sums);
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Marks the rows of a single block that k-means|| samples as candidates this round.
+ * Runs as a parallel_for task, so it only writes to the selection flags of its own rows.
+ *
+ * Each row is selected independently with probability min(1, sampling_factor * distance).
+ * The block draws from its own generator seeded from the round seed and the block index, so the selection is independent of the thread count.
+ */
+static void sample_candidates_block(void* arg, int block) {
+    SeedingPass* pass = (SeedingPass*) arg;
+    CMLRandom rng;
+    int start, end;
+
+    seed_rng(&rng, pass->round_seed ^ ((uint64_t) block * 0xD1B54A32D192ED03ULL));
+    block_bounds(pass, block, &start, &end);
+
+    for (int i = start; i < end; i++) {
+        pass->selected[i] = rng_uniform(&rng) < pass->sampling_factor * pass->min_distances[i];
+    }
+}
+
+
+/*
+ * Chooses the KMeans model's centroids with scalable k-means|| seeding.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Starts from a single uniformly drawn candidate and performs KMEANS_PARALLEL_ROUNDS sampling rounds.
+ * Each round samples every row independently in parallel, expecting KMEANS_OVERSAMPLING_FACTOR * k new candidates.
+ * Every candidate is then weighted by the number of rows nearest to it, and the weighted candidates are reclustered into k centroids with k-means++.
+ * Dynamically allocates the per-row state and the candidate set, freeing them before returning.
+ */
+static int seed_parallel(KMeans* km, const CMLMatrix* X, int num_threads) {
+    int d = km->num_variables;
+    int num_blocks = (X->num_rows + KMEANS_INIT_BLOCK - 1) / KMEANS_INIT_BLOCK;
+    int capacity = 1 + (int) (KMEANS_PARALLEL_ROUNDS * KMEANS_OVERSAMPLING_FACTOR * km->k) + km->k;
+    int num_candidates = 1;
+    int status = EXIT_FAILURE;
+    SeedingPass pass = {0};
+
+    double* candidates = (double*) malloc((size_t) capacity * (size_t) d * sizeof(double));
+    double* weights = NULL;
+
+    pass.context = km->context;
+    pass.X = X;
+    pass.reset = 1;
+    pass.min_distances = (double*) malloc((size_t) X->num_rows * sizeof(double));
+    pass.nearest = (int*) malloc((size_t) X->num_rows * sizeof(int));
+    pass.block_sums = (double*) malloc((size_t) num_blocks * sizeof(double));
+    pass.selected = (unsigned char*) malloc((size_t) X->num_rows);
+
+    if (candidates == NULL || pass.min_distances == NULL || pass.nearest == NULL || pass.block_sums == NULL || pass.selected == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for k-means|| seeding\n");
+        goto cleanup;
+    }
+
+    memcpy(candidates, matrix_row(X, (int) rng_below(&km->rng, (uint64_t) X->num_rows)), (size_t) d * sizeof(double));
+    double cost = fold_centers(&pass, candidates, 1, 0, num_threads);
+
+    for (int round = 0; round < KMEANS_PARALLEL_ROUNDS && cost > 0.0; round++) {
+        int first_new = num_candidates;
+
+        pass.round_seed = rng_next(&km->rng);
+        pass.sampling_factor = KMEANS_OVERSAMPLING_FACTOR * km->k / cost;
+        parallel_for_in(km->context, num_blocks, num_threads, sample_candidates_block, &pass);
+
+        // Gather the selected rows in row order, growing the candidate set if the round oversampled.
+        for (int i = 0; i < X->num_rows; i++) {
+            if (!pass.selected[i]) continue;
+
+            if (num_candidates == capacity) {
+                double* grown = (double*) realloc(candidates, (size_t) capacity * 2 * (size_t) d * sizeof(double));
+
+                if (grown == NULL) {
+                    fprintf(stderr, "Error: Failed to allocate memory for k-means|| candidates\n");
+                    goto cleanup;
+                }
+
+                candidates = grown;
+                capacity *= 2;
+            }
+
+            memcpy(candidates + (size_t) num_candidates * (size_t) d, matrix_row(X, i), (size_t) d * sizeof(double));
+            num_candidates++;
+        }
+
+        if (num_candidates == first_new) continue;
+
+        const double* new_candidates = candidates + (size_t) first_new * (size_t) d;
+        cost = fold_centers(&pass, new_candidates, num_candidates - first_new, first_new, num_threads);
+    }
+
+    // Weight each candidate by the number of rows it is nearest to.
+    weights = (double*) calloc(num_candidates, sizeof(double));
+
+    if (weights == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for k-means|| candidate weights\n");
+        goto cleanup;
+    }
+
+    for (int i = 0; i < X->num_rows; i++) {
+        weights[pass.nearest[i]] += 1.0;
+    }
+
+    // Recluster the weighted candidates into the model's centroids.
+    CMLMatrix candidate_matrix = matrix_view(candidates, num_candidates, d, d);
+    status = seed_plus_plus(km->context, &candidate_matrix, weights, km->k, &km->rng, km->centroids, num_threads);
+
+cleanup:
+    free(candidates);
+    free(weights);
+    free(pass.min_distances);
+    free(pass.nearest);
+    free(pass.block_sums);
+    free(pass.selected);
+
+    return status;
+}
+
+
+/*
+ * Initialises the KMeans model's centroids from a series of data samples with the model's init method.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Ensures that the model and sample matrix are non-null, that the matrix has one column per model variable and at least one row.
+ * KMEANS_INIT_RANGE keeps the centroids drawn when the model was created, while the other methods draw them from the samples.
+ * All randomness comes from the model's own generator, so a given seed always produces the same centroids.
+ * Marks the model as initialised, so that fitting does not seed it again.
+ */
+int init_k_means(KMeans* km, const CMLMatrix* X) {
+    if (km == NULL || X == NULL || X->data == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to init_k_means\n");
+        return EXIT_FAILURE;
+    }
+
+    if (X->num_cols != km->num_variables || X->num_rows <= 0) {
+        fprintf(stderr, "Error: Sample matrix must have at least one row and %d columns to initialise the KMeans model\n", km->num_variables);
+        return EXIT_FAILURE;
+    }
+
+    // The centroids are about to move, so any index over them is out of date.
+    free_centroid_index(km->index);
+    km->index = NULL;
+
+    int num_threads = resolve_context_threads(km->context, km->num_threads);
+    int status = EXIT_SUCCESS;
+
+    switch (km->init) {
+        case KMEANS_INIT_PLUS_PLUS:
+            status = seed_plus_plus(km->context, X, NULL, km->k, &km->rng, km->centroids, num_threads);
+            break;
+        case KMEANS_INIT_PARALLEL:
+            status = seed_parallel(km, X, num_threads);
+            break;
+        default:
+            break;
+    }
+
+    if (status == EXIT_SUCCESS) km->is_initialised = 1;
+
+    return status;
+}
@@ -0,0 +1,52 @@
+#ifndef K_MEANS_INTERNAL_H
+#define K_MEANS_INTERNAL_H
+
+#include "k_means.h"
+#include <stddef.h>
+
+/*
+ * The minimum number of rows in each accumulation partition of a fit.
+ */
+#define KMEANS_PARTITION_ROWS 4096
+
+/*
+ * The maximum number of accumulation partitions of a fit, bounding the cost of reducing their sums.
+ */
+#define KMEANS_MAX_PARTITIONS 128
+
+/*
+ * The maximum number of bytes of private partition sums a fit may allocate.
+ */
+#define KMEANS_PARTITION_BUDGET ((size_t) 256 << 20)
+
+/*
+ * The number of centroids reduced by each task of a centroid update.
+ */
+#define KMEANS_CENTROID_BLOCK 16
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Calculates how many accumulation partitions a fit over num_samples rows uses, given the size of each sum and each count it keeps per centroid.
+ * Returns a partition count that depends only on the problem size, never on the thread count.
+ */
+int count_partitions(long long num_samples, int k, int num_variables, size_t accum_size, size_t count_size);
+
+/*
+ * Calculates the first row of a partition, dividing the rows as evenly as possible in ascending order.
+ * Returns the index of the partition's first row, which is num_samples for partition num_partitions.
+ */
+long long partition_start(long long num_samples, int num_partitions, int partition);
+
+/*
+ * Obtains the half-open row range [start, end) covered by a partition of an in-memory fit.
+ */
+void partition_bounds(int num_samples, int num_partitions, int partition, int* start, int* end);
+
+/*
+ * Obtains the KMeans model's workspace, creating an empty one on first use.
+ * Returns a pointer to the workspace on success and NULL on failure.
+ */
+CMLWorkspace* model_workspace(KMeans* km);
+
+#endif /* For K_MEANS_INTERNAL_H */
@@ -0,0 +1,718 @@
+#include "k_means.h"
+#include "k_means_internal.h"
+#include "distance.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * The magic number opening every shard plan, spelling "CMLS" in little-endian order.
+ */
+#define KMEANS_SHARD_MAGIC 0x534C4D43u
+
+/*
+ * The version of the coordinator/worker protocol, bumped whenever a message changes layout.
+ */
+#define KMEANS_SHARD_VERSION 1
+
+/*
+ * The largest number of rows a worker asks its reader for at once while loading its shard.
+ */
+#define KMEANS_SHARD_READ_ROWS 65536
+
+/*
+ * How long the coordinator waits for each worker to connect, in milliseconds.
+ */
+#define KMEANS_SHARD_ACCEPT_TIMEOUT_MS 30000
+
+/*
+ * How many times, 10 milliseconds apart, a worker tries to connect before giving up on the coordinator.
+ */
+#define KMEANS_SHARD_CONNECT_ATTEMPTS 1000
+
+/*
+ * The commands the coordinator sends a worker at the start of each iteration.
+ */
+#define KMEANS_SHARD_STOP 0
+#define KMEANS_SHARD_ITERATE 1
+
+/*
+ * Define a typed struct holding the plan the coordinator sends each worker once it connects.
+ * The samples are split into num_partitions partitions exactly as fit_k_means would split them,
+ * and the worker owns the num_shard_partitions consecutive partitions starting from first_partition.
+ * Every message uses the host's native byte order, so the coordinator and its workers must share an architecture.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t k;
+    int32_t num_variables;
+    int64_t num_samples;
+    int32_t num_partitions;
+    int32_t first_partition;
+    int32_t num_shard_partitions;
+    int32_t reserved;
+} KMeansShardPlan;
+
+/*
+ * Define a typed struct holding a worker's shard and the scratch state of its assignments.
+ * The shard's rows are held contiguously from global row first_row, along with the label each row was last assigned.
+ * For each of its partitions it keeps the private cluster sums and counts, label changes and inertia that it reports each iteration.
+ */
+typedef struct {
+    KMeansShardPlan plan;
+    long long first_row;
+    int num_rows;
+    double* samples;
+    int* labels;
+    double* centroids;
+    double* sums;
+    int* counts;
+    int64_t* changes;
+    double* inertia;
+} KMeansShard;
+
+
+/*
+ * Helper function to send a whole buffer over a socket, retrying short and interrupted sends.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Sends with MSG_NOSIGNAL, so a peer that has gone away is reported as a failure rather than raising SIGPIPE.
+ */
+static int send_all(int fd, const void* buffer, size_t bytes) {
+    size_t done = 0;
+
+    while (done < bytes) {
+        ssize_t count = send(fd, (const char*) buffer + done, bytes - done, MSG_NOSIGNAL);
+
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return EXIT_FAILURE;
+
+        done += (size_t) count;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Helper function to receive a whole buffer from a socket, retrying short and interrupted receives.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if the peer closed the socket or the receive failed.
+ */
+static int receive_all(int fd, void* buffer, size_t bytes) {
+    size_t done = 0;
+
+    while (done < bytes) {
+        ssize_t count = recv(fd, (char*) buffer + done, bytes - done, 0);
+
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return EXIT_FAILURE;
+
+        done += (size_t) count;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Helper function to fill in the address of a Unix domain socket at the given path.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if the path is too long.
+ */
+static int socket_address(const char* path, struct sockaddr_un* address) {
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Error: Socket path %s is too long\n", path);
+        return EXIT_FAILURE;
+    }
+
+    strcpy(address->sun_path, path);
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Helper function to listen on a Unix domain socket and accept a connection from every worker, in the order they connect.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise, closing any connections already accepted.
+ *
+ * Any stale socket file at the path is replaced, and the file is removed again once every worker has connected.
+ * Each worker is waited for for at most KMEANS_SHARD_ACCEPT_TIMEOUT_MS milliseconds.
+ */
+static int accept_workers(const char* path, int num_workers, int* workers) {
+    struct sockaddr_un address;
+
+    if (socket_address(path, &address) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    int accepted = 0;
+
+    unlink(path);
+
+    if (listener < 0 || bind(listener, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(listener, num_workers) != 0) {
+        fprintf(stderr, "Error: Failed to listen for KMeans workers on %s\n", path);
+        if (listener >= 0) close(listener);
+
+        return EXIT_FAILURE;
+    }
+
+    while (accepted < num_workers) {
+        struct pollfd pending = {listener, POLLIN, 0};
+        int ready = poll(&pending, 1, KMEANS_SHARD_ACCEPT_TIMEOUT_MS);
+
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) break;
+
+        int worker = accept(listener, NULL, NULL);
+
+        if (worker < 0 && errno == EINTR) continue;
+        if (worker < 0) break;
+
+        workers[accepted++] = worker;
+    }
+
+    close(listener);
+    unlink(path);
+
+    if (accepted < num_workers) {
+        fprintf(stderr, "Error: Only %d of %d KMeans workers connected to %s\n", accepted, num_workers, path);
+
+        for (int w = 0; w < accepted; w++) {
+            close(workers[w]);
+        }
+
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Helper function to send each worker its plan and wait for every worker to confirm that it has loaded its shard.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if any worker failed or went away.
+ *
+ * The partitions are dealt out as evenly as possible in worker order, so a worker may own none if there are more workers than partitions.
+ */
+static int plan_shards(const KMeans* km, const int* workers, int num_workers, long long num_samples, int num_partitions, int* first_partitions) {
+    for (int w = 0; w <= num_workers; w++) {
+        first_partitions[w] = (int) ((long long) num_partitions * w / num_workers);
+    }
+
+    for (int w = 0; w < num_workers; w++) {
+        KMeansShardPlan plan = {KMEANS_SHARD_MAGIC, KMEANS_SHARD_VERSION, km->k, km->num_variables, num_samples, num_partitions,
+                                first_partitions[w], first_partitions[w + 1] - first_partitions[w], 0};
+
+        if (send_all(workers[w], &plan, sizeof(plan)) != EXIT_SUCCESS) return EXIT_FAILURE;
+    }
+
+    for (int w = 0; w < num_workers; w++) {
+        int32_t status;
+
+        if (receive_all(workers[w], &status, sizeof(status)) != EXIT_SUCCESS || status != EXIT_SUCCESS) {
+            fprintf(stderr, "Error: KMeans worker %d failed to load its shard\n", w);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Define a typed struct holding the coordinator's view of every partition's sums, which its reduction tasks share.
+ */
+typedef struct {
+    KMeans* km;
+    int num_partitions;
+    double* sums;
+    int* counts;
+} KMeansShardReduction;
+
+
+/*
+ * Reduces the partition sums of a block of KMEANS_CENTROID_BLOCK centroids and moves those centroids to their new means.
+ * Runs as a parallel_for task, so it only writes to the centroids in its own block.
+ *
+ * The partition sums are folded in ascending partition order, exactly as fit_k_means folds them, whichever worker computed them.
+ * Centroids whose clusters are empty keep their previous location.
+ */
+static void reduce_shard_block(void* arg, int block) {
+    KMeansShardReduction* reduction = (KMeansShardReduction*) arg;
+    KMeans* km = reduction->km;
+    int d = km->num_variables;
+    int first = block * KMEANS_CENTROID_BLOCK;
+    int last = first + KMEANS_CENTROID_BLOCK < km->k ? first + KMEANS_CENTROID_BLOCK : km->k;
+
+    for (int c = first; c < last; c++) {
+        long long count = 0;
+
+        for (int p = 0; p < reduction->num_partitions; p++) {
+            count += reduction->counts[(size_t) p * (size_t) km->k + (size_t) c];
+        }
+
+        if (count == 0) continue;
+
+        double* centroid = km->centroids + (size_t) c * (size_t) d;
+
+        for (int j = 0; j < d; j++) {
+            centroid[j] = 0.0;
+        }
+
+        for (int p = 0; p < reduction->num_partitions; p++) {
+            const double* cluster_sum = reduction->sums + ((size_t) p * (size_t) km->k + (size_t) c) * (size_t) d;
+
+            for (int j = 0; j < d; j++) {
+                centroid[j] += cluster_sum[j];
+            }
+        }
+
+        for (int j = 0; j < d; j++) {
+            centroid[j] /= count;
+        }
+    }
+}
+
+
+/*
+ * Helper function to run one assignment round across every worker, gathering their partitions' sums, counts, label changes and inertia.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if any worker failed or went away.
+ *
+ * The centroids are broadcast to every worker before any results are read, so the workers assign their shards concurrently.
+ * Each worker's results are written straight into the slots of the partitions it owns.
+ */
+static int gather_round(const KMeans* km, const int* workers, int num_workers, const int* first_partitions, KMeansShardReduction* reduction,
+                        int64_t* changes, double* inertia) {
+    int32_t command = KMEANS_SHARD_ITERATE;
+    size_t k = (size_t) km->k;
+    size_t d = (size_t) km->num_variables;
+
+    for (int w = 0; w < num_workers; w++) {
+        if (send_all(workers[w], &command, sizeof(command)) != EXIT_SUCCESS || send_all(workers[w], km->centroids, k * d * sizeof(double)) != EXIT_SUCCESS) {
+            fprintf(stderr, "Error: Failed to send centroids to KMeans worker %d\n", w);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (int w = 0; w < num_workers; w++) {
+        size_t first = (size_t) first_partitions[w];
+        size_t count = (size_t) (first_partitions[w + 1] - first_partitions[w]);
+        int fd = workers[w];
+
+        if (receive_all(fd, reduction->sums + first * k * d, count * k * d * sizeof(double)) != EXIT_SUCCESS
+            || receive_all(fd, reduction->counts + first * k, count * k * sizeof(int)) != EXIT_SUCCESS
+            || receive_all(fd, changes + first, count * sizeof(int64_t)) != EXIT_SUCCESS
+            || receive_all(fd, inertia + first, count * sizeof(double)) != EXIT_SUCCESS) {
+            fprintf(stderr, "Error: Failed to receive sums from KMeans worker %d\n", w);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Fits (trains) the KMeans model with Lloyd's algorithm to samples sharded across worker processes, acting as their coordinator.
+ * Performs up to a specified number of iterations, stopping early once converged.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Listens on a Unix domain socket at socket_path until num_workers workers (see serve_k_means_shard) have connected.
+ * The num_samples samples are split into the same partitions fit_k_means would use, and each worker is given a run of whole partitions.
+ * Each iteration the centroids are broadcast, every worker assigns and accumulates its own partitions, and only their sums and counts come back.
+ * These are reduced in partition order exactly as fit_k_means reduces them, so the fitted centroids are bit-identical to a single-process fit.
+ * The model must already be initialised, as the coordinator never sees the samples; a KMEANS_INIT_RANGE model is used as created.
+ * The convergence checks, report and callback follow fit_k_means, with the callback's hardware counters always reported as unavailable.
+ * Whether the fit succeeds or fails, every worker is released at the end, and a failed fit keeps the centroids of its last completed iteration.
+ */
+int fit_k_means_sharded(KMeans* km, const char* socket_path, int num_workers, long long num_samples, int num_iterations, KMeansReport* report) {
+    if (km == NULL || socket_path == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to fit_k_means_sharded\n");
+        return EXIT_FAILURE;
+    }
+
+    if (num_workers <= 0 || num_samples <= 0) {
+        fprintf(stderr, "Error: A sharded KMeans fit requires at least one worker and one sample\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!km->is_initialised && km->init != KMEANS_INIT_RANGE) {
+        fprintf(stderr, "Error: KMeans model must be initialised before a sharded fit\n");
+        return EXIT_FAILURE;
+    }
+
+    km->is_initialised = 1;
+
+    CMLWorkspace* workspace = model_workspace(km);
+    size_t k = (size_t) km->k;
+    size_t d = (size_t) km->num_variables;
+    int num_partitions = count_partitions(num_samples, km->k, km->num_variables, sizeof(double), sizeof(int));
+    size_t mark = workspace != NULL ? workspace_mark(workspace) : 0;
+    KMeansShardReduction reduction = {km, num_partitions, NULL, NULL};
+    int* workers = NULL;
+    int* first_partitions = NULL;
+    int64_t* changes = NULL;
+    double* inertias = NULL;
+    double* previous_centroids = NULL;
+
+    if (workspace != NULL) {
+        reduction.sums = (double*) workspace_alloc(workspace, (size_t) num_partitions * k * d * sizeof(double));
+        reduction.counts = (int*) workspace_alloc(workspace, (size_t) num_partitions * k * sizeof(int));
+        workers = (int*) workspace_alloc(workspace, (size_t) num_workers * sizeof(int));
+        first_partitions = (int*) workspace_alloc(workspace, ((size_t) num_workers + 1) * sizeof(int));
+        changes = (int64_t*) workspace_alloc(workspace, (size_t) num_partitions * sizeof(int64_t));
+        inertias = (double*) workspace_alloc(workspace, (size_t) num_partitions * sizeof(double));
+        previous_centroids = (double*) workspace_alloc(workspace, k * d * sizeof(double));
+    }
+
+    if (reduction.sums == NULL || reduction.counts == NULL || workers == NULL || first_partitions == NULL || changes == NULL || inertias == NULL
+        || previous_centroids == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for sharded KMeans fit\n");
+        if (workspace != NULL) workspace_release(workspace, mark);
+
+        return EXIT_FAILURE;
+    }
+
+    if (accept_workers(socket_path, num_workers, workers) != EXIT_SUCCESS) {
+        workspace_release(workspace, mark);
+        return EXIT_FAILURE;
+    }
+
+    // The centroids are about to move, so any index over them is out of date.
+    free_centroid_index(km->index);
+    km->index = NULL;
+
+    int num_threads = resolve_context_threads(km->context, km->num_threads);
+    int num_blocks = (km->k + KMEANS_CENTROID_BLOCK - 1) / KMEANS_CENTROID_BLOCK;
+    int is_instrumented = km->callback != NULL;
+    double previous_inertia = 0.0;
+    int status = plan_shards(km, workers, num_workers, num_samples, num_partitions, first_partitions);
+
+    if (report != NULL) {
+        report->num_iterations = 0;
+        report->converged = 0;
+        report->stopped = 0;
+        report->inertia = 0.0;
+    }
+
+    for (int iteration = 0; status == EXIT_SUCCESS && iteration < num_iterations; iteration++) {
+        double start_time = report != NULL || is_instrumented ? wall_time() : 0.0;
+        double assigned_time = 0.0;
+        long long num_changes = 0;
+        double inertia = 0.0;
+        double max_shift = 0.0;
+        int converged = 0;
+        int stopped = 0;
+
+        // Have every worker assign its shard to the current centroids and return its partition sums.
+        if (gather_round(km, workers, num_workers, first_partitions, &reduction, changes, inertias) != EXIT_SUCCESS) {
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        if (is_instrumented) assigned_time = wall_time();
+
+        for (int p = 0; p < num_partitions; p++) {
+            num_changes += changes[p];
+            inertia += inertias[p];
+        }
+
+        if (num_changes == 0) {
+            // Unchanged labels would reproduce the current centroids exactly, so the update can be skipped.
+            converged = 1;
+        } else {
+            if (km->shift_tolerance > 0.0) memcpy(previous_centroids, km->centroids, k * d * sizeof(double));
+
+            // Reduce the partition sums in partition order and update the centroids on the new cluster assignments.
+            parallel_for_in(km->context, num_blocks, num_threads, reduce_shard_block, &reduction);
+
+            if (km->shift_tolerance > 0.0) {
+                for (size_t c = 0; c < k; c++) {
+                    double shift = sqrt(squared_distance(previous_centroids + c * d, km->centroids + c * d, km->num_variables));
+
+                    if (shift > max_shift) max_shift = shift;
+                }
+
+                converged = max_shift <= km->shift_tolerance;
+            }
+
+            if (km->inertia_tolerance > 0.0 && iteration > 0) {
+                converged = converged || fabs(previous_inertia - inertia) <= km->inertia_tolerance * previous_inertia;
+            }
+        }
+
+        previous_inertia = inertia;
+
+        // Describe the iteration to the callback, which may ask for the fit to stop here.
+        if (is_instrumented) {
+            KMeansIterationStats stats;
+
+            stats.iteration = iteration;
+            stats.assignment_seconds = assigned_time - start_time;
+            stats.update_seconds = wall_time() - assigned_time;
+            stats.distance_computations = num_samples * km->k;
+            stats.distances_skipped = 0;
+            stats.labels_changed = num_changes;
+            stats.inertia = inertia;
+            stats.max_shift = max_shift;
+            memset(&stats.assignment_counters, 0xFF, sizeof(stats.assignment_counters));
+            memset(&stats.update_counters, 0xFF, sizeof(stats.update_counters));
+
+            stopped = km->callback(&stats, km->callback_arg) != 0;
+        }
+
+        if (report != NULL) {
+            if (iteration < report->max_iterations) {
+                report->iteration_times[iteration] = wall_time() - start_time;
+            }
+
+            report->num_iterations = iteration + 1;
+            report->converged = converged;
+            report->stopped = stopped;
+            report->inertia = inertia;
+        }
+
+        if (converged || stopped) break;
+    }
+
+    // Release the workers, which exit on a stop command or once their connection closes.
+    for (int w = 0; w < num_workers; w++) {
+        int32_t command = KMEANS_SHARD_STOP;
+
+        if (status == EXIT_SUCCESS) send_all(workers[w], &command, sizeof(command));
+        close(workers[w]);
+    }
+
+    workspace_release(workspace, mark);
+
+    return status;
+}
+
+
+/*
+ * Helper function to connect to a coordinator's Unix domain socket, retrying while it is not yet listening.
+ * Returns the connected socket on success, and -1 otherwise.
+ */
+static int connect_to_coordinator(const char* path) {
+    struct sockaddr_un address;
+
+    if (socket_address(path, &address) != EXIT_SUCCESS) return -1;
+
+    for (int attempt = 0; attempt < KMEANS_SHARD_CONNECT_ATTEMPTS; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr*) &address, sizeof(address)) == 0) return fd;
+
+        close(fd);
+
+        struct timespec pause = {0, 10000000};
+        nanosleep(&pause, NULL);
+    }
+
+    fprintf(stderr, "Error: Failed to connect to KMeans coordinator at %s\n", path);
+
+    return -1;
+}
+
+
+/*
+ * Helper function to allocate a worker's shard for its plan and load its rows through the reader.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Checks that the plan is from this protocol version and describes a shard this worker can hold.
+ * Every label starts out invalid, so that every sample counts as changed on the first iteration, as in fit_k_means.
+ * The reader must return every row asked of it, as the shard lies wholly within the samples.
+ */
+static int load_shard(KMeansShard* shard, KMeansReader reader, void* reader_arg) {
+    const KMeansShardPlan* plan = &shard->plan;
+
+    if (plan->magic != KMEANS_SHARD_MAGIC || plan->version != KMEANS_SHARD_VERSION || plan->k <= 0 || plan->num_variables <= 0
+        || plan->num_partitions <= 0 || plan->first_partition < 0 || plan->num_shard_partitions < 0
+        || plan->first_partition + plan->num_shard_partitions > plan->num_partitions) {
+        fprintf(stderr, "Error: KMeans worker received an invalid shard plan\n");
+        return EXIT_FAILURE;
+    }
+
+    long long end_row = partition_start(plan->num_samples, plan->num_partitions, plan->first_partition + plan->num_shard_partitions);
+
+    shard->first_row = partition_start(plan->num_samples, plan->num_partitions, plan->first_partition);
+
+    if (end_row - shard->first_row > 0x7FFFFFFF) {
+        fprintf(stderr, "Error: KMeans shard of %lld rows is too large for one worker\n", end_row - shard->first_row);
+        return EXIT_FAILURE;
+    }
+
+    size_t k = (size_t) plan->k;
+    size_t d = (size_t) plan->num_variables;
+    size_t partitions = (size_t) plan->num_shard_partitions;
+
+    shard->num_rows = (int) (end_row - shard->first_row);
+    shard->samples = (double*) malloc(((size_t) shard->num_rows * d + 1) * sizeof(double));
+    shard->labels = (int*) malloc(((size_t) shard->num_rows + 1) * sizeof(int));
+    shard->centroids = (double*) malloc(k * d * sizeof(double));
+    shard->sums = (double*) malloc((partitions * k * d + 1) * sizeof(double));
+    shard->counts = (int*) malloc((partitions * k + 1) * sizeof(int));
+    shard->changes = (int64_t*) malloc((partitions + 1) * sizeof(int64_t));
+    shard->inertia = (double*) malloc((partitions + 1) * sizeof(double));
+
+    if (shard->samples == NULL || shard->labels == NULL || shard->centroids == NULL || shard->sums == NULL || shard->counts == NULL
+        || shard->changes == NULL || shard->inertia == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for KMeans shard\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int loaded = 0; loaded < shard->num_rows;) {
+        int wanted = shard->num_rows - loaded < KMEANS_SHARD_READ_ROWS ? shard->num_rows - loaded : KMEANS_SHARD_READ_ROWS;
+
+        if (reader(shard->samples + (size_t) loaded * d, shard->first_row + loaded, wanted, reader_arg) != wanted) {
+            fprintf(stderr, "Error: KMeans sample reader failed at row %lld\n", shard->first_row + loaded);
+            return EXIT_FAILURE;
+        }
+
+        loaded += wanted;
+    }
+
+    for (int i = 0; i < shard->num_rows; i++) {
+        shard->labels[i] = -1;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Assigns each row of one of a worker's partitions to its nearest centroid and accumulates the partition's private cluster sums.
+ * Runs as a parallel_for task, so it only writes to the labels of its own rows and to its own sums, counts and statistics.
+ *
+ * Rows are visited in order and labelled by exact squared distances with ties to the lower centroid,
+ * exactly as fit_k_means assigns and accumulates the same partition.
+ */
+static void accumulate_shard_partition(void* arg, int partition) {
+    KMeansShard* shard = (KMeansShard*) arg;
+    const KMeansShardPlan* plan = &shard->plan;
+    int k = plan->k;
+    int d = plan->num_variables;
+    double* sums = shard->sums + (size_t) partition * (size_t) k * (size_t) d;
+    int* counts = shard->counts + (size_t) partition * (size_t) k;
+    int start = (int) (partition_start(plan->num_samples, plan->num_partitions, plan->first_partition + partition) - shard->first_row);
+    int end = (int) (partition_start(plan->num_samples, plan->num_partitions, plan->first_partition + partition + 1) - shard->first_row);
+    int64_t changes = 0;
+    double inertia = 0.0;
+
+    memset(sums, 0, (size_t) k * (size_t) d * sizeof(double));
+    memset(counts, 0, (size_t) k * sizeof(int));
+
+    for (int i = start; i < end; i++) {
+        const double* x = shard->samples + (size_t) i * (size_t) d;
+        double distance = 0.0;
+        int label = nearest_point(x, shard->centroids, k, d, &distance);
+        double* cluster_sum = sums + (size_t) label * (size_t) d;
+
+        changes += label != shard->labels[i];
+        inertia += distance;
+        shard->labels[i] = label;
+
+        for (int j = 0; j < d; j++) {
+            cluster_sum[j] += x[j];
+        }
+
+        counts[label]++;
+    }
+
+    shard->changes[partition] = changes;
+    shard->inertia[partition] = inertia;
+}
+
+
+/*
+ * Helper function to free the buffers of a worker's shard.
+ */
+static void free_shard(KMeansShard* shard) {
+    free(shard->samples);
+    free(shard->labels);
+    free(shard->centroids);
+    free(shard->sums);
+    free(shard->counts);
+    free(shard->changes);
+    free(shard->inertia);
+}
+
+
+/*
+ * Serves a shard of a sharded KMeans fit as a worker, until the coordinator at socket_path finishes the fit.
+ * Returns EXIT_SUCCESS once the coordinator ends the fit, and EXIT_FAILURE otherwise.
+ *
+ * Connects to the coordinator (waiting for it to start listening), receives the plan naming this worker's partitions,
+ * and loads just those rows through the reader, reporting whether that succeeded.
+ * Then, for each set of centroids received, assigns and accumulates its partitions across num_threads threads
+ * and sends back their sums, counts, label changes and inertia; the samples themselves never leave the worker.
+ * The worker stops when the coordinator sends a stop command or closes the connection, the latter counting as a failure.
+ */
+int serve_k_means_shard(const char* socket_path, KMeansReader reader, void* reader_arg, int num_threads) {
+    if (socket_path == NULL || reader == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to serve_k_means_shard\n");
+        return EXIT_FAILURE;
+    }
+
+    int fd = connect_to_coordinator(socket_path);
+
+    if (fd < 0) return EXIT_FAILURE;
+
+    KMeansShard shard = {0};
+    int status = receive_all(fd, &shard.plan, sizeof(shard.plan));
+
+    if (status == EXIT_SUCCESS) status = load_shard(&shard, reader, reader_arg);
+
+    int32_t loaded = status;
+
+    if (send_all(fd, &loaded, sizeof(loaded)) != EXIT_SUCCESS) status = EXIT_FAILURE;
+
+    num_threads = resolve_num_threads(num_threads);
+
+    size_t k = (size_t) shard.plan.k;
+    size_t d = (size_t) shard.plan.num_variables;
+    size_t partitions = (size_t) shard.plan.num_shard_partitions;
+
+    while (status == EXIT_SUCCESS) {
+        int32_t command;
+
+        if (receive_all(fd, &command, sizeof(command)) != EXIT_SUCCESS) {
+            fprintf(stderr, "Error: KMeans coordinator closed the connection mid-fit\n");
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        if (command == KMEANS_SHARD_STOP) break;
+
+        if (receive_all(fd, shard.centroids, k * d * sizeof(double)) != EXIT_SUCCESS) {
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        parallel_for((int) partitions, num_threads, accumulate_shard_partition, &shard);
+
+        if (send_all(fd, shard.sums, partitions * k * d * sizeof(double)) != EXIT_SUCCESS
+            || send_all(fd, shard.counts, partitions * k * sizeof(int)) != EXIT_SUCCESS
+            || send_all(fd, shard.changes, partitions * sizeof(int64_t)) != EXIT_SUCCESS
+            || send_all(fd, shard.inertia, partitions * sizeof(double)) != EXIT_SUCCESS) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    close(fd);
+    free_shard(&shard);
+
+    return status;
+}
@@ -0,0 +1,694 @@
+#include "k_means.h"
+#include "k_means_internal.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * The number of columns transposed by each task when the centroids are laid out for scoring.
+ */
+#define KMEANS_SPHERICAL_COLUMN_BLOCK 1024
+
+/*
+ * The number of rows labelled by each task of a spherical batch prediction.
+ */
+#define KMEANS_SPHERICAL_LABEL_BLOCK 1024
+
+/*
+ * Define a typed struct holding the state of a spherical fit or seeding pass over sparse samples, shared by every task.
+ * Rows are never normalised in place: inverse_norms holds the reciprocal of each row's norm (zero for an empty row) and scales every use of it.
+ * During a fit, transposed holds the unit centroids column-major (d by k), so each non-zero of a row adds one contiguous run of k scores.
+ * The order and cluster_starts arrays group the row indices by label, so that each centroid is rebuilt from its own rows alone.
+ * Each partition keeps k scores of scratch, and records how many of its labels changed and its inertia.
+ * During seeding, min_distances holds each row's cosine distance to the nearest center so far, and center the newest center.
+ * Every array is carved from the model's workspace, and mark records where to release them back to.
+ */
+typedef struct {
+    KMeans* km;
+    const CMLSparseMatrix* X;
+    double* inverse_norms;
+    double* transposed;
+    int* labels;
+    int* order;
+    int* cluster_starts;
+    double* scores;
+    int num_partitions;
+    long long* partition_changes;
+    double* partition_inertia;
+    double* min_distances;
+    const double* center;
+    size_t mark;
+} SphericalFit;
+
+
+/*
+ * Helper function to calculate the dot product of a sparse row with a dense vector.
+ * Returns the sum of each non-zero value multiplied by the vector's value in its column.
+ */
+static inline double sparse_dot(const CMLSparseMatrix* X, int row, const double* v) {
+    double dot = 0.0;
+
+    for (size_t p = X->row_offsets[row]; p < X->row_offsets[row + 1]; p++) {
+        dot += X->values[p] * v[X->col_indices[p]];
+    }
+
+    return dot;
+}
+
+
+/*
+ * Helper function to scale a dense vector to unit length.
+ * Returns the vector's norm before scaling, leaving a zero vector unchanged.
+ */
+static double normalise(double* v, int dimensions) {
+    double norm = 0.0;
+
+    for (int j = 0; j < dimensions; j++) {
+        norm += v[j] * v[j];
+    }
+
+    norm = sqrt(norm);
+
+    if (norm > 0.0) {
+        for (int j = 0; j < dimensions; j++) {
+            v[j] /= norm;
+        }
+    }
+
+    return norm;
+}
+
+
+/*
+ * Computes the inverse norm of each row of a single partition.
+ * Runs as a parallel_for task, so it only writes to the inverse norms of its own rows.
+ */
+static void compute_inverse_norms(void* arg, int partition) {
+    SphericalFit* fit = (SphericalFit*) arg;
+    const CMLSparseMatrix* X = fit->X;
+    int start, end;
+
+    partition_bounds(fit->X->num_rows, fit->num_partitions, partition, &start, &end);
+
+    for (int i = start; i < end; i++) {
+        double norm = 0.0;
+
+        for (size_t p = X->row_offsets[i]; p < X->row_offsets[i + 1]; p++) {
+            norm += X->values[p] * X->values[p];
+        }
+
+        fit->inverse_norms[i] = norm > 0.0 ? 1.0 / sqrt(norm) : 0.0;
+    }
+}
+
+
+/*
+ * Helper function to begin a spherical fit or seeding pass, carving the inverse norms and partition statistics from the model's workspace.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise, with nothing left allocated.
+ *
+ * The rows are split with the same partitioning as fit_k_means, budgeting each partition's k scores of scratch.
+ * The inverse norms are computed in parallel as soon as they are allocated, as every later step depends on them.
+ */
+static int begin_spherical_pass(SphericalFit* fit, KMeans* km, const CMLSparseMatrix* X, int num_threads) {
+    CMLWorkspace* workspace = model_workspace(km);
+
+    if (workspace == NULL) return EXIT_FAILURE;
+
+    fit->km = km;
+    fit->X = X;
+    fit->num_partitions = count_partitions(X->num_rows, km->k, 1, sizeof(double), 0);
+    fit->mark = workspace_mark(workspace);
+    fit->inverse_norms = (double*) workspace_alloc(workspace, (size_t) X->num_rows * sizeof(double));
+    fit->partition_changes = (long long*) workspace_alloc(workspace, (size_t) fit->num_partitions * sizeof(long long));
+    fit->partition_inertia = (double*) workspace_alloc(workspace, (size_t) fit->num_partitions * sizeof(double));
+
+    if (fit->inverse_norms == NULL || fit->partition_changes == NULL || fit->partition_inertia == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for spherical KMeans\n");
+        workspace_release(workspace, fit->mark);
+
+        return EXIT_FAILURE;
+    }
+
+    parallel_for_in(fit->km->context, fit->num_partitions, num_threads, compute_inverse_norms, fit);
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Folds the newest seeding center into the cosine distance of each row of a single partition, summing the partition's distances.
+ * Runs as a parallel_for task, so it only writes to the distances of its own rows and its own sum.
+ */
+static void fold_center_partition(void* arg, int partition) {
+    SphericalFit* fit = (SphericalFit*) arg;
+    double total = 0.0;
+    int start, end;
+
+    partition_bounds(fit->X->num_rows, fit->num_partitions, partition, &start, &end);
+
+    for (int i = start; i < end; i++) {
+        double distance = 1.0 - sparse_dot(fit->X, i, fit->center) * fit->inverse_norms[i];
+
+        if (distance < 0.0) distance = 0.0;
+        if (distance < fit->min_distances[i]) fit->min_distances[i] = distance;
+
+        total += fit->min_distances[i];
+    }
+
+    fit->partition_inertia[partition] = total;
+}
+
+
+/*
+ * Helper function to draw a row with probability proportional to its cosine distance to the nearest center so far.
+ * Returns the index of the drawn row, or -1 if every row has a zero distance.
+ *
+ * The partition sums locate the partition containing the drawn mass, so only that partition's rows are scanned.
+ */
+static int sample_by_cosine_distance(const SphericalFit* fit, CMLRandom* rng) {
+    double total = 0.0;
+    int last = -1;
+
+    for (int p = 0; p < fit->num_partitions; p++) {
+        total += fit->partition_inertia[p];
+    }
+
+    if (!(total > 0.0)) return -1;
+
+    double target = rng_uniform(rng) * total;
+
+    for (int p = 0; p < fit->num_partitions; p++) {
+        if (target >= fit->partition_inertia[p] && p < fit->num_partitions - 1) {
+            target -= fit->partition_inertia[p];
+            continue;
+        }
+
+        int start, end;
+        partition_bounds(fit->X->num_rows, fit->num_partitions, p, &start, &end);
+
+        for (int i = start; i < end; i++) {
+            if (fit->min_distances[i] <= 0.0) continue;
+
+            last = i;
+            target -= fit->min_distances[i];
+
+            if (target < 0.0) return i;
+        }
+    }
+
+    return last;
+}
+
+
+/*
+ * Helper function to seed the model's centroids from the rows with k-means++ under cosine distance.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Every non-empty row starts at the largest possible cosine distance, 2, so the first center is drawn uniformly from them.
+ * Each following center is drawn with probability proportional to its cosine distance to the nearest center so far.
+ * Once every distance is zero (fewer distinct directions than clusters), the remaining centroids repeat the last center.
+ */
+static int seed_spherical_plus_plus(SphericalFit* fit, int num_threads) {
+    KMeans* km = fit->km;
+    int d = km->num_variables;
+
+    fit->min_distances = (double*) workspace_alloc(km->workspace, (size_t) fit->X->num_rows * sizeof(double));
+
+    if (fit->min_distances == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for spherical KMeans seeding\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int p = 0; p < fit->num_partitions; p++) {
+        int start, end;
+        double total = 0.0;
+
+        partition_bounds(fit->X->num_rows, fit->num_partitions, p, &start, &end);
+
+        for (int i = start; i < end; i++) {
+            fit->min_distances[i] = fit->inverse_norms[i] > 0.0 ? 2.0 : 0.0;
+            total += fit->min_distances[i];
+        }
+
+        fit->partition_inertia[p] = total;
+    }
+
+    int row = sample_by_cosine_distance(fit, &km->rng);
+
+    if (row < 0) {
+        fprintf(stderr, "Error: Spherical KMeans needs at least one non-zero sample\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int c = 0; c < km->k; c++) {
+        double* center = km->centroids + (size_t) c * (size_t) d;
+
+        if (row < 0) {
+            memcpy(center, center - d, (size_t) d * sizeof(double));
+            continue;
+        }
+
+        memset(center, 0, (size_t) d * sizeof(double));
+
+        for (size_t p = fit->X->row_offsets[row]; p < fit->X->row_offsets[row + 1]; p++) {
+            center[fit->X->col_indices[p]] += fit->X->values[p] * fit->inverse_norms[row];
+        }
+
+        if (c + 1 == km->k) break;
+
+        fit->center = center;
+        parallel_for_in(fit->km->context, fit->num_partitions, num_threads, fold_center_partition, fit);
+
+        row = sample_by_cosine_distance(fit, &km->rng);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Initialises the KMeans model's centroids as unit vectors from a series of sparse data samples, for spherical k-means.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Ensures that the model and samples are non-null, and that the samples are well formed with at least one row and one column per model variable.
+ * KMEANS_INIT_RANGE keeps the centroids drawn when the model was created, scaled to unit length.
+ * The other methods seed the centroids with k-means++ under cosine distance, drawing from the model's own generator.
+ * Marks the model as initialised, so that fitting does not seed it again.
+ */
+int init_spherical_k_means(KMeans* km, const CMLSparseMatrix* X) {
+    if (km == NULL || X == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to init_spherical_k_means\n");
+        return EXIT_FAILURE;
+    }
+
+    if (X->num_cols != km->num_variables || X->num_rows <= 0) {
+        fprintf(stderr, "Error: Sample matrix must have at least one row and %d columns to initialise the KMeans model\n", km->num_variables);
+        return EXIT_FAILURE;
+    }
+
+    if (check_sparse_matrix(X) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+    // The centroids are about to move, so any index over them is out of date.
+    free_centroid_index(km->index);
+    km->index = NULL;
+
+    int status = EXIT_SUCCESS;
+
+    if (km->init == KMEANS_INIT_RANGE) {
+        for (int c = 0; c < km->k; c++) {
+            normalise(km->centroids + (size_t) c * (size_t) km->num_variables, km->num_variables);
+        }
+    } else {
+        int num_threads = resolve_context_threads(km->context, km->num_threads);
+        SphericalFit fit = {0};
+
+        if (begin_spherical_pass(&fit, km, X, num_threads) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+        status = seed_spherical_plus_plus(&fit, num_threads);
+        workspace_release(km->workspace, fit.mark);
+    }
+
+    if (status == EXIT_SUCCESS) km->is_initialised = 1;
+
+    return status;
+}
+
+
+/*
+ * Lays out a block of the model's columns in the column-major centroid table.
+ * Runs as a parallel_for task, so it only writes to the table rows of its own columns.
+ */
+static void transpose_column_block(void* arg, int block) {
+    SphericalFit* fit = (SphericalFit*) arg;
+    const KMeans* km = fit->km;
+    int first = block * KMEANS_SPHERICAL_COLUMN_BLOCK;
+    int last = first + KMEANS_SPHERICAL_COLUMN_BLOCK < km->num_variables ? first + KMEANS_SPHERICAL_COLUMN_BLOCK : km->num_variables;
+
+    for (int c = 0; c < km->k; c++) {
+        const double* centroid = km->centroids + (size_t) c * (size_t) km->num_variables;
+
+        for (int j = first; j < last; j++) {
+            fit->transposed[(size_t) j * (size_t) km->k + (size_t) c] = centroid[j];
+        }
+    }
+}
+
+
+/*
+ * Assigns each row of a single partition to the centroid of greatest cosine similarity.
+ * Runs as a parallel_for task, so it only writes to the labels of its own rows and to its own scores and statistics.
+ *
+ * The centroids are unit vectors, so the most similar centroid has the largest dot product with the row, and its norm never needs dividing out.
+ * Each non-zero adds its value times one contiguous row of the column-major table to the k scores, for O(nnz * k) work per row.
+ * Ties go to the lowest centroid index, and the inertia sums each row's cosine distance, 1 - similarity.
+ */
+static void assign_spherical_partition(void* arg, int partition) {
+    SphericalFit* fit = (SphericalFit*) arg;
+    const CMLSparseMatrix* X = fit->X;
+    int k = fit->km->k;
+    double* scores = fit->scores + (size_t) partition * (size_t) k;
+    long long changes = 0;
+    double inertia = 0.0;
+    int start, end;
+
+    partition_bounds(fit->X->num_rows, fit->num_partitions, partition, &start, &end);
+
+    for (int i = start; i < end; i++) {
+        memset(scores, 0, (size_t) k * sizeof(double));
+
+        for (size_t p = X->row_offsets[i]; p < X->row_offsets[i + 1]; p++) {
+            const double* column = fit->transposed + (size_t) X->col_indices[p] * (size_t) k;
+            double value = X->values[p];
+
+            for (int c = 0; c < k; c++) {
+                scores[c] += value * column[c];
+            }
+        }
+
+        int label = 0;
+
+        for (int c = 1; c < k; c++) {
+            if (scores[c] > scores[label]) label = c;
+        }
+
+        changes += label != fit->labels[i];
+        inertia += 1.0 - scores[label] * fit->inverse_norms[i];
+        fit->labels[i] = label;
+    }
+
+    fit->partition_changes[partition] = changes;
+    fit->partition_inertia[partition] = inertia;
+}
+
+
+/*
+ * Rebuilds a block of KMEANS_CENTROID_BLOCK centroids as the normalised sum of their rows' unit vectors.
+ * Runs as a parallel_for task, so it only writes to the centroids in its own block.
+ *
+ * Each centroid's rows are added in ascending row order, which keeps the result independent of the thread count.
+ * Centroids whose clusters are empty keep their previous direction.
+ */
+static void rebuild_centroid_block(void* arg, int block) {
+    SphericalFit* fit = (SphericalFit*) arg;
+    KMeans* km = fit->km;
+    const CMLSparseMatrix* X = fit->X;
+    int d = km->num_variables;
+    int first = block * KMEANS_CENTROID_BLOCK;
+    int last = first + KMEANS_CENTROID_BLOCK < km->k ? first + KMEANS_CENTROID_BLOCK : km->k;
+
+    for (int c = first; c < last; c++) {
+        if (fit->cluster_starts[c] == fit->cluster_starts[c + 1]) continue;
+
+        double* centroid = km->centroids + (size_t) c * (size_t) d;
+
+        memset(centroid, 0, (size_t) d * sizeof(double));
+
+        for (int r = fit->cluster_starts[c]; r < fit->cluster_starts[c + 1]; r++) {
+            int i = fit->order[r];
+
+            for (size_t p = X->row_offsets[i]; p < X->row_offsets[i + 1]; p++) {
+                centroid[X->col_indices[p]] += X->values[p] * fit->inverse_norms[i];
+            }
+        }
+
+        normalise(centroid, d);
+    }
+}
+
+
+/*
+ * Helper function to group the row indices by label with a counting sort, keeping rows in ascending order within each cluster.
+ */
+static void group_rows_by_label(SphericalFit* fit) {
+    int k = fit->km->k;
+
+    memset(fit->cluster_starts, 0, (size_t) (k + 1) * sizeof(int));
+
+    for (int i = 0; i < fit->X->num_rows; i++) {
+        fit->cluster_starts[fit->labels[i] + 1]++;
+    }
+
+    for (int c = 0; c < k; c++) {
+        fit->cluster_starts[c + 1] += fit->cluster_starts[c];
+    }
+
+    // Place each row at its cluster's next free slot, which leaves every start shifted along by one cluster.
+    for (int i = 0; i < fit->X->num_rows; i++) {
+        fit->order[fit->cluster_starts[fit->labels[i]]++] = i;
+    }
+
+    for (int c = k; c > 0; c--) {
+        fit->cluster_starts[c] = fit->cluster_starts[c - 1];
+    }
+
+    fit->cluster_starts[0] = 0;
+}
+
+
+/*
+ * Fits the KMeans model to a series of sparse data samples with spherical k-means, clustering by cosine similarity.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Ensures that the model and samples are non-null, and that the samples are well formed with one column per model variable.
+ * Initialises the unit centroids with init_spherical_k_means first, if the model has not been initialised yet.
+ * Rows are scaled by their precomputed inverse norms wherever they are used, so the samples are never copied or densified.
+ * Each iteration lays out the unit centroids column-major, then assigns every partition's rows in parallel in O(nnz * k).
+ * If no label changed, the fit has converged and the update is skipped.
+ * Otherwise the rows are grouped by label and each centroid becomes the normalised sum of its rows' unit vectors, in parallel across centroids.
+ * The model's algorithm and shift_tolerance are not used, since the assignment is exhaustive and unit centroids shift by at most 2.
+ * The inertia_tolerance, callback and report behave as in fit_k_means, with inertia measured as the summed cosine distance 1 - similarity.
+ * The fitted centroids are identical whatever num_threads is set to.
+ */
+int fit_spherical_k_means(KMeans* km, const CMLSparseMatrix* X, int num_iterations, KMeansReport* report) {
+    if (km == NULL || X == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to fit_spherical_k_means\n");
+        return EXIT_FAILURE;
+    }
+
+    if (X->num_cols != km->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the KMeans model expects %d\n", X->num_cols, km->num_variables);
+        return EXIT_FAILURE;
+    }
+
+    if (check_sparse_matrix(X) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+    // Seed the unit centroids from the samples if the model has not been initialised yet.
+    if (!km->is_initialised && init_spherical_k_means(km, X) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+    // The centroids are about to move, so any index over them is out of date.
+    free_centroid_index(km->index);
+    km->index = NULL;
+
+    int num_threads = resolve_context_threads(km->context, km->num_threads);
+    int is_instrumented = km->callback != NULL;
+    size_t k = (size_t) km->k;
+    double previous_inertia = 0.0;
+    SphericalFit fit = {0};
+
+    if (begin_spherical_pass(&fit, km, X, num_threads) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+    fit.transposed = (double*) workspace_alloc(km->workspace, (size_t) km->num_variables * k * sizeof(double));
+    fit.labels = (int*) workspace_alloc(km->workspace, (size_t) X->num_rows * sizeof(int));
+    fit.order = (int*) workspace_alloc(km->workspace, (size_t) X->num_rows * sizeof(int));
+    fit.cluster_starts = (int*) workspace_alloc(km->workspace, (k + 1) * sizeof(int));
+    fit.scores = (double*) workspace_alloc(km->workspace, (size_t) fit.num_partitions * k * sizeof(double));
+
+    if (fit.transposed == NULL || fit.labels == NULL || fit.order == NULL || fit.cluster_starts == NULL || fit.scores == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for KMeans fit\n");
+        workspace_release(km->workspace, fit.mark);
+
+        return EXIT_FAILURE;
+    }
+
+    // Start with invalid labels, so that every sample counts as changed on the first iteration.
+    for (int i = 0; i < X->num_rows; i++) {
+        fit.labels[i] = -1;
+    }
+
+    // Open the hardware counters only if the callback is there to receive them.
+    CMLPerfCounters counters;
+    CMLPerfReading readings[3];
+    int has_counters = is_instrumented && km->perf_counters && km->context == NULL && open_perf_counters(&counters) == EXIT_SUCCESS;
+    int num_column_blocks = (km->num_variables + KMEANS_SPHERICAL_COLUMN_BLOCK - 1) / KMEANS_SPHERICAL_COLUMN_BLOCK;
+    int num_centroid_blocks = (km->k + KMEANS_CENTROID_BLOCK - 1) / KMEANS_CENTROID_BLOCK;
+
+    if (report != NULL) {
+        report->num_iterations = 0;
+        report->converged = 0;
+        report->stopped = 0;
+        report->inertia = 0.0;
+    }
+
+    for (int iteration = 0; iteration < num_iterations; iteration++) {
+        double start_time = report != NULL || is_instrumented ? wall_time() : 0.0;
+        double assigned_time = 0.0;
+        long long changes = 0;
+        double inertia = 0.0;
+        int converged = 0;
+        int stopped = 0;
+
+        if (has_counters) read_perf_counters(&counters, &readings[0]);
+
+        // Lay out the centroids column-major, then label every row with its most similar centroid.
+        parallel_for_in(km->context, num_column_blocks, num_threads, transpose_column_block, &fit);
+        parallel_for_in(km->context, fit.num_partitions, num_threads, assign_spherical_partition, &fit);
+
+        if (is_instrumented) assigned_time = wall_time();
+        if (has_counters) read_perf_counters(&counters, &readings[1]);
+
+        for (int p = 0; p < fit.num_partitions; p++) {
+            changes += fit.partition_changes[p];
+            inertia += fit.partition_inertia[p];
+        }
+
+        if (changes == 0) {
+            converged = 1;
+        } else {
+            group_rows_by_label(&fit);
+            parallel_for_in(km->context, num_centroid_blocks, num_threads, rebuild_centroid_block, &fit);
+
+            if (km->inertia_tolerance > 0.0 && iteration > 0) {
+                converged = fabs(previous_inertia - inertia) <= km->inertia_tolerance * previous_inertia;
+            }
+        }
+
+        previous_inertia = inertia;
+
+        // Describe the iteration to the callback, which may ask for the fit to stop here.
+        if (is_instrumented) {
+            KMeansIterationStats stats;
+
+            stats.iteration = iteration;
+            stats.assignment_seconds = assigned_time - start_time;
+            stats.update_seconds = wall_time() - assigned_time;
+            stats.distance_computations = (long long) X->num_rows * km->k;
+            stats.distances_skipped = 0;
+            stats.labels_changed = changes;
+            stats.inertia = inertia;
+            stats.max_shift = 0.0;
+
+            if (has_counters) {
+                read_perf_counters(&counters, &readings[2]);
+                perf_reading_delta(&readings[0], &readings[1], &stats.assignment_counters);
+                perf_reading_delta(&readings[1], &readings[2], &stats.update_counters);
+            } else {
+                memset(&stats.assignment_counters, 0xFF, sizeof(stats.assignment_counters));
+                memset(&stats.update_counters, 0xFF, sizeof(stats.update_counters));
+            }
+
+            stopped = km->callback(&stats, km->callback_arg) != 0;
+        }
+
+        if (report != NULL) {
+            if (iteration < report->max_iterations) {
+                report->iteration_times[iteration] = wall_time() - start_time;
+            }
+
+            report->num_iterations = iteration + 1;
+            report->converged = converged;
+            report->stopped = stopped;
+            report->inertia = inertia;
+        }
+
+        if (converged || stopped) break;
+    }
+
+    if (has_counters) close_perf_counters(&counters);
+
+    workspace_release(km->workspace, fit.mark);
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Predicts the cluster of a sparse data point given as num_nonzeros column indices and values, by cosine similarity.
+ * Returns the index of the most similar centroid, or -1 on invalid arguments.
+ *
+ * The centroids are unit vectors, so the point needs no normalising: the largest dot product wins, with ties going to the lowest index.
+ * Each centroid's dot product only gathers the point's active columns, in O(num_nonzeros * k) time.
+ */
+int predict_spherical_k_means(KMeans* km, const int* indices, const double* values, int num_nonzeros) {
+    if (km == NULL || indices == NULL || values == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to predict_spherical_k_means\n");
+        return -1;
+    }
+
+    int label = 0;
+    double best = -INFINITY;
+
+    for (int c = 0; c < km->k; c++) {
+        const double* centroid = km->centroids + (size_t) c * (size_t) km->num_variables;
+        double dot = 0.0;
+
+        for (int p = 0; p < num_nonzeros; p++) {
+            dot += values[p] * centroid[indices[p]];
+        }
+
+        if (dot > best) {
+            best = dot;
+            label = c;
+        }
+    }
+
+    return label;
+}
+
+
+/*
+ * Define a typed struct describing a spherical labelling of the rows of a sparse matrix, shared by every block task.
+ */
+typedef struct {
+    KMeans* km;
+    const CMLSparseMatrix* X;
+    int* labels;
+} SphericalLabelling;
+
+
+/*
+ * Labels a block of KMEANS_SPHERICAL_LABEL_BLOCK rows with their most similar centroids.
+ * Runs as a parallel_for task, so it only writes to the labels of its own rows.
+ */
+static void label_spherical_block(void* arg, int block) {
+    SphericalLabelling* labelling = (SphericalLabelling*) arg;
+    const CMLSparseMatrix* X = labelling->X;
+    int start = block * KMEANS_SPHERICAL_LABEL_BLOCK;
+    int end = start + KMEANS_SPHERICAL_LABEL_BLOCK < X->num_rows ? start + KMEANS_SPHERICAL_LABEL_BLOCK : X->num_rows;
+
+    for (int i = start; i < end; i++) {
+        size_t offset = X->row_offsets[i];
+        int length = (int) (X->row_offsets[i + 1] - offset);
+
+        labelling->labels[i] = predict_spherical_k_means(labelling->km, X->col_indices + offset, X->values + offset, length);
+    }
+}
+
+
+/*
+ * Predicts the cluster of each row of a sparse matrix of data points, by cosine similarity.
+ * Writes the predicted cluster number of each row into the labels array.
+ *
+ * Ensures that the model, matrix and labels array are non-null, and that the matrix is well formed with one column per model variable.
+ * Blocks of rows are labelled in parallel across the model's threads, on its context if it has one.
+ */
+void predict_spherical_k_means_batch(KMeans* km, const CMLSparseMatrix* X, int* labels) {
+    if (km == NULL || X == NULL || labels == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to predict_spherical_k_means_batch\n");
+        return;
+    }
+
+    if (X->num_cols != km->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the KMeans model expects %d\n", X->num_cols, km->num_variables);
+        return;
+    }
+
+    if (check_sparse_matrix(X) != EXIT_SUCCESS) return;
+
+    SphericalLabelling labelling = {km, X, labels};
+    int num_blocks = (X->num_rows + KMEANS_SPHERICAL_LABEL_BLOCK - 1) / KMEANS_SPHERICAL_LABEL_BLOCK;
+
+    parallel_for_in(km->context, num_blocks, resolve_context_threads(km->context, km->num_threads), label_spherical_block, &labelling);
+}
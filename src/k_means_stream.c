@@ -0,0 +1,596 @@
+#include "k_means.h"
+#include "k_means_internal.h"
+#include "distance.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*
+ * The number of bytes of samples each chunk holds when no chunk size is given.
+ */
+#define KMEANS_STREAM_CHUNK_BYTES ((size_t) 32 << 20)
+
+/*
+ * Define a typed struct holding the state of a background thread that reads chunks into two alternating buffers.
+ * At most one read is outstanding at a time: requested_slot names the buffer to fill from requested_row, or is -1 when no read is waiting.
+ * Each buffer records whether its latest read has finished and how many rows it returned, which is -1 if the reader failed.
+ * If the thread could not be started, requests are served by reading on the calling thread instead.
+ */
+typedef struct {
+    KMeansReader reader;
+    void* reader_arg;
+    int chunk_rows;
+    double* buffers[2];
+    int rows[2];
+    int is_ready[2];
+    int requested_slot;
+    long long requested_row;
+    int is_stopping;
+    int has_thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    pthread_t thread;
+} KMeansPrefetcher;
+
+/*
+ * Define a typed struct holding the state of a streamed fit, shared by every task.
+ * Each chunk is split into num_partitions fixed row ranges, each owning a private block of k cluster sums, counts and its inertia.
+ * After every chunk these are folded in partition order into the pass's totals, so the fit is deterministic for any thread count.
+ * Every array is carved from the model's workspace, and mark records where to release them back to.
+ */
+typedef struct {
+    KMeans* km;
+    const double* chunk;
+    int chunk_rows;
+    int num_partitions;
+    double* sums;
+    long long* counts;
+    double* partition_inertia;
+    double* totals;
+    long long* total_counts;
+    double* previous_centroids;
+    size_t mark;
+} KMeansStream;
+
+
+/*
+ * Entry point of the prefetching thread, which serves read requests until it is asked to stop.
+ *
+ * The mutex is dropped while the reader runs, so the requesting thread keeps computing on the other buffer in the meantime.
+ */
+static void* prefetch_chunks(void* arg) {
+    KMeansPrefetcher* prefetcher = (KMeansPrefetcher*) arg;
+
+    pthread_mutex_lock(&prefetcher->mutex);
+
+    for (;;) {
+        while (prefetcher->requested_slot < 0 && !prefetcher->is_stopping) {
+            pthread_cond_wait(&prefetcher->changed, &prefetcher->mutex);
+        }
+
+        if (prefetcher->is_stopping) break;
+
+        int slot = prefetcher->requested_slot;
+        long long first_row = prefetcher->requested_row;
+
+        prefetcher->requested_slot = -1;
+        pthread_mutex_unlock(&prefetcher->mutex);
+
+        int rows = prefetcher->reader(prefetcher->buffers[slot], first_row, prefetcher->chunk_rows, prefetcher->reader_arg);
+
+        pthread_mutex_lock(&prefetcher->mutex);
+        prefetcher->rows[slot] = rows;
+        prefetcher->is_ready[slot] = 1;
+        pthread_cond_broadcast(&prefetcher->changed);
+    }
+
+    pthread_mutex_unlock(&prefetcher->mutex);
+
+    return NULL;
+}
+
+
+/*
+ * Helper function to start a prefetcher reading chunks of up to chunk_rows rows into the two given buffers.
+ * If the thread cannot be started, the prefetcher falls back to reading on the calling thread.
+ */
+static void start_prefetcher(KMeansPrefetcher* prefetcher, KMeansReader reader, void* reader_arg, int chunk_rows, double* first, double* second) {
+    memset(prefetcher, 0, sizeof(KMeansPrefetcher));
+    prefetcher->reader = reader;
+    prefetcher->reader_arg = reader_arg;
+    prefetcher->chunk_rows = chunk_rows;
+    prefetcher->buffers[0] = first;
+    prefetcher->buffers[1] = second;
+    prefetcher->requested_slot = -1;
+
+    pthread_mutex_init(&prefetcher->mutex, NULL);
+    pthread_cond_init(&prefetcher->changed, NULL);
+
+    prefetcher->has_thread = pthread_create(&prefetcher->thread, NULL, prefetch_chunks, prefetcher) == 0;
+}
+
+
+/*
+ * Helper function to ask the prefetcher to fill a buffer with the chunk starting at first_row.
+ * The buffer must not be read again until wait_for_chunk has returned for it.
+ */
+static void request_chunk(KMeansPrefetcher* prefetcher, int slot, long long first_row) {
+    if (!prefetcher->has_thread) {
+        prefetcher->rows[slot] = prefetcher->reader(prefetcher->buffers[slot], first_row, prefetcher->chunk_rows, prefetcher->reader_arg);
+        prefetcher->is_ready[slot] = 1;
+        return;
+    }
+
+    pthread_mutex_lock(&prefetcher->mutex);
+    prefetcher->is_ready[slot] = 0;
+    prefetcher->requested_slot = slot;
+    prefetcher->requested_row = first_row;
+    pthread_cond_broadcast(&prefetcher->changed);
+    pthread_mutex_unlock(&prefetcher->mutex);
+}
+
+
+/*
+ * Helper function to wait until the prefetcher has filled a requested buffer.
+ * Returns the number of rows read into it, or -1 if the reader failed.
+ */
+static int wait_for_chunk(KMeansPrefetcher* prefetcher, int slot) {
+    if (!prefetcher->has_thread) return prefetcher->rows[slot];
+
+    pthread_mutex_lock(&prefetcher->mutex);
+
+    while (!prefetcher->is_ready[slot]) {
+        pthread_cond_wait(&prefetcher->changed, &prefetcher->mutex);
+    }
+
+    int rows = prefetcher->rows[slot];
+
+    pthread_mutex_unlock(&prefetcher->mutex);
+
+    return rows;
+}
+
+
+/*
+ * Helper function to stop the prefetcher, waiting for any read in progress to finish before its buffers may be released.
+ */
+static void stop_prefetcher(KMeansPrefetcher* prefetcher) {
+    if (prefetcher->has_thread) {
+        pthread_mutex_lock(&prefetcher->mutex);
+        prefetcher->is_stopping = 1;
+        pthread_cond_broadcast(&prefetcher->changed);
+        pthread_mutex_unlock(&prefetcher->mutex);
+
+        pthread_join(prefetcher->thread, NULL);
+    }
+
+    pthread_cond_destroy(&prefetcher->changed);
+    pthread_mutex_destroy(&prefetcher->mutex);
+}
+
+
+/*
+ * Assigns each row of a single partition of the current chunk to its nearest centroid, accumulating the partition's private cluster sums.
+ * Runs as a parallel_for task, so it only writes to its own sums, counts and inertia.
+ *
+ * Rows are labelled by exact squared distances with ties to the lower centroid, exactly as Lloyd's assignment in fit_k_means does.
+ */
+static void accumulate_chunk_partition(void* arg, int partition) {
+    KMeansStream* stream = (KMeansStream*) arg;
+    const KMeans* km = stream->km;
+    int d = km->num_variables;
+    double* sums = stream->sums + (size_t) partition * (size_t) km->k * (size_t) d;
+    long long* counts = stream->counts + (size_t) partition * (size_t) km->k;
+    int start, end;
+
+    partition_bounds(stream->chunk_rows, stream->num_partitions, partition, &start, &end);
+    double inertia = 0.0;
+
+    memset(sums, 0, (size_t) km->k * (size_t) d * sizeof(double));
+    memset(counts, 0, (size_t) km->k * sizeof(long long));
+
+    for (int i = start; i < end; i++) {
+        const double* x = stream->chunk + (size_t) i * (size_t) d;
+        double distance;
+        int label = nearest_point(x, km->centroids, km->k, d, &distance);
+        double* cluster_sum = sums + (size_t) label * (size_t) d;
+
+        for (int j = 0; j < d; j++) {
+            cluster_sum[j] += x[j];
+        }
+
+        counts[label]++;
+        inertia += distance;
+    }
+
+    stream->partition_inertia[partition] = inertia;
+}
+
+
+/*
+ * Folds the partition sums of a block of KMEANS_CENTROID_BLOCK centroids into the pass's running totals.
+ * Runs as a parallel_for task, so it only writes to the totals of its own block.
+ *
+ * The partitions are folded in ascending order, which keeps the totals independent of the thread count.
+ */
+static void fold_chunk_block(void* arg, int block) {
+    KMeansStream* stream = (KMeansStream*) arg;
+    const KMeans* km = stream->km;
+    int d = km->num_variables;
+    int first = block * KMEANS_CENTROID_BLOCK;
+    int last = first + KMEANS_CENTROID_BLOCK < km->k ? first + KMEANS_CENTROID_BLOCK : km->k;
+
+    for (int c = first; c < last; c++) {
+        double* total = stream->totals + (size_t) c * (size_t) d;
+
+        for (int p = 0; p < stream->num_partitions; p++) {
+            const double* cluster_sum = stream->sums + ((size_t) p * (size_t) km->k + (size_t) c) * (size_t) d;
+
+            for (int j = 0; j < d; j++) {
+                total[j] += cluster_sum[j];
+            }
+
+            stream->total_counts[c] += stream->counts[(size_t) p * (size_t) km->k + (size_t) c];
+        }
+    }
+}
+
+
+/*
+ * Moves a block of KMEANS_CENTROID_BLOCK centroids to the means of the pass's totals.
+ * Runs as a parallel_for task, so it only writes to the centroids in its own block.
+ *
+ * Centroids whose clusters are empty keep their previous location.
+ */
+static void update_stream_block(void* arg, int block) {
+    KMeansStream* stream = (KMeansStream*) arg;
+    KMeans* km = stream->km;
+    int d = km->num_variables;
+    int first = block * KMEANS_CENTROID_BLOCK;
+    int last = first + KMEANS_CENTROID_BLOCK < km->k ? first + KMEANS_CENTROID_BLOCK : km->k;
+
+    for (int c = first; c < last; c++) {
+        if (stream->total_counts[c] == 0) continue;
+
+        double* centroid = km->centroids + (size_t) c * (size_t) d;
+        const double* total = stream->totals + (size_t) c * (size_t) d;
+
+        for (int j = 0; j < d; j++) {
+            centroid[j] = total[j] / stream->total_counts[c];
+        }
+    }
+}
+
+
+/*
+ * Helper function to allocate the scratch arrays of a streamed fit, including the two chunk buffers.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * If any allocation fails, every array allocated so far is released back to the workspace.
+ */
+static int allocate_stream(KMeansStream* stream, int chunk_rows, double** buffers) {
+    KMeans* km = stream->km;
+    CMLWorkspace* workspace = model_workspace(km);
+    size_t k = (size_t) km->k;
+    size_t d = (size_t) km->num_variables;
+
+    if (workspace == NULL) return EXIT_FAILURE;
+
+    stream->mark = workspace_mark(workspace);
+
+    buffers[0] = (double*) workspace_alloc(workspace, (size_t) chunk_rows * d * sizeof(double));
+    buffers[1] = (double*) workspace_alloc(workspace, (size_t) chunk_rows * d * sizeof(double));
+    stream->sums = (double*) workspace_alloc(workspace, (size_t) stream->num_partitions * k * d * sizeof(double));
+    stream->counts = (long long*) workspace_alloc(workspace, (size_t) stream->num_partitions * k * sizeof(long long));
+    stream->partition_inertia = (double*) workspace_alloc(workspace, (size_t) stream->num_partitions * sizeof(double));
+    stream->totals = (double*) workspace_alloc(workspace, k * d * sizeof(double));
+    stream->total_counts = (long long*) workspace_alloc(workspace, k * sizeof(long long));
+    stream->previous_centroids = (double*) workspace_alloc(workspace, k * d * sizeof(double));
+
+    if (buffers[0] == NULL || buffers[1] == NULL || stream->sums == NULL || stream->counts == NULL || stream->partition_inertia == NULL
+        || stream->totals == NULL || stream->total_counts == NULL || stream->previous_centroids == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for streamed KMeans fit\n");
+        workspace_release(workspace, stream->mark);
+
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Helper function to make a single pass over the samples, accumulating every centroid's cluster sum, count and the pass's inertia.
+ * Returns the number of samples read, or -1 if the reader failed.
+ *
+ * The first chunk is requested up front, and from then on the next chunk is requested before the current one is processed,
+ * so the prefetcher reads one chunk while the threads assign and accumulate the other.
+ * A chunk shorter than the chunk size ends the pass.
+ */
+static long long stream_pass(KMeansStream* stream, KMeansPrefetcher* prefetcher, int num_threads, double* inertia) {
+    const KMeans* km = stream->km;
+    int num_blocks = (km->k + KMEANS_CENTROID_BLOCK - 1) / KMEANS_CENTROID_BLOCK;
+    long long first_row = 0;
+    int slot = 0;
+
+    memset(stream->totals, 0, (size_t) km->k * (size_t) km->num_variables * sizeof(double));
+    memset(stream->total_counts, 0, (size_t) km->k * sizeof(long long));
+    *inertia = 0.0;
+
+    request_chunk(prefetcher, slot, 0);
+
+    for (;;) {
+        int rows = wait_for_chunk(prefetcher, slot);
+
+        if (rows < 0 || rows > prefetcher->chunk_rows) {
+            fprintf(stderr, "Error: KMeans sample reader failed at row %lld\n", first_row);
+            return -1;
+        }
+
+        // Read ahead into the other buffer while this chunk is assigned.
+        if (rows == prefetcher->chunk_rows) request_chunk(prefetcher, slot ^ 1, first_row + rows);
+
+        if (rows > 0) {
+            stream->chunk = prefetcher->buffers[slot];
+            stream->chunk_rows = rows;
+
+            parallel_for_in(km->context, stream->num_partitions, num_threads, accumulate_chunk_partition, stream);
+            parallel_for_in(km->context, num_blocks, num_threads, fold_chunk_block, stream);
+
+            for (int p = 0; p < stream->num_partitions; p++) {
+                *inertia += stream->partition_inertia[p];
+            }
+        }
+
+        first_row += rows;
+
+        if (rows < prefetcher->chunk_rows) return first_row;
+
+        slot ^= 1;
+    }
+}
+
+
+/*
+ * Fits (trains) the KMeans model to samples streamed through a reader, without ever holding more than two chunks of them in memory.
+ * Performs Lloyd's algorithm for up to a specified number of iterations, stopping early once converged.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Ensures that the model and reader are non-null, and picks a chunk of about KMEANS_STREAM_CHUNK_BYTES if chunk_rows is non-positive.
+ * A background thread reads the next chunk while the current one is assigned, so each iteration is a single sequential pass with I/O
+ * overlapping compute. Each chunk is split into fixed partitions whose sums are folded in order, so the fit is deterministic for any thread count.
+ * If the model has not been initialised yet, its centroids are first seeded from the first chunk with the model's init method.
+ * Bounds for Elkan and Hamerly would need per-sample state as large as the labels, so every streamed fit uses Lloyd's algorithm.
+ * The labels are not kept either, so the fit has converged once an update leaves every centroid where it was,
+ * which is exactly when fit_k_means would have seen no label change. The tolerances are checked as in fit_k_means.
+ * The model's callback receives each pass's timings, distances, inertia and largest shift, with labels_changed reported as -1.
+ * If the reader fails, the function exits with the centroids of the last completed iteration.
+ */
+int fit_k_means_stream(KMeans* km, KMeansReader reader, void* reader_arg, int chunk_rows, int num_iterations, KMeansReport* report) {
+    if (km == NULL || reader == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to fit_k_means_stream\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t row_bytes = (size_t) km->num_variables * sizeof(double);
+
+    if (chunk_rows <= 0) {
+        size_t rows = KMEANS_STREAM_CHUNK_BYTES / row_bytes;
+        chunk_rows = rows > (size_t) 0x40000000 ? 0x40000000 : (rows > 0 ? (int) rows : 1);
+    }
+
+    int num_threads = resolve_context_threads(km->context, km->num_threads);
+    int num_blocks = (km->k + KMEANS_CENTROID_BLOCK - 1) / KMEANS_CENTROID_BLOCK;
+    int is_instrumented = km->callback != NULL;
+    double previous_inertia = 0.0;
+    double* buffers[2];
+    KMeansStream stream = {0};
+    KMeansPrefetcher prefetcher;
+
+    stream.km = km;
+    stream.num_partitions = count_partitions(chunk_rows, km->k, km->num_variables, sizeof(double), sizeof(long long));
+
+    if (allocate_stream(&stream, chunk_rows, buffers) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+    // Seed the centroids from the first chunk if the model has not been initialised yet.
+    if (!km->is_initialised) {
+        int rows = reader(buffers[0], 0, chunk_rows, reader_arg);
+        CMLMatrix first_chunk = matrix_view(buffers[0], rows > 0 ? rows : 0, km->num_variables, km->num_variables);
+
+        if (rows <= 0 || rows > chunk_rows || init_k_means(km, &first_chunk) != EXIT_SUCCESS) {
+            if (rows <= 0 || rows > chunk_rows) fprintf(stderr, "Error: KMeans sample reader returned no samples to initialise from\n");
+            workspace_release(km->workspace, stream.mark);
+
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The centroids are about to move, so any index over them is out of date.
+    free_centroid_index(km->index);
+    km->index = NULL;
+
+    // Open the hardware counters only if the callback is there to receive them.
+    CMLPerfCounters counters;
+    CMLPerfReading readings[3];
+    int has_counters = is_instrumented && km->perf_counters && km->context == NULL && open_perf_counters(&counters) == EXIT_SUCCESS;
+    int status = EXIT_SUCCESS;
+
+    if (report != NULL) {
+        report->num_iterations = 0;
+        report->converged = 0;
+        report->stopped = 0;
+        report->inertia = 0.0;
+    }
+
+    start_prefetcher(&prefetcher, reader, reader_arg, chunk_rows, buffers[0], buffers[1]);
+
+    for (int iteration = 0; iteration < num_iterations; iteration++) {
+        double start_time = report != NULL || is_instrumented ? wall_time() : 0.0;
+        double assigned_time = 0.0;
+        double inertia;
+        int stopped = 0;
+
+        if (has_counters) read_perf_counters(&counters, &readings[0]);
+
+        // Stream every sample past the centroids, accumulating each cluster's sum.
+        long long num_samples = stream_pass(&stream, &prefetcher, num_threads, &inertia);
+
+        if (num_samples <= 0) {
+            if (num_samples == 0) fprintf(stderr, "Error: KMeans sample reader returned no samples\n");
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        if (is_instrumented) assigned_time = wall_time();
+        if (has_counters) read_perf_counters(&counters, &readings[1]);
+
+        memcpy(stream.previous_centroids, km->centroids, (size_t) km->k * row_bytes);
+        parallel_for_in(km->context, num_blocks, num_threads, update_stream_block, &stream);
+
+        double max_shift = 0.0;
+
+        for (int c = 0; c < km->k; c++) {
+            size_t offset = (size_t) c * (size_t) km->num_variables;
+            double shift = sqrt(squared_distance(stream.previous_centroids + offset, km->centroids + offset, km->num_variables));
+
+            if (shift > max_shift) max_shift = shift;
+        }
+
+        // Centroids that did not move would reproduce the same labels, so the fit has converged.
+        int converged = max_shift == 0.0 || (km->shift_tolerance > 0.0 && max_shift <= km->shift_tolerance);
+
+        if (km->inertia_tolerance > 0.0 && iteration > 0) {
+            converged = converged || fabs(previous_inertia - inertia) <= km->inertia_tolerance * previous_inertia;
+        }
+
+        previous_inertia = inertia;
+
+        // Describe the iteration to the callback, which may ask for the fit to stop here.
+        if (is_instrumented) {
+            KMeansIterationStats stats;
+
+            stats.iteration = iteration;
+            stats.assignment_seconds = assigned_time - start_time;
+            stats.update_seconds = wall_time() - assigned_time;
+            stats.distance_computations = num_samples * km->k;
+            stats.distances_skipped = 0;
+            stats.labels_changed = -1;
+            stats.inertia = inertia;
+            stats.max_shift = max_shift;
+
+            if (has_counters) {
+                read_perf_counters(&counters, &readings[2]);
+                perf_reading_delta(&readings[0], &readings[1], &stats.assignment_counters);
+                perf_reading_delta(&readings[1], &readings[2], &stats.update_counters);
+            } else {
+                memset(&stats.assignment_counters, 0xFF, sizeof(stats.assignment_counters));
+                memset(&stats.update_counters, 0xFF, sizeof(stats.update_counters));
+            }
+
+            stopped = km->callback(&stats, km->callback_arg) != 0;
+        }
+
+        if (report != NULL) {
+            if (iteration < report->max_iterations) {
+                report->iteration_times[iteration] = wall_time() - start_time;
+            }
+
+            report->num_iterations = iteration + 1;
+            report->converged = converged;
+            report->stopped = stopped;
+            report->inertia = inertia;
+        }
+
+        if (converged || stopped) break;
+    }
+
+    stop_prefetcher(&prefetcher);
+
+    if (has_counters) close_perf_counters(&counters);
+
+    workspace_release(km->workspace, stream.mark);
+
+    return status;
+}
+
+
+/*
+ * Define a typed struct describing a raw binary sample file being streamed into a fit.
+ */
+typedef struct {
+    int fd;
+    size_t row_bytes;
+} KMeansSampleFile;
+
+
+/*
+ * Reads up to max_rows rows starting from first_row of a raw binary sample file, as a KMeansReader.
+ * Returns the number of rows read, or -1 on failure.
+ *
+ * Reads with pread, so the file offset is never shared, and retries short or interrupted reads until the chunk is full or the file ends.
+ */
+static int read_sample_file(double* buffer, long long first_row, int max_rows, void* arg) {
+    const KMeansSampleFile* file = (const KMeansSampleFile*) arg;
+    size_t wanted = (size_t) max_rows * file->row_bytes;
+    off_t offset = (off_t) first_row * (off_t) file->row_bytes;
+    size_t done = 0;
+
+    while (done < wanted) {
+        ssize_t count = pread(file->fd, (char*) buffer + done, wanted - done, offset + (off_t) done);
+
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) return -1;
+        if (count == 0) break;
+
+        done += (size_t) count;
+    }
+
+    return (int) (done / file->row_bytes);
+}
+
+
+/*
+ * Fits (trains) the KMeans model to the samples of a raw binary file, streaming it in chunks of chunk_rows rows.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The file holds the samples back to back as native doubles, num_variables per row, with no header.
+ * Ensures that the file opens and that its size is a whole, non-zero number of rows, then advises the kernel that it is read sequentially
+ * and streams it through fit_k_means_stream.
+ */
+int fit_k_means_file(KMeans* km, const char* path, int chunk_rows, int num_iterations, KMeansReport* report) {
+    if (km == NULL || path == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to fit_k_means_file\n");
+        return EXIT_FAILURE;
+    }
+
+    KMeansSampleFile file = {open(path, O_RDONLY), (size_t) km->num_variables * sizeof(double)};
+    struct stat info;
+
+    if (file.fd < 0) {
+        fprintf(stderr, "Error: Failed to open sample file %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    if (fstat(file.fd, &info) != 0 || info.st_size == 0 || (size_t) info.st_size % file.row_bytes != 0) {
+        fprintf(stderr, "Error: Sample file %s does not hold a whole number of %d-variable rows\n", path, km->num_variables);
+        close(file.fd);
+
+        return EXIT_FAILURE;
+    }
+
+    posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    int status = fit_k_means_stream(km, read_sample_file, &file, chunk_rows, num_iterations, report);
+
+    close(file.fd);
+
+    return status;
+}
@@ -0,0 +1,52 @@
+/*
+ * Type-generic declarations of a single-precision KMeans model, instantiated by float_models.h.
+ * Samples and centroids are always stored as floats, halving their memory traffic and doubling the SIMD lanes of each distance.
+ * Before each inclusion, CML_ACCUM must name the type centroid sums are accumulated in,
+ * CML_KMEANS the model's type name and CML_SUFFIX its function suffix.
+ * This file deliberately has no include guard, as it is included once per instantiation.
+ */
+
+/*
+ * Define a typed struct to encapsulate KMeans models of the instantiated precision.
+ * The centroids are stored row-major in a single buffer of k rows by num_variables columns.
+ * The num_threads field sets how many threads a fit uses, where a non-positive value uses every online CPU.
+ * If context is set, fits and predictions run on its shared pool instead, using every one of its threads.
+ */
+typedef struct {
+    float* centroids;
+    int k;
+    int num_variables;
+    int num_threads;
+    CMLContext* context;
+    CMLRandom rng;
+} CML_KMEANS;
+
+/*
+ * Creates a new KMeans of the instantiated precision for a specified number of clusters and features, driven by the given seed.
+ * Returns a pointer to a new model on success and NULL on failure.
+ */
+CML_KMEANS* CML_TYPED(create_k_means_seeded)(int k, int num_variables, double initial_centroid_range, uint64_t seed);
+
+/*
+ * Fits the KMeans model to a series of single-precision data samples with Lloyd's algorithm, for up to num_iterations iterations.
+ * The fitted centroids are identical whatever num_threads is set to, and if report is non-null it is filled in with the outcome of the fit.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int CML_TYPED(fit_k_means)(CML_KMEANS* km, const CMLMatrixF* X, int num_iterations, KMeansReport* report);
+
+/*
+ * Predicts the cluster of a given single-precision data point.
+ * Returns the predicted cluster number based on the model's centroids.
+ */
+int CML_TYPED(predict_k_means)(CML_KMEANS* km, const float* x);
+
+/*
+ * Predicts the cluster of each row of a single-precision matrix of data points.
+ * Writes the predicted cluster number of each row into the labels array.
+ */
+void CML_TYPED(predict_k_means_batch)(CML_KMEANS* km, const CMLMatrixF* X, int* labels);
+
+/*
+ * Frees the dynamically allocated memory used by the KMeans model.
+ */
+void CML_TYPED(free_k_means)(CML_KMEANS* km);
@@ -0,0 +1,264 @@
+#include "linalg.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * The smallest ratio of a Cholesky pivot to the largest diagonal entry that is accepted.
+ * A smaller pivot implies a condition number beyond roughly 1e12, at which point the factorisation is abandoned.
+ */
+#define CHOLESKY_PIVOT_TOLERANCE 1e-12
+
+/*
+ * The smallest ratio of a diagonal entry of R to its first entry that counts towards the rank in a pivoted QR solve.
+ */
+#define QR_RANK_TOLERANCE 1e-12
+
+
+/*
+ * Factorises the symmetric positive definite matrix A as L L^T, where A and L are row-major n by n matrices.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if A is not positive definite or too ill-conditioned for a Cholesky factorisation.
+ *
+ * Only the lower triangle of A is read, and only the lower triangle of L is written, so L may be the same matrix as A.
+ * A pivot that is non-positive or below CHOLESKY_PIVOT_TOLERANCE of the largest diagonal entry fails the factorisation.
+ */
+int cholesky_factor(const double* A, int n, double* L) {
+    if (A == NULL || L == NULL || n <= 0) {
+        fprintf(stderr, "Error: Invalid matrix passed to cholesky_factor\n");
+        return EXIT_FAILURE;
+    }
+
+    double max_diagonal = 0.0;
+
+    for (int i = 0; i < n; i++) {
+        if (A[(size_t) i * n + i] > max_diagonal) max_diagonal = A[(size_t) i * n + i];
+    }
+
+    for (int i = 0; i < n; i++) {
+        double* Li = L + (size_t) i * n;
+
+        for (int j = 0; j <= i; j++) {
+            const double* Lj = L + (size_t) j * n;
+            double sum = A[(size_t) i * n + j];
+
+            for (int p = 0; p < j; p++) {
+                sum -= Li[p] * Lj[p];
+            }
+
+            if (i != j) {
+                Li[j] = sum / Lj[j];
+                continue;
+            }
+
+            if (!(sum > CHOLESKY_PIVOT_TOLERANCE * max_diagonal)) return EXIT_FAILURE;
+
+            Li[i] = sqrt(sum);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Solves L L^T x = b by forward and back substitution, given the lower triangular Cholesky factor L from cholesky_factor.
+ *
+ * Each substitution only reads entries of x it has already written, so x may be the same vector as b.
+ * This costs O(n^2), so a factor can be reused for as many right-hand sides as needed.
+ */
+void cholesky_substitute(const double* L, const double* b, int n, double* x) {
+    // Solve L z = b into x, then L^T x = z in place.
+    for (int i = 0; i < n; i++) {
+        double sum = b[i];
+
+        for (int p = 0; p < i; p++) {
+            sum -= L[(size_t) i * n + p] * x[p];
+        }
+
+        x[i] = sum / L[(size_t) i * n + i];
+    }
+
+    for (int i = n - 1; i >= 0; i--) {
+        double sum = x[i];
+
+        for (int p = i + 1; p < n; p++) {
+            sum -= L[(size_t) p * n + i] * x[p];
+        }
+
+        x[i] = sum / L[(size_t) i * n + i];
+    }
+}
+
+
+/*
+ * Solves the symmetric positive definite system A x = b, where A is a row-major n by n matrix.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if A is not positive definite or too ill-conditioned for a Cholesky factorisation.
+ *
+ * Factorises a copy of A with cholesky_factor, then solves with cholesky_substitute, leaving A and b untouched.
+ * If the factorisation fails, x is left unchanged.
+ */
+int cholesky_solve(const double* A, const double* b, int n, double* x) {
+    if (A == NULL || b == NULL || x == NULL || n <= 0) {
+        fprintf(stderr, "Error: Invalid system passed to cholesky_solve\n");
+        return EXIT_FAILURE;
+    }
+
+    double* L = (double*) malloc((size_t) n * (size_t) n * sizeof(double));
+
+    if (L == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for a Cholesky factorisation\n");
+        return EXIT_FAILURE;
+    }
+
+    int status = cholesky_factor(A, n, L);
+
+    if (status == EXIT_SUCCESS) cholesky_substitute(L, b, n, x);
+
+    free(L);
+
+    return status;
+}
+
+
+/*
+ * Solves the system A x = b in the least-squares sense, where A is a row-major n by n matrix that may be rank deficient.
+ * Returns the numerical rank of A on success, and -1 on failure.
+ *
+ * Factorises a copy of A as Q R P^T with Householder reflections, pivoting the remaining column of largest norm into place at each step.
+ * Q^T is applied to a copy of b alongside the factorisation, so Q is never formed.
+ * Columns whose diagonal entry of R falls below QR_RANK_TOLERANCE of the first are treated as dependent and given a zero coefficient.
+ */
+int pivoted_qr_solve(const double* A, const double* b, int n, double* x) {
+    if (A == NULL || b == NULL || x == NULL || n <= 0) {
+        fprintf(stderr, "Error: Invalid system passed to pivoted_qr_solve\n");
+        return -1;
+    }
+
+    double* R = (double*) malloc((size_t) n * (size_t) n * sizeof(double));
+    double* qb = (double*) malloc(n * sizeof(double));
+    double* v = (double*) malloc(n * sizeof(double));
+    int* permutation = (int*) malloc(n * sizeof(int));
+
+    if (R == NULL || qb == NULL || v == NULL || permutation == NULL) {
+        free(R);
+        free(qb);
+        free(v);
+        free(permutation);
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for a QR factorisation\n");
+        return -1;
+    }
+
+    memcpy(R, A, (size_t) n * (size_t) n * sizeof(double));
+    memcpy(qb, b, n * sizeof(double));
+
+    for (int j = 0; j < n; j++) {
+        permutation[j] = j;
+    }
+
+    for (int k = 0; k < n; k++) {
+        // Pivot the remaining column with the largest trailing norm into position k.
+        int pivot = k;
+        double pivot_norm = -1.0;
+
+        for (int j = k; j < n; j++) {
+            double norm = 0.0;
+
+            for (int i = k; i < n; i++) {
+                norm += R[(size_t) i * n + j] * R[(size_t) i * n + j];
+            }
+
+            if (norm > pivot_norm) {
+                pivot_norm = norm;
+                pivot = j;
+            }
+        }
+
+        if (pivot != k) {
+            for (int i = 0; i < n; i++) {
+                double swap = R[(size_t) i * n + k];
+                R[(size_t) i * n + k] = R[(size_t) i * n + pivot];
+                R[(size_t) i * n + pivot] = swap;
+            }
+
+            int swap = permutation[k];
+            permutation[k] = permutation[pivot];
+            permutation[pivot] = swap;
+        }
+
+        if (pivot_norm == 0.0) break;
+
+        // Build the reflection that maps the trailing column onto a multiple of the first basis vector.
+        double alpha = R[(size_t) k * n + k] > 0.0 ? -sqrt(pivot_norm) : sqrt(pivot_norm);
+        double v_norm = 0.0;
+
+        for (int i = k; i < n; i++) {
+            v[i] = R[(size_t) i * n + k];
+        }
+
+        v[k] -= alpha;
+
+        for (int i = k; i < n; i++) {
+            v_norm += v[i] * v[i];
+        }
+
+        if (v_norm > 0.0) {
+            for (int j = k + 1; j < n; j++) {
+                double dot = 0.0;
+
+                for (int i = k; i < n; i++) {
+                    dot += v[i] * R[(size_t) i * n + j];
+                }
+
+                for (int i = k; i < n; i++) {
+                    R[(size_t) i * n + j] -= 2.0 * dot / v_norm * v[i];
+                }
+            }
+
+            double dot = 0.0;
+
+            for (int i = k; i < n; i++) {
+                dot += v[i] * qb[i];
+            }
+
+            for (int i = k; i < n; i++) {
+                qb[i] -= 2.0 * dot / v_norm * v[i];
+            }
+        }
+
+        R[(size_t) k * n + k] = alpha;
+    }
+
+    int rank = 0;
+
+    while (rank < n && fabs(R[(size_t) rank * n + rank]) > QR_RANK_TOLERANCE * fabs(R[0])) {
+        rank++;
+    }
+
+    // Back substitute over the independent columns, reusing v for the permuted solution.
+    for (int i = n - 1; i >= 0; i--) {
+        if (i >= rank) {
+            v[i] = 0.0;
+            continue;
+        }
+
+        double sum = qb[i];
+
+        for (int j = i + 1; j < rank; j++) {
+            sum -= R[(size_t) i * n + j] * v[j];
+        }
+
+        v[i] = sum / R[(size_t) i * n + i];
+    }
+
+    for (int i = 0; i < n; i++) {
+        x[permutation[i]] = v[i];
+    }
+
+    free(R);
+    free(qb);
+    free(v);
+    free(permutation);
+
+    return rank;
+}
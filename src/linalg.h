@@ -0,0 +1,29 @@
+#ifndef LINALG_H
+#define LINALG_H
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Factorises the symmetric positive definite matrix A as L L^T, where A and L are row-major n by n matrices.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if A is not positive definite or too ill-conditioned for a Cholesky factorisation.
+ */
+int cholesky_factor(const double* A, int n, double* L);
+
+/*
+ * Solves L L^T x = b by forward and back substitution, given the lower triangular Cholesky factor L from cholesky_factor.
+ */
+void cholesky_substitute(const double* L, const double* b, int n, double* x);
+
+/*
+ * Solves the symmetric positive definite system A x = b, where A is a row-major n by n matrix.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if A is not positive definite or too ill-conditioned for a Cholesky factorisation.
+ */
+int cholesky_solve(const double* A, const double* b, int n, double* x);
+
+/*
+ * Solves the system A x = b in the least-squares sense, where A is a row-major n by n matrix that may be rank deficient.
+ * Returns the numerical rank of A on success, and -1 on failure.
+ */
+int pivoted_qr_solve(const double* A, const double* b, int n, double* x);
+
+#endif /* For LINALG_H */
@@ -1,6 +1,50 @@
 #include "linear_regression.h"
+#include "distance.h"
+#include "linalg.h"
+#include "model_file.h"
+#include "perf_counters.h"
+#include "parallel.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+/*
+ * The number of rows accumulated together into X^T X, sized so that a block of rows stays in cache across every row of the gram matrix.
+ */
+#define LINEAR_REGRESSION_BLOCK_ROWS 64
+
+/*
+ * The number of rows in each gradient partition of a mini-batch step.
+ * Partitions depend only on the batch size, so a step's reduced gradient is identical whatever the thread count.
+ */
+#define LINEAR_REGRESSION_GRADIENT_ROWS 256
+
+/*
+ * The smallest lazily applied weight scale in sparse training before it is folded back into the weights, keeping the scaled steps well conditioned.
+ */
+#define LINEAR_REGRESSION_MIN_SCALE 1e-6
+
+
+/*
+ * Define a typed struct describing a parallel stochastic gradient descent run, shared by every task.
+ * Each partition or shard owns a private gradient, with consecutive gradients gradient_stride values apart so that none share a cache line.
+ */
+typedef struct {
+    LinearRegression* lr;
+    const CMLMatrix* X;
+    const double* y;
+    double learning_rate;
+    int batch_start;
+    int batch_end;
+    double* gradients;
+    int num_shards;
+    size_t gradient_stride;
+} LinearRegressionSGDRun;
 
 /*
  * Creates a new LinearRegression for a specified number of variables.
@@ -26,32 +70,186 @@ LinearRegression* new_linear_regression(int num_variables) {
     }
 
     lr->num_variables = num_variables;
+    lr->gram = NULL;
+    lr->moments = NULL;
+    lr->num_samples = 0;
+    lr->num_threads = 1;
+    lr->context = NULL;
+    lr->batch_size = 1;
+    lr->sgd = LINEAR_REGRESSION_MINI_BATCH;
+    lr->mapping = NULL;
+    lr->mapping_size = 0;
+    lr->workspace = NULL;
+    lr->callback = NULL;
+    lr->callback_arg = NULL;
+    lr->perf_counters = 0;
+    lr->inverse_gram = NULL;
+    lr->forgetting_factor = 1.0;
+    lr->weights_version = 0;
 
     return lr;
 }
 
+
+/*
+ * Helper function to obtain the LinearRegression model's workspace, creating an empty one on first use.
+ * Returns a pointer to the workspace on success and NULL on failure.
+ */
+static CMLWorkspace* model_workspace(LinearRegression* lr) {
+    if (lr->workspace == NULL) lr->workspace = create_workspace(0, lr->num_threads);
+
+    return lr->workspace;
+}
+
+/*
+ * Define a typed struct holding the state of a training run's per-epoch instrumentation, which is only active when the model has a callback.
+ */
+typedef struct {
+    int is_instrumented;
+    int has_counters;
+    CMLPerfCounters counters;
+    CMLPerfReading start_reading;
+    double start_time;
+} LinearRegressionMonitor;
+
+/*
+ * Helper function to start monitoring a training run, opening hardware counters if the model asks for them.
+ * The counters are skipped for a run on a context, whose already running workers they cannot follow.
+ */
+static void open_monitor(const LinearRegression* lr, const CMLContext* context, LinearRegressionMonitor* monitor) {
+    monitor->is_instrumented = lr->callback != NULL;
+    monitor->has_counters = monitor->is_instrumented && lr->perf_counters && context == NULL && open_perf_counters(&monitor->counters) == EXIT_SUCCESS;
+}
+
+/*
+ * Helper function to stop monitoring a training run, closing any hardware counters.
+ */
+static void close_monitor(LinearRegressionMonitor* monitor) {
+    if (monitor->has_counters) close_perf_counters(&monitor->counters);
+}
+
+/*
+ * Helper function to mark the start of an epoch, reading the clock and counters only when instrumented.
+ */
+static void begin_epoch(LinearRegressionMonitor* monitor) {
+    if (!monitor->is_instrumented) return;
+
+    monitor->start_time = wall_time();
+
+    if (monitor->has_counters) read_perf_counters(&monitor->counters, &monitor->start_reading);
+}
+
+/*
+ * Helper function to describe a finished epoch to the model's callback, when instrumented.
+ * Returns non-zero if the callback asked for training to stop.
+ *
+ * The epoch's time and counters are taken before measuring the loss, so they only cover the training itself.
+ * The loss and its gradient then take one extra pass over the samples, dense X or sparse S, with the gradient carved from the model's workspace.
+ */
+static int end_epoch(LinearRegression* lr, LinearRegressionMonitor* monitor, const CMLMatrix* X, const CMLSparseMatrix* S, const double* y, int epoch) {
+    if (!monitor->is_instrumented) return 0;
+
+    LinearRegressionEpochStats stats;
+    int d = lr->num_variables;
+
+    stats.epoch = epoch;
+    stats.seconds = wall_time() - monitor->start_time;
+    stats.loss = 0.0;
+    stats.gradient_norm = 0.0;
+
+    if (monitor->has_counters) {
+        CMLPerfReading end_reading;
+
+        read_perf_counters(&monitor->counters, &end_reading);
+        perf_reading_delta(&monitor->start_reading, &end_reading, &stats.counters);
+    } else {
+        memset(&stats.counters, 0xFF, sizeof(stats.counters));
+    }
+
+    CMLWorkspace* workspace = model_workspace(lr);
+    size_t mark = workspace_mark(workspace);
+    double* gradient = workspace != NULL ? (double*) workspace_alloc(workspace, (size_t) d * sizeof(double)) : NULL;
+
+    int num_rows = S != NULL ? S->num_rows : X->num_rows;
+
+    if (gradient != NULL && num_rows > 0) {
+        memset(gradient, 0, (size_t) d * sizeof(double));
+
+        for (int i = 0; i < num_rows; i++) {
+            double error = -y[i];
+
+            if (S != NULL) {
+                for (size_t p = S->row_offsets[i]; p < S->row_offsets[i + 1]; p++) {
+                    error += lr->weights[S->col_indices[p]] * S->values[p];
+                }
+
+                for (size_t p = S->row_offsets[i]; p < S->row_offsets[i + 1]; p++) {
+                    gradient[S->col_indices[p]] += error * S->values[p];
+                }
+            } else {
+                const double* x = matrix_row(X, i);
+
+                for (int j = 0; j < d; j++) {
+                    error += lr->weights[j] * x[j];
+                }
+
+                for (int j = 0; j < d; j++) {
+                    gradient[j] += error * x[j];
+                }
+            }
+
+            stats.loss += error * error;
+        }
+
+        for (int j = 0; j < d; j++) {
+            double component = 2.0 * gradient[j] / num_rows;
+            stats.gradient_norm += component * component;
+        }
+
+        stats.loss /= num_rows;
+        stats.gradient_norm = sqrt(stats.gradient_norm);
+    }
+
+    workspace_release(workspace, mark);
+
+    return lr->callback(&stats, lr->callback_arg) != 0;
+}
+
 /*
  * Trains the given LinearRegression model based on a series of samples and their accompanying target values.
  * The impact each sample has on the LinearRegression model is controlled by the learning_rate parameter.
  *
- * Ensures that the model and sample-target sets are non-null and executes the training.
+ * Ensures that the model and sample-target sets are non-null, and that the samples have one column per model variable, then executes the training.
  * Each sample's target is predicted with the current weights and compared to the actual target.
  * The error between these is then used to update the model's weights based on the gradient delta.
  * The number of iterations used in the gradient descent is also parameterised here.
+ * If the model has a callback, it is passed the loss and gradient norm after each iteration, and can stop the training early.
  */
-void train_linear_regression(LinearRegression* lr, double** X, double* y, int num_samples, double learning_rate, int num_iterations) {
-    if (lr == NULL || X == NULL || y == NULL) {
+void train_linear_regression(LinearRegression* lr, const CMLMatrix* X, const double* y, double learning_rate, int num_iterations) {
+    if (lr == NULL || X == NULL || X->data == NULL || y == NULL) {
         fprintf(stderr, "Error: Null pointer passed to train_linear_regression\n");
         return;
     }
 
+    if (X->num_cols != lr->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the LinearRegression model expects %d\n", X->num_cols, lr->num_variables);
+        return;
+    }
+
+    LinearRegressionMonitor monitor;
+
+    open_monitor(lr, NULL, &monitor);
+
     for (int iteration = 0; iteration < num_iterations; iteration++) {
-        for (int i = 0; i < num_samples; i++) {
+        begin_epoch(&monitor);
+
+        for (int i = 0; i < X->num_rows; i++) {
+            const double* x = matrix_row(X, i);
             double predicted = 0.0;
 
             // Calculate the model's prediction
             for (int j = 0; j < lr->num_variables; j++) {
-                predicted += lr->weights[j] * X[i][j];
+                predicted += lr->weights[j] * x[j];
             }
 
             // Compute the error
@@ -59,10 +257,685 @@ void train_linear_regression(LinearRegression* lr, double** X, double* y, int nu
 
             // Update the weights appropriately
             for (int j = 0; j < lr->num_variables; j++) {
-                lr->weights[j] -= learning_rate * error * X[i][j];
+                lr->weights[j] -= learning_rate * error * x[j];
+            }
+        }
+
+        if (end_epoch(lr, &monitor, X, NULL, y, iteration)) break;
+    }
+
+    close_monitor(&monitor);
+}
+
+/*
+ * Helper function to fold a lazily applied weight scale back into the weights, so that they hold their true values again.
+ */
+static void fold_weight_scale(LinearRegression* lr, double scale) {
+    if (scale == 1.0) return;
+
+    for (int j = 0; j < lr->num_variables; j++) {
+        lr->weights[j] *= scale;
+    }
+}
+
+/*
+ * Trains the given LinearRegression model by stochastic gradient descent over sparse samples, with an optional L2 penalty.
+ * Returns EXIT_SUCCESS on success and EXIT_FAILURE on failure.
+ *
+ * Ensures that the model, samples and targets are non-null, that the samples are well formed with one column per model variable, and that 0 <= learning_rate * l2 < 1.
+ * Each step costs O(nnz) of its row: the prediction and the gradient step only touch the row's active coordinates.
+ * The L2 penalty shrinks every weight each step, so it is applied lazily by keeping the weights as scale * w.
+ * Shrinking then only multiplies the scale, and a step of -learning_rate * error * x on the true weights becomes one of -learning_rate * error * x / scale on w.
+ * The scale is folded back into the weights at the end of each epoch, or earlier if it falls below LINEAR_REGRESSION_MIN_SCALE.
+ * With no penalty, the steps are exactly those train_linear_regression takes over the equivalent dense samples.
+ */
+int train_linear_regression_sparse(LinearRegression* lr, const CMLSparseMatrix* X, const double* y, double learning_rate, double l2, int num_iterations) {
+    if (lr == NULL || X == NULL || y == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to train_linear_regression_sparse\n");
+        return EXIT_FAILURE;
+    }
+
+    if (X->num_cols != lr->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the LinearRegression model expects %d\n", X->num_cols, lr->num_variables);
+        return EXIT_FAILURE;
+    }
+
+    if (!(l2 >= 0.0 && learning_rate * l2 < 1.0)) {
+        fprintf(stderr, "Error: L2 penalty must be non-negative, and less than the inverse of the learning rate\n");
+        return EXIT_FAILURE;
+    }
+
+    if (check_sparse_matrix(X) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+    LinearRegressionMonitor monitor;
+    double decay = 1.0 - learning_rate * l2;
+
+    open_monitor(lr, NULL, &monitor);
+
+    for (int iteration = 0; iteration < num_iterations; iteration++) {
+        double scale = 1.0;
+
+        begin_epoch(&monitor);
+
+        for (int i = 0; i < X->num_rows; i++) {
+            size_t start = X->row_offsets[i];
+            size_t end = X->row_offsets[i + 1];
+            double predicted = 0.0;
+
+            for (size_t p = start; p < end; p++) {
+                predicted += lr->weights[X->col_indices[p]] * X->values[p];
+            }
+
+            double error = scale * predicted - y[i];
+
+            // Shrink every weight at once, then step the active ones on the scaled weights
+            scale *= decay;
+
+            double step = learning_rate * error / scale;
+
+            for (size_t p = start; p < end; p++) {
+                lr->weights[X->col_indices[p]] -= step * X->values[p];
+            }
+
+            if (scale < LINEAR_REGRESSION_MIN_SCALE) {
+                fold_weight_scale(lr, scale);
+                scale = 1.0;
+            }
+        }
+
+        fold_weight_scale(lr, scale);
+
+        if (end_epoch(lr, &monitor, NULL, X, y, iteration)) break;
+    }
+
+    close_monitor(&monitor);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Accumulates the squared-error gradient of one partition of the current mini-batch into that partition's private gradient.
+ * Runs as a parallel_for task, reading the weights, which are only updated between steps.
+ */
+static void accumulate_gradient_partition(void* arg, int partition) {
+    LinearRegressionSGDRun* run = (LinearRegressionSGDRun*) arg;
+    int d = run->lr->num_variables;
+    int start = run->batch_start + partition * LINEAR_REGRESSION_GRADIENT_ROWS;
+    int end = start + LINEAR_REGRESSION_GRADIENT_ROWS < run->batch_end ? start + LINEAR_REGRESSION_GRADIENT_ROWS : run->batch_end;
+    double* gradient = run->gradients + (size_t) partition * run->gradient_stride;
+
+    memset(gradient, 0, d * sizeof(double));
+
+    for (int i = start; i < end; i++) {
+        const double* x = matrix_row(run->X, i);
+        double error = -run->y[i];
+
+        for (int j = 0; j < d; j++) {
+            error += run->lr->weights[j] * x[j];
+        }
+
+        for (int j = 0; j < d; j++) {
+            gradient[j] += error * x[j];
+        }
+    }
+}
+
+/*
+ * Runs stochastic gradient descent over one shard of the samples, updating the shared weights without locking.
+ * Runs as a parallel_for task, with each shard a contiguous range of rows.
+ *
+ * Weights are read and written with relaxed atomic accesses, so concurrent updates may be lost but never torn.
+ * Each batch's gradient is gathered in a private buffer and then applied only to the coordinates the batch touched.
+ * Zero features are skipped entirely, so sparse rows contend on few weights.
+ */
+static void hogwild_shard(void* arg, int shard) {
+    LinearRegressionSGDRun* run = (LinearRegressionSGDRun*) arg;
+    LinearRegression* lr = run->lr;
+    int d = lr->num_variables;
+    int start = (int) ((long long) run->X->num_rows * shard / run->num_shards);
+    int end = (int) ((long long) run->X->num_rows * (shard + 1) / run->num_shards);
+    double* gradient = run->gradients + (size_t) shard * run->gradient_stride;
+
+    for (int batch_start = start; batch_start < end; batch_start += lr->batch_size) {
+        int batch_end = batch_start + lr->batch_size < end ? batch_start + lr->batch_size : end;
+
+        memset(gradient, 0, d * sizeof(double));
+
+        for (int i = batch_start; i < batch_end; i++) {
+            const double* x = matrix_row(run->X, i);
+            double error = -run->y[i];
+
+            for (int j = 0; j < d; j++) {
+                if (x[j] == 0.0) continue;
+
+                double weight;
+                __atomic_load(&lr->weights[j], &weight, __ATOMIC_RELAXED);
+                error += weight * x[j];
+            }
+
+            for (int j = 0; j < d; j++) {
+                gradient[j] += error * x[j];
+            }
+        }
+
+        double step = run->learning_rate / (batch_end - batch_start);
+
+        for (int j = 0; j < d; j++) {
+            if (gradient[j] == 0.0) continue;
+
+            double weight;
+            __atomic_load(&lr->weights[j], &weight, __ATOMIC_RELAXED);
+            weight -= step * gradient[j];
+            __atomic_store(&lr->weights[j], &weight, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*
+ * Trains the given LinearRegression model by stochastic gradient descent across the model's threads, on its context if it has one.
+ * Returns EXIT_SUCCESS on success and EXIT_FAILURE on failure, filling the report (if non-null) with the training throughput.
+ *
+ * Ensures that the model and sample-target sets are non-null, that the samples have one column per model variable, and that batch_size is positive.
+ * Each epoch walks the samples in order in batches of batch_size, stepping the weights by learning_rate times the batch's mean gradient.
+ * With a batch size of one this is exactly the update train_linear_regression makes.
+ * In LINEAR_REGRESSION_MINI_BATCH mode each batch's gradient is split into fixed partitions computed concurrently and reduced in order,
+ * so the trained weights are identical whatever the thread count.
+ * A model without a context runs its batches on a private context created once per call, rather than spawning threads for every batch.
+ * In LINEAR_REGRESSION_HOGWILD mode the samples are split into one shard per thread, each descending independently on the shared weights,
+ * which trades reproducibility for the absence of any synchronisation between steps.
+ * If the model has a callback, it is passed the loss and gradient norm after each epoch, and can stop the training early.
+ */
+int train_linear_regression_parallel(LinearRegression* lr, const CMLMatrix* X, const double* y, double learning_rate, int num_epochs, LinearRegressionReport* report) {
+    if (lr == NULL || X == NULL || X->data == NULL || y == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to train_linear_regression_parallel\n");
+        return EXIT_FAILURE;
+    }
+
+    if (X->num_cols != lr->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the LinearRegression model expects %d\n", X->num_cols, lr->num_variables);
+        return EXIT_FAILURE;
+    }
+
+    if (lr->batch_size <= 0) {
+        fprintf(stderr, "Error: LinearRegression batch size must be a positive value\n");
+        return EXIT_FAILURE;
+    }
+
+    int d = lr->num_variables;
+    int num_threads = resolve_context_threads(lr->context, lr->num_threads);
+    int max_partitions = (lr->batch_size + LINEAR_REGRESSION_GRADIENT_ROWS - 1) / LINEAR_REGRESSION_GRADIENT_ROWS;
+    int num_shards = num_threads < X->num_rows ? num_threads : (X->num_rows > 0 ? X->num_rows : 1);
+    int num_buffers = lr->sgd == LINEAR_REGRESSION_HOGWILD ? num_shards : max_partitions;
+    size_t gradient_stride = ((size_t) d * sizeof(double) + CML_WORKSPACE_ALIGNMENT - 1) / CML_WORKSPACE_ALIGNMENT * CML_WORKSPACE_ALIGNMENT / sizeof(double);
+    CMLWorkspace* workspace = model_workspace(lr);
+    size_t mark = workspace_mark(workspace);
+    double* gradients = workspace != NULL ? (double*) workspace_alloc(workspace, (size_t) num_buffers * gradient_stride * sizeof(double)) : NULL;
+
+    if (gradients == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for LinearRegression gradients\n");
+        return EXIT_FAILURE;
+    }
+
+    LinearRegressionSGDRun run = {lr, X, y, learning_rate, 0, 0, gradients, num_shards, gradient_stride};
+    LinearRegressionMonitor monitor;
+    double start_time = wall_time();
+    int epochs_run = 0;
+
+    open_monitor(lr, lr->context, &monitor);
+
+    // Create the private context after opening the counters, so that its workers inherit them.
+    int needs_context = lr->context == NULL && lr->sgd != LINEAR_REGRESSION_HOGWILD && num_threads > 1 && max_partitions > 1;
+    CMLContext* private_context = needs_context ? create_context(num_threads, CML_PLACEMENT_ANY) : NULL;
+    CMLContext* context = private_context != NULL ? private_context : lr->context;
+
+    while (epochs_run < num_epochs) {
+        begin_epoch(&monitor);
+
+        if (lr->sgd == LINEAR_REGRESSION_HOGWILD) {
+            parallel_for_in(lr->context, num_shards, num_threads, hogwild_shard, &run);
+
+            if (end_epoch(lr, &monitor, X, NULL, y, epochs_run++)) break;
+
+            continue;
+        }
+
+        for (run.batch_start = 0; run.batch_start < X->num_rows; run.batch_start = run.batch_end) {
+            run.batch_end = run.batch_start + lr->batch_size < X->num_rows ? run.batch_start + lr->batch_size : X->num_rows;
+            int num_partitions = (run.batch_end - run.batch_start + LINEAR_REGRESSION_GRADIENT_ROWS - 1) / LINEAR_REGRESSION_GRADIENT_ROWS;
+
+            parallel_for_in(context, num_partitions, num_threads, accumulate_gradient_partition, &run);
+
+            double step = learning_rate / (run.batch_end - run.batch_start);
+
+            for (int j = 0; j < d; j++) {
+                double gradient = 0.0;
+
+                for (int p = 0; p < num_partitions; p++) {
+                    gradient += gradients[(size_t) p * gradient_stride + j];
+                }
+
+                lr->weights[j] -= step * gradient;
+            }
+        }
+
+        if (end_epoch(lr, &monitor, X, NULL, y, epochs_run++)) break;
+    }
+
+    if (private_context != NULL) free_context(private_context);
+
+    close_monitor(&monitor);
+
+    if (report != NULL) {
+        report->num_epochs = epochs_run;
+        report->samples_processed = (long long) report->num_epochs * X->num_rows;
+        report->elapsed_seconds = wall_time() - start_time;
+        report->samples_per_second = report->elapsed_seconds > 0.0 ? report->samples_processed / report->elapsed_seconds : 0.0;
+    }
+
+    workspace_release(workspace, mark);
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Fits the given LinearRegression model in closed form by ridge-regularised least squares, in a single pass over the samples.
+ * Returns EXIT_SUCCESS on success and EXIT_FAILURE on failure, keeping X^T X and X^T y so that refit_linear_regression can re-solve.
+ *
+ * Ensures that the model and sample-target sets are non-null, and that the samples have one column per model variable.
+ * Rows are streamed in blocks of LINEAR_REGRESSION_BLOCK_ROWS, each block updating one row of the upper triangle of X^T X at a time.
+ * Any statistics kept from a previous fit are replaced, and the weights are then solved exactly as refit_linear_regression would.
+ */
+int fit_linear_regression(LinearRegression* lr, const CMLMatrix* X, const double* y, double ridge) {
+    if (lr == NULL || X == NULL || X->data == NULL || y == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to fit_linear_regression\n");
+        return EXIT_FAILURE;
+    }
+
+    if (X->num_cols != lr->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the LinearRegression model expects %d\n", X->num_cols, lr->num_variables);
+        return EXIT_FAILURE;
+    }
+
+    int d = lr->num_variables;
+
+    if (lr->gram == NULL) lr->gram = (double*) malloc((size_t) d * (size_t) d * sizeof(double));
+    if (lr->moments == NULL) lr->moments = (double*) malloc(d * sizeof(double));
+
+    if (lr->gram == NULL || lr->moments == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for LinearRegression sufficient statistics\n");
+        return EXIT_FAILURE;
+    }
+
+    memset(lr->gram, 0, (size_t) d * (size_t) d * sizeof(double));
+    memset(lr->moments, 0, d * sizeof(double));
+
+    for (int start = 0; start < X->num_rows; start += LINEAR_REGRESSION_BLOCK_ROWS) {
+        int end = start + LINEAR_REGRESSION_BLOCK_ROWS < X->num_rows ? start + LINEAR_REGRESSION_BLOCK_ROWS : X->num_rows;
+
+        for (int a = 0; a < d; a++) {
+            double* gram_row = lr->gram + (size_t) a * d;
+            double moment = 0.0;
+
+            for (int i = start; i < end; i++) {
+                const double* x = matrix_row(X, i);
+                double xa = x[a];
+
+                for (int b = a; b < d; b++) {
+                    gram_row[b] += xa * x[b];
+                }
+
+                moment += xa * y[i];
+            }
+
+            lr->moments[a] += moment;
+        }
+    }
+
+    // Mirror the upper triangle so that the kept gram matrix is complete.
+    for (int a = 0; a < d; a++) {
+        for (int b = 0; b < a; b++) {
+            lr->gram[(size_t) a * d + b] = lr->gram[(size_t) b * d + a];
+        }
+    }
+
+    lr->num_samples = X->num_rows;
+
+    return refit_linear_regression(lr, ridge);
+}
+
+/*
+ * Helper function to invert a regularised gram matrix from its Cholesky factor, into the row-major d by d inverse.
+ * Solves for one column of the inverse per unit vector, reusing the single factorisation, with column as d values of scratch.
+ */
+static void invert_factor(const double* factor, int d, double* inverse, double* column) {
+    for (int b = 0; b < d; b++) {
+        for (int a = 0; a < d; a++) {
+            column[a] = a == b ? 1.0 : 0.0;
+        }
+
+        cholesky_substitute(factor, column, d, column);
+
+        for (int a = 0; a < d; a++) {
+            inverse[(size_t) a * d + b] = column[a];
+        }
+    }
+}
+
+/*
+ * Re-solves a closed-form fitted LinearRegression model from its kept sufficient statistics with a new ridge penalty.
+ * Returns EXIT_SUCCESS on success and EXIT_FAILURE on failure, without touching the original samples.
+ *
+ * Solves (X^T X + ridge I) w = X^T y, which costs O(d^3) regardless of how many samples were fitted.
+ * A Cholesky factorisation is tried first, falling back to a column-pivoted QR solve when the system is singular or ill-conditioned.
+ * The QR fallback gives dependent variables a zero weight, so collinear samples still produce a usable model.
+ * If the model is prepared for online updates, its inverse gram matrix is rebuilt from the same factor, so later updates continue from the refit.
+ * When only the QR fallback succeeds there is no such inverse, so it is freed and updates must be started again.
+ */
+int refit_linear_regression(LinearRegression* lr, double ridge) {
+    if (lr == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to refit_linear_regression\n");
+        return EXIT_FAILURE;
+    }
+
+    if (lr->gram == NULL || lr->moments == NULL) {
+        fprintf(stderr, "Error: LinearRegression model has no sufficient statistics to refit from\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!(ridge >= 0.0)) {
+        fprintf(stderr, "Error: Ridge penalty must be a non-negative value\n");
+        return EXIT_FAILURE;
+    }
+
+    int d = lr->num_variables;
+    size_t size = (size_t) d * (size_t) d;
+    CMLWorkspace* workspace = model_workspace(lr);
+    size_t mark = workspace_mark(workspace);
+    double* system = workspace != NULL ? (double*) workspace_alloc(workspace, (2 * size + (size_t) d) * sizeof(double)) : NULL;
+
+    if (system == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for LinearRegression solve\n");
+        return EXIT_FAILURE;
+    }
+
+    double* factor = system + size;
+    double* column = factor + size;
+
+    memcpy(system, lr->gram, size * sizeof(double));
+
+    for (int a = 0; a < d; a++) {
+        system[(size_t) a * d + a] += ridge;
+    }
+
+    int status = EXIT_SUCCESS;
+
+    if (cholesky_factor(system, d, factor) == EXIT_SUCCESS) {
+        cholesky_substitute(factor, lr->moments, d, lr->weights);
+
+        if (lr->inverse_gram != NULL) invert_factor(factor, d, lr->inverse_gram, column);
+    } else {
+        if (pivoted_qr_solve(system, lr->moments, d, lr->weights) < 0) status = EXIT_FAILURE;
+
+        free(lr->inverse_gram);
+        lr->inverse_gram = NULL;
+    }
+
+    workspace_release(workspace, mark);
+
+    return status;
+}
+
+/*
+ * Helper function to begin reading the weights under the model's sequence lock, waiting out any update in progress.
+ * Returns the version to validate the read against.
+ */
+static inline unsigned int begin_weights_read(const LinearRegression* lr) {
+    unsigned int version;
+
+    while ((version = __atomic_load_n(&lr->weights_version, __ATOMIC_ACQUIRE)) & 1u) {
+        sched_yield();
+    }
+
+    return version;
+}
+
+/*
+ * Helper function to finish reading the weights under the model's sequence lock.
+ * Returns non-zero if an update published new weights during the read, which must then be retried.
+ */
+static inline int retry_weights_read(const LinearRegression* lr, unsigned int version) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&lr->weights_version, __ATOMIC_RELAXED) != version;
+}
+
+/*
+ * Helper function to publish new weights under the model's sequence lock.
+ *
+ * The version is odd while the weights are being written, so readers that overlap the write either wait or retry.
+ * Only a single thread may publish at a time.
+ */
+static void publish_weights(LinearRegression* lr, const double* weights) {
+    unsigned int version = lr->weights_version;
+
+    __atomic_store_n(&lr->weights_version, version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (int j = 0; j < lr->num_variables; j++) {
+        __atomic_store(&lr->weights[j], (double*) &weights[j], __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&lr->weights_version, version + 2, __ATOMIC_RELEASE);
+}
+
+/*
+ * Prepares the LinearRegression model for online updates, continuing from its closed-form fit if it has one.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * With the sufficient statistics of a closed-form fit, the inverse gram matrix is (X^T X + regularisation * I)^-1.
+ * It is factorised by Cholesky once, then found one column at a time by substitution against that factor.
+ * The weights are re-solved against the same factor, so they are the ridge fit for regularisation even if the last fit used another penalty.
+ * Updates then produce exactly the weights a ridge fit over every sample seen would (with a unit forgetting factor).
+ * Without them, the inverse gram matrix starts as I / regularisation around the current weights, which must then be positive.
+ * This O(d^3) set-up runs once, and can be repeated to reset the model's memory of past samples.
+ */
+int start_linear_regression_updates(LinearRegression* lr, double regularisation) {
+    if (lr == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to start_linear_regression_updates\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!(regularisation >= 0.0) || (lr->gram == NULL && regularisation == 0.0)) {
+        fprintf(stderr, "Error: Online updates need a positive regularisation, or a non-negative one after a closed-form fit\n");
+        return EXIT_FAILURE;
+    }
+
+    int d = lr->num_variables;
+    size_t size = (size_t) d * (size_t) d;
+
+    if (lr->inverse_gram == NULL) lr->inverse_gram = (double*) malloc(size * sizeof(double));
+
+    if (lr->inverse_gram == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for LinearRegression updates\n");
+        return EXIT_FAILURE;
+    }
+
+    if (lr->gram == NULL) {
+        for (size_t a = 0; a < size; a++) {
+            lr->inverse_gram[a] = a % ((size_t) d + 1) == 0 ? 1.0 / regularisation : 0.0;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    CMLWorkspace* workspace = model_workspace(lr);
+    size_t mark = workspace_mark(workspace);
+    double* factor = workspace != NULL ? (double*) workspace_alloc(workspace, (size + 2 * (size_t) d) * sizeof(double)) : NULL;
+    int status = factor != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (factor != NULL) {
+        double* column = factor + size;
+        double* weights = column + d;
+
+        memcpy(factor, lr->gram, size * sizeof(double));
+
+        for (int a = 0; a < d; a++) {
+            factor[(size_t) a * d + a] += regularisation;
+        }
+
+        status = cholesky_factor(factor, d, factor);
+
+        // Re-solve the weights with the same penalty, so that they agree with the inverse gram matrix.
+        if (status == EXIT_SUCCESS) {
+            invert_factor(factor, d, lr->inverse_gram, column);
+            cholesky_substitute(factor, lr->moments, d, weights);
+            publish_weights(lr, weights);
+        }
+    }
+
+    workspace_release(workspace, mark);
+
+    if (status != EXIT_SUCCESS) {
+        fprintf(stderr, "Error: Gram matrix is singular, so online updates need a positive regularisation\n");
+        free(lr->inverse_gram);
+        lr->inverse_gram = NULL;
+    }
+
+    return status;
+}
+
+/*
+ * Helper function to fold a single sample into a working copy of the weights and the model's inverse gram matrix.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE if the update is numerically degenerate.
+ *
+ * With P the inverse gram matrix and f the forgetting factor, the gain is k = Px / (f + x^T P x).
+ * The weights move by k times the sample's prediction error, and P becomes (P - k (Px)^T) / f.
+ * Only the upper triangle of P is computed and then mirrored, so it stays exactly symmetric.
+ * Any kept sufficient statistics are discounted and updated alike, so a later refit agrees with the updates.
+ */
+static int fold_sample(LinearRegression* lr, double* weights, const double* x, double y, double* projected) {
+    int d = lr->num_variables;
+    double* P = lr->inverse_gram;
+    double forgetting = lr->forgetting_factor;
+    double denominator = forgetting;
+    double error = y;
+
+    for (int a = 0; a < d; a++) {
+        const double* row = P + (size_t) a * d;
+        double value = 0.0;
+
+        for (int b = 0; b < d; b++) {
+            value += row[b] * x[b];
+        }
+
+        projected[a] = value;
+        denominator += x[a] * value;
+        error -= weights[a] * x[a];
+    }
+
+    if (!(denominator > 0.0) || !isfinite(denominator)) return EXIT_FAILURE;
+
+    for (int a = 0; a < d; a++) {
+        double gain = projected[a] / denominator;
+
+        weights[a] += gain * error;
+
+        for (int b = a; b < d; b++) {
+            double value = (P[(size_t) a * d + b] - gain * projected[b]) / forgetting;
+
+            P[(size_t) a * d + b] = value;
+            P[(size_t) b * d + a] = value;
+        }
+    }
+
+    if (lr->gram != NULL && lr->moments != NULL) {
+        for (int a = 0; a < d; a++) {
+            for (int b = 0; b < d; b++) {
+                lr->gram[(size_t) a * d + b] = forgetting * lr->gram[(size_t) a * d + b] + x[a] * x[b];
             }
+
+            lr->moments[a] = forgetting * lr->moments[a] + x[a] * y;
         }
     }
+
+    lr->num_samples++;
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Folds a single sample and its target into the LinearRegression model by recursive least squares, in O(d^2) time.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * A single-row batch, so the new weights are published exactly as update_linear_regression_batch does.
+ */
+int update_linear_regression(LinearRegression* lr, const double* x, double y) {
+    if (lr == NULL || x == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to update_linear_regression\n");
+        return EXIT_FAILURE;
+    }
+
+    CMLMatrix sample = matrix_view((double*) x, 1, lr->num_variables, lr->num_variables);
+
+    return update_linear_regression_batch(lr, &sample, &y);
+}
+
+/*
+ * Folds a batch of samples and their targets into the LinearRegression model by recursive least squares, publishing the new weights once.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * Ensures that the model has been prepared with start_linear_regression_updates, that its forgetting factor is in (0, 1], and that the batch matches it.
+ * The samples are folded in row order into a private copy of the weights, in O(d^2) time each.
+ * The copy is then published under the sequence lock, so concurrent predictions see either the old or the new weights, never a mix.
+ * Only one thread may update the model at a time, and not while it is being trained or refitted.
+ * If a sample is numerically degenerate, the samples folded before it are still published.
+ */
+int update_linear_regression_batch(LinearRegression* lr, const CMLMatrix* X, const double* y) {
+    if (lr == NULL || X == NULL || X->data == NULL || y == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to update_linear_regression_batch\n");
+        return EXIT_FAILURE;
+    }
+
+    if (lr->inverse_gram == NULL) {
+        fprintf(stderr, "Error: LinearRegression model must be prepared with start_linear_regression_updates\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!(lr->forgetting_factor > 0.0 && lr->forgetting_factor <= 1.0)) {
+        fprintf(stderr, "Error: Forgetting factor must be in the range (0, 1]\n");
+        return EXIT_FAILURE;
+    }
+
+    if (X->num_cols != lr->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the LinearRegression model expects %d\n", X->num_cols, lr->num_variables);
+        return EXIT_FAILURE;
+    }
+
+    int d = lr->num_variables;
+    CMLWorkspace* workspace = model_workspace(lr);
+    size_t mark = workspace_mark(workspace);
+    double* weights = workspace != NULL ? (double*) workspace_alloc(workspace, 2 * (size_t) d * sizeof(double)) : NULL;
+
+    if (weights == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for LinearRegression update\n");
+        return EXIT_FAILURE;
+    }
+
+    double* projected = weights + d;
+    int status = EXIT_SUCCESS;
+
+    memcpy(weights, lr->weights, (size_t) d * sizeof(double));
+
+    for (int i = 0; i < X->num_rows && status == EXIT_SUCCESS; i++) {
+        status = fold_sample(lr, weights, matrix_row(X, i), y[i], projected);
+    }
+
+    if (status != EXIT_SUCCESS) fprintf(stderr, "Error: Degenerate sample passed to LinearRegression update\n");
+
+    publish_weights(lr, weights);
+    workspace_release(workspace, mark);
+
+    return status;
 }
 
 /*
@@ -71,30 +944,226 @@ void train_linear_regression(LinearRegression* lr, double** X, double* y, int nu
  *
  * Ensures that the model and set of independent variables are non-null and executes the prediction.
  * Employs linear regression on the variables using the model's weights to approximate the target value.
+ * The weights are read under the model's sequence lock, retrying if an online update publishes new weights meanwhile.
  */
-double predict_linear_regression(LinearRegression* lr, double* X) {
+double predict_linear_regression(LinearRegression* lr, const double* X) {
     if (lr == NULL || X == NULL) {
         fprintf(stderr, "Error: Null pointer passed to predict_linear_regression\n");
         return 0.0;
     }
 
-    double prediction = 0.0;
+    double prediction;
+    unsigned int version;
+
+    do {
+        version = begin_weights_read(lr);
+        prediction = 0.0;
+
+        for (int i = 0; i < lr->num_variables; i++) {
+            prediction += lr->weights[i] * X[i];
+        }
+    } while (retry_weights_read(lr, version));
+
+    return prediction;
+}
+
+/*
+ * Predicts the target value for each row of a matrix of independent variables.
+ * Writes the predicted value of each row into the predictions array.
+ *
+ * Ensures that the model, matrix and predictions array are non-null and that the matrix has one column per model variable.
+ * Rows are dotted with the model's weights four at a time, so every load of the weights is shared by four rows.
+ * Any remaining rows are padded by repeating the last row, whose extra products are discarded.
+ * Each group of four rows reads the weights under the model's sequence lock, so it never mixes weights from before and after an online update.
+ */
+void predict_linear_regression_batch(LinearRegression* lr, const CMLMatrix* X, double* predictions) {
+    if (lr == NULL || X == NULL || X->data == NULL || predictions == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to predict_linear_regression_batch\n");
+        return;
+    }
+
+    if (X->num_cols != lr->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the LinearRegression model expects %d\n", X->num_cols, lr->num_variables);
+        return;
+    }
+
+    double dots[4];
+
+    for (int i = 0; i < X->num_rows; i += 4) {
+        int width = X->num_rows - i < 4 ? X->num_rows - i : 4;
+        const double* rows[4];
+
+        for (int q = 0; q < 4; q++) {
+            rows[q] = matrix_row(X, i + (q < width ? q : width - 1));
+        }
+
+        unsigned int version;
 
-    for (int i = 0; i < lr->num_variables; i++) {
-        prediction += lr->weights[i] * X[i];
+        do {
+            version = begin_weights_read(lr);
+            dot_product_4(lr->weights, rows[0], rows[1], rows[2], rows[3], lr->num_variables, dots);
+        } while (retry_weights_read(lr, version));
+
+        for (int q = 0; q < width; q++) {
+            predictions[i + q] = dots[q];
+        }
     }
+}
+
+/*
+ * Predicts the target value of the dependent variable from a sparse sample given as num_nonzeros column indices and values.
+ * Returns the predicted value based on the model's weights.
+ *
+ * Ensures that the model, indices and values are non-null, then dots only the active coordinates with the weights, in O(num_nonzeros) time.
+ * The indices must lie in [0, num_variables), and are read under the model's sequence lock as predict_linear_regression does.
+ */
+double predict_linear_regression_sparse(LinearRegression* lr, const int* indices, const double* values, int num_nonzeros) {
+    if (lr == NULL || indices == NULL || values == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to predict_linear_regression_sparse\n");
+        return 0.0;
+    }
+
+    double prediction;
+    unsigned int version;
+
+    do {
+        version = begin_weights_read(lr);
+        prediction = 0.0;
+
+        for (int p = 0; p < num_nonzeros; p++) {
+            prediction += lr->weights[indices[p]] * values[p];
+        }
+    } while (retry_weights_read(lr, version));
 
     return prediction;
 }
 
+/*
+ * Predicts the target value for each row of a sparse matrix of independent variables.
+ * Writes the predicted value of each row into the predictions array.
+ *
+ * Ensures that the model, matrix and predictions array are non-null, and that the matrix is well formed with one column per model variable.
+ * Each row costs O(nnz) of that row, through predict_linear_regression_sparse.
+ */
+void predict_linear_regression_sparse_batch(LinearRegression* lr, const CMLSparseMatrix* X, double* predictions) {
+    if (lr == NULL || X == NULL || predictions == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to predict_linear_regression_sparse_batch\n");
+        return;
+    }
+
+    if (X->num_cols != lr->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the LinearRegression model expects %d\n", X->num_cols, lr->num_variables);
+        return;
+    }
+
+    if (check_sparse_matrix(X) != EXIT_SUCCESS) return;
+
+    for (int i = 0; i < X->num_rows; i++) {
+        size_t start = X->row_offsets[i];
+        int length = (int) (X->row_offsets[i + 1] - start);
+
+        predictions[i] = predict_linear_regression_sparse(lr, X->col_indices + start, X->values + start, length);
+    }
+}
+
+/*
+ * Saves the LinearRegression model's weights and training settings to a binary model file.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The weights form a single-row payload, with the batch size and gradient descent variant kept as header parameters.
+ * Sufficient statistics from a closed-form fit are not saved, as serving only needs the weights.
+ */
+int save_linear_regression(const LinearRegression* lr, const char* path) {
+    if (lr == NULL || path == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to save_linear_regression\n");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t parameters[CML_MODEL_FILE_PARAMETERS] = {(uint64_t) lr->batch_size, (uint64_t) lr->sgd, 0, 0, 0, 0};
+
+    return write_model_file(path, CML_MODEL_LINEAR_REGRESSION, 1, (uint64_t) lr->num_variables, parameters, lr->weights);
+}
+
+/*
+ * Loads a LinearRegression model from a binary model file by mapping it into memory, verifying the weights' checksum if verify_payload is set.
+ * Returns a pointer to a new LinearRegression on success and NULL on failure.
+ *
+ * The weights are used in place within the private mapping, so loading touches only the header however many variables the model has.
+ * The model can still be trained, with its updates landing in copy-on-write pages rather than the file.
+ * Files holding a batch size outside 1 to INT_MAX or an unknown gradient descent variant are rejected before either is used.
+ */
+LinearRegression* load_linear_regression(const char* path, int verify_payload) {
+    CMLModelFile file;
+
+    if (path == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to load_linear_regression\n");
+        return NULL;
+    }
+
+    if (map_model_file(path, CML_MODEL_LINEAR_REGRESSION, verify_payload, &file) != EXIT_SUCCESS) return NULL;
+
+    if (file.num_rows != 1) {
+        fprintf(stderr, "Error: Model file %s does not hold a single row of weights\n", path);
+        munmap(file.mapping, file.mapping_size);
+
+        return NULL;
+    }
+
+    if (file.parameters[0] < 1 || file.parameters[0] > INT_MAX || file.parameters[1] > LINEAR_REGRESSION_HOGWILD) {
+        fprintf(stderr, "Error: Model file %s holds an invalid batch size or gradient descent variant\n", path);
+        munmap(file.mapping, file.mapping_size);
+
+        return NULL;
+    }
+
+    LinearRegression* lr = (LinearRegression*) malloc(sizeof(LinearRegression));
+
+    if (lr == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for LinearRegression model\n");
+        munmap(file.mapping, file.mapping_size);
+
+        return NULL;
+    }
+
+    lr->weights = file.payload;
+    lr->num_variables = (int) file.num_cols;
+    lr->gram = NULL;
+    lr->moments = NULL;
+    lr->num_samples = 0;
+    lr->num_threads = 1;
+    lr->context = NULL;
+    lr->batch_size = (int) file.parameters[0];
+    lr->sgd = (LinearRegressionSGD) file.parameters[1];
+    lr->mapping = file.mapping;
+    lr->mapping_size = file.mapping_size;
+    lr->workspace = NULL;
+    lr->callback = NULL;
+    lr->callback_arg = NULL;
+    lr->perf_counters = 0;
+    lr->inverse_gram = NULL;
+    lr->forgetting_factor = 1.0;
+    lr->weights_version = 0;
+
+    return lr;
+}
+
 /*
  * Frees the dynamically allocated memory used by the LinerRegression model.
  *
- * Ensures that the model is non-null and deallocates its weights array, followed by the model itself.
+ * Ensures that the model is non-null and deallocates its weights array (or unmaps the model file holding it), any kept sufficient statistics, its inverse gram matrix and its workspace, followed by the model itself.
  */
 void free_linear_regression(LinearRegression* lr) {
     if (lr == NULL) return;
 
-    free(lr->weights);
+    if (lr->mapping != NULL) {
+        munmap(lr->mapping, lr->mapping_size);
+    } else {
+        free(lr->weights);
+    }
+
+    free(lr->gram);
+    free(lr->moments);
+    free(lr->inverse_gram);
+    free_workspace(lr->workspace);
     free(lr);
 }
\ No newline at end of file
@@ -1,14 +1,82 @@
 #ifndef LINEAR_REGRESSION_H
 #define LINEAR_REGRESSION_H
 
+#include "matrix.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include "workspace.h"
+
+/*
+ * Define an enumeration of the ways a LinearRegression model can be trained by parallel stochastic gradient descent.
+ * LINEAR_REGRESSION_MINI_BATCH reduces the gradient of each batch across threads before a single synchronous update.
+ * LINEAR_REGRESSION_HOGWILD lets every thread update the shared weights without locking, which suits sparse or high-dimensional data.
+ */
+typedef enum {
+    LINEAR_REGRESSION_MINI_BATCH,
+    LINEAR_REGRESSION_HOGWILD
+} LinearRegressionSGD;
+
+/*
+ * Define a typed struct describing a single epoch of LinearRegression training, as passed to the model's callback.
+ * The loss is the mean squared error over the training samples after the epoch, and gradient_norm the Euclidean norm of its gradient.
+ * The counters hold the epoch's hardware events when the model's perf_counters field is set, with -1 for any counter that is unavailable.
+ * Parallel training on a context reports every counter as -1, as the counters cannot follow the context's already running workers.
+ */
+typedef struct {
+    int epoch;
+    double seconds;
+    double loss;
+    double gradient_norm;
+    CMLPerfReading counters;
+} LinearRegressionEpochStats;
+
+/*
+ * Define the type of a LinearRegression training callback, which returns non-zero to stop training after that epoch.
+ */
+typedef int (*LinearRegressionCallback)(const LinearRegressionEpochStats* stats, void* arg);
+
 /*
  * Define a typed struct to encapsulate LinearRegression models.
+ * The sufficient statistics X^T X (gram) and X^T y (moments) are kept after a closed-form fit so that it can be re-solved cheaply.
+ * The num_threads, batch_size and sgd fields configure train_linear_regression_parallel, where a non-positive num_threads uses every online CPU.
+ * If context is set, parallel training runs on its shared pool instead, using every one of its threads, so it must outlive its use by the model.
+ * A model loaded from a file keeps its weights within the file's mapping, which is released when the model is freed.
+ * Training and solving carve their scratch buffers from the model's workspace, created on first use and freed with the model.
+ * If callback is set, gradient descent calls it with callback_arg after every epoch, also reading hardware counters for it if perf_counters is set.
+ * Online recursive least squares updates keep the inverse of the regularised X^T X in inverse_gram, with older samples discounted by forgetting_factor.
+ * Updates publish new weights under the weights_version sequence lock, so predictions may run concurrently with a single updating thread.
  */
 typedef struct {
     double* weights;
     int num_variables;
+    double* gram;
+    double* moments;
+    long long num_samples;
+    int num_threads;
+    CMLContext* context;
+    int batch_size;
+    LinearRegressionSGD sgd;
+    void* mapping;
+    size_t mapping_size;
+    CMLWorkspace* workspace;
+    LinearRegressionCallback callback;
+    void* callback_arg;
+    int perf_counters;
+    double* inverse_gram;
+    double forgetting_factor;
+    unsigned int weights_version;
 } LinearRegression;
 
+/*
+ * Define a typed struct to encapsulate the report of a parallel LinearRegression training run.
+ */
+typedef struct {
+    int num_epochs;
+    long long samples_processed;
+    double elapsed_seconds;
+    double samples_per_second;
+} LinearRegressionReport;
+
 
 /* FUNCTION PROTOTYPES */
 
@@ -22,13 +90,86 @@ LinearRegression* new_linear_regression(int num_variables);
  * Trains the given LinearRegression model based on a series of samples and their accompanying target values.
  * The impact each sample has on the LinearRegression model is controlled by the learning_rate parameter.
  */
-void train_linear_regression(LinearRegression* lr, double** X, double* y, int num_samples, double learning_rates, int num_iterations);
+void train_linear_regression(LinearRegression* lr, const CMLMatrix* X, const double* y, double learning_rate, int num_iterations);
+
+/*
+ * Trains the given LinearRegression model by stochastic gradient descent over sparse samples, with an optional L2 penalty.
+ * Returns EXIT_SUCCESS on success and EXIT_FAILURE on failure.
+ */
+int train_linear_regression_sparse(LinearRegression* lr, const CMLSparseMatrix* X, const double* y, double learning_rate, double l2, int num_iterations);
+
+/*
+ * Trains the given LinearRegression model by stochastic gradient descent across the model's num_threads threads.
+ * Returns EXIT_SUCCESS on success and EXIT_FAILURE on failure, filling the report (if non-null) with the training throughput.
+ */
+int train_linear_regression_parallel(LinearRegression* lr, const CMLMatrix* X, const double* y, double learning_rate, int num_epochs, LinearRegressionReport* report);
+
+/*
+ * Fits the given LinearRegression model in closed form by ridge-regularised least squares, in a single pass over the samples.
+ * Returns EXIT_SUCCESS on success and EXIT_FAILURE on failure, keeping X^T X and X^T y so that refit_linear_regression can re-solve.
+ */
+int fit_linear_regression(LinearRegression* lr, const CMLMatrix* X, const double* y, double ridge);
+
+/*
+ * Re-solves a closed-form fitted LinearRegression model from its kept sufficient statistics with a new ridge penalty.
+ * Returns EXIT_SUCCESS on success and EXIT_FAILURE on failure, without touching the original samples.
+ * A model prepared for online updates has its inverse gram matrix rebuilt for the new penalty, or freed if the system is singular.
+ */
+int refit_linear_regression(LinearRegression* lr, double ridge);
+
+/*
+ * Prepares the LinearRegression model for online updates, continuing from its closed-form fit if it has one.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int start_linear_regression_updates(LinearRegression* lr, double regularisation);
+
+/*
+ * Folds a single sample and its target into the LinearRegression model by recursive least squares, in O(d^2) time.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int update_linear_regression(LinearRegression* lr, const double* x, double y);
+
+/*
+ * Folds a batch of samples and their targets into the LinearRegression model by recursive least squares, publishing the new weights once.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int update_linear_regression_batch(LinearRegression* lr, const CMLMatrix* X, const double* y);
 
 /*
  * Predicts the target value of the dependent variable based on the independent variables supplied.
  * Returns the predicted value based on the model's weights.
  */
-double predict_linear_regression(LinearRegression* lr, double* X);
+double predict_linear_regression(LinearRegression* lr, const double* X);
+
+/*
+ * Predicts the target value for each row of a matrix of independent variables.
+ * Writes the predicted value of each row into the predictions array.
+ */
+void predict_linear_regression_batch(LinearRegression* lr, const CMLMatrix* X, double* predictions);
+
+/*
+ * Predicts the target value of the dependent variable from a sparse sample given as num_nonzeros column indices and values.
+ * Returns the predicted value based on the model's weights.
+ */
+double predict_linear_regression_sparse(LinearRegression* lr, const int* indices, const double* values, int num_nonzeros);
+
+/*
+ * Predicts the target value for each row of a sparse matrix of independent variables.
+ * Writes the predicted value of each row into the predictions array.
+ */
+void predict_linear_regression_sparse_batch(LinearRegression* lr, const CMLSparseMatrix* X, double* predictions);
+
+/*
+ * Saves the LinearRegression model's weights and training settings to a binary model file.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int save_linear_regression(const LinearRegression* lr, const char* path);
+
+/*
+ * Loads a LinearRegression model from a binary model file by mapping it into memory, verifying the weights' checksum if verify_payload is set.
+ * Returns a pointer to a new LinearRegression on success and NULL on failure.
+ */
+LinearRegression* load_linear_regression(const char* path, int verify_payload);
 
 /*
  * Frees the dynamically allocated memory used by the LinerRegression model.
@@ -0,0 +1,45 @@
+/*
+ * Type-generic declarations of a single-precision LinearRegression model, instantiated by float_models.h.
+ * Samples and targets are always stored as floats.
+ * Before each inclusion, CML_ACCUM must name the type weights and gradients are accumulated in,
+ * CML_LINEAR_REGRESSION the model's type name and CML_SUFFIX its function suffix.
+ * This file deliberately has no include guard, as it is included once per instantiation.
+ */
+
+/*
+ * Define a typed struct to encapsulate LinearRegression models of the instantiated precision.
+ * The weights accumulate every update, so they are kept in the accumulation type.
+ */
+typedef struct {
+    CML_ACCUM* weights;
+    int num_variables;
+} CML_LINEAR_REGRESSION;
+
+/*
+ * Creates a new LinearRegression of the instantiated precision for a specified number of variables.
+ * Returns a pointer to a new model on success and NULL on failure.
+ */
+CML_LINEAR_REGRESSION* CML_TYPED(new_linear_regression)(int num_variables);
+
+/*
+ * Trains the given LinearRegression model by stochastic gradient descent over single-precision samples and targets.
+ * The impact each sample has on the model is controlled by the learning_rate parameter.
+ */
+void CML_TYPED(train_linear_regression)(CML_LINEAR_REGRESSION* lr, const CMLMatrixF* X, const float* y, double learning_rate, int num_iterations);
+
+/*
+ * Predicts the target value of the dependent variable based on the single-precision independent variables supplied.
+ * Returns the predicted value based on the model's weights.
+ */
+CML_ACCUM CML_TYPED(predict_linear_regression)(CML_LINEAR_REGRESSION* lr, const float* x);
+
+/*
+ * Predicts the target value for each row of a single-precision matrix of independent variables.
+ * Writes the predicted value of each row into the predictions array.
+ */
+void CML_TYPED(predict_linear_regression_batch)(CML_LINEAR_REGRESSION* lr, const CMLMatrixF* X, CML_ACCUM* predictions);
+
+/*
+ * Frees the dynamically allocated memory used by the LinearRegression model.
+ */
+void CML_TYPED(free_linear_regression)(CML_LINEAR_REGRESSION* lr);
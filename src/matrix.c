@@ -0,0 +1,327 @@
+#include "matrix.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * The alignment (in bytes) of matrix data allocated by the library, matching a typical cache line.
+ */
+#define MATRIX_ALIGNMENT 64
+
+
+/*
+ * Creates a new zeroed matrix with the specified number of rows and columns.
+ * Returns a pointer to a new CMLMatrix that owns its data on success and NULL on failure.
+ *
+ * Dynamically allocates memory for a CMLMatrix struct and a single cache-line aligned buffer holding every row.
+ * The rows are packed back to back, so the stride of the new matrix is equal to its column count.
+ * A NULL is returned if the dimensions are non-positive or if any dynamic allocation fails, with any already allocated memory freed.
+ */
+CMLMatrix* create_matrix(int num_rows, int num_cols) {
+    if (num_rows <= 0 || num_cols <= 0) {
+        fprintf(stderr, "Error: Matrix dimensions must be positive values\n");
+        return NULL;
+    }
+
+    CMLMatrix* X = (CMLMatrix*) malloc(sizeof(CMLMatrix));
+
+    if (X == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for matrix\n");
+        return NULL;
+    }
+
+    size_t size = (size_t) num_rows * (size_t) num_cols * sizeof(double);
+    void* data = NULL;
+
+    if (posix_memalign(&data, MATRIX_ALIGNMENT, size) != 0) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for matrix\n");
+        free(X);
+
+        return NULL;
+    }
+
+    memset(data, 0, size);
+
+    X->data = (double*) data;
+    X->num_rows = num_rows;
+    X->num_cols = num_cols;
+    X->stride = num_cols;
+
+    return X;
+}
+
+
+/*
+ * Creates a zero-copy view over caller-owned row-major memory.
+ * Returns the view by value, which must not be passed to free_matrix; an empty view is returned on invalid arguments.
+ *
+ * The view references the data directly, so the caller must keep the memory alive for as long as the view is used.
+ * A stride larger than the column count allows views over padded rows or over the leading columns of a wider table.
+ */
+CMLMatrix matrix_view(double* data, int num_rows, int num_cols, int stride) {
+    CMLMatrix view = {NULL, 0, 0, 0};
+
+    if (data == NULL || num_rows < 0 || num_cols <= 0 || stride < num_cols) {
+        fprintf(stderr, "Error: Invalid arguments passed to matrix_view\n");
+        return view;
+    }
+
+    view.data = data;
+    view.num_rows = num_rows;
+    view.num_cols = num_cols;
+    view.stride = stride;
+
+    return view;
+}
+
+
+/*
+ * Creates a zero-copy view over a contiguous range of rows of an existing matrix.
+ * Returns the view by value, which must not be passed to free_matrix; an empty view is returned on an invalid range.
+ *
+ * The slice shares the parent's data and stride, so it is only valid while the parent's data remains alive.
+ */
+CMLMatrix matrix_slice(const CMLMatrix* X, int start_row, int num_rows) {
+    CMLMatrix view = {NULL, 0, 0, 0};
+
+    if (X == NULL || X->data == NULL || start_row < 0 || num_rows < 0 || start_row + num_rows > X->num_rows) {
+        fprintf(stderr, "Error: Invalid row range passed to matrix_slice\n");
+        return view;
+    }
+
+    view.data = matrix_row(X, start_row);
+    view.num_rows = num_rows;
+    view.num_cols = X->num_cols;
+    view.stride = X->stride;
+
+    return view;
+}
+
+
+/*
+ * Frees the dynamically allocated memory used by a matrix created with create_matrix.
+ *
+ * Ensures that the matrix is non-null and deallocates its data buffer, followed by the matrix itself.
+ */
+void free_matrix(CMLMatrix* X) {
+    if (X == NULL) return;
+
+    free(X->data);
+    free(X);
+}
+
+
+/*
+ * Creates a new zeroed single-precision matrix with the specified number of rows and columns.
+ * Returns a pointer to a new CMLMatrixF that owns its data on success and NULL on failure.
+ *
+ * Allocates exactly as create_matrix does, with a cache-line aligned buffer of packed rows.
+ */
+CMLMatrixF* create_matrix_f(int num_rows, int num_cols) {
+    if (num_rows <= 0 || num_cols <= 0) {
+        fprintf(stderr, "Error: Matrix dimensions must be positive values\n");
+        return NULL;
+    }
+
+    CMLMatrixF* X = (CMLMatrixF*) malloc(sizeof(CMLMatrixF));
+
+    if (X == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for matrix\n");
+        return NULL;
+    }
+
+    size_t size = (size_t) num_rows * (size_t) num_cols * sizeof(float);
+    void* data = NULL;
+
+    if (posix_memalign(&data, MATRIX_ALIGNMENT, size) != 0) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for matrix\n");
+        free(X);
+
+        return NULL;
+    }
+
+    memset(data, 0, size);
+
+    X->data = (float*) data;
+    X->num_rows = num_rows;
+    X->num_cols = num_cols;
+    X->stride = num_cols;
+
+    return X;
+}
+
+
+/*
+ * Creates a zero-copy single-precision view over caller-owned row-major memory.
+ * Returns the view by value, which must not be passed to free_matrix_f; an empty view is returned on invalid arguments.
+ *
+ * Follows the same rules as matrix_view.
+ */
+CMLMatrixF matrix_view_f(float* data, int num_rows, int num_cols, int stride) {
+    CMLMatrixF view = {NULL, 0, 0, 0};
+
+    if (data == NULL || num_rows < 0 || num_cols <= 0 || stride < num_cols) {
+        fprintf(stderr, "Error: Invalid arguments passed to matrix_view_f\n");
+        return view;
+    }
+
+    view.data = data;
+    view.num_rows = num_rows;
+    view.num_cols = num_cols;
+    view.stride = stride;
+
+    return view;
+}
+
+
+/*
+ * Frees the dynamically allocated memory used by a matrix created with create_matrix_f.
+ *
+ * Ensures that the matrix is non-null and deallocates its data buffer, followed by the matrix itself.
+ */
+void free_matrix_f(CMLMatrixF* X) {
+    if (X == NULL) return;
+
+    free(X->data);
+    free(X);
+}
+
+
+/*
+ * Creates a new sparse matrix with room for a given number of non-zeros, whose row offsets are zeroed for the caller to fill.
+ * Returns a pointer to a new CMLSparseMatrix that owns its arrays on success and NULL on failure.
+ *
+ * Dynamically allocates the struct, num_rows + 1 row offsets and num_nonzeros values and column indices.
+ * A NULL is returned if the dimensions are invalid or if any dynamic allocation fails, with any already allocated memory freed.
+ */
+CMLSparseMatrix* create_sparse_matrix(int num_rows, int num_cols, size_t num_nonzeros) {
+    if (num_rows < 0 || num_cols <= 0) {
+        fprintf(stderr, "Error: Sparse matrix dimensions must be positive values\n");
+        return NULL;
+    }
+
+    CMLSparseMatrix* X = (CMLSparseMatrix*) malloc(sizeof(CMLSparseMatrix));
+
+    if (X == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for sparse matrix\n");
+        return NULL;
+    }
+
+    // Allocate at least one value so that an empty matrix still has non-null arrays.
+    size_t capacity = num_nonzeros > 0 ? num_nonzeros : 1;
+
+    X->values = (double*) malloc(capacity * sizeof(double));
+    X->col_indices = (int*) malloc(capacity * sizeof(int));
+    X->row_offsets = (size_t*) calloc((size_t) num_rows + 1, sizeof(size_t));
+
+    if (X->values == NULL || X->col_indices == NULL || X->row_offsets == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for sparse matrix\n");
+        free_sparse_matrix(X);
+
+        return NULL;
+    }
+
+    X->num_rows = num_rows;
+    X->num_cols = num_cols;
+    X->num_nonzeros = num_nonzeros;
+
+    return X;
+}
+
+
+/*
+ * Creates a new sparse matrix holding the non-zero values of a dense matrix.
+ * Returns a pointer to a new CMLSparseMatrix on success and NULL on failure.
+ *
+ * Counts the non-zeros in a first pass so that the arrays are allocated exactly, then copies them in a second.
+ * Each row's columns are stored in ascending order.
+ */
+CMLSparseMatrix* sparse_matrix_from_dense(const CMLMatrix* X) {
+    if (X == NULL || X->data == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to sparse_matrix_from_dense\n");
+        return NULL;
+    }
+
+    size_t num_nonzeros = 0;
+
+    for (int i = 0; i < X->num_rows; i++) {
+        const double* row = matrix_row(X, i);
+
+        for (int j = 0; j < X->num_cols; j++) {
+            if (row[j] != 0.0) num_nonzeros++;
+        }
+    }
+
+    CMLSparseMatrix* S = create_sparse_matrix(X->num_rows, X->num_cols, num_nonzeros);
+
+    if (S == NULL) return NULL;
+
+    size_t position = 0;
+
+    for (int i = 0; i < X->num_rows; i++) {
+        const double* row = matrix_row(X, i);
+
+        for (int j = 0; j < X->num_cols; j++) {
+            if (row[j] == 0.0) continue;
+
+            S->values[position] = row[j];
+            S->col_indices[position] = j;
+            position++;
+        }
+
+        S->row_offsets[i + 1] = position;
+    }
+
+    return S;
+}
+
+
+/*
+ * Checks that a sparse matrix's row offsets and column indices are consistent with its dimensions.
+ * Returns EXIT_SUCCESS if the matrix is well formed, and EXIT_FAILURE otherwise.
+ *
+ * The row offsets must start at zero, never decrease and end at num_nonzeros, and every column index must lie in [0, num_cols).
+ * This takes a single O(rows + non-zeros) pass, so sparse routines can afford to run it before trusting the indices.
+ */
+int check_sparse_matrix(const CMLSparseMatrix* X) {
+    if (X == NULL || X->values == NULL || X->col_indices == NULL || X->row_offsets == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to check_sparse_matrix\n");
+        return EXIT_FAILURE;
+    }
+
+    if (X->row_offsets[0] != 0 || X->row_offsets[X->num_rows] != X->num_nonzeros) {
+        fprintf(stderr, "Error: Sparse matrix row offsets must span its %zu non-zeros\n", X->num_nonzeros);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < X->num_rows; i++) {
+        if (X->row_offsets[i + 1] < X->row_offsets[i]) {
+            fprintf(stderr, "Error: Sparse matrix row offsets decrease at row %d\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (size_t p = 0; p < X->num_nonzeros; p++) {
+        if (X->col_indices[p] < 0 || X->col_indices[p] >= X->num_cols) {
+            fprintf(stderr, "Error: Sparse matrix column index %d is outside [0, %d)\n", X->col_indices[p], X->num_cols);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Frees the dynamically allocated memory used by a sparse matrix created with create_sparse_matrix.
+ *
+ * Ensures that the matrix is non-null and deallocates its three arrays, followed by the matrix itself.
+ */
+void free_sparse_matrix(CMLSparseMatrix* X) {
+    if (X == NULL) return;
+
+    free(X->values);
+    free(X->col_indices);
+    free(X->row_offsets);
+    free(X);
+}
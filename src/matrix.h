@@ -0,0 +1,121 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stddef.h>
+
+/*
+ * Define a typed struct to encapsulate row-major matrices of doubles.
+ * Each row's values are contiguous in memory and consecutive rows begin stride values apart.
+ * A matrix either owns its data (see create_matrix) or is a view over memory owned by someone else.
+ */
+typedef struct {
+    double* data;
+    int num_rows;
+    int num_cols;
+    int stride;
+} CMLMatrix;
+
+/*
+ * Define a typed struct to encapsulate row-major matrices of floats, laid out exactly as CMLMatrix.
+ */
+typedef struct {
+    float* data;
+    int num_rows;
+    int num_cols;
+    int stride;
+} CMLMatrixF;
+
+/*
+ * Define a typed struct to encapsulate matrices of doubles in compressed sparse row (CSR) form.
+ * The non-zeros of row i are at positions row_offsets[i] to row_offsets[i + 1] of values, with their columns in col_indices.
+ * Columns within a row need not be sorted, but each must lie in [0, num_cols).
+ */
+typedef struct {
+    double* values;
+    int* col_indices;
+    size_t* row_offsets;
+    int num_rows;
+    int num_cols;
+    size_t num_nonzeros;
+} CMLSparseMatrix;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Creates a new zeroed matrix with the specified number of rows and columns.
+ * Returns a pointer to a new CMLMatrix that owns its data on success and NULL on failure.
+ */
+CMLMatrix* create_matrix(int num_rows, int num_cols);
+
+/*
+ * Creates a zero-copy view over caller-owned row-major memory.
+ * Returns the view by value, which must not be passed to free_matrix; an empty view is returned on invalid arguments.
+ */
+CMLMatrix matrix_view(double* data, int num_rows, int num_cols, int stride);
+
+/*
+ * Creates a zero-copy view over a contiguous range of rows of an existing matrix.
+ * Returns the view by value, which must not be passed to free_matrix; an empty view is returned on an invalid range.
+ */
+CMLMatrix matrix_slice(const CMLMatrix* X, int start_row, int num_rows);
+
+/*
+ * Returns a pointer to the first value of the given row of a matrix.
+ */
+static inline double* matrix_row(const CMLMatrix* X, int row) {
+    return X->data + (size_t) row * (size_t) X->stride;
+}
+
+/*
+ * Frees the dynamically allocated memory used by a matrix created with create_matrix.
+ */
+void free_matrix(CMLMatrix* X);
+
+/*
+ * Creates a new zeroed single-precision matrix with the specified number of rows and columns.
+ * Returns a pointer to a new CMLMatrixF that owns its data on success and NULL on failure.
+ */
+CMLMatrixF* create_matrix_f(int num_rows, int num_cols);
+
+/*
+ * Creates a zero-copy single-precision view over caller-owned row-major memory.
+ * Returns the view by value, which must not be passed to free_matrix_f; an empty view is returned on invalid arguments.
+ */
+CMLMatrixF matrix_view_f(float* data, int num_rows, int num_cols, int stride);
+
+/*
+ * Returns a pointer to the first value of the given row of a single-precision matrix.
+ */
+static inline float* matrix_row_f(const CMLMatrixF* X, int row) {
+    return X->data + (size_t) row * (size_t) X->stride;
+}
+
+/*
+ * Frees the dynamically allocated memory used by a matrix created with create_matrix_f.
+ */
+void free_matrix_f(CMLMatrixF* X);
+
+/*
+ * Creates a new sparse matrix with room for a given number of non-zeros, whose row offsets are zeroed for the caller to fill.
+ * Returns a pointer to a new CMLSparseMatrix that owns its arrays on success and NULL on failure.
+ */
+CMLSparseMatrix* create_sparse_matrix(int num_rows, int num_cols, size_t num_nonzeros);
+
+/*
+ * Creates a new sparse matrix holding the non-zero values of a dense matrix.
+ * Returns a pointer to a new CMLSparseMatrix on success and NULL on failure.
+ */
+CMLSparseMatrix* sparse_matrix_from_dense(const CMLMatrix* X);
+
+/*
+ * Checks that a sparse matrix's row offsets and column indices are consistent with its dimensions.
+ * Returns EXIT_SUCCESS if the matrix is well formed, and EXIT_FAILURE otherwise.
+ */
+int check_sparse_matrix(const CMLSparseMatrix* X);
+
+/*
+ * Frees the dynamically allocated memory used by a sparse matrix created with create_sparse_matrix.
+ */
+void free_sparse_matrix(CMLSparseMatrix* X);
+
+#endif /* For MATRIX_H */
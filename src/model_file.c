@@ -0,0 +1,233 @@
+#include "model_file.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * The magic bytes at the start of every model file.
+ */
+#define MODEL_FILE_MAGIC "CMLMODL"
+
+/*
+ * A value written in the host's byte order, so that a reader on a host of the other byte order can reject the file.
+ */
+#define MODEL_FILE_BYTE_ORDER 0x01020304u
+
+/*
+ * The alignment (in bytes) of the payload within a model file, matching a typical cache line.
+ */
+#define MODEL_FILE_ALIGNMENT 64
+
+/*
+ * The multipliers of the checksum's lanes, taken from the 64-bit golden ratio and xxHash's primes.
+ */
+#define CHECKSUM_PRIME_1 0x9E3779B185EBCA87ULL
+#define CHECKSUM_PRIME_2 0xC2B2AE3D27D4EB4FULL
+
+
+/*
+ * Define a typed struct describing the fixed 128-byte header at the start of every model file.
+ * The header checksum covers every byte before it, and the payload follows at payload_offset.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t model_type;
+    uint32_t reserved;
+    uint64_t num_rows;
+    uint64_t num_cols;
+    uint64_t payload_offset;
+    uint64_t payload_bytes;
+    uint64_t payload_checksum;
+    uint64_t parameters[CML_MODEL_FILE_PARAMETERS];
+    uint64_t header_checksum;
+    uint8_t padding[8];
+} ModelFileHeader;
+
+
+/*
+ * Helper function to rotate a 64-bit value left by a given number of bits.
+ */
+static inline uint64_t rotate_left(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+
+/*
+ * Calculates a 64-bit checksum of a buffer, reading it eight bytes at a time.
+ * Returns the checksum, which depends on both the contents and the length of the buffer.
+ *
+ * Four independent multiply-rotate lanes each absorb every fourth word, so the loop runs at close to memory bandwidth.
+ * The lanes, any trailing bytes and the length are then folded together and avalanched.
+ */
+uint64_t checksum_bytes(const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    uint64_t lanes[4] = {CHECKSUM_PRIME_1, CHECKSUM_PRIME_2, 0, (uint64_t) 0 - CHECKSUM_PRIME_1};
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+
+            memcpy(&word, bytes + i + 8 * lane, sizeof(word));
+            lanes[lane] = rotate_left(lanes[lane] + word * CHECKSUM_PRIME_2, 31) * CHECKSUM_PRIME_1;
+        }
+    }
+
+    uint64_t hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) + rotate_left(lanes[3], 18);
+
+    for (; i < size; i++) {
+        hash = rotate_left(hash ^ (bytes[i] * CHECKSUM_PRIME_1), 11) * CHECKSUM_PRIME_2;
+    }
+
+    hash ^= (uint64_t) size;
+    hash ^= hash >> 33;
+    hash *= CHECKSUM_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= CHECKSUM_PRIME_1;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+
+/*
+ * Writes a model's parameters and its row-major payload of doubles to a model file, replacing any existing file atomically.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The file is written beside the destination and renamed over it once complete, so a reader never maps a partially written model.
+ * The payload is aligned to MODEL_FILE_ALIGNMENT bytes, so a mapped payload can be used in place.
+ */
+int write_model_file(const char* path, CMLModelType type, uint64_t num_rows, uint64_t num_cols, const uint64_t* parameters, const double* payload) {
+    size_t payload_bytes = (size_t) (num_rows * num_cols * sizeof(double));
+    size_t path_length = strlen(path);
+    char* temporary_path = (char*) malloc(path_length + 5);
+    ModelFileHeader header;
+
+    if (temporary_path == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory to save model\n");
+        return EXIT_FAILURE;
+    }
+
+    memcpy(temporary_path, path, path_length);
+    memcpy(temporary_path + path_length, ".tmp", 5);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_FILE_MAGIC, sizeof(MODEL_FILE_MAGIC));
+    header.byte_order = MODEL_FILE_BYTE_ORDER;
+    header.version = CML_MODEL_FILE_VERSION;
+    header.model_type = (uint32_t) type;
+    header.num_rows = num_rows;
+    header.num_cols = num_cols;
+    header.payload_offset = (sizeof(ModelFileHeader) + MODEL_FILE_ALIGNMENT - 1) / MODEL_FILE_ALIGNMENT * MODEL_FILE_ALIGNMENT;
+    header.payload_bytes = payload_bytes;
+    header.payload_checksum = checksum_bytes(payload, payload_bytes);
+    memcpy(header.parameters, parameters, sizeof(header.parameters));
+    header.header_checksum = checksum_bytes(&header, offsetof(ModelFileHeader, header_checksum));
+
+    FILE* file = fopen(temporary_path, "wb");
+    int status = file != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (file != NULL) {
+        if (fwrite(&header, sizeof(header), 1, file) != 1) status = EXIT_FAILURE;
+        if (status == EXIT_SUCCESS && fwrite(payload, 1, payload_bytes, file) != payload_bytes) status = EXIT_FAILURE;
+        if (fclose(file) != 0) status = EXIT_FAILURE;
+    }
+
+    if (status == EXIT_SUCCESS && rename(temporary_path, path) != 0) status = EXIT_FAILURE;
+
+    if (status != EXIT_SUCCESS) {
+        fprintf(stderr, "Error: Failed to write model file %s\n", path);
+        remove(temporary_path);
+    }
+
+    free(temporary_path);
+
+    return status;
+}
+
+
+/*
+ * Maps a model file of the given type into memory, verifying its header and, if verify_payload is set, its payload checksum.
+ * Returns EXIT_SUCCESS on success, filling in file, and EXIT_FAILURE otherwise.
+ *
+ * The file is mapped privately (copy-on-write), so the payload can be used and even updated in place without modifying the file.
+ * Only the header is read eagerly, so loading costs the same whatever the payload's size, with pages faulted in as they are used.
+ * Verifying the payload checksum reads every page, trading that startup time for detection of corruption in the payload itself.
+ * The payload's size and offset are bounded by the space left in the file rather than by sums, so a crafted header cannot wrap around,
+ * which the header checksum alone cannot rule out as it can be recomputed for any header.
+ */
+int map_model_file(const char* path, CMLModelType type, int verify_payload, CMLModelFile* file) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "Error: Failed to open model file %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(ModelFileHeader)) {
+        fprintf(stderr, "Error: Model file %s is too small to hold a header\n", path);
+        close(fd);
+
+        return EXIT_FAILURE;
+    }
+
+    size_t size = (size_t) info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Error: Failed to map model file %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    const ModelFileHeader* header = (const ModelFileHeader*) mapping;
+    const char* problem = NULL;
+
+    if (memcmp(header->magic, MODEL_FILE_MAGIC, sizeof(MODEL_FILE_MAGIC)) != 0) {
+        problem = "is not a CML model";
+    } else if (header->byte_order != MODEL_FILE_BYTE_ORDER) {
+        problem = "was written on a host of a different byte order";
+    } else if (header->header_checksum != checksum_bytes(header, offsetof(ModelFileHeader, header_checksum))) {
+        problem = "has a corrupt header";
+    } else if (header->version != CML_MODEL_FILE_VERSION) {
+        problem = "has an unsupported version";
+    } else if (header->model_type != (uint32_t) type) {
+        problem = "holds a different kind of model";
+    } else if (header->num_cols == 0 || header->num_rows > (uint64_t) 0x7FFFFFFF || header->num_cols > (uint64_t) 0x7FFFFFFF
+               || (header->num_rows != 0 && header->num_cols > UINT64_MAX / sizeof(double) / header->num_rows)
+               || header->payload_bytes != header->num_rows * header->num_cols * sizeof(double)
+               || header->payload_offset % MODEL_FILE_ALIGNMENT != 0 || header->payload_offset < sizeof(ModelFileHeader)
+               || header->payload_offset > size || header->payload_bytes > size - header->payload_offset) {
+        problem = "has a truncated or inconsistent payload";
+    } else if (type == CML_MODEL_K_MEANS && header->num_rows == 0) {
+        problem = "holds a KMeans model without any centroids";
+    } else if (verify_payload && header->payload_checksum != checksum_bytes((const char*) mapping + header->payload_offset, header->payload_bytes)) {
+        problem = "has a corrupt payload";
+    }
+
+    if (problem != NULL) {
+        fprintf(stderr, "Error: Model file %s %s\n", path, problem);
+        munmap(mapping, size);
+
+        return EXIT_FAILURE;
+    }
+
+    file->mapping = mapping;
+    file->mapping_size = size;
+    file->num_rows = header->num_rows;
+    file->num_cols = header->num_cols;
+    file->payload_checksum = header->payload_checksum;
+    file->payload = (double*) ((char*) mapping + header->payload_offset);
+    memcpy(file->parameters, header->parameters, sizeof(file->parameters));
+
+    return EXIT_SUCCESS;
+}
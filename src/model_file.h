@@ -0,0 +1,59 @@
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The version of the binary model format written by this library.
+ */
+#define CML_MODEL_FILE_VERSION 1
+
+/*
+ * The number of model-specific parameter words stored in a model file's header.
+ */
+#define CML_MODEL_FILE_PARAMETERS 6
+
+/*
+ * Define an enumeration of the kinds of model a model file can hold.
+ */
+typedef enum {
+    CML_MODEL_K_MEANS = 1,
+    CML_MODEL_LINEAR_REGRESSION = 2
+} CMLModelType;
+
+/*
+ * Define a typed struct describing a model file mapped into memory.
+ * The payload is a num_rows by num_cols row-major array of doubles within the mapping, which stays valid until it is unmapped.
+ */
+typedef struct {
+    void* mapping;
+    size_t mapping_size;
+    uint64_t num_rows;
+    uint64_t num_cols;
+    uint64_t parameters[CML_MODEL_FILE_PARAMETERS];
+    uint64_t payload_checksum;
+    double* payload;
+} CMLModelFile;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Calculates a 64-bit checksum of a buffer, reading it eight bytes at a time.
+ * Returns the checksum, which depends on both the contents and the length of the buffer.
+ */
+uint64_t checksum_bytes(const void* data, size_t size);
+
+/*
+ * Writes a model's parameters and its row-major payload of doubles to a model file, replacing any existing file atomically.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ */
+int write_model_file(const char* path, CMLModelType type, uint64_t num_rows, uint64_t num_cols, const uint64_t* parameters, const double* payload);
+
+/*
+ * Maps a model file of the given type into memory, verifying its header and, if verify_payload is set, its payload checksum.
+ * Returns EXIT_SUCCESS on success, filling in file, and EXIT_FAILURE otherwise.
+ */
+int map_model_file(const char* path, CMLModelType type, int verify_payload, CMLModelFile* file);
+
+#endif /* For MODEL_FILE_H */
@@ -0,0 +1,531 @@
+#define _GNU_SOURCE
+#include "parallel.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+/*
+ * The largest number of NUMA nodes a context deals its workers out across.
+ */
+#define CONTEXT_MAX_NODES 64
+
+/*
+ * Define a typed struct describing a single parallel_for invocation shared by all of its threads.
+ */
+typedef struct {
+    void (*task)(void* arg, int task_index);
+    void* arg;
+    int num_tasks;
+    int next_task;
+} ParallelJob;
+
+/*
+ * Define a typed struct holding one thread's range [begin, end) of a context job's tasks, packed into a single word with begin in the high half,
+ * so that its owner and thieves alike claim from it with a single compare-and-swap.
+ * Each range is padded to a cache line, so threads claiming from their own ranges never contend.
+ */
+typedef struct {
+    uint64_t range;
+    char padding[56];
+} StealRange;
+
+/*
+ * Define a typed struct describing a single worker thread of a context, and the slot of each job's ranges it claims from.
+ */
+typedef struct {
+    pthread_t thread;
+    CMLContext* context;
+    int slot;
+} ContextWorker;
+
+/*
+ * Define the struct of an execution context, whose workers take slots 1 onwards of each job while the submitting thread takes slot 0.
+ * Jobs are published under lock by bumping generation, and active counts the workers still taking part in the current job.
+ * The submit lock serialises jobs submitted from different threads.
+ */
+struct CMLContext {
+    int num_threads;
+    int num_workers;
+    ContextWorker* workers;
+    StealRange* ranges;
+    pthread_mutex_t submit;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    unsigned long generation;
+    int active;
+    int stopping;
+    void (*task)(void* arg, int task_index);
+    void* arg;
+    int num_participants;
+};
+
+/*
+ * The context whose job the current thread is running tasks of, if any.
+ */
+static __thread const CMLContext* running_context = NULL;
+
+
+/*
+ * Helper function to repeatedly claim and run the next unclaimed task of a job until none remain.
+ */
+static void run_tasks(ParallelJob* job) {
+    int task_index;
+
+    while ((task_index = __atomic_fetch_add(&job->next_task, 1, __ATOMIC_RELAXED)) < job->num_tasks) {
+        job->task(job->arg, task_index);
+    }
+}
+
+
+/*
+ * Entry point of each spawned thread, which simply joins in claiming tasks.
+ */
+static void* parallel_worker(void* arg) {
+    run_tasks((ParallelJob*) arg);
+
+    return NULL;
+}
+
+
+/*
+ * Runs task(arg, i) once for every i in [0, num_tasks), spread across up to num_threads threads.
+ * Tasks are claimed dynamically, so the mapping of tasks to threads is unspecified; the call returns once every task has run.
+ *
+ * The calling thread takes part in the work, so only num_threads - 1 additional threads are spawned.
+ * If memory for the thread handles cannot be allocated, or a thread fails to spawn, the remaining threads pick up its share.
+ */
+void parallel_for(int num_tasks, int num_threads, void (*task)(void* arg, int task_index), void* arg) {
+    ParallelJob job = {task, arg, num_tasks, 0};
+
+    if (num_threads > num_tasks) num_threads = num_tasks;
+
+    if (num_threads <= 1) {
+        run_tasks(&job);
+        return;
+    }
+
+    pthread_t* threads = (pthread_t*) malloc((size_t) (num_threads - 1) * sizeof(pthread_t));
+    int num_spawned = 0;
+
+    if (threads != NULL) {
+        while (num_spawned < num_threads - 1 && pthread_create(&threads[num_spawned], NULL, parallel_worker, &job) == 0) {
+            num_spawned++;
+        }
+    }
+
+    run_tasks(&job);
+
+    for (int i = 0; i < num_spawned; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+}
+
+
+/*
+ * Helper function to pack a range of task indices into a single word.
+ * Returns the packed range.
+ */
+static inline uint64_t pack_range(uint32_t begin, uint32_t end) {
+    return ((uint64_t) begin << 32) | end;
+}
+
+
+/*
+ * Helper function to claim the first task of a range.
+ * Returns the index of the claimed task, or -1 if the range is empty.
+ */
+static int claim_task(StealRange* range) {
+    uint64_t current = __atomic_load_n(&range->range, __ATOMIC_ACQUIRE);
+
+    while ((uint32_t) (current >> 32) < (uint32_t) current) {
+        uint32_t begin = (uint32_t) (current >> 32);
+
+        if (__atomic_compare_exchange_n(&range->range, &current, pack_range(begin + 1, (uint32_t) current), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return (int) begin;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+ * Helper function to steal the back half of another thread's range into a thread's own, emptied range, visiting the others in turn from the next slot.
+ * Returns 1 if any tasks were stolen, and 0 if every range was empty.
+ *
+ * A range only ever shrinks until its owner has emptied it, and an empty range is never stolen from,
+ * so a stolen range can never be mistaken for one a thief read earlier.
+ */
+static int steal_tasks(CMLContext* context, int slot) {
+    int num_participants = context->num_participants;
+
+    for (int i = 1; i < num_participants; i++) {
+        StealRange* victim = &context->ranges[(slot + i) % num_participants];
+        uint64_t current = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+
+        while ((uint32_t) (current >> 32) < (uint32_t) current) {
+            uint32_t begin = (uint32_t) (current >> 32);
+            uint32_t end = (uint32_t) current;
+            uint32_t split = end - (end - begin + 1) / 2;
+
+            if (__atomic_compare_exchange_n(&victim->range, &current, pack_range(begin, split), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_store_n(&context->ranges[slot].range, pack_range(split, end), __ATOMIC_RELEASE);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Helper function to run a context job's tasks from a slot's range, stealing more whenever it runs dry, until every task is claimed.
+ */
+static void run_context_tasks(CMLContext* context, int slot) {
+    const CMLContext* previous = running_context;
+    int task_index;
+
+    running_context = context;
+
+    do {
+        while ((task_index = claim_task(&context->ranges[slot])) >= 0) {
+            context->task(context->arg, task_index);
+        }
+    } while (steal_tasks(context, slot));
+
+    running_context = previous;
+}
+
+
+/*
+ * Entry point of each of a context's worker threads, which sleeps until a job is published and takes part in it if its slot is needed.
+ * Returns once the context is stopping.
+ */
+static void* context_worker(void* arg) {
+    ContextWorker* worker = (ContextWorker*) arg;
+    CMLContext* context = worker->context;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&context->lock);
+
+    for (;;) {
+        while (!context->stopping && context->generation == seen) {
+            pthread_cond_wait(&context->wake, &context->lock);
+        }
+
+        if (context->stopping) break;
+
+        seen = context->generation;
+
+        if (worker->slot < context->num_participants) {
+            pthread_mutex_unlock(&context->lock);
+            run_context_tasks(context, worker->slot);
+            pthread_mutex_lock(&context->lock);
+
+            if (--context->active == 0) pthread_cond_signal(&context->done);
+        }
+    }
+
+    pthread_mutex_unlock(&context->lock);
+
+    return NULL;
+}
+
+
+/*
+ * Runs task(arg, i) once for every i in [0, num_tasks) on a context's pool, using up to num_threads of its threads including the caller.
+ * A null context runs the tasks through parallel_for instead. The call returns once every task has run.
+ *
+ * The tasks are dealt out as one contiguous range per thread, which keeps neighbouring tasks on one thread, with stealing balancing any unevenness.
+ * A job of a single thread, or one submitted by a task already running on the context, runs inline on the calling thread.
+ * Otherwise, the caller waits for any other thread's job on the context to finish, publishes its own, and takes slot 0 of it,
+ * returning only once every worker taking part has finished, so the job's state can never outlive the call.
+ */
+void parallel_for_in(CMLContext* context, int num_tasks, int num_threads, void (*task)(void* arg, int task_index), void* arg) {
+    if (context == NULL) {
+        parallel_for(num_tasks, num_threads, task, arg);
+        return;
+    }
+
+    if (num_threads > context->num_threads) num_threads = context->num_threads;
+    if (num_threads > num_tasks) num_threads = num_tasks;
+
+    if (num_threads <= 1 || running_context == context) {
+        for (int i = 0; i < num_tasks; i++) {
+            task(arg, i);
+        }
+
+        return;
+    }
+
+    pthread_mutex_lock(&context->submit);
+    pthread_mutex_lock(&context->lock);
+
+    context->task = task;
+    context->arg = arg;
+    context->num_participants = num_threads;
+    context->active = num_threads - 1;
+
+    for (int p = 0; p < num_threads; p++) {
+        uint32_t begin = (uint32_t) ((long long) num_tasks * p / num_threads);
+        uint32_t end = (uint32_t) ((long long) num_tasks * (p + 1) / num_threads);
+
+        context->ranges[p].range = pack_range(begin, end);
+    }
+
+    context->generation++;
+    pthread_cond_broadcast(&context->wake);
+    pthread_mutex_unlock(&context->lock);
+
+    run_context_tasks(context, 0);
+
+    pthread_mutex_lock(&context->lock);
+
+    while (context->active > 0) {
+        pthread_cond_wait(&context->done, &context->lock);
+    }
+
+    pthread_mutex_unlock(&context->lock);
+    pthread_mutex_unlock(&context->submit);
+}
+
+
+/*
+ * Resolves a requested thread count, where a non-positive request means one thread per online CPU.
+ * Returns the number of threads to use, which is always at least one.
+ */
+int resolve_num_threads(int num_threads) {
+    if (num_threads > 0) return num_threads;
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return online > 0 ? (int) online : 1;
+}
+
+
+/*
+ * Resolves the thread count of a model's work, which is every thread of its context if it has one, and its own num_threads otherwise.
+ * Returns the number of threads to use, which is always at least one.
+ */
+int resolve_context_threads(const CMLContext* context, int num_threads) {
+    return context != NULL ? context->num_threads : resolve_num_threads(num_threads);
+}
+
+
+/*
+ * Helper function to parse a kernel CPU list such as "0-3,8,10-11" into a CPU set.
+ * Parsing stops at the first malformed entry, keeping the CPUs before it.
+ */
+static void parse_cpu_list(const char* text, cpu_set_t* cpus) {
+    CPU_ZERO(cpus);
+
+    for (;;) {
+        char* end;
+        long first = strtol(text, &end, 10);
+        long last = first;
+
+        if (end == text || first < 0) return;
+
+        if (*end == '-') {
+            text = end + 1;
+            last = strtol(text, &end, 10);
+
+            if (end == text) return;
+        }
+
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET((int) cpu, cpus);
+        }
+
+        if (*end != ',') return;
+
+        text = end + 1;
+    }
+}
+
+
+/*
+ * Helper function to read the CPUs of each NUMA node from sysfs, keeping only the ones the process may run on.
+ * Returns the number of nodes with any such CPUs, whose sets are written to nodes, which is zero if the topology cannot be read.
+ */
+static int read_node_cpus(const cpu_set_t* allowed, cpu_set_t* nodes) {
+    char path[64];
+    char text[4096];
+    int num_nodes = 0;
+
+    for (int node = 0; node < CONTEXT_MAX_NODES; node++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+        FILE* file = fopen(path, "r");
+
+        if (file == NULL) continue;
+
+        if (fgets(text, sizeof(text), file) != NULL) {
+            parse_cpu_list(text, &nodes[num_nodes]);
+            CPU_AND(&nodes[num_nodes], &nodes[num_nodes], allowed);
+
+            if (CPU_COUNT(&nodes[num_nodes]) > 0) num_nodes++;
+        }
+
+        fclose(file);
+    }
+
+    return num_nodes;
+}
+
+
+/*
+ * Helper function to work out the CPUs each of a context's workers is bound to, from the CPUs the process may run on.
+ * Returns 1 if the workers' sets were written to cpus, and 0 if the workers are left to the scheduler.
+ *
+ * Pinned cores are taken in turn from the second allowed CPU, leaving the first to the thread that submits jobs.
+ * Nodes are likewise taken in turn from the second, so the submitting thread and its workers fill the nodes evenly.
+ */
+static int place_workers(CMLPlacement placement, int num_workers, cpu_set_t* cpus) {
+    cpu_set_t allowed;
+
+    if (placement == CML_PLACEMENT_ANY || sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return 0;
+
+    if (placement == CML_PLACEMENT_CORES) {
+        int num_allowed = CPU_COUNT(&allowed);
+        int allowed_cpus[CPU_SETSIZE];
+        int n = 0;
+
+        for (int cpu = 0; cpu < CPU_SETSIZE && n < num_allowed; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) allowed_cpus[n++] = cpu;
+        }
+
+        for (int w = 0; w < num_workers; w++) {
+            CPU_ZERO(&cpus[w]);
+            CPU_SET(allowed_cpus[(w + 1) % n], &cpus[w]);
+        }
+
+        return 1;
+    }
+
+    cpu_set_t nodes[CONTEXT_MAX_NODES];
+    int num_nodes = read_node_cpus(&allowed, nodes);
+
+    if (num_nodes == 0) return 0;
+
+    for (int w = 0; w < num_workers; w++) {
+        cpus[w] = nodes[(w + 1) % num_nodes];
+    }
+
+    return 1;
+}
+
+
+/*
+ * Creates a new execution context of num_threads threads, counting the thread that submits each job, placed on CPUs as given.
+ * Returns a pointer to a new CMLContext on success and NULL on failure.
+ *
+ * Spawns num_threads - 1 workers, each bound to its CPUs before it starts, so that its stack and the memory it first touches land on them.
+ * Placement is best effort, leaving the workers to the scheduler if the CPUs the process may run on or the NUMA topology cannot be read.
+ * A NULL is returned if any dynamic allocation fails or a worker cannot be spawned, with any workers already spawned stopped.
+ */
+CMLContext* create_context(int num_threads, CMLPlacement placement) {
+    num_threads = resolve_num_threads(num_threads);
+
+    CMLContext* context = (CMLContext*) calloc(1, sizeof(CMLContext));
+    ContextWorker* workers = (ContextWorker*) calloc((size_t) num_threads, sizeof(ContextWorker));
+    StealRange* ranges = (StealRange*) calloc((size_t) num_threads, sizeof(StealRange));
+    cpu_set_t* cpus = (cpu_set_t*) malloc((size_t) num_threads * sizeof(cpu_set_t));
+
+    if (context == NULL || workers == NULL || ranges == NULL || cpus == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for execution context\n");
+        free(context);
+        free(workers);
+        free(ranges);
+        free(cpus);
+
+        return NULL;
+    }
+
+    context->num_threads = num_threads;
+    context->workers = workers;
+    context->ranges = ranges;
+    pthread_mutex_init(&context->submit, NULL);
+    pthread_mutex_init(&context->lock, NULL);
+    pthread_cond_init(&context->wake, NULL);
+    pthread_cond_init(&context->done, NULL);
+
+    int placed = place_workers(placement, num_threads - 1, cpus);
+
+    for (int w = 0; w < num_threads - 1; w++) {
+        pthread_attr_t attributes;
+        int status;
+
+        workers[w].context = context;
+        workers[w].slot = w + 1;
+        pthread_attr_init(&attributes);
+
+        if (placed) pthread_attr_setaffinity_np(&attributes, sizeof(cpu_set_t), &cpus[w]);
+
+        status = pthread_create(&workers[w].thread, &attributes, context_worker, &workers[w]);
+        pthread_attr_destroy(&attributes);
+
+        if (status != 0) {
+            fprintf(stderr, "Error: Failed to spawn worker %d of execution context\n", w + 1);
+            free(cpus);
+            free_context(context);
+
+            return NULL;
+        }
+
+        context->num_workers++;
+    }
+
+    free(cpus);
+
+    return context;
+}
+
+
+/*
+ * Gets the number of threads of an execution context, counting the thread that submits each job.
+ * Returns the number of threads, or -1 if the context is null.
+ */
+int context_num_threads(const CMLContext* context) {
+    if (context == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to context_num_threads\n");
+        return -1;
+    }
+
+    return context->num_threads;
+}
+
+
+/*
+ * Frees an execution context, stopping and joining its worker threads.
+ *
+ * Ensures that the context is non-null, wakes every worker to see that it is stopping and joins it,
+ * then deallocates the workers and ranges, followed by the context itself.
+ */
+void free_context(CMLContext* context) {
+    if (context == NULL) return;
+
+    pthread_mutex_lock(&context->lock);
+    context->stopping = 1;
+    pthread_cond_broadcast(&context->wake);
+    pthread_mutex_unlock(&context->lock);
+
+    for (int w = 0; w < context->num_workers; w++) {
+        pthread_join(context->workers[w].thread, NULL);
+    }
+
+    pthread_mutex_destroy(&context->submit);
+    pthread_mutex_destroy(&context->lock);
+    pthread_cond_destroy(&context->wake);
+    pthread_cond_destroy(&context->done);
+    free(context->workers);
+    free(context->ranges);
+    free(context);
+}
@@ -0,0 +1,70 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+/*
+ * Define an enumeration of how a context places its worker threads on the CPUs the process may run on.
+ * CML_PLACEMENT_ANY leaves them to the scheduler.
+ * CML_PLACEMENT_CORES pins each worker to a single CPU, taking the allowed CPUs in turn.
+ * CML_PLACEMENT_NODES deals workers out across NUMA nodes in turn, binding each to its node's CPUs, so the memory it first touches stays local.
+ */
+typedef enum {
+    CML_PLACEMENT_ANY,
+    CML_PLACEMENT_CORES,
+    CML_PLACEMENT_NODES
+} CMLPlacement;
+
+/*
+ * Define an opaque type for an execution context, which owns a pool of worker threads that every model given it shares.
+ * The workers are created once, with the context, and sleep between jobs.
+ * Each job's tasks are dealt out as one contiguous range per thread, and a thread that runs out steals half of another's remaining range.
+ * Jobs submitted from different threads take turns on the pool, so models sharing a context never run more threads than it holds,
+ * and a task that submits a job to the context it is running on runs that job inline.
+ */
+typedef struct CMLContext CMLContext;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Runs task(arg, i) once for every i in [0, num_tasks), spread across up to num_threads threads.
+ * Tasks are claimed dynamically, so the mapping of tasks to threads is unspecified; the call returns once every task has run.
+ */
+void parallel_for(int num_tasks, int num_threads, void (*task)(void* arg, int task_index), void* arg);
+
+/*
+ * Runs task(arg, i) once for every i in [0, num_tasks) on a context's pool, using up to num_threads of its threads including the caller.
+ * A null context runs the tasks through parallel_for instead. The call returns once every task has run.
+ */
+void parallel_for_in(CMLContext* context, int num_tasks, int num_threads, void (*task)(void* arg, int task_index), void* arg);
+
+/*
+ * Resolves a requested thread count, where a non-positive request means one thread per online CPU.
+ * Returns the number of threads to use, which is always at least one.
+ */
+int resolve_num_threads(int num_threads);
+
+/*
+ * Resolves the thread count of a model's work, which is every thread of its context if it has one, and its own num_threads otherwise.
+ * Returns the number of threads to use, which is always at least one.
+ */
+int resolve_context_threads(const CMLContext* context, int num_threads);
+
+/*
+ * Creates a new execution context of num_threads threads, counting the thread that submits each job, placed on CPUs as given.
+ * A non-positive num_threads uses one thread per online CPU.
+ * Returns a pointer to a new CMLContext on success and NULL on failure.
+ */
+CMLContext* create_context(int num_threads, CMLPlacement placement);
+
+/*
+ * Gets the number of threads of an execution context, counting the thread that submits each job.
+ * Returns the number of threads, or -1 if the context is null.
+ */
+int context_num_threads(const CMLContext* context);
+
+/*
+ * Frees an execution context, stopping and joining its worker threads.
+ * No job may be running on it, and no model may use it afterwards.
+ */
+void free_context(CMLContext* context);
+
+#endif /* For PARALLEL_H */
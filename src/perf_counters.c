@@ -0,0 +1,137 @@
+#include "perf_counters.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+ * The number of counters in a set.
+ */
+#define PERF_NUM_COUNTERS 4
+
+
+/*
+ * Helper function to store a counter's value in the matching field of a reading.
+ */
+static void set_reading(CMLPerfReading* reading, int counter, long long value) {
+    switch (counter) {
+        case 0: reading->cycles = value; break;
+        case 1: reading->instructions = value; break;
+        case 2: reading->cache_misses = value; break;
+        default: reading->branch_misses = value; break;
+    }
+}
+
+
+/*
+ * Helper function to load a counter's value from the matching field of a reading.
+ */
+static long long get_reading(const CMLPerfReading* reading, int counter) {
+    switch (counter) {
+        case 0: return reading->cycles;
+        case 1: return reading->instructions;
+        case 2: return reading->cache_misses;
+        default: return reading->branch_misses;
+    }
+}
+
+
+/*
+ * Opens the cycle, instruction, cache miss and branch miss counters of the calling thread (and the threads it spawns) with perf_event_open.
+ * Returns EXIT_SUCCESS if at least one counter opened, and EXIT_FAILURE if none did (for example off Linux, or when perf events are restricted).
+ *
+ * Each counter is opened on its own rather than as a group, since inherited counters cannot be read as a group.
+ * The counters only count user space, so they remain usable under the default perf_event_paranoid setting.
+ */
+int open_perf_counters(CMLPerfCounters* counters) {
+    int opened = 0;
+
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        counters->fds[c] = -1;
+    }
+
+#ifdef __linux__
+    static const unsigned long long events[PERF_NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = events[c];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+
+        counters->fds[c] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+        if (counters->fds[c] >= 0) opened++;
+    }
+#endif
+
+    return opened > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+/*
+ * Reads the current totals of a set of open counters into reading.
+ *
+ * Counters that are not open, or whose read fails, are reported as -1.
+ */
+void read_perf_counters(const CMLPerfCounters* counters, CMLPerfReading* reading) {
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        long long value = -1;
+
+        if (counters->fds[c] >= 0 && read(counters->fds[c], &value, sizeof(value)) != (ssize_t) sizeof(value)) value = -1;
+
+        set_reading(reading, c, value);
+    }
+}
+
+
+/*
+ * Calculates the counts accrued between two readings, keeping -1 for unavailable counters.
+ */
+void perf_reading_delta(const CMLPerfReading* start, const CMLPerfReading* end, CMLPerfReading* delta) {
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        long long first = get_reading(start, c);
+        long long last = get_reading(end, c);
+
+        set_reading(delta, c, first >= 0 && last >= 0 ? last - first : -1);
+    }
+}
+
+
+/*
+ * Closes every open counter of a set.
+ */
+void close_perf_counters(CMLPerfCounters* counters) {
+    for (int c = 0; c < PERF_NUM_COUNTERS; c++) {
+        if (counters->fds[c] >= 0) close(counters->fds[c]);
+
+        counters->fds[c] = -1;
+    }
+}
+
+
+/*
+ * Reads a monotonic wall clock.
+ * Returns the current time in seconds.
+ */
+double wall_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
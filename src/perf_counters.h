@@ -0,0 +1,52 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+/*
+ * Define a typed struct holding hardware event counts, each of which is -1 if its counter is unavailable.
+ */
+typedef struct {
+    long long cycles;
+    long long instructions;
+    long long cache_misses;
+    long long branch_misses;
+} CMLPerfReading;
+
+/*
+ * Define a typed struct holding a set of open hardware counters, one file descriptor per event (or -1 if it could not be opened).
+ * The counters follow the thread that opened them and every thread it spawns afterwards, as parallel_for's workers are.
+ * Threads that already exist, such as the pooled workers of a CMLContext, are not counted, so models running on a context skip their counters.
+ */
+typedef struct {
+    int fds[4];
+} CMLPerfCounters;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Opens the cycle, instruction, cache miss and branch miss counters of the calling thread (and the threads it spawns afterwards) with perf_event_open.
+ * Returns EXIT_SUCCESS if at least one counter opened, and EXIT_FAILURE if none did (for example off Linux, or when perf events are restricted).
+ */
+int open_perf_counters(CMLPerfCounters* counters);
+
+/*
+ * Reads the current totals of a set of open counters into reading.
+ */
+void read_perf_counters(const CMLPerfCounters* counters, CMLPerfReading* reading);
+
+/*
+ * Calculates the counts accrued between two readings, keeping -1 for unavailable counters.
+ */
+void perf_reading_delta(const CMLPerfReading* start, const CMLPerfReading* end, CMLPerfReading* delta);
+
+/*
+ * Closes every open counter of a set.
+ */
+void close_perf_counters(CMLPerfCounters* counters);
+
+/*
+ * Reads a monotonic wall clock, which every timed report and benchmark measures with.
+ * Returns the current time in seconds.
+ */
+double wall_time(void);
+
+#endif /* For PERF_COUNTERS_H */
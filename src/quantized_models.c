@@ -0,0 +1,327 @@
+#include "quantized_models.h"
+#include "distance.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * The number of centroids re-ranked exactly per prediction when no count is given.
+ */
+#define KMEANS_Q8_DEFAULT_CANDIDATES 8
+
+/*
+ * The largest code magnitude, kept symmetric so that negating a code never overflows.
+ */
+#define KMEANS_Q8_MAX_CODE 127
+
+/*
+ * The largest number of variables a quantized model supports, keeping every integer squared distance within 32 bits.
+ */
+#define KMEANS_Q8_MAX_VARIABLES 32767
+
+/*
+ * The number of rows labelled by each task of a quantized batch prediction.
+ */
+#define KMEANS_Q8_LABEL_BLOCK 256
+
+/*
+ * Define a typed struct describing a quantized labelling of the rows of a matrix, shared by every block task.
+ */
+typedef struct {
+    const KMeansQ8* qkm;
+    const CMLMatrix* X;
+    int* labels;
+} KMeansQ8Labelling;
+
+
+/*
+ * Helper function to quantize a value of a given variable to its int8 code, clamping values beyond the codes' range.
+ * Returns the nearest code.
+ */
+static inline int8_t quantize_value(const KMeansQ8* qkm, int variable, double value) {
+    double code = nearbyint((value - qkm->offsets[variable]) / qkm->scale);
+
+    if (code > KMEANS_Q8_MAX_CODE) code = KMEANS_Q8_MAX_CODE;
+    if (code < -KMEANS_Q8_MAX_CODE) code = -KMEANS_Q8_MAX_CODE;
+
+    return (int8_t) code;
+}
+
+
+/*
+ * Creates a new int8 quantized copy of a KMeans model's centroids for serving, re-ranking num_candidates centroids per prediction.
+ * Returns a pointer to a new KMeansQ8 on success and NULL on failure.
+ *
+ * Each variable is centred on the midpoint of its centroid values, and a single scale maps the widest variable's range onto the codes,
+ * so that one integer distance ranks every variable on the same footing. A model whose centroids all coincide uses a unit scale.
+ * The number of candidates is capped at k, at which point every centroid is re-ranked.
+ * The int8 distance kernel's per-centroid terms are computed once here, rather than on every prediction.
+ * The quantized model takes the KMeans model's num_threads and context, and keeps no reference to the model itself.
+ * A NULL is returned if the model has more than KMEANS_Q8_MAX_VARIABLES variables or if any dynamic allocation fails, with any already allocated memory freed.
+ */
+KMeansQ8* quantize_k_means(const KMeans* km, int num_candidates) {
+    if (km == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to quantize_k_means\n");
+        return NULL;
+    }
+
+    if (km->num_variables > KMEANS_Q8_MAX_VARIABLES) {
+        fprintf(stderr, "Error: Quantized KMeans models support at most %d variables\n", KMEANS_Q8_MAX_VARIABLES);
+        return NULL;
+    }
+
+    size_t k = (size_t) km->k;
+    size_t d = (size_t) km->num_variables;
+    KMeansQ8* qkm = (KMeansQ8*) malloc(sizeof(KMeansQ8));
+    int8_t* codes = (int8_t*) malloc(k * d);
+    int32_t* terms = (int32_t*) malloc(k * sizeof(int32_t));
+    double* offsets = (double*) malloc(d * sizeof(double));
+
+    if (qkm == NULL || codes == NULL || terms == NULL || offsets == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for quantized KMeans model\n");
+        free(qkm);
+        free(codes);
+        free(terms);
+        free(offsets);
+
+        return NULL;
+    }
+
+    double widest = 0.0;
+
+    for (size_t j = 0; j < d; j++) {
+        double low = km->centroids[j];
+        double high = km->centroids[j];
+
+        for (size_t c = 1; c < k; c++) {
+            double value = km->centroids[c * d + j];
+
+            if (value < low) low = value;
+            if (value > high) high = value;
+        }
+
+        offsets[j] = 0.5 * (low + high);
+
+        if (high - low > widest) widest = high - low;
+    }
+
+    qkm->codes = codes;
+    qkm->terms = terms;
+    qkm->offsets = offsets;
+    qkm->scale = widest > 0.0 ? widest / (2.0 * KMEANS_Q8_MAX_CODE) : 1.0;
+    qkm->k = km->k;
+    qkm->num_variables = km->num_variables;
+    qkm->num_candidates = num_candidates > 0 ? num_candidates : KMEANS_Q8_DEFAULT_CANDIDATES;
+    qkm->num_threads = km->num_threads;
+    qkm->context = km->context;
+
+    if (qkm->num_candidates > qkm->k) qkm->num_candidates = qkm->k;
+
+    for (size_t c = 0; c < k; c++) {
+        for (size_t j = 0; j < d; j++) {
+            codes[c * d + j] = quantize_value(qkm, (int) j, km->centroids[c * d + j]);
+        }
+    }
+
+    prepare_points_i8(codes, km->k, km->num_variables, terms);
+
+    return qkm;
+}
+
+
+/*
+ * Creates the scratch buffers for single-point predictions with the quantized KMeans model.
+ * Returns a pointer to a new KMeansQ8Scratch on success and NULL on failure.
+ *
+ * The buffers are sized for the model's k, num_variables and num_candidates, which predict_k_means_q8 checks each model it is given against.
+ */
+KMeansQ8Scratch* create_k_means_q8_scratch(const KMeansQ8* qkm) {
+    if (qkm == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to create_k_means_q8_scratch\n");
+        return NULL;
+    }
+
+    KMeansQ8Scratch* scratch = (KMeansQ8Scratch*) malloc(sizeof(KMeansQ8Scratch));
+
+    if (scratch == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for quantized prediction\n");
+        return NULL;
+    }
+
+    scratch->query = (int8_t*) malloc((size_t) qkm->num_variables + 1);
+    scratch->distances = (int32_t*) malloc((size_t) qkm->k * sizeof(int32_t));
+    scratch->candidates = (int*) malloc((size_t) qkm->num_candidates * sizeof(int));
+    scratch->candidate_distances = (int32_t*) malloc((size_t) qkm->num_candidates * sizeof(int32_t));
+    scratch->k = qkm->k;
+    scratch->num_variables = qkm->num_variables;
+    scratch->num_candidates = qkm->num_candidates;
+
+    if (scratch->query == NULL || scratch->distances == NULL || scratch->candidates == NULL || scratch->candidate_distances == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for quantized prediction\n");
+        free_k_means_q8_scratch(scratch);
+
+        return NULL;
+    }
+
+    return scratch;
+}
+
+
+/*
+ * Helper function to label a single data point with a quantized model.
+ * Returns the index of the nearest re-ranked centroid.
+ *
+ * The data point is quantized with the centroids' offsets and scale, and its integer distance to every centroid is measured in the int8 kernel.
+ * The num_candidates smallest are kept by insertion, scanning centroids in ascending order so that ties keep the lower index.
+ * Each candidate is then re-ranked by the exact squared distance from the unquantized point to its decoded centroid,
+ * which undoes the rounding of the point itself, with ties again going to the lower index.
+ */
+static int label_point(const KMeansQ8* qkm, const double* x, KMeansQ8Scratch* scratch) {
+    int d = qkm->num_variables;
+    int m = qkm->num_candidates;
+    int found = 0;
+
+    for (int j = 0; j < d; j++) {
+        scratch->query[j] = quantize_value(qkm, j, x[j]);
+    }
+
+    squared_distances_i8(scratch->query, qkm->codes, qkm->terms, qkm->k, d, scratch->distances);
+
+    for (int c = 0; c < qkm->k; c++) {
+        int32_t distance = scratch->distances[c];
+
+        if (found == m && distance >= scratch->candidate_distances[m - 1]) continue;
+
+        int slot = found < m ? found++ : m - 1;
+
+        while (slot > 0 && scratch->candidate_distances[slot - 1] > distance) {
+            scratch->candidates[slot] = scratch->candidates[slot - 1];
+            scratch->candidate_distances[slot] = scratch->candidate_distances[slot - 1];
+            slot--;
+        }
+
+        scratch->candidates[slot] = c;
+        scratch->candidate_distances[slot] = distance;
+    }
+
+    int best = -1;
+    double best_distance = INFINITY;
+
+    for (int i = 0; i < found; i++) {
+        int c = scratch->candidates[i];
+        const int8_t* code = qkm->codes + (size_t) c * (size_t) d;
+        double distance = 0.0;
+
+        for (int j = 0; j < d; j++) {
+            double diff = x[j] - (qkm->offsets[j] + qkm->scale * code[j]);
+            distance += diff * diff;
+        }
+
+        if (distance < best_distance || (distance == best_distance && c < best)) {
+            best = c;
+            best_distance = distance;
+        }
+    }
+
+    return best;
+}
+
+
+/*
+ * Predicts the cluster for a data point based on the quantized KMeans model, using the caller's scratch buffers.
+ * Returns the index of the nearest re-ranked centroid, or -1 on failure.
+ *
+ * Ensures that the model, point and scratch are non-null and that the scratch is large enough for the model.
+ * Nothing is allocated, so the model can be shared by any number of threads as long as each brings its own scratch.
+ */
+int predict_k_means_q8(const KMeansQ8* qkm, const double* x, KMeansQ8Scratch* scratch) {
+    if (qkm == NULL || x == NULL || scratch == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to predict_k_means_q8\n");
+        return -1;
+    }
+
+    if (scratch->k < qkm->k || scratch->num_variables < qkm->num_variables || scratch->num_candidates < qkm->num_candidates) {
+        fprintf(stderr, "Error: Quantized prediction scratch is too small for the KMeans model\n");
+        return -1;
+    }
+
+    return label_point(qkm, x, scratch);
+}
+
+
+/*
+ * Labels each data point of a single block of KMEANS_Q8_LABEL_BLOCK rows with the quantized model.
+ * Runs as a parallel_for task, so it only writes to the labels of its own rows.
+ *
+ * The block's scratch buffers are created once and reused for each of its rows, and every row is labelled -1 if that fails.
+ */
+static void label_q8_block(void* arg, int block) {
+    KMeansQ8Labelling* labelling = (KMeansQ8Labelling*) arg;
+    int start = block * KMEANS_Q8_LABEL_BLOCK;
+    int end = start + KMEANS_Q8_LABEL_BLOCK < labelling->X->num_rows ? start + KMEANS_Q8_LABEL_BLOCK : labelling->X->num_rows;
+    KMeansQ8Scratch* scratch = create_k_means_q8_scratch(labelling->qkm);
+
+    for (int i = start; i < end; i++) {
+        labelling->labels[i] = scratch != NULL ? label_point(labelling->qkm, matrix_row(labelling->X, i), scratch) : -1;
+    }
+
+    free_k_means_q8_scratch(scratch);
+}
+
+
+/*
+ * Predicts the cluster of each row of a matrix of data points with the quantized KMeans model.
+ * Writes the predicted cluster number of each row into the labels array.
+ *
+ * Ensures that the model, matrix and labels are non-null and that the matrix has one column per model variable.
+ * Splits the rows into blocks which are labelled concurrently across the model's threads, on its context if it has one.
+ */
+void predict_k_means_batch_q8(const KMeansQ8* qkm, const CMLMatrix* X, int* labels) {
+    if (qkm == NULL || X == NULL || labels == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to predict_k_means_batch_q8\n");
+        return;
+    }
+
+    if (X->num_cols != qkm->num_variables) {
+        fprintf(stderr, "Error: Sample matrix has %d columns but the quantized KMeans model expects %d\n", X->num_cols, qkm->num_variables);
+        return;
+    }
+
+    KMeansQ8Labelling labelling = {qkm, X, labels};
+    int num_blocks = (X->num_rows + KMEANS_Q8_LABEL_BLOCK - 1) / KMEANS_Q8_LABEL_BLOCK;
+
+    parallel_for_in(qkm->context, num_blocks, resolve_context_threads(qkm->context, qkm->num_threads), label_q8_block, &labelling);
+}
+
+
+/*
+ * Frees the dynamically allocated memory used by a quantized KMeans model.
+ *
+ * Ensures that the model is non-null and deallocates its codes, terms and offsets, followed by the model itself.
+ */
+void free_k_means_q8(KMeansQ8* qkm) {
+    if (qkm == NULL) return;
+
+    free(qkm->codes);
+    free(qkm->terms);
+    free(qkm->offsets);
+    free(qkm);
+}
+
+
+/*
+ * Frees the dynamically allocated memory used by the scratch buffers of quantized predictions.
+ *
+ * Ensures that the scratch is non-null and deallocates each of its buffers, followed by the scratch itself.
+ */
+void free_k_means_q8_scratch(KMeansQ8Scratch* scratch) {
+    if (scratch == NULL) return;
+
+    free(scratch->query);
+    free(scratch->distances);
+    free(scratch->candidates);
+    free(scratch->candidate_distances);
+    free(scratch);
+}
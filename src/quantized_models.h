@@ -0,0 +1,84 @@
+#ifndef QUANTIZED_MODELS_H
+#define QUANTIZED_MODELS_H
+
+#include <stdint.h>
+#include "matrix.h"
+#include "k_means.h"
+
+/*
+ * Define a typed struct to encapsulate a prediction-only KMeans model whose centroids are scalar quantized to int8.
+ * Each centroid value c of variable j is stored as the code round((c - offsets[j]) / scale), in [-127, 127],
+ * so the centroids take k * num_variables bytes rather than eight times as many.
+ * The scale is shared by every variable, so squared distances between codes are proportional to squared distances between the values they decode to.
+ * Each centroid's terms entry caches the int8 distance kernel's per-point term, from prepare_points_i8.
+ * Predictions rank every centroid by the integer distance between the codes and the quantized data point,
+ * then re-rank the num_candidates nearest exactly, measuring the unquantized data point against the decoded centroids.
+ * The num_threads field sets how many threads a batch prediction uses, where a non-positive value uses every online CPU,
+ * unless context is set, in which case batch predictions run on its shared pool.
+ */
+typedef struct {
+    int8_t* codes;
+    int32_t* terms;
+    double* offsets;
+    double scale;
+    int k;
+    int num_variables;
+    int num_candidates;
+    int num_threads;
+    CMLContext* context;
+} KMeansQ8;
+
+/*
+ * Define a typed struct holding the scratch buffers of a single thread's quantized predictions, sized for a model's k, num_variables and num_candidates.
+ * The query holds the data point's codes, distances its integer distance to every centroid,
+ * and candidates the indices of the nearest centroids found so far, ordered by their integer distances.
+ * A scratch is owned by its caller and reused across predictions, so serving a point allocates nothing; each thread needs its own.
+ */
+typedef struct {
+    int8_t* query;
+    int32_t* distances;
+    int* candidates;
+    int32_t* candidate_distances;
+    int k;
+    int num_variables;
+    int num_candidates;
+} KMeansQ8Scratch;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Creates a new int8 quantized copy of a KMeans model's centroids for serving, re-ranking num_candidates centroids per prediction.
+ * A non-positive num_candidates uses a default of eight.
+ * Returns a pointer to a new KMeansQ8 on success and NULL on failure.
+ */
+KMeansQ8* quantize_k_means(const KMeans* km, int num_candidates);
+
+/*
+ * Creates the scratch buffers for single-point predictions with a quantized KMeans model, or any model no larger than it.
+ * Returns a pointer to a new KMeansQ8Scratch on success and NULL on failure.
+ */
+KMeansQ8Scratch* create_k_means_q8_scratch(const KMeansQ8* qkm);
+
+/*
+ * Predicts the cluster of a given data point with a quantized KMeans model, using the caller's scratch buffers.
+ * Returns the predicted cluster number, or -1 on failure.
+ */
+int predict_k_means_q8(const KMeansQ8* qkm, const double* x, KMeansQ8Scratch* scratch);
+
+/*
+ * Predicts the cluster of each row of a matrix of data points with a quantized KMeans model.
+ * Writes the predicted cluster number of each row into the labels array.
+ */
+void predict_k_means_batch_q8(const KMeansQ8* qkm, const CMLMatrix* X, int* labels);
+
+/*
+ * Frees the dynamically allocated memory used by a quantized KMeans model.
+ */
+void free_k_means_q8(KMeansQ8* qkm);
+
+/*
+ * Frees the dynamically allocated memory used by the scratch buffers of quantized predictions.
+ */
+void free_k_means_q8_scratch(KMeansQ8Scratch* scratch);
+
+#endif /* For QUANTIZED_MODELS_H */
@@ -0,0 +1,84 @@
+#include "rng.h"
+
+
+/*
+ * Helper function to rotate a 64-bit value left by a given number of bits.
+ */
+static inline uint64_t rotate_left(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+
+/*
+ * Seeds a generator, expanding the 64-bit seed into the full state with SplitMix64.
+ * The same seed always produces the same sequence.
+ *
+ * SplitMix64 never produces four zero words in a row, so the generator cannot be seeded into its all-zero fixed point.
+ */
+void seed_rng(CMLRandom* rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        rng->state[i] = z ^ (z >> 31);
+    }
+}
+
+
+/*
+ * Advances a generator.
+ * Returns the next 64 uniformly distributed random bits.
+ *
+ * Implements the xoshiro256** scrambler and linear engine by Blackman and Vigna.
+ */
+uint64_t rng_next(CMLRandom* rng) {
+    uint64_t* s = rng->state;
+    uint64_t result = rotate_left(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotate_left(s[3], 45);
+
+    return result;
+}
+
+
+/*
+ * Advances a generator.
+ * Returns a uniformly distributed double in [0, 1).
+ *
+ * Uses the top 53 bits of the next output, so every representable multiple of 2^-53 is equally likely.
+ */
+double rng_uniform(CMLRandom* rng) {
+    return (double) (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+
+/*
+ * Advances a generator.
+ * Returns a uniformly distributed integer in [0, bound), without modulo bias, or 0 if the bound is 0.
+ *
+ * Uses Lemire's multiply-and-reject method, which rarely needs more than one draw.
+ */
+uint64_t rng_below(CMLRandom* rng, uint64_t bound) {
+    if (bound == 0) return 0;
+
+    __uint128_t product = (__uint128_t) rng_next(rng) * bound;
+    uint64_t low = (uint64_t) product;
+
+    if (low < bound) {
+        uint64_t threshold = -bound % bound;
+
+        while (low < threshold) {
+            product = (__uint128_t) rng_next(rng) * bound;
+            low = (uint64_t) product;
+        }
+    }
+
+    return (uint64_t) (product >> 64);
+}
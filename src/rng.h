@@ -0,0 +1,40 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*
+ * Define a typed struct to encapsulate the state of a xoshiro256** pseudo-random number generator.
+ * Each generator is independent, so generators owned by different models or threads never interfere.
+ */
+typedef struct {
+    uint64_t state[4];
+} CMLRandom;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Seeds a generator, expanding the 64-bit seed into the full state with SplitMix64.
+ * The same seed always produces the same sequence.
+ */
+void seed_rng(CMLRandom* rng, uint64_t seed);
+
+/*
+ * Advances a generator.
+ * Returns the next 64 uniformly distributed random bits.
+ */
+uint64_t rng_next(CMLRandom* rng);
+
+/*
+ * Advances a generator.
+ * Returns a uniformly distributed double in [0, 1).
+ */
+double rng_uniform(CMLRandom* rng);
+
+/*
+ * Advances a generator.
+ * Returns a uniformly distributed integer in [0, bound), without modulo bias, or 0 if the bound is 0.
+ */
+uint64_t rng_below(CMLRandom* rng, uint64_t bound);
+
+#endif /* For RNG_H */
@@ -0,0 +1,225 @@
+#include "workspace.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * The number of bytes each task faults in when a new block is touched by several threads.
+ */
+#define WORKSPACE_TOUCH_CHUNK ((size_t) 256 << 10)
+
+
+/*
+ * Helper function to round a size up to the workspace alignment.
+ */
+static inline size_t align_up(size_t bytes) {
+    return (bytes + CML_WORKSPACE_ALIGNMENT - 1) & ~((size_t) CML_WORKSPACE_ALIGNMENT - 1);
+}
+
+
+/*
+ * Faults in a single chunk of a new block by zeroing it.
+ * Runs as a parallel_for task, so it only writes to its own chunk.
+ */
+static void touch_chunk(void* arg, int chunk) {
+    CMLWorkspaceBlock* block = (CMLWorkspaceBlock*) arg;
+    size_t start = (size_t) chunk * WORKSPACE_TOUCH_CHUNK;
+    size_t end = start + WORKSPACE_TOUCH_CHUNK < block->capacity ? start + WORKSPACE_TOUCH_CHUNK : block->capacity;
+
+    memset(block->data + start, 0, end - start);
+}
+
+
+/*
+ * Helper function to free a block and its data.
+ */
+static void free_block(CMLWorkspaceBlock* block) {
+    if (block == NULL) return;
+
+    free(block->data);
+    free(block);
+}
+
+
+/*
+ * Helper function to push a new block of at least the given capacity onto a workspace.
+ * Returns EXIT_SUCCESS on success, and EXIT_FAILURE otherwise.
+ *
+ * The spare block is reused if it is large enough, and otherwise a new block is allocated.
+ * A new block's data is aligned to CML_WORKSPACE_ALIGNMENT and faulted in up front across the workspace's threads.
+ * Paying for the page faults here keeps them out of the loops that later use the memory.
+ */
+static int push_block(CMLWorkspace* workspace, size_t capacity) {
+    capacity = align_up(capacity > 0 ? capacity : 1);
+
+    if (workspace->spare != NULL && workspace->spare->capacity >= capacity) {
+        CMLWorkspaceBlock* spare = workspace->spare;
+
+        workspace->spare = NULL;
+        spare->previous = workspace->head;
+        spare->used = 0;
+        workspace->head = spare;
+
+        return EXIT_SUCCESS;
+    }
+
+    CMLWorkspaceBlock* block = (CMLWorkspaceBlock*) malloc(sizeof(CMLWorkspaceBlock));
+
+    if (block == NULL || (block->data = (unsigned char*) aligned_alloc(CML_WORKSPACE_ALIGNMENT, capacity)) == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for workspace\n");
+        free(block);
+
+        return EXIT_FAILURE;
+    }
+
+    block->previous = workspace->head;
+    block->capacity = capacity;
+    block->used = 0;
+
+    int num_chunks = (int) ((capacity + WORKSPACE_TOUCH_CHUNK - 1) / WORKSPACE_TOUCH_CHUNK);
+    parallel_for(num_chunks, resolve_num_threads(workspace->num_threads), touch_chunk, block);
+
+    workspace->head = block;
+    workspace->num_block_allocations++;
+
+    return EXIT_SUCCESS;
+}
+
+
+/*
+ * Helper function to pop the current block of a workspace, keeping the larger of it and the spare block as the new spare.
+ */
+static void pop_block(CMLWorkspace* workspace) {
+    CMLWorkspaceBlock* block = workspace->head;
+
+    workspace->head = block->previous;
+
+    if (workspace->spare == NULL || block->capacity > workspace->spare->capacity) {
+        free_block(workspace->spare);
+        workspace->spare = block;
+    } else {
+        free_block(block);
+    }
+}
+
+
+/*
+ * Creates a new CMLWorkspace with an initial capacity (in bytes), whose blocks are faulted in by num_threads threads.
+ * Returns a pointer to a new CMLWorkspace on success and NULL on failure.
+ *
+ * A zero capacity defers allocating the first block until the first buffer is requested.
+ * A non-positive num_threads faults blocks in with every online CPU.
+ */
+CMLWorkspace* create_workspace(size_t capacity, int num_threads) {
+    CMLWorkspace* workspace = (CMLWorkspace*) calloc(1, sizeof(CMLWorkspace));
+
+    if (workspace == NULL) {
+        fprintf(stderr, "Error: Failed to allocate sufficient memory for workspace\n");
+        return NULL;
+    }
+
+    workspace->num_threads = num_threads;
+
+    if (capacity > 0 && push_block(workspace, capacity) != EXIT_SUCCESS) {
+        free(workspace);
+        return NULL;
+    }
+
+    return workspace;
+}
+
+
+/*
+ * Allocates a cache-line aligned, uninitialised buffer of the given size from a workspace, growing it if needed.
+ * Returns a pointer to the buffer on success and NULL on failure.
+ *
+ * Buffers are carved from the current block by bumping its usage, so an allocation that fits costs a few instructions.
+ * Otherwise a new block is pushed, at least doubling the capacity, and earlier buffers stay valid in the blocks beneath it.
+ */
+void* workspace_alloc(CMLWorkspace* workspace, size_t bytes) {
+    if (workspace == NULL) {
+        fprintf(stderr, "Error: Null pointer passed to workspace_alloc\n");
+        return NULL;
+    }
+
+    size_t size = align_up(bytes > 0 ? bytes : 1);
+    CMLWorkspaceBlock* block = workspace->head;
+
+    if (block == NULL || block->capacity - block->used < size) {
+        size_t capacity = block != NULL ? 2 * block->capacity : 0;
+
+        if (capacity < size) capacity = size;
+        if (push_block(workspace, capacity) != EXIT_SUCCESS) return NULL;
+
+        block = workspace->head;
+    }
+
+    void* buffer = block->data + block->used;
+
+    block->used += size;
+    workspace->in_use += size;
+
+    if (workspace->in_use > workspace->peak) workspace->peak = workspace->in_use;
+
+    return buffer;
+}
+
+
+/*
+ * Records the workspace's current allocation level, to later release everything allocated after it.
+ * Returns the mark to pass to workspace_release.
+ */
+size_t workspace_mark(const CMLWorkspace* workspace) {
+    return workspace != NULL ? workspace->in_use : 0;
+}
+
+
+/*
+ * Releases every buffer allocated from the workspace since the given mark was taken.
+ *
+ * Blocks emptied by the release are popped, unless they are the workspace's only block, with the largest kept as the spare.
+ * Once the workspace is empty and its only block is smaller than the peak usage, its blocks are replaced by a single one of peak bytes.
+ * The next workload of the same shape then fits in a single block, and allocates nothing from the heap.
+ */
+void workspace_release(CMLWorkspace* workspace, size_t mark) {
+    if (workspace == NULL || mark >= workspace->in_use) return;
+
+    while (workspace->head->previous != NULL && workspace->in_use - workspace->head->used >= mark) {
+        workspace->in_use -= workspace->head->used;
+        pop_block(workspace);
+    }
+
+    workspace->head->used -= workspace->in_use - mark;
+    workspace->in_use = mark;
+
+    if (mark == 0 && workspace->head->capacity < workspace->peak) {
+        free_block(workspace->head);
+        free_block(workspace->spare);
+        workspace->head = NULL;
+        workspace->spare = NULL;
+
+        // If the merged block cannot be allocated, the next allocation simply grows the workspace again.
+        push_block(workspace, workspace->peak);
+    }
+}
+
+
+/*
+ * Frees the dynamically allocated memory used by a CMLWorkspace, invalidating every buffer allocated from it.
+ *
+ * Ensures that the workspace is non-null and frees each of its blocks and its spare block, followed by the workspace itself.
+ */
+void free_workspace(CMLWorkspace* workspace) {
+    if (workspace == NULL) return;
+
+    while (workspace->head != NULL) {
+        CMLWorkspaceBlock* previous = workspace->head->previous;
+
+        free_block(workspace->head);
+        workspace->head = previous;
+    }
+
+    free_block(workspace->spare);
+    free(workspace);
+}
@@ -0,0 +1,69 @@
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <stddef.h>
+
+/*
+ * The alignment (in bytes) of every allocation from a workspace, matching a cache line so that buffers written by different threads never share one.
+ */
+#define CML_WORKSPACE_ALIGNMENT 64
+
+/*
+ * Define a typed struct describing a single block of memory owned by a workspace.
+ * Blocks form a stack, each pointing at the block that was current before it.
+ */
+typedef struct CMLWorkspaceBlock {
+    struct CMLWorkspaceBlock* previous;
+    unsigned char* data;
+    size_t capacity;
+    size_t used;
+} CMLWorkspaceBlock;
+
+/*
+ * Define a typed struct to encapsulate a workspace, an arena that scratch buffers are carved from and released back to in stack order.
+ * The in_use field counts the bytes currently allocated (including alignment padding), and peak the most that have ever been allocated at once.
+ * A block emptied by a release is kept as the spare, and reused by the next block pushed if it is large enough.
+ * Whenever the workspace is emptied, its blocks are merged into a single block of peak bytes, so a repeated workload stops touching the heap.
+ * New blocks are faulted in by num_threads threads, so under a first-touch NUMA policy their pages are spread across the threads that use them.
+ * The num_block_allocations field counts every block taken from the heap, which makes allocator traffic observable.
+ */
+typedef struct {
+    CMLWorkspaceBlock* head;
+    CMLWorkspaceBlock* spare;
+    size_t in_use;
+    size_t peak;
+    int num_threads;
+    long long num_block_allocations;
+} CMLWorkspace;
+
+/* FUNCTION PROTOTYPES */
+
+/*
+ * Creates a new CMLWorkspace with an initial capacity (in bytes), whose blocks are faulted in by num_threads threads.
+ * Returns a pointer to a new CMLWorkspace on success and NULL on failure.
+ */
+CMLWorkspace* create_workspace(size_t capacity, int num_threads);
+
+/*
+ * Allocates a cache-line aligned, uninitialised buffer of the given size from a workspace, growing it if needed.
+ * Returns a pointer to the buffer on success and NULL on failure.
+ */
+void* workspace_alloc(CMLWorkspace* workspace, size_t bytes);
+
+/*
+ * Records the workspace's current allocation level, to later release everything allocated after it.
+ * Returns the mark to pass to workspace_release.
+ */
+size_t workspace_mark(const CMLWorkspace* workspace);
+
+/*
+ * Releases every buffer allocated from the workspace since the given mark was taken.
+ */
+void workspace_release(CMLWorkspace* workspace, size_t mark);
+
+/*
+ * Frees the dynamically allocated memory used by a CMLWorkspace, invalidating every buffer allocated from it.
+ */
+void free_workspace(CMLWorkspace* workspace);
+
+#endif /* For WORKSPACE_H */
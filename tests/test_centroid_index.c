@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "assert.h"
+#include "centroid_index.h"
+#include "distance.h"
+#include "rng.h"
+
+/*
+ * The number of indexed points to use during tests.
+ */
+#define NUM_POINTS 4096
+
+/*
+ * The number of queries to make in each test.
+ */
+#define NUM_QUERIES 500
+
+/*
+ * The largest dimensionality used during tests.
+ */
+#define MAX_DIMENSIONS 32
+
+/*
+ * The points and queries to use during tests, drawn from clustered random data.
+ */
+static double* points;
+static double* queries;
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Helper function to fill a buffer with rows scattered around a handful of random blob centers.
+ */
+static void fill_clustered(double* data, int num_rows, int dimensions, CMLRandom* rng) {
+    for (int i = 0; i < num_rows; i++) {
+        int blob = (int) rng_below(rng, 16);
+
+        for (int j = 0; j < dimensions; j++) {
+            data[(size_t) i * dimensions + j] = (double) ((blob * 7 + j * 3) % 11) + rng_uniform(rng) - 0.5;
+        }
+    }
+}
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    CMLRandom rng;
+
+    seed_rng(&rng, 42);
+    points = (double*) malloc((size_t) NUM_POINTS * MAX_DIMENSIONS * sizeof(double));
+    queries = (double*) malloc((size_t) NUM_QUERIES * MAX_DIMENSIONS * sizeof(double));
+    total_count++;
+
+    if (points != NULL && queries != NULL) {
+        fill_clustered(points, NUM_POINTS, MAX_DIMENSIONS, &rng);
+        fill_clustered(queries, NUM_QUERIES, MAX_DIMENSIONS, &rng);
+    }
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+    free(points);
+    free(queries);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/*
+ * Helper function to count how many queries an index answers with the same point as a linear scan, reading the shared buffers as rows of the given dimensionality.
+ * Returns the number of matching queries, or -1 if a matching query reported a different distance.
+ */
+static int count_exact_answers(const CMLCentroidIndex* index, int dimensions) {
+    int matches = 0;
+
+    for (int q = 0; q < NUM_QUERIES; q++) {
+        const double* x = queries + (size_t) q * dimensions;
+        double expected_distance, distance;
+        int expected = nearest_point(x, points, NUM_POINTS, dimensions, &expected_distance);
+        int found = centroid_index_nearest(index, x, &distance);
+
+        if (found != expected) continue;
+        if (distance != squared_distance(x, points + (size_t) expected * dimensions, dimensions)) return -1;
+
+        matches++;
+    }
+
+    return matches;
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that a k-d tree over low-dimensional points answers every query exactly as a linear scan does.
+ */
+int kd_tree_matches_linear_scan() {
+    CMLCentroidIndex* index = create_centroid_index(points, NUM_POINTS, 3, CENTROID_INDEX_KD_TREE, 0, 1);
+
+    assert(index != NULL);
+
+    int matches = count_exact_answers(index, 3);
+
+    free_centroid_index(index);
+
+    assert(matches == NUM_QUERIES);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that an IVF index with its default probing answers every high-dimensional query exactly as a linear scan does.
+ */
+int ivf_exact_search_matches_linear_scan() {
+    CMLCentroidIndex* index = create_centroid_index(points, NUM_POINTS, MAX_DIMENSIONS, CENTROID_INDEX_IVF, 0, 2);
+
+    assert(index != NULL);
+    assert(index->num_lists == 64 && index->num_probes == 0);
+    assert(index->list_starts[0] == 0 && index->list_starts[index->num_lists] == NUM_POINTS);
+
+    int matches = count_exact_answers(index, MAX_DIMENSIONS);
+
+    free_centroid_index(index);
+
+    assert(matches == NUM_QUERIES);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that limiting an IVF index's probes trades recall for fewer lists, with recall never falling as the probes grow.
+ */
+int ivf_recall_grows_with_probes() {
+    CMLCentroidIndex* index = create_centroid_index(points, NUM_POINTS, MAX_DIMENSIONS, CENTROID_INDEX_IVF, 64, 1);
+
+    assert(index != NULL);
+
+    index->num_probes = 1;
+    int one_probe = count_exact_answers(index, MAX_DIMENSIONS);
+
+    index->num_probes = 8;
+    int eight_probes = count_exact_answers(index, MAX_DIMENSIONS);
+
+    index->num_probes = 64;
+    int every_probe = count_exact_answers(index, MAX_DIMENSIONS);
+
+    free_centroid_index(index);
+
+    assert(one_probe > 0 && eight_probes >= one_probe);
+    assert(every_probe == NUM_QUERIES);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that an index cannot be created over no points or from a null buffer.
+ */
+int create_centroid_index_rejects_invalid_arguments() {
+    assert(create_centroid_index(NULL, NUM_POINTS, 3, CENTROID_INDEX_KD_TREE, 0, 1) == NULL);
+    assert(create_centroid_index(points, 0, 3, CENTROID_INDEX_IVF, 0, 1) == NULL);
+    assert(create_centroid_index(points, NUM_POINTS, 0, CENTROID_INDEX_KD_TREE, 0, 1) == NULL);
+
+    free_centroid_index(NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined centroid index tests.
+ */
+int main() {
+    printf("Running Centroid Index tests...\n");
+
+    // Run the tests
+    run_test(kd_tree_matches_linear_scan);
+    run_test(ivf_exact_search_matches_linear_scan);
+    run_test(ivf_recall_grows_with_probes);
+    run_test(create_centroid_index_rejects_invalid_arguments);
+
+    printf("----------------\n");
+    printf("Centroid Index Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "assert.h"
+#include "csv.h"
+#include "rng.h"
+
+/*
+ * The number of rows of the larger files written during tests.
+ */
+#define NUM_ROWS 5000
+
+/*
+ * The path of the CSV file written during tests.
+ */
+static char path[64];
+
+/*
+ * The reader to use during tests.
+ */
+static CMLCsvReader* reader;
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    snprintf(path, sizeof(path), "/tmp/cml_test_csv_%d.csv", (int) getpid());
+    reader = create_csv_reader();
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+    free_csv_reader(reader);
+    remove(path);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/*
+ * Helper function to write a string to the test file.
+ */
+static void write_file(const char* contents) {
+    FILE* file = fopen(path, "wb");
+
+    fputs(contents, file);
+    fclose(file);
+}
+
+/*
+ * Helper function to write NUM_ROWS rows of three random values, printed with enough digits to round-trip, to the test file.
+ */
+static void write_random_file(double* values) {
+    FILE* file = fopen(path, "wb");
+    CMLRandom rng;
+
+    seed_rng(&rng, 7);
+
+    for (int i = 0; i < NUM_ROWS * 3; i++) {
+        values[i] = (rng_uniform(&rng) - 0.5) * pow(10.0, (double) rng_below(&rng, 40) - 20.0);
+        fprintf(file, "%.17g%s", values[i], i % 3 == 2 ? "\n" : ",");
+    }
+
+    fclose(file);
+}
+
+/*
+ * Define a typed struct recording what a streaming callback was handed.
+ */
+typedef struct {
+    int num_chunks;
+    int num_rows;
+    int stop_after;
+    double sum;
+} StreamRecord;
+
+/*
+ * Streaming callback recording the chunks it is handed, stopping once stop_after chunks have arrived.
+ */
+static int record_chunk(const CMLMatrix* chunk, const double* y, void* arg) {
+    StreamRecord* record = (StreamRecord*) arg;
+
+    (void) y;
+    record->num_chunks++;
+    record->num_rows += chunk->num_rows;
+
+    for (int i = 0; i < chunk->num_rows; i++) {
+        for (int j = 0; j < chunk->num_cols; j++) {
+            record->sum += matrix_row(chunk, i)[j] * (record->num_rows - chunk->num_rows + i + 1);
+        }
+    }
+
+    return record->stop_after > 0 && record->num_chunks >= record->stop_after;
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that a file with a header, a target column, blank lines, carriage returns and assorted number formats is read correctly.
+ */
+int read_csv_handles_headers_targets_and_formats() {
+    write_file("a;label;b\r\n1.5;1;-2\r\n\r\n .25 ;0; 1e3\r\n-0;1;1.7976931348623157e308\r\n3;0;nan\n");
+
+    reader->delimiter = ';';
+    reader->has_header = 1;
+    reader->target_column = 1;
+
+    double* y = NULL;
+    CMLMatrix* X = read_csv(reader, path, &y);
+
+    assert(X != NULL && y != NULL);
+    assert(X->num_rows == 4 && X->num_cols == 2);
+    assert(matrix_row(X, 0)[0] == 1.5 && matrix_row(X, 0)[1] == -2.0);
+    assert(matrix_row(X, 1)[0] == 0.25 && matrix_row(X, 1)[1] == 1000.0);
+    assert(matrix_row(X, 2)[0] == 0.0 && signbit(matrix_row(X, 2)[0]));
+    assert(matrix_row(X, 2)[1] == 1.7976931348623157e308);
+    assert(isnan(matrix_row(X, 3)[1]));
+    assert(y[0] == 1.0 && y[1] == 0.0 && y[2] == 1.0 && y[3] == 0.0);
+
+    free(y);
+    free_matrix(X);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the fast parser agrees bit for bit with strtod over values spanning many magnitudes.
+ */
+int read_csv_matches_strtod() {
+    double* values = (double*) malloc(NUM_ROWS * 3 * sizeof(double));
+
+    write_random_file(values);
+    reader->num_threads = 3;
+
+    CMLMatrix* X = read_csv(reader, path, NULL);
+
+    assert(X != NULL);
+    assert(X->num_rows == NUM_ROWS && X->num_cols == 3);
+    assert(memcmp(X->data, values, NUM_ROWS * 3 * sizeof(double)) == 0);
+
+    free_matrix(X);
+    free(values);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that streaming hands over the same rows in the same chunks whatever the thread count, and that a callback can stop it.
+ */
+int stream_csv_chunks_are_independent_of_threads() {
+    double* values = (double*) malloc(NUM_ROWS * 3 * sizeof(double));
+    StreamRecord serial = {0, 0, 0, 0.0};
+    StreamRecord parallel = {0, 0, 0, 0.0};
+    StreamRecord stopped = {0, 0, 2, 0.0};
+
+    write_random_file(values);
+    reader->chunk_rows = 1500;
+
+    assert(stream_csv(reader, path, record_chunk, &serial) == EXIT_SUCCESS);
+
+    reader->num_threads = 4;
+    assert(stream_csv(reader, path, record_chunk, &parallel) == EXIT_SUCCESS);
+    assert(stream_csv(reader, path, record_chunk, &stopped) == EXIT_SUCCESS);
+
+    assert(serial.num_chunks == 4 && serial.num_rows == NUM_ROWS);
+    assert(parallel.num_chunks == serial.num_chunks && parallel.num_rows == serial.num_rows);
+    assert(parallel.sum == serial.sum);
+    assert(stopped.num_chunks == 2 && stopped.num_rows == 3000);
+
+    free(values);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that rows with a malformed value or the wrong number of fields are rejected.
+ */
+int read_csv_rejects_malformed_rows() {
+    write_file("1,2,3\n4,5x,6\n");
+    assert(read_csv(reader, path, NULL) == NULL);
+
+    write_file("1,2,3\n4,5\n");
+    assert(read_csv(reader, path, NULL) == NULL);
+
+    write_file("1,2,3\n4,5,6,7\n");
+    assert(read_csv(reader, path, NULL) == NULL);
+
+    write_file("");
+    assert(read_csv(reader, path, NULL) == NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined CSV tests.
+ */
+int main() {
+    printf("Running CSV tests...\n");
+
+    // Run the tests
+    run_test(read_csv_handles_headers_targets_and_formats);
+    run_test(read_csv_matches_strtod);
+    run_test(stream_csv_chunks_are_independent_of_threads);
+    run_test(read_csv_rejects_malformed_rows);
+
+    printf("----------------\n");
+    printf("CSV Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
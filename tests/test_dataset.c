@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "assert.h"
+#include "dataset.h"
+#include "k_means.h"
+
+/*
+ * The path of the dataset file written during tests.
+ */
+static char path[64];
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    snprintf(path, sizeof(path), "/tmp/cml_test_dataset_%d.cmld", (int) getpid());
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+    remove(path);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that a double-precision dataset with targets round-trips through a mapped file, skipping the source's stride padding.
+ */
+int dataset_round_trips_with_targets() {
+    double data[3][4] = {
+        {1.0, 2.0, 3.0, -1.0},
+        {4.0, 5.0, 6.0, -1.0},
+        {7.0, 8.0, 9.0, -1.0}
+    };
+    double y[3] = {0.5, 1.5, 2.5};
+    CMLMatrix X = matrix_view(&data[0][0], 3, 3, 4);
+
+    assert(write_dataset(path, &X, y) == EXIT_SUCCESS);
+
+    CMLDataset* dataset = open_dataset(path);
+
+    assert(dataset != NULL);
+    assert(dataset->dtype == CML_DTYPE_FLOAT64);
+    assert(dataset->X.num_rows == 3 && dataset->X.num_cols == 3 && dataset->X.stride == 3);
+    assert((size_t) dataset->X.data % 64 == 0);
+    assert(dataset->y != NULL && dataset->X_f.data == NULL);
+
+    for (int i = 0; i < 3; i++) {
+        assert(memcmp(matrix_row(&dataset->X, i), data[i], 3 * sizeof(double)) == 0);
+        assert(dataset->y[i] == y[i]);
+    }
+
+    free_dataset(dataset);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a single-precision dataset without targets round-trips, and that its view is mapped read-only.
+ */
+int dataset_round_trips_single_precision_without_targets() {
+    float data[2][2] = {{1.0f, 2.0f}, {3.0f, 4.0f}};
+    CMLMatrixF X = matrix_view_f(&data[0][0], 2, 2, 2);
+
+    assert(write_dataset_f(path, &X, NULL) == EXIT_SUCCESS);
+
+    CMLDataset* dataset = open_dataset(path);
+
+    assert(dataset != NULL);
+    assert(dataset->dtype == CML_DTYPE_FLOAT32);
+    assert(dataset->y_f == NULL && dataset->X.data == NULL);
+    assert(memcmp(dataset->X_f.data, data, sizeof(data)) == 0);
+
+    // Writing through the view must fault, so try it in a child process, which only exits cleanly if the write went through.
+    pid_t child = fork();
+
+    if (child == 0) {
+        dataset->X_f.data[0] = 100.0f;
+        _exit(0);
+    }
+
+    int status = 0;
+
+    assert(child > 0 && waitpid(child, &status, 0) == child);
+    assert(!WIFEXITED(status) || WEXITSTATUS(status) != 0);
+    assert(dataset->X_f.data[0] == 1.0f);
+    free_dataset(dataset);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a mapped dataset can be fitted directly, giving the same centroids as the in-memory matrix.
+ */
+int mapped_dataset_fits_like_memory() {
+    CMLMatrix* X = create_matrix(2000, 2);
+
+    for (int i = 0; i < X->num_rows; i++) {
+        matrix_row(X, i)[0] = (i % 2) * 10.0 + sin(i);
+        matrix_row(X, i)[1] = cos(i * 3.0);
+    }
+
+    assert(write_dataset(path, X, NULL) == EXIT_SUCCESS);
+
+    CMLDataset* dataset = open_dataset(path);
+    KMeans* memory = create_k_means_seeded(2, 2, 5, 1);
+    KMeans* mapped = create_k_means_seeded(2, 2, 5, 1);
+
+    assert(dataset != NULL);
+    fit_k_means(memory, X, 10, NULL);
+    fit_k_means(mapped, &dataset->X, 10, NULL);
+    assert(memcmp(memory->centroids, mapped->centroids, 4 * sizeof(double)) == 0);
+
+    free_k_means(memory);
+    free_k_means(mapped);
+    free_dataset(dataset);
+    free_matrix(X);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that rewriting a dataset with fewer rows leaves a dataset mapped from the old file readable to its last row.
+ */
+int rewriting_dataset_keeps_open_mappings_intact() {
+    CMLMatrix* X = create_matrix(4096, 4);
+
+    for (int i = 0; i < X->num_rows; i++) {
+        for (int j = 0; j < X->num_cols; j++) {
+            matrix_row(X, i)[j] = i * 4.0 + j;
+        }
+    }
+
+    assert(write_dataset(path, X, NULL) == EXIT_SUCCESS);
+
+    CMLDataset* before = open_dataset(path);
+    CMLMatrix first_row = matrix_slice(X, 0, 1);
+
+    assert(before != NULL);
+    assert(write_dataset(path, &first_row, NULL) == EXIT_SUCCESS);
+
+    CMLDataset* after = open_dataset(path);
+
+    assert(after != NULL && after->X.num_rows == 1);
+    assert(memcmp(matrix_row(&before->X, 4095), matrix_row(X, 4095), 4 * sizeof(double)) == 0);
+
+    free_dataset(before);
+    free_dataset(after);
+    free_matrix(X);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that opening a file which is not a dataset, or which is truncated, fails.
+ */
+int open_dataset_rejects_invalid_files() {
+    FILE* file = fopen(path, "wb");
+
+    assert(file != NULL);
+    fputs("definitely not a dataset, but long enough to hold a full header of sixty-four bytes", file);
+    fclose(file);
+    assert(open_dataset(path) == NULL);
+
+    double data[2] = {1.0, 2.0};
+    CMLMatrix X = matrix_view(data, 1, 2, 2);
+
+    assert(write_dataset(path, &X, data) == EXIT_SUCCESS);
+    assert(truncate(path, 70) == 0);
+    assert(open_dataset(path) == NULL);
+    assert(open_dataset("/nonexistent/dataset.cmld") == NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Helper function to overwrite a single 64-bit header field of the dataset file at path.
+ * Returns a non-zero value if the field was written.
+ */
+static int patch_header(long offset, uint64_t value) {
+    FILE* file = fopen(path, "r+b");
+    int written = file != NULL && fseek(file, offset, SEEK_SET) == 0 && fwrite(&value, sizeof(value), 1, file) == 1;
+
+    if (file != NULL) written = fclose(file) == 0 && written;
+
+    return written;
+}
+
+/*
+ * Checks that headers whose offsets or sizes would wrap around 64 bits, or run past the file, are rejected rather than mapped.
+ * The header holds num_rows at byte 24, num_cols at 32, data_offset at 40 and target_offset at 48.
+ */
+int open_dataset_rejects_out_of_range_headers() {
+    double data[8] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0};
+    double y[1] = {1.0};
+    CMLMatrix X = matrix_view(data, 1, 8, 8);
+    uint64_t wrapping_offset = UINT64_MAX - 63;
+
+    assert(write_dataset(path, &X, y) == EXIT_SUCCESS);
+    assert(patch_header(40, wrapping_offset));
+    assert(open_dataset(path) == NULL);
+
+    assert(write_dataset(path, &X, y) == EXIT_SUCCESS);
+    assert(patch_header(48, wrapping_offset));
+    assert(open_dataset(path) == NULL);
+
+    assert(write_dataset(path, &X, y) == EXIT_SUCCESS);
+    assert(patch_header(24, 0x7fffffff) && patch_header(32, 0x40000001));
+    assert(open_dataset(path) == NULL);
+
+    assert(write_dataset(path, &X, y) == EXIT_SUCCESS);
+
+    CMLDataset* dataset = open_dataset(path);
+
+    assert(dataset != NULL);
+    free_dataset(dataset);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined dataset tests.
+ */
+int main() {
+    printf("Running Dataset tests...\n");
+
+    // Run the tests
+    run_test(dataset_round_trips_with_targets);
+    run_test(dataset_round_trips_single_precision_without_targets);
+    run_test(mapped_dataset_fits_like_memory);
+    run_test(rewriting_dataset_keeps_open_mappings_intact);
+    run_test(open_dataset_rejects_invalid_files);
+    run_test(open_dataset_rejects_out_of_range_headers);
+
+    printf("----------------\n");
+    printf("Dataset Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "assert.h"
+#include "distance.h"
+
+/*
+ * The largest dimensionality to compare kernels over, covering every vector width and tail length.
+ */
+#define MAX_DIMENSIONS 37
+
+/*
+ * The number of points to search over in nearest point tests.
+ */
+#define NUM_POINTS 9
+
+/*
+ * The kernel that was automatically selected when the library was loaded.
+ */
+static CMLDistanceKernel default_kernel;
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Tolerance for floating-point number comparison.
+ */
+#define EPSILON 1e-9
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test, restoring the automatically selected kernel.
+ */
+void teardown() {
+    select_distance_kernel(default_kernel);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/*
+ * Helper function to compute a reference squared distance in plain C.
+ */
+static double reference_squared_distance(const double* a, const double* b, int dimensions) {
+    double sum = 0.0;
+
+    for (int i = 0; i < dimensions; i++) {
+        sum += (a[i] - b[i]) * (a[i] - b[i]);
+    }
+
+    return sum;
+}
+
+/*
+ * Helper function to check every dimensionality up to MAX_DIMENSIONS against the reference with the active kernel.
+ * Returns a non-zero value when every dimensionality matches.
+ */
+static int active_kernel_matches_reference() {
+    double a[MAX_DIMENSIONS];
+    double b[MAX_DIMENSIONS];
+
+    for (int i = 0; i < MAX_DIMENSIONS; i++) {
+        a[i] = sin(i + 1.0) * 3.0;
+        b[i] = cos(i * 0.5) - 1.0;
+    }
+
+    for (int d = 0; d <= MAX_DIMENSIONS; d++) {
+        double expected = reference_squared_distance(a, b, d);
+
+        if (fabs(squared_distance(a, b, d) - expected) > EPSILON * (1.0 + expected)) return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Helper function to check the four-way dot product of the active kernel against plain C for every dimensionality.
+ * Returns a non-zero value when every dimensionality matches.
+ */
+static int active_dot_product_matches_reference() {
+    double x[MAX_DIMENSIONS];
+    double p[4][MAX_DIMENSIONS];
+
+    for (int i = 0; i < MAX_DIMENSIONS; i++) {
+        x[i] = sin(i + 1.0) * 3.0;
+
+        for (int q = 0; q < 4; q++) {
+            p[q][i] = cos(i * 0.5 + q) - 1.0;
+        }
+    }
+
+    for (int d = 0; d <= MAX_DIMENSIONS; d++) {
+        double out[4];
+
+        dot_product_4(x, p[0], p[1], p[2], p[3], d, out);
+
+        for (int q = 0; q < 4; q++) {
+            double expected = 0.0;
+
+            for (int i = 0; i < d; i++) {
+                expected += x[i] * p[q][i];
+            }
+
+            if (fabs(out[q] - expected) > EPSILON * (1.0 + fabs(expected))) return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Helper function to check the int8 distances of the active kernel against plain C for every dimensionality, including extreme values.
+ * Returns a non-zero value when every dimensionality matches.
+ */
+static int active_i8_distances_match_reference() {
+    int8_t x[MAX_DIMENSIONS];
+    int8_t points[NUM_POINTS * MAX_DIMENSIONS];
+    int32_t distances[NUM_POINTS];
+    int32_t terms[NUM_POINTS];
+
+    for (int i = 0; i < MAX_DIMENSIONS; i++) {
+        x[i] = (int8_t) (i % 2 == 0 ? -128 : (i * 37) % 256 - 128);
+    }
+
+    for (int d = 0; d <= MAX_DIMENSIONS; d++) {
+        for (int p = 0; p < NUM_POINTS; p++) {
+            for (int i = 0; i < d; i++) {
+                points[p * d + i] = (int8_t) (p == 0 ? 127 : (p * 53 + i * 11) % 256 - 128);
+            }
+        }
+
+        prepare_points_i8(points, NUM_POINTS, d, terms);
+        squared_distances_i8(x, points, terms, NUM_POINTS, d, distances);
+
+        for (int p = 0; p < NUM_POINTS; p++) {
+            int32_t expected = 0;
+
+            for (int i = 0; i < d; i++) {
+                expected += (x[i] - points[p * d + i]) * (x[i] - points[p * d + i]);
+            }
+
+            if (distances[p] != expected) return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that the automatically selected kernel is a concrete kernel.
+ */
+int auto_kernel_is_concrete() {
+    assert(default_kernel != DISTANCE_KERNEL_AUTO);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the scalar kernel is always available and matches the reference.
+ */
+int scalar_kernel_matches_reference() {
+    assert(select_distance_kernel(DISTANCE_KERNEL_SCALAR) == EXIT_SUCCESS);
+    assert(active_distance_kernel() == DISTANCE_KERNEL_SCALAR);
+    assert(active_kernel_matches_reference());
+    assert(active_dot_product_matches_reference());
+    assert(active_i8_distances_match_reference());
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that every vectorised kernel supported by this CPU matches the reference for all tail lengths.
+ */
+int vectorised_kernels_match_reference() {
+    CMLDistanceKernel kernels[] = {DISTANCE_KERNEL_SSE2, DISTANCE_KERNEL_AVX2, DISTANCE_KERNEL_AVX512};
+
+    for (int i = 0; i < 3; i++) {
+        if (select_distance_kernel(kernels[i]) != EXIT_SUCCESS) continue;
+
+        assert(active_distance_kernel() == kernels[i]);
+        assert(active_kernel_matches_reference());
+        assert(active_dot_product_matches_reference());
+        assert(active_i8_distances_match_reference());
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the nearest point search returns the closest point and its squared distance, preferring the lowest index on ties.
+ */
+int nearest_point_finds_first_minimum() {
+    double points[NUM_POINTS][3];
+
+    for (int i = 0; i < NUM_POINTS; i++) {
+        points[i][0] = i;
+        points[i][1] = -i;
+        points[i][2] = 0.5 * i;
+    }
+
+    // Duplicate the closest point at a later index to create a tie.
+    double x[3] = {4.1, -4.1, 2.0};
+    points[7][0] = 4.0;
+    points[7][1] = -4.0;
+    points[7][2] = 2.0;
+
+    double min_distance = 0.0;
+    int index = nearest_point(x, &points[0][0], NUM_POINTS, 3, &min_distance);
+
+    assert(index == 4);
+    assert(fabs(min_distance - 0.02) < EPSILON);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the blocked search agrees with nearest_point across several row and point tiles, including partial groups of points.
+ */
+int nearest_points_blocked_matches_nearest_point() {
+    int num_rows = 150;
+    int num_points = 1030;
+    int dimensions = 5;
+    double* rows = (double*) malloc((size_t) num_rows * dimensions * sizeof(double));
+    double* points = (double*) malloc((size_t) num_points * dimensions * sizeof(double));
+    double* norms = (double*) malloc(num_points * sizeof(double));
+    double* distances = (double*) malloc(num_rows * sizeof(double));
+    int* labels = (int*) malloc(num_rows * sizeof(int));
+
+    for (int i = 0; i < num_points; i++) {
+        norms[i] = 0.0;
+
+        for (int j = 0; j < dimensions; j++) {
+            points[i * dimensions + j] = i * 10.0 + j;
+            norms[i] += points[i * dimensions + j] * points[i * dimensions + j];
+        }
+    }
+
+    // Place each row just off a distinct point, so that the nearest point is never close to a tie.
+    for (int i = 0; i < num_rows; i++) {
+        for (int j = 0; j < dimensions; j++) {
+            rows[i * dimensions + j] = points[(i * 7 % num_points) * dimensions + j] + 0.25;
+        }
+    }
+
+    nearest_points_blocked(rows, dimensions, num_rows, points, norms, num_points, dimensions, labels, distances);
+
+    for (int i = 0; i < num_rows; i++) {
+        double expected_distance = 0.0;
+        int expected = nearest_point(rows + i * dimensions, points, num_points, dimensions, &expected_distance);
+
+        assert(labels[i] == expected);
+        assert(fabs(distances[i] - expected_distance) < 1e-6);
+    }
+
+    free(rows);
+    free(points);
+    free(norms);
+    free(distances);
+    free(labels);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined distance tests.
+ */
+int main() {
+    printf("Running Distance tests...\n");
+
+    default_kernel = active_distance_kernel();
+
+    // Run the tests
+    run_test(auto_kernel_is_concrete);
+    run_test(scalar_kernel_matches_reference);
+    run_test(vectorised_kernels_match_reference);
+    run_test(nearest_point_finds_first_minimum);
+    run_test(nearest_points_blocked_matches_nearest_point);
+
+    printf("----------------\n");
+    printf("Distance Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "assert.h"
+#include "distance.h"
+#include "float_models.h"
+#include "linear_regression.h"
+
+/*
+ * The number of clusters to fit during tests.
+ */
+#define NUM_CLUSTERS 8
+
+/*
+ * The number of variables of every sample during tests.
+ */
+#define NUM_VARIABLES 3
+
+/*
+ * The number of samples to fit during tests.
+ */
+#define NUM_SAMPLES 12000
+
+/*
+ * The seed to use during tests.
+ */
+#define DEFAULT_SEED 42
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/*
+ * Helper function to fill a double-precision matrix and a single-precision copy with well separated clusters of samples.
+ */
+static void fill_blobs(CMLMatrix* X, CMLMatrixF* Xf) {
+    for (int i = 0; i < X->num_rows; i++) {
+        for (int j = 0; j < X->num_cols; j++) {
+            matrix_row(X, i)[j] = (float) (((i >> j) & 1) * 8.0 + sin(i * 12.9898 + j * 78.233));
+            matrix_row_f(Xf, i)[j] = (float) matrix_row(X, i)[j];
+        }
+    }
+}
+
+/*
+ * Helper function to fit a double-precision model from the same starting centroids as a single-precision one.
+ * Returns the largest absolute difference between the two models' fitted centroids.
+ */
+static double double_fit_difference(const float* start, const float* fitted, const CMLMatrix* X) {
+    KMeans* reference = create_k_means_seeded(NUM_CLUSTERS, NUM_VARIABLES, 10, DEFAULT_SEED);
+    double difference = 0.0;
+
+    for (int i = 0; i < NUM_CLUSTERS * NUM_VARIABLES; i++) {
+        reference->centroids[i] = start[i];
+    }
+
+    fit_k_means(reference, X, 30, NULL);
+
+    for (int i = 0; i < NUM_CLUSTERS * NUM_VARIABLES; i++) {
+        if (fabs(reference->centroids[i] - fitted[i]) > difference) difference = fabs(reference->centroids[i] - fitted[i]);
+    }
+
+    free_k_means(reference);
+
+    return difference;
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that the single-precision distance matches a reference for every dimensionality up to several vector widths.
+ */
+int squared_distance_f_matches_reference() {
+    float a[37];
+    float b[37];
+
+    for (int i = 0; i < 37; i++) {
+        a[i] = (float) (sin(i + 1.0) * 3.0);
+        b[i] = (float) (cos(i * 0.5) - 1.0);
+    }
+
+    for (int d = 0; d <= 37; d++) {
+        double expected = 0.0;
+
+        for (int i = 0; i < d; i++) {
+            expected += ((double) a[i] - b[i]) * ((double) a[i] - b[i]);
+        }
+
+        assert(fabs(squared_distance_f(a, b, d) - expected) < 1e-4 * (1.0 + expected));
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that single- and mixed-precision k-means fits land on the double-precision centroids, mixed precision more tightly.
+ */
+int float_k_means_match_double_precision() {
+    CMLMatrix* X = create_matrix(NUM_SAMPLES, NUM_VARIABLES);
+    CMLMatrixF* Xf = create_matrix_f(NUM_SAMPLES, NUM_VARIABLES);
+    KMeansF* single = create_k_means_seeded_f(NUM_CLUSTERS, NUM_VARIABLES, 10, DEFAULT_SEED);
+    KMeansMixed* mixed = create_k_means_seeded_mixed(NUM_CLUSTERS, NUM_VARIABLES, 10, DEFAULT_SEED);
+    float start[NUM_CLUSTERS * NUM_VARIABLES];
+
+    fill_blobs(X, Xf);
+    memcpy(start, single->centroids, sizeof(start));
+    memcpy(mixed->centroids, start, sizeof(start));
+
+    assert(fit_k_means_f(single, Xf, 30, NULL) == EXIT_SUCCESS);
+    assert(fit_k_means_mixed(mixed, Xf, 30, NULL) == EXIT_SUCCESS);
+    assert(double_fit_difference(start, single->centroids, X) < 1e-3);
+    assert(double_fit_difference(start, mixed->centroids, X) < 1e-5);
+
+    free_k_means_f(single);
+    free_k_means_mixed(mixed);
+    free_matrix_f(Xf);
+    free_matrix(X);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a mixed-precision fit is identical across thread counts and that batch prediction matches single prediction.
+ */
+int mixed_k_means_is_deterministic_across_thread_counts() {
+    CMLMatrix* X = create_matrix(NUM_SAMPLES, NUM_VARIABLES);
+    CMLMatrixF* Xf = create_matrix_f(NUM_SAMPLES, NUM_VARIABLES);
+    KMeansMixed* serial = create_k_means_seeded_mixed(NUM_CLUSTERS, NUM_VARIABLES, 10, DEFAULT_SEED);
+    KMeansMixed* parallel = create_k_means_seeded_mixed(NUM_CLUSTERS, NUM_VARIABLES, 10, DEFAULT_SEED);
+    KMeansReport* report = create_k_means_report(30);
+    int* labels = (int*) malloc(NUM_SAMPLES * sizeof(int));
+
+    fill_blobs(X, Xf);
+    parallel->num_threads = 3;
+
+    fit_k_means_mixed(serial, Xf, 30, NULL);
+    fit_k_means_mixed(parallel, Xf, 30, report);
+
+    assert(memcmp(serial->centroids, parallel->centroids, NUM_CLUSTERS * NUM_VARIABLES * sizeof(float)) == 0);
+    assert(report->converged);
+
+    predict_k_means_batch_mixed(parallel, Xf, labels);
+
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        assert(labels[i] == predict_k_means_mixed(parallel, matrix_row_f(Xf, i)));
+    }
+
+    free(labels);
+    free_k_means_report(report);
+    free_k_means_mixed(serial);
+    free_k_means_mixed(parallel);
+    free_matrix_f(Xf);
+    free_matrix(X);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that single- and mixed-precision linear regressions train to the same predictions as the double-precision model.
+ */
+int float_linear_regression_matches_double_precision() {
+    float Xf[4][4] = {
+        {1.0f, 2.0f, 3.0f, 4.0f},
+        {2.0f, 3.0f, 4.0f, 5.0f},
+        {3.0f, 4.0f, 5.0f, 6.0f},
+        {4.0f, 5.0f, 6.0f, 7.0f}
+    };
+    double X[4][4];
+    float yf[4] = {10.0f, 14.0f, 18.0f, 22.0f};
+    double y[4] = {10.0, 14.0, 18.0, 22.0};
+    float test_sample[4] = {5.0f, 6.0f, 7.0f, 8.0f};
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            X[i][j] = Xf[i][j];
+        }
+    }
+
+    CMLMatrix samples = matrix_view(&X[0][0], 4, 4, 4);
+    CMLMatrixF samples_f = matrix_view_f(&Xf[0][0], 4, 4, 4);
+    LinearRegression* reference = new_linear_regression(4);
+    LinearRegressionF* single = new_linear_regression_f(4);
+    LinearRegressionMixed* mixed = new_linear_regression_mixed(4);
+    double predictions[4];
+
+    train_linear_regression(reference, &samples, y, 0.01, 1000);
+    train_linear_regression_f(single, &samples_f, yf, 0.01, 1000);
+    train_linear_regression_mixed(mixed, &samples_f, yf, 0.01, 1000);
+
+    assert(fabs(predict_linear_regression_f(single, test_sample) - 26.0) < 1e-3);
+    assert(fabs(predict_linear_regression_mixed(mixed, test_sample) - 26.0) < 1e-6);
+
+    predict_linear_regression_batch_mixed(mixed, &samples_f, predictions);
+
+    for (int i = 0; i < 4; i++) {
+        assert(fabs(predictions[i] - predict_linear_regression(reference, X[i])) < 1e-6);
+    }
+
+    free_linear_regression(reference);
+    free_linear_regression_f(single);
+    free_linear_regression_mixed(mixed);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined single- and mixed-precision model tests.
+ */
+int main() {
+    printf("Running Float Model tests...\n");
+
+    // Run the tests
+    run_test(squared_distance_f_matches_reference);
+    run_test(float_k_means_match_double_precision);
+    run_test(mixed_k_means_is_deterministic_across_thread_counts);
+    run_test(float_linear_regression_matches_double_precision);
+
+    printf("----------------\n");
+    printf("Float Model Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
@@ -2,8 +2,12 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "assert.h"
 #include "k_means.h"
+#include "model_file.h"
 
 /*
  * The default number of clusters to use during tests.
@@ -83,7 +87,7 @@ int create_k_means_is_non_null() {
 int create_k_means_initialises_centroids_to_random_values() {
     for (int i = 0; i < DEFAULT_NUM_CLUSTERS; i++) {
         for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
-            assert(fabs(km->centroids[i][j]) <= DEFAULT_INITIAL_CENTROID_RANGE);
+            assert(fabs(km->centroids[i * DEFAULT_NUM_VARIABLES + j]) <= DEFAULT_INITIAL_CENTROID_RANGE);
         }
     }
 
@@ -123,20 +127,16 @@ int k_means_can_train() {
         {9.0, 11.0}
     };
 
-    double* X_ptr[6];
+    CMLMatrix samples = matrix_view(&X[0][0], 6, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
 
-    for (int i = 0; i < 6; i++) {
-        X_ptr[i] = X[i];
-    }
-
-    fit_k_means(km, X_ptr, 6, 10);
+    fit_k_means(km, &samples, 10, NULL);
 
     // Check that the centroids are updated from the initial zero values.
     for (int i = 0; i < DEFAULT_NUM_CLUSTERS; i++) {
         bool is_updated = false;
 
         for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
-            if (fabs(km->centroids[i][j]) > EPSILON) {
+            if (fabs(km->centroids[i * DEFAULT_NUM_VARIABLES + j]) > EPSILON) {
                 is_updated = true;
             }
         }
@@ -160,13 +160,9 @@ int k_means_can_predict() {
         {9.0, 11.0}
     };
 
-    double* X_ptr[6];
-
-    for (int i = 0; i < 6; i++) {
-        X_ptr[i] = X[i];
-    }
+    CMLMatrix samples = matrix_view(&X[0][0], 6, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
 
-    fit_k_means(km, X_ptr, 6, 10);
+    fit_k_means(km, &samples, 10, NULL);
 
     double test_sample[DEFAULT_NUM_VARIABLES] = {0.0, 0.0};
     int cluster = predict_k_means(km, test_sample);
@@ -177,6 +173,1225 @@ int k_means_can_predict() {
     return TEST_SUCCESS;
 }
 
+/*
+ * Checks that batch prediction labels every row exactly as single-row prediction does.
+ */
+int k_means_batch_prediction_matches_single_prediction() {
+    double X[6][DEFAULT_NUM_VARIABLES] = {
+        {1.0, 2.0},
+        {1.5, 1.8},
+        {5.0, 8.0},
+        {8.0, 8.0},
+        {1.0, 0.6},
+        {9.0, 11.0}
+    };
+
+    CMLMatrix samples = matrix_view(&X[0][0], 6, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
+    int labels[6];
+
+    fit_k_means(km, &samples, 10, NULL);
+    predict_k_means_batch(km, &samples, labels);
+
+    for (int i = 0; i < 6; i++) {
+        assert(labels[i] == predict_k_means(km, X[i]));
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that fitting rejects a sample matrix whose width does not match the model, leaving the centroids untouched.
+ */
+int k_means_fit_rejects_mismatched_columns() {
+    double X[2][3] = {
+        {1.0, 2.0, 3.0},
+        {4.0, 5.0, 6.0}
+    };
+
+    double before = km->centroids[0];
+    CMLMatrix samples = matrix_view(&X[0][0], 2, 3, 3);
+
+    fit_k_means(km, &samples, 10, NULL);
+    assert(km->centroids[0] == before);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Helper function to fill a matrix with noisy points scattered around the corners of a square.
+ */
+static void fill_blobs(CMLMatrix* X) {
+    for (int i = 0; i < X->num_rows; i++) {
+        double* x = matrix_row(X, i);
+
+        for (int j = 0; j < X->num_cols; j++) {
+            x[j] = ((i >> j) & 1) * 8.0 + sin(i * 12.9898 + j * 78.233);
+        }
+    }
+}
+
+/*
+ * Checks that a multithreaded fit over several partitions produces exactly the same centroids as a single-threaded fit.
+ */
+int k_means_fit_is_deterministic_across_thread_counts() {
+    CMLMatrix* X = create_matrix(20000, DEFAULT_NUM_VARIABLES);
+    KMeans* parallel = create_k_means(DEFAULT_NUM_CLUSTERS, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+
+    assert(X != NULL && parallel != NULL);
+
+    fill_blobs(X);
+    memcpy(parallel->centroids, km->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double));
+    parallel->num_threads = 4;
+
+    fit_k_means(km, X, 10, NULL);
+    fit_k_means(parallel, X, 10, NULL);
+
+    int identical = memcmp(parallel->centroids, km->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0;
+
+    free_k_means(parallel);
+    free_matrix(X);
+    assert(identical);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Helper function to fit a copy of a reference model with a given algorithm and thread count.
+ * Returns a non-zero value if the fitted centroids are bit-identical to those of a single-threaded Lloyd fit.
+ */
+static int algorithm_matches_lloyd(KMeansAlgorithm algorithm, int num_threads) {
+    int k = 8;
+    CMLMatrix* X = create_matrix(12000, DEFAULT_NUM_VARIABLES);
+    KMeans* lloyd = create_k_means(k, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+    KMeans* accelerated = create_k_means(k, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+
+    fill_blobs(X);
+    memcpy(accelerated->centroids, lloyd->centroids, k * DEFAULT_NUM_VARIABLES * sizeof(double));
+    accelerated->algorithm = algorithm;
+    accelerated->num_threads = num_threads;
+
+    fit_k_means(lloyd, X, 20, NULL);
+    fit_k_means(accelerated, X, 20, NULL);
+
+    int identical = memcmp(lloyd->centroids, accelerated->centroids, k * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0;
+
+    free_k_means(lloyd);
+    free_k_means(accelerated);
+    free_matrix(X);
+
+    return identical;
+}
+
+/*
+ * Checks that blocked batch prediction over many rows and threads agrees with single-row prediction on clustered data.
+ */
+int k_means_blocked_batch_prediction_matches_single_prediction() {
+    CMLMatrix* X = create_matrix(5000, 3);
+    KMeans* blobs = create_k_means_seeded(8, 3, 10, 7);
+    int* labels = (int*) malloc(X->num_rows * sizeof(int));
+
+    fill_blobs(X);
+    blobs->num_threads = 3;
+    fit_k_means(blobs, X, 20, NULL);
+    predict_k_means_batch(blobs, X, labels);
+
+    for (int i = 0; i < X->num_rows; i++) {
+        assert(labels[i] == predict_k_means(blobs, matrix_row(X, i)));
+    }
+
+    free(labels);
+    free_k_means(blobs);
+    free_matrix(X);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that Elkan's algorithm produces exactly the same centroids as Lloyd's, on one and several threads.
+ */
+int k_means_elkan_matches_lloyd() {
+    assert(algorithm_matches_lloyd(KMEANS_ELKAN, 1));
+    assert(algorithm_matches_lloyd(KMEANS_ELKAN, 3));
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that Hamerly's algorithm produces exactly the same centroids as Lloyd's, on one and several threads.
+ */
+int k_means_hamerly_matches_lloyd() {
+    assert(algorithm_matches_lloyd(KMEANS_HAMERLY, 1));
+    assert(algorithm_matches_lloyd(KMEANS_HAMERLY, 3));
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that with a single cluster, pushing batches through partial_fit keeps the centroid at the running mean of every sample seen.
+ */
+int k_means_partial_fit_tracks_running_mean() {
+    double first[3][DEFAULT_NUM_VARIABLES] = {{1.0, 2.0}, {3.0, 4.0}, {5.0, 0.0}};
+    double second[2][DEFAULT_NUM_VARIABLES] = {{-2.0, 6.0}, {8.0, 3.0}};
+    KMeans* single = create_k_means(1, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+
+    CMLMatrix batch = matrix_view(&first[0][0], 3, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
+    partial_fit_k_means(single, &batch);
+
+    batch = matrix_view(&second[0][0], 2, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
+    partial_fit_k_means(single, &batch);
+
+    double x = single->centroids[0];
+    double y = single->centroids[1];
+    long long count = single->cluster_counts[0];
+
+    free_k_means(single);
+
+    assert(count == 5);
+    assert(fabs(x - 3.0) < EPSILON);
+    assert(fabs(y - 3.0) < EPSILON);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that mini-batch fitting with one cluster converges towards the mean of the samples.
+ */
+int k_means_mini_batch_converges_to_mean() {
+    CMLMatrix* X = create_matrix(4000, DEFAULT_NUM_VARIABLES);
+    KMeans* single = create_k_means(1, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+
+    fill_blobs(X);
+    fit_k_means_mini_batch(single, X, 256, 40);
+
+    // The blobs sit on the corners of a square of side 8, so their mean is close to (4, 4).
+    double x = single->centroids[0];
+    double y = single->centroids[1];
+
+    free_k_means(single);
+    free_matrix(X);
+
+    assert(fabs(x - 4.0) < 0.5);
+    assert(fabs(y - 4.0) < 0.5);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that two models created with the same seed draw the same initial centroids.
+ */
+int k_means_seeded_creation_is_reproducible() {
+    KMeans* first = create_k_means_seeded(DEFAULT_NUM_CLUSTERS, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 7);
+    KMeans* second = create_k_means_seeded(DEFAULT_NUM_CLUSTERS, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 7);
+
+    int identical = memcmp(first->centroids, second->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0;
+
+    free_k_means(first);
+    free_k_means(second);
+    assert(identical);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that k-means++ seeds every centroid at a distinct data point, placing one in each well separated blob.
+ */
+int k_means_plus_plus_seeds_from_data() {
+    double X[8][DEFAULT_NUM_VARIABLES] = {
+        {0.0, 0.0}, {0.1, 0.0},
+        {50.0, 0.0}, {50.0, 0.1},
+        {0.0, 50.0}, {0.1, 50.0},
+        {50.0, 50.0}, {50.1, 50.0}
+    };
+    KMeans* seeded = create_k_means_seeded(4, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 11);
+    CMLMatrix samples = matrix_view(&X[0][0], 8, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
+    int blobs_seen[4] = {0};
+
+    seeded->init = KMEANS_INIT_PLUS_PLUS;
+    int status = init_k_means(seeded, &samples);
+
+    for (int c = 0; c < 4; c++) {
+        double* centroid = seeded->centroids + c * DEFAULT_NUM_VARIABLES;
+        blobs_seen[(centroid[0] > 25.0) + 2 * (centroid[1] > 25.0)]++;
+    }
+
+    int is_initialised = seeded->is_initialised;
+    free_k_means(seeded);
+
+    assert(status == EXIT_SUCCESS && is_initialised);
+
+    for (int b = 0; b < 4; b++) {
+        assert(blobs_seen[b] == 1);
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a fit seeded with k-means|| is reproducible for a fixed seed, whatever the thread count.
+ */
+int k_means_parallel_init_is_reproducible_across_threads() {
+    int k = 6;
+    CMLMatrix* X = create_matrix(5000, DEFAULT_NUM_VARIABLES);
+    KMeans* serial = create_k_means_seeded(k, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 99);
+    KMeans* threaded = create_k_means_seeded(k, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 99);
+
+    fill_blobs(X);
+    serial->init = KMEANS_INIT_PARALLEL;
+    threaded->init = KMEANS_INIT_PARALLEL;
+    threaded->num_threads = 4;
+
+    fit_k_means(serial, X, 5, NULL);
+    fit_k_means(threaded, X, 5, NULL);
+
+    int identical = memcmp(serial->centroids, threaded->centroids, k * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0;
+
+    free_k_means(serial);
+    free_k_means(threaded);
+    free_matrix(X);
+    assert(identical);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that models sharing an execution context seed, fit and label data exactly as a single-threaded model does.
+ */
+int k_means_fits_sharing_a_context_match_serial_fit() {
+    int k = 6;
+    CMLContext* context = create_context(3, CML_PLACEMENT_CORES);
+    CMLMatrix* X = create_matrix(20000, DEFAULT_NUM_VARIABLES);
+    KMeans* serial = create_k_means_seeded(k, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 99);
+    KMeans* pooled[2] = {create_k_means_seeded(k, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 99),
+                         create_k_means_seeded(k, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 99)};
+    int* labels = (int*) malloc(20000 * sizeof(int));
+    int* pooled_labels = (int*) malloc(20000 * sizeof(int));
+
+    assert(context != NULL && X != NULL && serial != NULL && pooled[0] != NULL && pooled[1] != NULL && labels != NULL && pooled_labels != NULL);
+
+    fill_blobs(X);
+    serial->init = KMEANS_INIT_PARALLEL;
+    pooled[1]->algorithm = KMEANS_ELKAN;
+
+    fit_k_means(serial, X, 10, NULL);
+    predict_k_means_batch(serial, X, labels);
+
+    int identical = 1;
+
+    for (int m = 0; m < 2; m++) {
+        pooled[m]->init = KMEANS_INIT_PARALLEL;
+        pooled[m]->context = context;
+
+        fit_k_means(pooled[m], X, 10, NULL);
+        predict_k_means_batch(pooled[m], X, pooled_labels);
+
+        identical = identical && memcmp(serial->centroids, pooled[m]->centroids, k * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0
+                    && memcmp(labels, pooled_labels, 20000 * sizeof(int)) == 0;
+    }
+
+    free(pooled_labels);
+    free(labels);
+    free_k_means(pooled[1]);
+    free_k_means(pooled[0]);
+    free_k_means(serial);
+    free_matrix(X);
+    free_context(context);
+    assert(identical);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a fit on well separated data stops early once no label changes, and reports its outcome.
+ */
+int k_means_fit_stops_when_labels_settle() {
+    double X[6][DEFAULT_NUM_VARIABLES] = {
+        {0.0, 0.0}, {0.0, 1.0},
+        {10.0, 10.0}, {10.0, 11.0},
+        {-10.0, 10.0}, {-10.0, 11.0}
+    };
+    double initial[DEFAULT_NUM_CLUSTERS][DEFAULT_NUM_VARIABLES] = {{1.0, 0.0}, {9.0, 9.0}, {-9.0, 9.0}};
+    CMLMatrix samples = matrix_view(&X[0][0], 6, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
+    KMeansReport* report = create_k_means_report(50);
+
+    memcpy(km->centroids, initial, sizeof(initial));
+    int status = fit_k_means(km, &samples, 50, report);
+
+    // The first iteration finds the clusters and the second confirms that no label changed.
+    int iterations = report->num_iterations;
+    int converged = report->converged;
+    double inertia = report->inertia;
+    double first_time = report->iteration_times[0];
+
+    free_k_means_report(report);
+
+    assert(status == EXIT_SUCCESS);
+    assert(iterations == 2 && converged);
+    assert(fabs(inertia - 1.5) < EPSILON);
+    assert(first_time >= 0.0);
+    assert(fabs(km->centroids[0] - 0.0) < EPSILON && fabs(km->centroids[1] - 0.5) < EPSILON);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a loose centroid shift tolerance stops a fit before its labels settle.
+ */
+int k_means_fit_stops_on_shift_tolerance() {
+    CMLMatrix* X = create_matrix(4000, DEFAULT_NUM_VARIABLES);
+    KMeansReport* report = create_k_means_report(100);
+
+    fill_blobs(X);
+    km->shift_tolerance = 1e3;
+    fit_k_means(km, X, 100, report);
+
+    int iterations = report->num_iterations;
+    int converged = report->converged;
+
+    free_k_means_report(report);
+    free_matrix(X);
+
+    assert(iterations == 1 && converged);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Define a typed struct recording the statistics a KMeans fit's callback receives.
+ */
+typedef struct {
+    int calls;
+    int stop_after;
+    KMeansIterationStats last;
+    long long first_changes;
+    long long skipped;
+} IterationLog;
+
+/*
+ * Callback that logs each iteration, asking the fit to stop once stop_after iterations have run.
+ */
+static int log_iteration(const KMeansIterationStats* stats, void* arg) {
+    IterationLog* log = (IterationLog*) arg;
+
+    if (log->calls == 0) log->first_changes = stats->labels_changed;
+
+    log->skipped += stats->distances_skipped;
+    log->last = *stats;
+    log->calls++;
+
+    return log->stop_after > 0 && log->calls >= log->stop_after;
+}
+
+/*
+ * Checks that an inertia tolerance stops a fit while labels are still changing, in fewer iterations than an exact fit.
+ * The samples are scattered evenly over a square, so an exact fit takes many iterations of shrinking improvements.
+ */
+int k_means_fit_stops_on_inertia_tolerance() {
+    int k = 8;
+    CMLMatrix* X = create_matrix(4000, DEFAULT_NUM_VARIABLES);
+    KMeans* tolerant = create_k_means_seeded(k, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 5);
+    KMeans* exact = create_k_means_seeded(k, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 5);
+    KMeansReport* tolerant_report = create_k_means_report(100);
+    KMeansReport* exact_report = create_k_means_report(100);
+    IterationLog log = {0};
+
+    assert(X != NULL && tolerant != NULL && exact != NULL && tolerant_report != NULL && exact_report != NULL);
+
+    for (int i = 0; i < X->num_rows; i++) {
+        for (int j = 0; j < X->num_cols; j++) {
+            double hash = sin(i * 12.9898 + j * 78.233) * 43758.5453;
+
+            matrix_row(X, i)[j] = 10.0 * (hash - floor(hash));
+        }
+    }
+
+    tolerant->inertia_tolerance = 0.01;
+    tolerant->callback = log_iteration;
+    tolerant->callback_arg = &log;
+    fit_k_means(tolerant, X, 100, tolerant_report);
+    fit_k_means(exact, X, 100, exact_report);
+
+    int tolerant_iterations = tolerant_report->num_iterations;
+    int exact_iterations = exact_report->num_iterations;
+    int converged = tolerant_report->converged && exact_report->converged;
+
+    free_k_means_report(tolerant_report);
+    free_k_means_report(exact_report);
+    free_k_means(tolerant);
+    free_k_means(exact);
+    free_matrix(X);
+
+    assert(converged);
+    assert(log.calls == tolerant_iterations && log.last.labels_changed > 0);
+    assert(tolerant_iterations < exact_iterations);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the callback sees every Lloyd iteration with full distance counts and exact inertia, and can stop the fit early.
+ */
+int k_means_callback_reports_and_stops_fit() {
+    CMLMatrix* X = create_matrix(2000, DEFAULT_NUM_VARIABLES);
+    KMeansReport* report = create_k_means_report(10);
+    IterationLog log = {0};
+
+    assert(X != NULL && report != NULL);
+
+    fill_blobs(X);
+    log.stop_after = 2;
+    km->callback = log_iteration;
+    km->callback_arg = &log;
+    km->perf_counters = 1;
+
+    fit_k_means(km, X, 10, report);
+
+    int stopped = report->stopped;
+    int iterations = report->num_iterations;
+    double inertia = report->inertia;
+
+    free_k_means_report(report);
+    free_matrix(X);
+
+    assert(stopped && iterations == 2 && log.calls == 2);
+    assert(log.first_changes == 2000);
+    assert(log.last.iteration == 1);
+    assert(log.last.distance_computations == 2000LL * DEFAULT_NUM_CLUSTERS && log.last.distances_skipped == 0);
+    assert(log.last.inertia == inertia);
+    assert(log.last.assignment_seconds >= 0.0 && log.last.update_seconds >= 0.0);
+    assert(log.last.assignment_counters.cycles >= -1 && log.last.update_counters.instructions >= -1);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a fit on a context reports every hardware counter as unavailable, since its pooled workers cannot be counted.
+ */
+int k_means_callback_skips_counters_on_a_context() {
+    CMLMatrix* X = create_matrix(2000, DEFAULT_NUM_VARIABLES);
+    CMLContext* context = create_context(2, CML_PLACEMENT_ANY);
+    IterationLog log = {0};
+
+    assert(X != NULL && context != NULL);
+
+    fill_blobs(X);
+    km->callback = log_iteration;
+    km->callback_arg = &log;
+    km->perf_counters = 1;
+    km->context = context;
+
+    int result = fit_k_means(km, X, 3, NULL);
+
+    km->context = NULL;
+    free_context(context);
+    free_matrix(X);
+
+    assert(result == EXIT_SUCCESS && log.calls > 0);
+    assert(log.last.assignment_counters.cycles == -1 && log.last.assignment_counters.instructions == -1);
+    assert(log.last.assignment_counters.cache_misses == -1 && log.last.assignment_counters.branch_misses == -1);
+    assert(log.last.update_counters.cycles == -1 && log.last.update_counters.branch_misses == -1);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the callback sees Elkan's pruning as skipped distance computations without changing the fitted centroids.
+ */
+int k_means_callback_counts_pruned_distances() {
+    int k = 8;
+    CMLMatrix* X = create_matrix(4000, DEFAULT_NUM_VARIABLES);
+    KMeans* plain = create_k_means_seeded(k, DEFAULT_NUM_VARIABLES, 1.0, 7);
+    KMeans* observed = create_k_means_seeded(k, DEFAULT_NUM_VARIABLES, 1.0, 7);
+    IterationLog log = {0};
+
+    assert(X != NULL && plain != NULL && observed != NULL);
+
+    fill_blobs(X);
+    plain->algorithm = KMEANS_ELKAN;
+    observed->algorithm = KMEANS_ELKAN;
+    observed->callback = log_iteration;
+    observed->callback_arg = &log;
+
+    fit_k_means(plain, X, 30, NULL);
+    fit_k_means(observed, X, 30, NULL);
+
+    int identical = memcmp(plain->centroids, observed->centroids, (size_t) k * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0;
+
+    free_k_means(plain);
+    free_k_means(observed);
+    free_matrix(X);
+
+    assert(identical);
+    assert(log.calls > 1 && log.skipped > 0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that once a fit has sized the model's workspace, later fits and mini-batch updates allocate no more scratch memory.
+ */
+int k_means_refits_reuse_workspace() {
+    CMLMatrix* X = create_matrix(5000, DEFAULT_NUM_VARIABLES);
+
+    assert(X != NULL);
+
+    fill_blobs(X);
+    km->algorithm = KMEANS_ELKAN;
+    fit_k_means(km, X, 5, NULL);
+
+    assert(km->workspace != NULL && km->workspace->in_use == 0);
+
+    long long allocations = km->workspace->num_block_allocations;
+
+    for (int i = 0; i < 3; i++) {
+        km->algorithm = i == 1 ? KMEANS_LLOYD : KMEANS_ELKAN;
+        fit_k_means(km, X, 5, NULL);
+    }
+
+    fit_k_means_mini_batch(km, X, 256, 10);
+
+    int reused = km->workspace->num_block_allocations == allocations && km->workspace->in_use == 0;
+
+    free_matrix(X);
+    assert(reused);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Helper function to flip every bit of the byte at a given offset of a file.
+ * Returns a non-zero value if the byte was flipped.
+ */
+static int corrupt_byte(const char* path, long offset) {
+    FILE* file = fopen(path, "r+b");
+
+    if (file == NULL) return 0;
+
+    fseek(file, offset, SEEK_SET);
+
+    int byte = fgetc(file);
+
+    fseek(file, offset, SEEK_SET);
+    fputc(byte ^ 0xFF, file);
+
+    return fclose(file) == 0;
+}
+
+/*
+ * Checks that a saved model loads with identical centroids and settings, predicts alike, and can be refitted without altering its file.
+ */
+int k_means_save_and_load_round_trips() {
+    char path[64];
+    CMLMatrix* X = create_matrix(400, DEFAULT_NUM_VARIABLES);
+    int* labels = (int*) malloc(400 * sizeof(int));
+    int* loaded_labels = (int*) malloc(400 * sizeof(int));
+
+    assert(X != NULL && labels != NULL && loaded_labels != NULL);
+
+    snprintf(path, sizeof(path), "/tmp/cml_test_k_means_%d.cmlm", (int) getpid());
+    fill_blobs(X);
+    km->algorithm = KMEANS_HAMERLY;
+    km->shift_tolerance = 1e-3;
+    fit_k_means(km, X, 20, NULL);
+
+    assert(save_k_means(km, path) == EXIT_SUCCESS);
+
+    KMeans* loaded = load_k_means(path, 1);
+
+    assert(loaded != NULL);
+    assert(loaded->k == km->k && loaded->num_variables == km->num_variables);
+    assert(loaded->algorithm == KMEANS_HAMERLY && loaded->shift_tolerance == 1e-3);
+    assert(memcmp(loaded->centroids, km->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0);
+
+    predict_k_means_batch(km, X, labels);
+    predict_k_means_batch(loaded, X, loaded_labels);
+    assert(memcmp(labels, loaded_labels, 400 * sizeof(int)) == 0);
+
+    // Refitting the loaded model on other data must only touch its private copy of the centroids.
+    for (int i = 0; i < X->num_rows; i++) matrix_row(X, i)[0] += 100.0;
+
+    fit_k_means(loaded, X, 5, NULL);
+    free_k_means(loaded);
+
+    loaded = load_k_means(path, 1);
+
+    assert(loaded != NULL);
+    assert(memcmp(loaded->centroids, km->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0);
+
+    free_k_means(loaded);
+    free(loaded_labels);
+    free(labels);
+    free_matrix(X);
+    remove(path);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that loading rejects missing files and corrupt headers, and corrupt centroids whenever the payload is verified.
+ */
+int k_means_load_rejects_corrupt_files() {
+    char path[64];
+
+    snprintf(path, sizeof(path), "/tmp/cml_test_k_means_%d.cmlm", (int) getpid());
+
+    assert(load_k_means("/nonexistent/model.cmlm", 0) == NULL);
+    assert(save_k_means(km, path) == EXIT_SUCCESS);
+
+    // A flipped byte in the header's dimensions is caught by the header checksum.
+    assert(corrupt_byte(path, 24));
+    assert(load_k_means(path, 0) == NULL);
+    assert(corrupt_byte(path, 24));
+
+    // A flipped byte in the centroids is only caught when the payload is verified.
+    assert(corrupt_byte(path, 130));
+
+    KMeans* unverified = load_k_means(path, 0);
+
+    assert(unverified != NULL);
+    assert(load_k_means(path, 1) == NULL);
+
+    free_k_means(unverified);
+    remove(path);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Helper function to overwrite a 64-bit field of a model file's header at a given offset, recomputing the header checksum to match.
+ * Returns a non-zero value if the header was rewritten.
+ */
+static int forge_header_field(const char* path, long offset, uint64_t value) {
+    unsigned char header[128];
+    long checksum_offset = 64 + 8 * CML_MODEL_FILE_PARAMETERS;
+    FILE* file = fopen(path, "r+b");
+
+    if (file == NULL) return 0;
+
+    int forged = fread(header, sizeof(header), 1, file) == 1;
+
+    if (forged) {
+        memcpy(header + offset, &value, sizeof(value));
+
+        uint64_t checksum = checksum_bytes(header, (size_t) checksum_offset);
+
+        memcpy(header + checksum_offset, &checksum, sizeof(checksum));
+        forged = fseek(file, 0, SEEK_SET) == 0 && fwrite(header, sizeof(header), 1, file) == 1;
+    }
+
+    return fclose(file) == 0 && forged;
+}
+
+/*
+ * Checks that headers with valid checksums but a wrapping payload offset, or no centroids, are rejected.
+ * The header holds num_rows at byte 24, payload_offset at 40 and payload_bytes at 48.
+ */
+int k_means_load_rejects_forged_headers() {
+    char path[64];
+    KMeans* wide = create_k_means(10, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+
+    assert(wide != NULL);
+    snprintf(path, sizeof(path), "/tmp/cml_test_k_means_%d.cmlm", (int) getpid());
+
+    // The payload's 160 bytes would wrap an offset of 2^64 - 64 back into the file.
+    assert(save_k_means(wide, path) == EXIT_SUCCESS);
+    assert(forge_header_field(path, 40, UINT64_MAX - 63));
+    assert(load_k_means(path, 0) == NULL);
+
+    assert(save_k_means(wide, path) == EXIT_SUCCESS);
+    assert(forge_header_field(path, 24, 0) && forge_header_field(path, 48, 0));
+    assert(load_k_means(path, 0) == NULL);
+
+    assert(save_k_means(wide, path) == EXIT_SUCCESS);
+
+    KMeans* loaded = load_k_means(path, 1);
+
+    assert(loaded != NULL && loaded->k == 10);
+
+    free_k_means(loaded);
+    free_k_means(wide);
+    remove(path);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that headers naming an algorithm or initialisation outside their enumerations are rejected.
+ * The header holds the algorithm at byte 64 and the initialisation at byte 72.
+ */
+int k_means_load_rejects_unknown_settings() {
+    char path[64];
+    KMeans* model = create_k_means(DEFAULT_NUM_CLUSTERS, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+
+    assert(model != NULL);
+    snprintf(path, sizeof(path), "/tmp/cml_test_k_means_%d.cmlm", (int) getpid());
+
+    assert(save_k_means(model, path) == EXIT_SUCCESS);
+    assert(forge_header_field(path, 64, KMEANS_HAMERLY + 1));
+    assert(load_k_means(path, 0) == NULL);
+
+    assert(save_k_means(model, path) == EXIT_SUCCESS);
+    assert(forge_header_field(path, 72, UINT64_MAX));
+    assert(load_k_means(path, 0) == NULL);
+
+    assert(save_k_means(model, path) == EXIT_SUCCESS);
+    assert(forge_header_field(path, 64, KMEANS_HAMERLY) && forge_header_field(path, 72, KMEANS_INIT_PARALLEL));
+
+    KMeans* loaded = load_k_means(path, 1);
+
+    assert(loaded != NULL && loaded->algorithm == KMEANS_HAMERLY && loaded->init == KMEANS_INIT_PARALLEL);
+
+    free_k_means(loaded);
+    free_k_means(model);
+    remove(path);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Define a typed struct describing a matrix served to a streamed fit through a reader, which fails every read from fail_row onwards.
+ */
+typedef struct {
+    const CMLMatrix* X;
+    long long next_row;
+    long long fail_row;
+    int out_of_order;
+} MatrixReader;
+
+/*
+ * Helper function to serve rows of a matrix to a streamed fit, noting any read that neither continues the last one nor restarts a pass.
+ * Returns the number of rows copied, or -1 once the failing row is reached.
+ */
+static int read_matrix_rows(double* buffer, long long first_row, int max_rows, void* arg) {
+    MatrixReader* reader = (MatrixReader*) arg;
+    int rows = reader->X->num_rows - first_row < max_rows ? (int) (reader->X->num_rows - first_row) : max_rows;
+
+    if (first_row != 0 && first_row != reader->next_row) reader->out_of_order = 1;
+    if (first_row + rows > reader->fail_row) return -1;
+
+    for (int i = 0; i < rows; i++) {
+        memcpy(buffer + (size_t) i * reader->X->num_cols, matrix_row(reader->X, (int) first_row + i), reader->X->num_cols * sizeof(double));
+    }
+
+    reader->next_row = first_row + rows;
+
+    return rows;
+}
+
+/*
+ * Helper function to write the rows of a matrix to a raw binary sample file.
+ * Returns a non-zero value if every row was written.
+ */
+static int write_sample_file(const char* path, const CMLMatrix* X) {
+    FILE* file = fopen(path, "wb");
+    int written = 0;
+
+    if (file == NULL) return 0;
+
+    for (int i = 0; i < X->num_rows; i++) {
+        written += fwrite(matrix_row(X, i), sizeof(double), X->num_cols, file) == (size_t) X->num_cols;
+    }
+
+    return fclose(file) == 0 && written == X->num_rows;
+}
+
+/*
+ * Checks that streaming a sample file in chunks converges in the same iterations, and to the same centroids, as an in-memory fit.
+ */
+int k_means_file_fit_matches_in_memory_fit() {
+    char path[64];
+    CMLMatrix* X = create_matrix(20000, DEFAULT_NUM_VARIABLES);
+    KMeans* streamed = create_k_means(DEFAULT_NUM_CLUSTERS, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+    KMeansReport* report = create_k_means_report(0);
+    KMeansReport* streamed_report = create_k_means_report(0);
+
+    assert(X != NULL && streamed != NULL && report != NULL && streamed_report != NULL);
+
+    snprintf(path, sizeof(path), "/tmp/cml_test_k_means_%d.bin", (int) getpid());
+    fill_blobs(X);
+    memcpy(streamed->centroids, km->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double));
+    streamed->num_threads = 2;
+
+    assert(write_sample_file(path, X));
+    assert(fit_k_means(km, X, 50, report) == EXIT_SUCCESS);
+    assert(fit_k_means_file(streamed, path, 3000, 50, streamed_report) == EXIT_SUCCESS);
+
+    assert(report->converged && streamed_report->converged);
+    assert(streamed_report->num_iterations == report->num_iterations);
+    assert(fabs(streamed_report->inertia - report->inertia) <= EPSILON * report->inertia);
+
+    for (int i = 0; i < DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES; i++) {
+        assert(fabs(streamed->centroids[i] - km->centroids[i]) < EPSILON);
+    }
+
+    free_k_means_report(streamed_report);
+    free_k_means_report(report);
+    free_k_means(streamed);
+    free_matrix(X);
+    remove(path);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a streamed fit reads each pass in order, and produces exactly the same centroids whatever its thread count.
+ */
+int k_means_stream_fit_is_deterministic_across_thread_counts() {
+    CMLMatrix* X = create_matrix(20000, DEFAULT_NUM_VARIABLES);
+    KMeans* parallel = create_k_means(DEFAULT_NUM_CLUSTERS, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+
+    assert(X != NULL && parallel != NULL);
+
+    fill_blobs(X);
+    memcpy(parallel->centroids, km->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double));
+    parallel->num_threads = 4;
+
+    MatrixReader reader = {X, 0, X->num_rows, 0};
+    MatrixReader parallel_reader = {X, 0, X->num_rows, 0};
+
+    assert(fit_k_means_stream(km, read_matrix_rows, &reader, 5000, 10, NULL) == EXIT_SUCCESS);
+    assert(fit_k_means_stream(parallel, read_matrix_rows, &parallel_reader, 5000, 10, NULL) == EXIT_SUCCESS);
+
+    int identical = memcmp(parallel->centroids, km->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0;
+
+    free_k_means(parallel);
+    free_matrix(X);
+
+    assert(identical);
+    assert(!reader.out_of_order && !parallel_reader.out_of_order);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a streamed fit rejects missing and truncated sample files, and stops on a failing reader with its centroids intact.
+ */
+int k_means_stream_fit_rejects_bad_sources() {
+    char path[64];
+    double before[DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES];
+    CMLMatrix* X = create_matrix(1000, DEFAULT_NUM_VARIABLES);
+
+    assert(X != NULL);
+
+    snprintf(path, sizeof(path), "/tmp/cml_test_k_means_%d.bin", (int) getpid());
+    fill_blobs(X);
+
+    assert(fit_k_means_file(km, "/nonexistent/samples.bin", 0, 10, NULL) == EXIT_FAILURE);
+    assert(fit_k_means_stream(km, NULL, NULL, 0, 10, NULL) == EXIT_FAILURE);
+
+    // A file whose size is not a whole number of rows is rejected before any fitting.
+    FILE* file = fopen(path, "wb");
+
+    assert(file != NULL);
+    fwrite(matrix_row(X, 0), sizeof(double), 3, file);
+    fclose(file);
+
+    assert(fit_k_means_file(km, path, 0, 10, NULL) == EXIT_FAILURE);
+
+    // A reader failing partway through the first pass leaves the centroids untouched.
+    MatrixReader reader = {X, 0, 700, 0};
+
+    memcpy(before, km->centroids, sizeof(before));
+
+    int status = fit_k_means_stream(km, read_matrix_rows, &reader, 256, 10, NULL);
+
+    free_matrix(X);
+    remove(path);
+
+    assert(status == EXIT_FAILURE);
+    assert(memcmp(before, km->centroids, sizeof(before)) == 0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Helper function to fork a worker process serving a shard of a matrix to the coordinator at the given path, failing every read from fail_row onwards.
+ * Returns the worker's process id, or -1 if it could not be forked.
+ */
+static pid_t fork_shard_worker(const char* path, const CMLMatrix* X, long long fail_row) {
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        MatrixReader reader = {X, 0, fail_row, 0};
+
+        _exit(serve_k_means_shard(path, read_matrix_rows, &reader, 2));
+    }
+
+    return pid;
+}
+
+/*
+ * Helper function to wait for a set of worker processes to exit.
+ * Returns the number of workers that exited successfully.
+ */
+static int wait_for_workers(const pid_t* pids, int num_workers) {
+    int succeeded = 0;
+
+    for (int w = 0; w < num_workers; w++) {
+        int status;
+
+        if (pids[w] > 0 && waitpid(pids[w], &status, 0) == pids[w] && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) succeeded++;
+    }
+
+    return succeeded;
+}
+
+/*
+ * Checks that a fit sharded unevenly across worker processes converges in the same iterations, and to bit-identical centroids, as fit_k_means.
+ */
+int k_means_sharded_fit_matches_single_process_fit() {
+    char path[64];
+    pid_t pids[3];
+    CMLMatrix* X = create_matrix(30000, DEFAULT_NUM_VARIABLES);
+    KMeans* sharded = create_k_means(DEFAULT_NUM_CLUSTERS, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE);
+    KMeansReport* report = create_k_means_report(0);
+    KMeansReport* sharded_report = create_k_means_report(0);
+
+    assert(X != NULL && sharded != NULL && report != NULL && sharded_report != NULL);
+
+    snprintf(path, sizeof(path), "/tmp/cml_test_k_means_%d.sock", (int) getpid());
+    fill_blobs(X);
+    memcpy(sharded->centroids, km->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double));
+
+    for (int w = 0; w < 3; w++) {
+        pids[w] = fork_shard_worker(path, X, X->num_rows);
+    }
+
+    int status = fit_k_means_sharded(sharded, path, 3, X->num_rows, 50, sharded_report);
+    int succeeded = wait_for_workers(pids, 3);
+
+    assert(status == EXIT_SUCCESS && succeeded == 3);
+    assert(fit_k_means(km, X, 50, report) == EXIT_SUCCESS);
+
+    int identical = memcmp(sharded->centroids, km->centroids, DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES * sizeof(double)) == 0;
+    int same_outcome = sharded_report->num_iterations == report->num_iterations && sharded_report->converged == report->converged
+                       && sharded_report->inertia == report->inertia;
+
+    free_k_means_report(sharded_report);
+    free_k_means_report(report);
+    free_k_means(sharded);
+    free_matrix(X);
+
+    assert(identical && same_outcome);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a sharded fit refuses an uninitialised data-seeded model, and fails with its centroids intact when a worker cannot load its shard.
+ */
+int k_means_sharded_fit_fails_on_worker_error() {
+    char path[64];
+    pid_t pids[2];
+    double before[DEFAULT_NUM_CLUSTERS * DEFAULT_NUM_VARIABLES];
+    CMLMatrix* X = create_matrix(10000, DEFAULT_NUM_VARIABLES);
+
+    assert(X != NULL);
+
+    snprintf(path, sizeof(path), "/tmp/cml_test_k_means_%d.sock", (int) getpid());
+    fill_blobs(X);
+
+    assert(fit_k_means_sharded(km, path, 0, X->num_rows, 10, NULL) == EXIT_FAILURE);
+    assert(serve_k_means_shard(path, NULL, NULL, 1) == EXIT_FAILURE);
+
+    km->init = KMEANS_INIT_PLUS_PLUS;
+    assert(fit_k_means_sharded(km, path, 2, X->num_rows, 10, NULL) == EXIT_FAILURE);
+    km->init = KMEANS_INIT_RANGE;
+
+    // Shards go to workers in the order they connect, so both fail reads from row 9000 onwards, which stops whichever gets the last shard loading.
+    memcpy(before, km->centroids, sizeof(before));
+    pids[0] = fork_shard_worker(path, X, 9000);
+    pids[1] = fork_shard_worker(path, X, 9000);
+
+    int status = fit_k_means_sharded(km, path, 2, X->num_rows, 10, NULL);
+    int succeeded = wait_for_workers(pids, 2);
+
+    free_matrix(X);
+
+    assert(status == EXIT_FAILURE && succeeded == 0);
+    assert(memcmp(before, km->centroids, sizeof(before)) == 0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that predictions through either kind of index match a linear scan of the centroids, and that refitting discards the index.
+ */
+int k_means_index_predictions_match_linear_scan() {
+    CMLMatrix* X = create_matrix(5000, DEFAULT_NUM_VARIABLES);
+    KMeans* wide = create_k_means_seeded(1024, DEFAULT_NUM_VARIABLES, DEFAULT_INITIAL_CENTROID_RANGE, 5);
+    int* scanned = (int*) malloc(5000 * sizeof(int));
+    int* indexed = (int*) malloc(5000 * sizeof(int));
+    CMLCentroidIndexType types[2] = {CENTROID_INDEX_KD_TREE, CENTROID_INDEX_IVF};
+    int matches = 1;
+
+    assert(X != NULL && wide != NULL && scanned != NULL && indexed != NULL);
+
+    fill_blobs(X);
+
+    for (int i = 0; i < 5000; i++) {
+        scanned[i] = predict_k_means(wide, matrix_row(X, i));
+    }
+
+    for (int t = 0; t < 2; t++) {
+        if (build_k_means_index(wide, types[t], 0) != EXIT_SUCCESS) matches = 0;
+
+        predict_k_means_batch(wide, X, indexed);
+
+        for (int i = 0; i < 5000; i++) {
+            if (indexed[i] != scanned[i] || predict_k_means(wide, matrix_row(X, i)) != scanned[i]) matches = 0;
+        }
+    }
+
+    int had_index = wide->index != NULL;
+
+    fit_k_means(wide, X, 1, NULL);
+
+    int index_discarded = wide->index == NULL;
+
+    free(indexed);
+    free(scanned);
+    free_k_means(wide);
+    free_matrix(X);
+
+    assert(matches && had_index && index_discarded);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * The number of columns of the sparse documents used by the spherical tests, with a block of 1000 words per topic and one shared word.
+ */
+#define NUM_DOCUMENT_COLUMNS 6000
+
+/*
+ * Helper function to create sparse documents drawn from three topics, where document i uses the words of topic i % 3.
+ * Each document has six of its topic's eight words and one shared word, with the whole document scaled by a length that cosine similarity ignores.
+ * Returns a pointer to a new CMLSparseMatrix on success and NULL on failure.
+ */
+static CMLSparseMatrix* create_topic_documents(int num_documents) {
+    CMLSparseMatrix* S = create_sparse_matrix(num_documents, NUM_DOCUMENT_COLUMNS, (size_t) num_documents * 7);
+
+    if (S == NULL) return NULL;
+
+    for (int i = 0; i < num_documents; i++) {
+        size_t p = (size_t) i * 7;
+        double length = 1.0 + i % 7;
+
+        for (int q = 0; q < 6; q++) {
+            S->col_indices[p + q] = (i % 3) * 1000 + (i * 37 + q * 101) % 8;
+            S->values[p + q] = length * (1.0 + (i * q) % 5);
+        }
+
+        S->col_indices[p + 6] = NUM_DOCUMENT_COLUMNS - 1;
+        S->values[p + 6] = length;
+        S->row_offsets[i + 1] = p + 7;
+    }
+
+    return S;
+}
+
+/*
+ * Checks that spherical k-means separates sparse documents by topic, keeps unit centroids and predicts consistently.
+ */
+int spherical_k_means_clusters_sparse_topics() {
+    CMLSparseMatrix* S = create_topic_documents(300);
+    KMeans* spherical = create_k_means_seeded(DEFAULT_NUM_CLUSTERS, NUM_DOCUMENT_COLUMNS, 1.0, 7);
+    KMeansReport* report = create_k_means_report(20);
+    int labels[300];
+
+    assert(S != NULL && spherical != NULL && report != NULL);
+
+    spherical->init = KMEANS_INIT_PLUS_PLUS;
+    int status = fit_spherical_k_means(spherical, S, 20, report);
+
+    predict_spherical_k_means_batch(spherical, S, labels);
+
+    int consistent = labels[0] != labels[1] && labels[1] != labels[2] && labels[0] != labels[2];
+
+    for (int i = 0; i < 300; i++) {
+        size_t offset = S->row_offsets[i];
+
+        if (labels[i] != labels[i % 3]) consistent = 0;
+        if (predict_spherical_k_means(spherical, S->col_indices + offset, S->values + offset, 7) != labels[i]) consistent = 0;
+    }
+
+    double max_norm_error = 0.0;
+
+    for (int c = 0; c < DEFAULT_NUM_CLUSTERS; c++) {
+        double norm = 0.0;
+
+        for (int j = 0; j < NUM_DOCUMENT_COLUMNS; j++) {
+            norm += spherical->centroids[c * NUM_DOCUMENT_COLUMNS + j] * spherical->centroids[c * NUM_DOCUMENT_COLUMNS + j];
+        }
+
+        max_norm_error = fmax(max_norm_error, fabs(sqrt(norm) - 1.0));
+    }
+
+    int converged = report->converged;
+    double inertia = report->inertia;
+
+    free_k_means_report(report);
+    free_k_means(spherical);
+    free_sparse_matrix(S);
+
+    assert(status == EXIT_SUCCESS && converged);
+    assert(consistent);
+    assert(max_norm_error < EPSILON);
+    assert(inertia > 0.0 && inertia < 300.0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a multithreaded spherical fit over several partitions produces exactly the same centroids as a single-threaded fit.
+ */
+int spherical_k_means_is_deterministic_across_thread_counts() {
+    CMLSparseMatrix* S = create_topic_documents(20000);
+    KMeans* single = create_k_means_seeded(DEFAULT_NUM_CLUSTERS, NUM_DOCUMENT_COLUMNS, 1.0, 3);
+    KMeans* parallel = create_k_means_seeded(DEFAULT_NUM_CLUSTERS, NUM_DOCUMENT_COLUMNS, 1.0, 3);
+
+    assert(S != NULL && single != NULL && parallel != NULL);
+
+    single->init = KMEANS_INIT_PLUS_PLUS;
+    parallel->init = KMEANS_INIT_PLUS_PLUS;
+    parallel->num_threads = 4;
+
+    int status = fit_spherical_k_means(single, S, 10, NULL) | fit_spherical_k_means(parallel, S, 10, NULL);
+    int identical = memcmp(single->centroids, parallel->centroids, DEFAULT_NUM_CLUSTERS * NUM_DOCUMENT_COLUMNS * sizeof(double)) == 0;
+
+    free_k_means(parallel);
+    free_k_means(single);
+    free_sparse_matrix(S);
+
+    assert(status == EXIT_SUCCESS);
+    assert(identical);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that spherical k-means rejects samples with the wrong column count, and samples with no non-zero row to seed from.
+ */
+int spherical_k_means_rejects_invalid_samples() {
+    CMLSparseMatrix* empty = create_sparse_matrix(4, DEFAULT_NUM_VARIABLES, 0);
+    CMLSparseMatrix* wide = create_topic_documents(3);
+
+    assert(empty != NULL && wide != NULL);
+
+    km->init = KMEANS_INIT_PLUS_PLUS;
+
+    int rejects_wide = fit_spherical_k_means(km, wide, 5, NULL) == EXIT_FAILURE;
+    int rejects_empty = fit_spherical_k_means(km, empty, 5, NULL) == EXIT_FAILURE;
+
+    free_sparse_matrix(wide);
+    free_sparse_matrix(empty);
+
+    assert(rejects_wide && rejects_empty);
+    assert(!km->is_initialised);
+
+    return TEST_SUCCESS;
+}
+
 /*
  * Checks that freeing a NULL KMeans model does not cause errors.
  */
@@ -199,6 +1414,38 @@ int main() {
     run_test(create_k_means_fails_on_negative_range);
     run_test(k_means_can_train);
     run_test(k_means_can_predict);
+    run_test(k_means_batch_prediction_matches_single_prediction);
+    run_test(k_means_blocked_batch_prediction_matches_single_prediction);
+    run_test(k_means_fit_rejects_mismatched_columns);
+    run_test(k_means_fit_is_deterministic_across_thread_counts);
+    run_test(k_means_elkan_matches_lloyd);
+    run_test(k_means_hamerly_matches_lloyd);
+    run_test(k_means_partial_fit_tracks_running_mean);
+    run_test(k_means_mini_batch_converges_to_mean);
+    run_test(k_means_seeded_creation_is_reproducible);
+    run_test(k_means_plus_plus_seeds_from_data);
+    run_test(k_means_parallel_init_is_reproducible_across_threads);
+    run_test(k_means_fits_sharing_a_context_match_serial_fit);
+    run_test(k_means_fit_stops_when_labels_settle);
+    run_test(k_means_fit_stops_on_shift_tolerance);
+    run_test(k_means_fit_stops_on_inertia_tolerance);
+    run_test(k_means_callback_reports_and_stops_fit);
+    run_test(k_means_callback_skips_counters_on_a_context);
+    run_test(k_means_callback_counts_pruned_distances);
+    run_test(k_means_refits_reuse_workspace);
+    run_test(k_means_save_and_load_round_trips);
+    run_test(k_means_load_rejects_corrupt_files);
+    run_test(k_means_load_rejects_forged_headers);
+    run_test(k_means_load_rejects_unknown_settings);
+    run_test(k_means_file_fit_matches_in_memory_fit);
+    run_test(k_means_stream_fit_is_deterministic_across_thread_counts);
+    run_test(k_means_stream_fit_rejects_bad_sources);
+    run_test(k_means_sharded_fit_matches_single_process_fit);
+    run_test(k_means_sharded_fit_fails_on_worker_error);
+    run_test(k_means_index_predictions_match_linear_scan);
+    run_test(spherical_k_means_clusters_sparse_topics);
+    run_test(spherical_k_means_is_deterministic_across_thread_counts);
+    run_test(spherical_k_means_rejects_invalid_samples);
     run_test(free_null_k_means);
 
     printf("----------------\n");
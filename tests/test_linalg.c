@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "assert.h"
+#include "linalg.h"
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Tolerance for floating-point number comparison.
+ */
+#define EPSILON 1e-9
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that the Cholesky solve recovers the solution of a symmetric positive definite system.
+ */
+int cholesky_solve_solves_positive_definite_system() {
+    double A[3][3] = {
+        {4.0, 2.0, 0.6},
+        {2.0, 5.0, 1.0},
+        {0.6, 1.0, 3.0}
+    };
+    double expected[3] = {1.0, -2.0, 0.5};
+    double b[3];
+    double x[3];
+
+    for (int i = 0; i < 3; i++) {
+        b[i] = A[i][0] * expected[0] + A[i][1] * expected[1] + A[i][2] * expected[2];
+    }
+
+    assert(cholesky_solve(&A[0][0], b, 3, x) == EXIT_SUCCESS);
+
+    for (int i = 0; i < 3; i++) {
+        assert(fabs(x[i] - expected[i]) < EPSILON);
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the Cholesky solve refuses a singular system.
+ */
+int cholesky_solve_rejects_singular_system() {
+    double A[2][2] = {
+        {1.0, 2.0},
+        {2.0, 4.0}
+    };
+    double b[2] = {1.0, 2.0};
+    double x[2];
+
+    assert(cholesky_solve(&A[0][0], b, 2, x) == EXIT_FAILURE);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a Cholesky factor computed in place inverts a matrix by substituting each unit vector in place.
+ */
+int cholesky_factor_inverts_by_substitution() {
+    double A[3][3] = {
+        {4.0, 2.0, 0.6},
+        {2.0, 5.0, 1.0},
+        {0.6, 1.0, 3.0}
+    };
+    double L[3][3] = {
+        {4.0, 2.0, 0.6},
+        {2.0, 5.0, 1.0},
+        {0.6, 1.0, 3.0}
+    };
+    double singular[2][2] = {
+        {1.0, 2.0},
+        {2.0, 4.0}
+    };
+
+    assert(cholesky_factor(&L[0][0], 3, &L[0][0]) == EXIT_SUCCESS);
+    assert(cholesky_factor(&singular[0][0], 2, &singular[0][0]) == EXIT_FAILURE);
+
+    for (int b = 0; b < 3; b++) {
+        double column[3] = {0.0, 0.0, 0.0};
+
+        column[b] = 1.0;
+        cholesky_substitute(&L[0][0], column, 3, column);
+
+        for (int i = 0; i < 3; i++) {
+            double product = A[i][0] * column[0] + A[i][1] * column[1] + A[i][2] * column[2];
+
+            assert(fabs(product - (i == b ? 1.0 : 0.0)) < EPSILON);
+        }
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the pivoted QR solve reports the rank of a singular system and still satisfies it when it is consistent.
+ */
+int pivoted_qr_solve_handles_rank_deficiency() {
+    double A[3][3] = {
+        {1.0, 2.0, 3.0},
+        {2.0, 4.0, 6.0},
+        {1.0, 0.0, 1.0}
+    };
+    double b[3] = {6.0, 12.0, 2.0};
+    double x[3];
+
+    assert(pivoted_qr_solve(&A[0][0], b, 3, x) == 2);
+
+    for (int i = 0; i < 3; i++) {
+        assert(fabs(A[i][0] * x[0] + A[i][1] * x[1] + A[i][2] * x[2] - b[i]) < EPSILON);
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined linear algebra tests.
+ */
+int main() {
+    printf("Running Linear Algebra tests...\n");
+
+    // Run the tests
+    run_test(cholesky_solve_solves_positive_definite_system);
+    run_test(cholesky_solve_rejects_singular_system);
+    run_test(cholesky_factor_inverts_by_substitution);
+    run_test(pivoted_qr_solve_handles_rank_deficiency);
+
+    printf("----------------\n");
+    printf("Linear Algebra Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
@@ -1,6 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stddef.h>
 #include <math.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "assert.h"
 #include "linear_regression.h"
 
@@ -86,12 +89,9 @@ int linear_regression_can_train_and_predict() {
         {4.0, 5.0, 6.0, 7.0}
     };
     double y[4] = {10.0, 14.0, 18.0, 22.0};
-    double* X_ptr[4];
-    for (int i = 0; i < 4; i++) {
-        X_ptr[i] = X[i];
-    }
+    CMLMatrix samples = matrix_view(&X[0][0], 4, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
 
-    train_linear_regression(lr, X_ptr, y, 4, 0.01, 1000);
+    train_linear_regression(lr, &samples, y, 0.01, 1000);
 
     double test_sample[DEFAULT_NUM_VARIABLES] = {5.0, 6.0, 7.0, 8.0};
     double prediction = predict_linear_regression(lr, test_sample);
@@ -101,6 +101,743 @@ int linear_regression_can_train_and_predict() {
     return TEST_SUCCESS;
 }
 
+/*
+ * Checks that batch prediction produces the same values as single-row prediction.
+ */
+int linear_regression_batch_prediction_matches_single_prediction() {
+    double X[3][DEFAULT_NUM_VARIABLES] = {
+        {1.0, 2.0, 3.0, 4.0},
+        {-1.0, 0.5, 2.0, 0.0},
+        {5.0, 6.0, 7.0, 8.0}
+    };
+    double predictions[3];
+
+    for (int i = 0; i < DEFAULT_NUM_VARIABLES; i++) {
+        lr->weights[i] = i + 1.0;
+    }
+
+    CMLMatrix samples = matrix_view(&X[0][0], 3, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
+    predict_linear_regression_batch(lr, &samples, predictions);
+
+    for (int i = 0; i < 3; i++) {
+        assert(fabs(predictions[i] - predict_linear_regression(lr, X[i])) < EPSILON);
+    }
+    return TEST_SUCCESS;
+}
+
+/*
+ * Helper function to fill a sample matrix and its targets with noiseless data from fixed weights.
+ */
+static void fill_linear_samples(CMLMatrix* X, double* y, const double* weights) {
+    for (int i = 0; i < X->num_rows; i++) {
+        double* x = matrix_row(X, i);
+        y[i] = 0.0;
+
+        for (int j = 0; j < X->num_cols; j++) {
+            x[j] = sin(i * (1.7 + j * 0.61) + j) * (j + 1);
+            y[i] += weights[j] * x[j];
+        }
+    }
+}
+
+/*
+ * Checks that parallel training with a batch size of one takes the same steps as train_linear_regression.
+ */
+int linear_regression_parallel_unit_batches_match_sequential() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLMatrix* X = create_matrix(100, DEFAULT_NUM_VARIABLES);
+    LinearRegression* sequential = new_linear_regression(DEFAULT_NUM_VARIABLES);
+    double y[100];
+
+    fill_linear_samples(X, y, weights);
+    train_linear_regression(sequential, X, y, 0.01, 5);
+
+    lr->num_threads = 2;
+    assert(train_linear_regression_parallel(lr, X, y, 0.01, 5, NULL) == EXIT_SUCCESS);
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        assert(fabs(lr->weights[j] - sequential->weights[j]) < EPSILON);
+    }
+
+    free_linear_regression(sequential);
+    free_matrix(X);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that mini-batch training produces identical weights whatever the thread count, and reports its throughput.
+ */
+int linear_regression_mini_batch_is_deterministic_across_thread_counts() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLMatrix* X = create_matrix(3000, DEFAULT_NUM_VARIABLES);
+    LinearRegression* threaded = new_linear_regression(DEFAULT_NUM_VARIABLES);
+    LinearRegressionReport report;
+    double* y = (double*) malloc(X->num_rows * sizeof(double));
+
+    fill_linear_samples(X, y, weights);
+
+    lr->batch_size = 1000;
+    threaded->batch_size = 1000;
+    threaded->num_threads = 3;
+
+    assert(train_linear_regression_parallel(lr, X, y, 0.1, 50, NULL) == EXIT_SUCCESS);
+    assert(train_linear_regression_parallel(threaded, X, y, 0.1, 50, &report) == EXIT_SUCCESS);
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        assert(lr->weights[j] == threaded->weights[j]);
+        assert(fabs(lr->weights[j] - weights[j]) < 1e-3);
+    }
+
+    assert(report.num_epochs == 50);
+    assert(report.samples_processed == 50LL * 3000);
+    assert(report.samples_per_second > 0.0);
+
+    free(y);
+    free_linear_regression(threaded);
+    free_matrix(X);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that mini-batch training on an execution context produces exactly the weights of single-threaded training.
+ */
+int linear_regression_mini_batch_on_context_matches_serial_training() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLContext* context = create_context(3, CML_PLACEMENT_NODES);
+    CMLMatrix* X = create_matrix(3000, DEFAULT_NUM_VARIABLES);
+    LinearRegression* pooled = new_linear_regression(DEFAULT_NUM_VARIABLES);
+    double* y = (double*) malloc(X->num_rows * sizeof(double));
+
+    assert(context != NULL && pooled != NULL);
+
+    fill_linear_samples(X, y, weights);
+
+    lr->batch_size = 1000;
+    pooled->batch_size = 1000;
+    pooled->context = context;
+
+    assert(train_linear_regression_parallel(lr, X, y, 0.1, 50, NULL) == EXIT_SUCCESS);
+    assert(train_linear_regression_parallel(pooled, X, y, 0.1, 50, NULL) == EXIT_SUCCESS);
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        assert(lr->weights[j] == pooled->weights[j]);
+    }
+
+    free(y);
+    free_linear_regression(pooled);
+    free_matrix(X);
+    free_context(context);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that Hogwild training converges to the true weights on noiseless data.
+ */
+int linear_regression_hogwild_converges() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLMatrix* X = create_matrix(2000, DEFAULT_NUM_VARIABLES);
+    double* y = (double*) malloc(X->num_rows * sizeof(double));
+
+    fill_linear_samples(X, y, weights);
+
+    lr->sgd = LINEAR_REGRESSION_HOGWILD;
+    lr->num_threads = 4;
+    lr->batch_size = 8;
+
+    assert(train_linear_regression_parallel(lr, X, y, 0.01, 20, NULL) == EXIT_SUCCESS);
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        assert(fabs(lr->weights[j] - weights[j]) < 1e-3);
+    }
+
+    free(y);
+    free_matrix(X);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that parallel training rejects a non-positive batch size.
+ */
+int linear_regression_parallel_rejects_invalid_batch_size() {
+    double X[1][DEFAULT_NUM_VARIABLES] = {{1.0, 2.0, 3.0, 4.0}};
+    double y[1] = {1.0};
+    CMLMatrix samples = matrix_view(&X[0][0], 1, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
+
+    lr->batch_size = 0;
+    assert(train_linear_regression_parallel(lr, &samples, y, 0.01, 1, NULL) == EXIT_FAILURE);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the closed-form fit recovers the exact weights of noiseless data in one pass.
+ */
+int linear_regression_closed_form_recovers_weights() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLMatrix* X = create_matrix(200, DEFAULT_NUM_VARIABLES);
+    double y[200];
+
+    fill_linear_samples(X, y, weights);
+
+    assert(fit_linear_regression(lr, X, y, 0.0) == EXIT_SUCCESS);
+    assert(lr->num_samples == 200);
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        assert(fabs(lr->weights[j] - weights[j]) < EPSILON);
+    }
+
+    // A ridge penalty shrinks the weights, and removing it again restores them without the samples.
+    assert(refit_linear_regression(lr, 1000.0) == EXIT_SUCCESS);
+    assert(fabs(lr->weights[3]) < 3.0 - 0.1);
+    assert(refit_linear_regression(lr, 0.0) == EXIT_SUCCESS);
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        assert(fabs(lr->weights[j] - weights[j]) < EPSILON);
+    }
+
+    free_matrix(X);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the closed-form fit still fits collinear samples exactly by falling back to the pivoted QR solve.
+ */
+int linear_regression_closed_form_handles_collinear_samples() {
+    double X[4][DEFAULT_NUM_VARIABLES] = {
+        {1.0, 2.0, 3.0, 4.0},
+        {2.0, 3.0, 4.0, 5.0},
+        {3.0, 4.0, 5.0, 6.0},
+        {4.0, 5.0, 6.0, 7.0}
+    };
+    double y[4] = {10.0, 14.0, 18.0, 22.0};
+    CMLMatrix samples = matrix_view(&X[0][0], 4, DEFAULT_NUM_VARIABLES, DEFAULT_NUM_VARIABLES);
+
+    assert(fit_linear_regression(lr, &samples, y, 0.0) == EXIT_SUCCESS);
+
+    double test_sample[DEFAULT_NUM_VARIABLES] = {5.0, 6.0, 7.0, 8.0};
+
+    assert(fabs(predict_linear_regression(lr, test_sample) - 26.0) < EPSILON);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that refitting a model without sufficient statistics fails.
+ */
+int linear_regression_refit_requires_closed_form_fit() {
+    assert(refit_linear_regression(lr, 1.0) == EXIT_FAILURE);
+    return TEST_SUCCESS;
+}
+
+/*
+ * Define a typed struct recording the losses a LinearRegression training callback receives.
+ */
+typedef struct {
+    int calls;
+    int stop_after;
+    double losses[8];
+    double last_gradient_norm;
+} EpochLog;
+
+/*
+ * Callback that logs each epoch's loss, asking training to stop once stop_after epochs have run.
+ */
+static int log_epoch(const LinearRegressionEpochStats* stats, void* arg) {
+    EpochLog* log = (EpochLog*) arg;
+
+    if (stats->epoch != log->calls || log->calls >= 8) return 1;
+
+    log->losses[log->calls++] = stats->loss;
+    log->last_gradient_norm = stats->gradient_norm;
+
+    return log->calls >= log->stop_after;
+}
+
+/*
+ * Checks that both trainers report a falling loss to the callback every epoch, and stop when it asks.
+ */
+int linear_regression_callback_reports_and_stops_training() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLMatrix* X = create_matrix(512, DEFAULT_NUM_VARIABLES);
+    double* y = (double*) malloc(512 * sizeof(double));
+    EpochLog sequential = {0, 3, {0}, 0.0};
+    EpochLog parallel = {0, 4, {0}, 0.0};
+    LinearRegressionReport report;
+
+    assert(X != NULL && y != NULL);
+
+    fill_linear_samples(X, y, weights);
+
+    lr->callback = log_epoch;
+    lr->callback_arg = &sequential;
+    lr->perf_counters = 1;
+    train_linear_regression(lr, X, y, 0.01, 100);
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) lr->weights[j] = 0.0;
+
+    lr->callback_arg = &parallel;
+    lr->batch_size = 32;
+    int status = train_linear_regression_parallel(lr, X, y, 0.05, 100, &report);
+
+    free_matrix(X);
+    free(y);
+
+    assert(sequential.calls == 3 && parallel.calls == 4);
+    assert(status == EXIT_SUCCESS && report.num_epochs == 4 && report.samples_processed == 4 * 512);
+    assert(sequential.losses[2] < sequential.losses[0] && parallel.losses[3] < parallel.losses[0]);
+    assert(parallel.last_gradient_norm > 0.0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that folding in samples one at a time after a closed-form fit reproduces the closed-form fit over every sample.
+ */
+int linear_regression_updates_match_closed_form_fit() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLMatrix* X = create_matrix(400, DEFAULT_NUM_VARIABLES);
+    double* y = (double*) malloc(400 * sizeof(double));
+    LinearRegression* full = new_linear_regression(DEFAULT_NUM_VARIABLES);
+
+    assert(X != NULL && y != NULL && full != NULL);
+
+    fill_linear_samples(X, y, weights);
+
+    // Perturb the targets so that the fit is not exact, and the updates have something to change.
+    for (int i = 0; i < 400; i++) y[i] += 0.1 * cos(i * 0.37);
+
+    CMLMatrix first_half = matrix_slice(X, 0, 200);
+
+    assert(fit_linear_regression(lr, &first_half, y, 0.5) == EXIT_SUCCESS);
+    assert(start_linear_regression_updates(lr, 0.5) == EXIT_SUCCESS);
+
+    for (int i = 200; i < 300; i++) {
+        assert(update_linear_regression(lr, matrix_row(X, i), y[i]) == EXIT_SUCCESS);
+    }
+
+    CMLMatrix last_rows = matrix_slice(X, 300, 100);
+
+    assert(update_linear_regression_batch(lr, &last_rows, y + 300) == EXIT_SUCCESS);
+    assert(fit_linear_regression(full, X, y, 0.5) == EXIT_SUCCESS);
+
+    double difference = 0.0;
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        difference = fmax(difference, fabs(lr->weights[j] - full->weights[j]));
+    }
+
+    long long num_samples = lr->num_samples;
+
+    free_linear_regression(full);
+    free_matrix(X);
+    free(y);
+
+    assert(difference < 1e-9);
+    assert(num_samples == 400);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that starting updates with a different penalty than the closed-form fit re-solves the weights for that penalty.
+ */
+int linear_regression_updates_resolve_for_their_penalty() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLMatrix* X = create_matrix(200, DEFAULT_NUM_VARIABLES);
+    double* y = (double*) malloc(200 * sizeof(double));
+    LinearRegression* ridged = new_linear_regression(DEFAULT_NUM_VARIABLES);
+
+    assert(X != NULL && y != NULL && ridged != NULL);
+
+    fill_linear_samples(X, y, weights);
+
+    for (int i = 0; i < 200; i++) y[i] += 0.1 * cos(i * 0.37);
+
+    assert(fit_linear_regression(lr, X, y, 0.0) == EXIT_SUCCESS);
+    assert(start_linear_regression_updates(lr, 50.0) == EXIT_SUCCESS);
+    assert(fit_linear_regression(ridged, X, y, 50.0) == EXIT_SUCCESS);
+
+    double difference = 0.0;
+    double shrinkage = 0.0;
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        difference = fmax(difference, fabs(lr->weights[j] - ridged->weights[j]));
+        shrinkage = fmax(shrinkage, fabs(weights[j] - ridged->weights[j]));
+    }
+
+    free_linear_regression(ridged);
+    free_matrix(X);
+    free(y);
+
+    assert(shrinkage > 1e-3);
+    assert(difference < 1e-9);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that updates after a refit continue from the refit's penalty, matching a closed-form fit over every sample with it.
+ */
+int linear_regression_updates_follow_refit() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLMatrix* X = create_matrix(400, DEFAULT_NUM_VARIABLES);
+    double* y = (double*) malloc(400 * sizeof(double));
+    LinearRegression* full = new_linear_regression(DEFAULT_NUM_VARIABLES);
+
+    assert(X != NULL && y != NULL && full != NULL);
+
+    fill_linear_samples(X, y, weights);
+
+    for (int i = 0; i < 400; i++) y[i] += 0.1 * cos(i * 0.37);
+
+    CMLMatrix first_half = matrix_slice(X, 0, 200);
+    CMLMatrix third_quarter = matrix_slice(X, 200, 100);
+    CMLMatrix last_quarter = matrix_slice(X, 300, 100);
+
+    assert(fit_linear_regression(lr, &first_half, y, 0.5) == EXIT_SUCCESS);
+    assert(start_linear_regression_updates(lr, 0.5) == EXIT_SUCCESS);
+    assert(update_linear_regression_batch(lr, &third_quarter, y + 200) == EXIT_SUCCESS);
+    assert(refit_linear_regression(lr, 40.0) == EXIT_SUCCESS);
+    assert(update_linear_regression_batch(lr, &last_quarter, y + 300) == EXIT_SUCCESS);
+    assert(fit_linear_regression(full, X, y, 40.0) == EXIT_SUCCESS);
+
+    double difference = 0.0;
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        difference = fmax(difference, fabs(lr->weights[j] - full->weights[j]));
+    }
+
+    free_linear_regression(full);
+    free_matrix(X);
+    free(y);
+
+    assert(difference < 1e-9);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a forgetting factor lets updates track weights that change part way through a stream.
+ */
+int linear_regression_updates_forget_old_samples() {
+    double before[DEFAULT_NUM_VARIABLES] = {1.0, 1.0, 1.0, 1.0};
+    double after[DEFAULT_NUM_VARIABLES] = {-2.0, 0.5, 3.0, -1.0};
+    CMLMatrix* X = create_matrix(300, DEFAULT_NUM_VARIABLES);
+    double* y = (double*) malloc(300 * sizeof(double));
+
+    assert(X != NULL && y != NULL);
+
+    lr->forgetting_factor = 0.9;
+    assert(update_linear_regression(lr, before, 1.0) == EXIT_FAILURE);
+    assert(start_linear_regression_updates(lr, 0.0) == EXIT_FAILURE);
+    assert(start_linear_regression_updates(lr, 1e-3) == EXIT_SUCCESS);
+
+    fill_linear_samples(X, y, before);
+    assert(update_linear_regression_batch(lr, X, y) == EXIT_SUCCESS);
+
+    fill_linear_samples(X, y, after);
+    assert(update_linear_regression_batch(lr, X, y) == EXIT_SUCCESS);
+
+    free_matrix(X);
+    free(y);
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        assert(fabs(lr->weights[j] - after[j]) < 1e-6);
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Define a typed struct shared with a thread that predicts while the model is being updated.
+ */
+typedef struct {
+    LinearRegression* lr;
+    int done;
+    int torn_predictions;
+} PredictionLoad;
+
+/*
+ * Thread entry point that keeps predicting until told to stop, counting any prediction made from torn weights.
+ * The updates keep both weights equal, so the prediction for (1, -1) is exactly zero unless two versions of the weights are mixed.
+ */
+static void* predict_while_updating(void* arg) {
+    PredictionLoad* load = (PredictionLoad*) arg;
+    double alternating[2] = {1.0, -1.0};
+
+    while (!__atomic_load_n(&load->done, __ATOMIC_ACQUIRE)) {
+        if (predict_linear_regression(load->lr, alternating) != 0.0) load->torn_predictions++;
+    }
+
+    return NULL;
+}
+
+/*
+ * Checks that predictions made while updates are published only ever see complete sets of weights.
+ */
+int linear_regression_predictions_run_during_updates() {
+    double ones[2] = {1.0, 1.0};
+    LinearRegression* pair = new_linear_regression(2);
+    PredictionLoad load = {pair, 0, 0};
+    pthread_t thread;
+
+    assert(pair != NULL);
+    assert(start_linear_regression_updates(pair, 1.0) == EXIT_SUCCESS);
+    assert(pthread_create(&thread, NULL, predict_while_updating, &load) == 0);
+
+    // Every sample is symmetric in the two variables, so each update moves both weights identically.
+    int status = EXIT_SUCCESS;
+
+    for (int i = 0; i < 20000 && status == EXIT_SUCCESS; i++) {
+        status = update_linear_regression(pair, ones, (double) (i % 7));
+    }
+
+    __atomic_store_n(&load.done, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+
+    int weights_equal = pair->weights[0] == pair->weights[1] && pair->weights[0] != 0.0;
+
+    free_linear_regression(pair);
+
+    assert(status == EXIT_SUCCESS);
+    assert(load.torn_predictions == 0);
+    assert(weights_equal);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Helper function to fill a matrix with linear samples as fill_linear_samples does, then zero out roughly a third of the values.
+ */
+static void fill_sparse_linear_samples(CMLMatrix* X, double* y, const double* weights) {
+    for (int i = 0; i < X->num_rows; i++) {
+        double* x = matrix_row(X, i);
+        y[i] = 0.0;
+
+        for (int j = 0; j < X->num_cols; j++) {
+            x[j] = (i + j) % 3 == 0 ? 0.0 : sin(i * (1.7 + j * 0.61) + j) * (j + 1);
+            y[i] += weights[j] * x[j];
+        }
+    }
+}
+
+/*
+ * Checks that sparse training without a penalty takes exactly the steps dense training takes over the same samples.
+ */
+int linear_regression_sparse_training_matches_dense() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    CMLMatrix* X = create_matrix(100, DEFAULT_NUM_VARIABLES);
+    LinearRegression* dense = new_linear_regression(DEFAULT_NUM_VARIABLES);
+    double y[100];
+
+    assert(X != NULL && dense != NULL);
+
+    fill_sparse_linear_samples(X, y, weights);
+
+    CMLSparseMatrix* S = sparse_matrix_from_dense(X);
+
+    train_linear_regression(dense, X, y, 0.01, 5);
+    int status = train_linear_regression_sparse(lr, S, y, 0.01, 0.0, 5);
+
+    double difference = 0.0;
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        difference = fmax(difference, fabs(lr->weights[j] - dense->weights[j]));
+    }
+
+    free_sparse_matrix(S);
+    free_linear_regression(dense);
+    free_matrix(X);
+
+    assert(status == EXIT_SUCCESS);
+    assert(difference < 1e-12);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the lazily applied L2 penalty matches shrinking every weight at every step.
+ */
+int linear_regression_sparse_l2_matches_eager_decay() {
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    double eager[DEFAULT_NUM_VARIABLES] = {0.0};
+    CMLMatrix* X = create_matrix(100, DEFAULT_NUM_VARIABLES);
+    double y[100];
+
+    assert(X != NULL);
+
+    fill_sparse_linear_samples(X, y, weights);
+
+    for (int iteration = 0; iteration < 5; iteration++) {
+        for (int i = 0; i < 100; i++) {
+            const double* x = matrix_row(X, i);
+            double error = -y[i];
+
+            for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) error += eager[j] * x[j];
+
+            for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+                eager[j] = (1.0 - 0.01 * 0.5) * eager[j] - 0.01 * error * x[j];
+            }
+        }
+    }
+
+    CMLSparseMatrix* S = sparse_matrix_from_dense(X);
+    int status = train_linear_regression_sparse(lr, S, y, 0.01, 0.5, 5);
+    int rejected = train_linear_regression_sparse(lr, S, y, 0.01, 100.0, 1) == EXIT_FAILURE;
+
+    double difference = 0.0;
+
+    for (int j = 0; j < DEFAULT_NUM_VARIABLES; j++) {
+        difference = fmax(difference, fabs(lr->weights[j] - eager[j]));
+    }
+
+    free_sparse_matrix(S);
+    free_matrix(X);
+
+    assert(status == EXIT_SUCCESS && rejected);
+    assert(difference < 1e-10);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that sparse training learns hashed one-hot style samples over a million variables, and that batch and single predictions agree.
+ */
+int linear_regression_sparse_trains_high_dimensional_samples() {
+    const int num_variables = 1 << 20;
+    const int num_rows = 400;
+    const int row_nonzeros = 8;
+    LinearRegression* wide = new_linear_regression(num_variables);
+    CMLSparseMatrix* S = create_sparse_matrix(num_rows, num_variables, (size_t) num_rows * row_nonzeros);
+    double* y = (double*) malloc(num_rows * sizeof(double));
+    double* predictions = (double*) malloc(num_rows * sizeof(double));
+    EpochLog log = {0, 8, {0}, 0.0};
+
+    assert(wide != NULL && S != NULL && y != NULL && predictions != NULL);
+
+    // Each row activates eight hashed columns, half of them drawn from a small set of informative features.
+    for (int i = 0; i < num_rows; i++) {
+        y[i] = 0.0;
+
+        for (int q = 0; q < row_nonzeros; q++) {
+            size_t p = (size_t) i * row_nonzeros + q;
+            unsigned int feature = q < row_nonzeros / 2 ? (unsigned int) (i * 7 + q) % 16 : (unsigned int) (i * row_nonzeros + q);
+            int column = (int) ((feature * 2654435761u) % (unsigned int) num_variables);
+
+            S->col_indices[p] = column;
+            S->values[p] = 1.0;
+            y[i] += q < row_nonzeros / 2 ? (double) (feature % 5) - 2.0 : 0.0;
+        }
+
+        S->row_offsets[i + 1] = (size_t) (i + 1) * row_nonzeros;
+    }
+
+    // The untrained model predicts zero everywhere, so its loss is the mean squared target.
+    double initial_loss = 0.0;
+
+    for (int i = 0; i < num_rows; i++) initial_loss += y[i] * y[i] / num_rows;
+
+    wide->callback = log_epoch;
+    wide->callback_arg = &log;
+
+    int status = train_linear_regression_sparse(wide, S, y, 0.05, 1e-4, 8);
+
+    predict_linear_regression_sparse_batch(wide, S, predictions);
+
+    int predictions_match = 1;
+
+    for (int i = 0; i < num_rows; i++) {
+        const int* indices = S->col_indices + (size_t) i * row_nonzeros;
+        const double* values = S->values + (size_t) i * row_nonzeros;
+
+        if (predictions[i] != predict_linear_regression_sparse(wide, indices, values, row_nonzeros)) predictions_match = 0;
+    }
+
+    free(predictions);
+    free(y);
+    free_sparse_matrix(S);
+    free_linear_regression(wide);
+
+    assert(status == EXIT_SUCCESS && log.calls == 8);
+    assert(log.losses[7] < log.losses[0] && log.losses[7] < 0.01 * initial_loss);
+    assert(predictions_match);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a saved model loads with identical weights and settings, and that a corrupt weight is caught when verified.
+ */
+int linear_regression_save_and_load_round_trips() {
+    char path[64];
+    double weights[DEFAULT_NUM_VARIABLES] = {1.5, -2.0, 0.25, 3.0};
+    double test_sample[DEFAULT_NUM_VARIABLES] = {5.0, 6.0, 7.0, 8.0};
+
+    snprintf(path, sizeof(path), "/tmp/cml_test_linear_regression_%d.cmlm", (int) getpid());
+
+    for (int i = 0; i < DEFAULT_NUM_VARIABLES; i++) lr->weights[i] = weights[i];
+
+    lr->batch_size = 32;
+    lr->sgd = LINEAR_REGRESSION_HOGWILD;
+
+    assert(save_linear_regression(lr, path) == EXIT_SUCCESS);
+
+    LinearRegression* loaded = load_linear_regression(path, 1);
+
+    assert(loaded != NULL);
+    assert(loaded->num_variables == DEFAULT_NUM_VARIABLES);
+    assert(loaded->batch_size == 32 && loaded->sgd == LINEAR_REGRESSION_HOGWILD);
+    assert(predict_linear_regression(loaded, test_sample) == predict_linear_regression(lr, test_sample));
+
+    free_linear_regression(loaded);
+
+    // Flip a byte of the last weight, which only a verified load detects.
+    FILE* file = fopen(path, "r+b");
+
+    assert(file != NULL);
+    fseek(file, -1, SEEK_END);
+
+    int byte = fgetc(file);
+
+    fseek(file, -1, SEEK_END);
+    fputc(byte ^ 0xFF, file);
+    fclose(file);
+
+    loaded = load_linear_regression(path, 0);
+
+    assert(loaded != NULL);
+    assert(load_linear_regression(path, 1) == NULL);
+
+    free_linear_regression(loaded);
+    remove(path);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that files holding a non-positive or oversized batch size, or an unknown gradient descent variant, are rejected.
+ * Saving writes the settings unchecked, so each invalid file carries a valid checksum.
+ */
+int linear_regression_load_rejects_invalid_settings() {
+    char path[64];
+    int batch_sizes[] = {0, -1, 32};
+    int variants[] = {LINEAR_REGRESSION_MINI_BATCH, LINEAR_REGRESSION_MINI_BATCH, LINEAR_REGRESSION_HOGWILD + 1};
+
+    snprintf(path, sizeof(path), "/tmp/cml_test_linear_regression_%d.cmlm", (int) getpid());
+
+    for (int i = 0; i < 3; i++) {
+        lr->batch_size = batch_sizes[i];
+        lr->sgd = (LinearRegressionSGD) variants[i];
+
+        assert(save_linear_regression(lr, path) == EXIT_SUCCESS);
+        assert(load_linear_regression(path, 1) == NULL);
+    }
+
+    lr->batch_size = 1;
+    lr->sgd = LINEAR_REGRESSION_MINI_BATCH;
+    remove(path);
+
+    return TEST_SUCCESS;
+}
+
 /*
  * Checks that freeing a NULL LinearRegression model does not cause errors.
  */
@@ -119,6 +856,26 @@ int main() {
     run_test(new_linear_regression_is_non_null);
     run_test(new_linear_regression_initializes_weights_to_zero);
     run_test(linear_regression_can_train_and_predict);
+    run_test(linear_regression_batch_prediction_matches_single_prediction);
+    run_test(linear_regression_parallel_unit_batches_match_sequential);
+    run_test(linear_regression_mini_batch_is_deterministic_across_thread_counts);
+    run_test(linear_regression_mini_batch_on_context_matches_serial_training);
+    run_test(linear_regression_hogwild_converges);
+    run_test(linear_regression_parallel_rejects_invalid_batch_size);
+    run_test(linear_regression_closed_form_recovers_weights);
+    run_test(linear_regression_closed_form_handles_collinear_samples);
+    run_test(linear_regression_refit_requires_closed_form_fit);
+    run_test(linear_regression_callback_reports_and_stops_training);
+    run_test(linear_regression_updates_match_closed_form_fit);
+    run_test(linear_regression_updates_resolve_for_their_penalty);
+    run_test(linear_regression_updates_follow_refit);
+    run_test(linear_regression_updates_forget_old_samples);
+    run_test(linear_regression_predictions_run_during_updates);
+    run_test(linear_regression_sparse_training_matches_dense);
+    run_test(linear_regression_sparse_l2_matches_eager_decay);
+    run_test(linear_regression_sparse_trains_high_dimensional_samples);
+    run_test(linear_regression_save_and_load_round_trips);
+    run_test(linear_regression_load_rejects_invalid_settings);
     run_test(free_null_linear_regression);
 
     printf("----------------\n");
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "assert.h"
+#include "matrix.h"
+
+/*
+ * The default number of rows to use during tests.
+ */
+#define DEFAULT_NUM_ROWS 5
+
+/*
+ * The default number of columns to use during tests.
+ */
+#define DEFAULT_NUM_COLS 3
+
+/*
+ * The matrix to use during tests.
+ */
+static CMLMatrix* X;
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    X = create_matrix(DEFAULT_NUM_ROWS, DEFAULT_NUM_COLS);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+    free_matrix(X);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that the matrix constructor returns a non-null, zeroed, packed and cache-line aligned matrix.
+ */
+int create_matrix_is_zeroed_and_aligned() {
+    assert(X != NULL);
+    assert(X->num_rows == DEFAULT_NUM_ROWS);
+    assert(X->num_cols == DEFAULT_NUM_COLS);
+    assert(X->stride == DEFAULT_NUM_COLS);
+    assert((uintptr_t) X->data % 64 == 0);
+
+    for (int i = 0; i < DEFAULT_NUM_ROWS * DEFAULT_NUM_COLS; i++) {
+        assert(X->data[i] == 0.0);
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that the matrix constructor rejects non-positive dimensions.
+ */
+int create_matrix_fails_on_zero_dimensions() {
+    CMLMatrix* empty = create_matrix(0, DEFAULT_NUM_COLS);
+    assert(empty == NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a view over padded caller-owned memory addresses rows through its stride without copying.
+ */
+int matrix_view_uses_stride() {
+    double data[3][4] = {
+        {1.0, 2.0, -1.0, -1.0},
+        {3.0, 4.0, -1.0, -1.0},
+        {5.0, 6.0, -1.0, -1.0}
+    };
+
+    CMLMatrix view = matrix_view(&data[0][0], 3, 2, 4);
+
+    assert(view.data == &data[0][0]);
+    assert(matrix_row(&view, 2) == data[2]);
+    assert(matrix_row(&view, 1)[1] == 4.0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a view is rejected when its stride is narrower than its rows.
+ */
+int matrix_view_rejects_narrow_stride() {
+    double data[4] = {1.0, 2.0, 3.0, 4.0};
+
+    CMLMatrix view = matrix_view(data, 2, 2, 1);
+    assert(view.data == NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a row slice shares the parent's memory and writes through to it.
+ */
+int matrix_slice_shares_data() {
+    CMLMatrix slice = matrix_slice(X, 2, 3);
+
+    assert(slice.num_rows == 3);
+    assert(slice.data == matrix_row(X, 2));
+
+    matrix_row(&slice, 0)[1] = 7.0;
+    assert(matrix_row(X, 2)[1] == 7.0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a slice extending past the last row of the parent is rejected.
+ */
+int matrix_slice_rejects_out_of_range() {
+    CMLMatrix slice = matrix_slice(X, 3, 3);
+    assert(slice.data == NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that converting a dense matrix to sparse form keeps exactly its non-zeros, in row and column order.
+ */
+int sparse_matrix_from_dense_keeps_nonzeros() {
+    matrix_row(X, 0)[2] = 1.5;
+    matrix_row(X, 2)[0] = -2.0;
+    matrix_row(X, 2)[1] = 3.0;
+    matrix_row(X, 4)[1] = 0.25;
+
+    CMLSparseMatrix* S = sparse_matrix_from_dense(X);
+
+    assert(S != NULL);
+    assert(S->num_rows == DEFAULT_NUM_ROWS && S->num_cols == DEFAULT_NUM_COLS && S->num_nonzeros == 4);
+
+    size_t offsets[DEFAULT_NUM_ROWS + 1] = {0, 1, 1, 3, 3, 4};
+    int columns[4] = {2, 0, 1, 1};
+    double values[4] = {1.5, -2.0, 3.0, 0.25};
+    int matches = check_sparse_matrix(S) == EXIT_SUCCESS;
+
+    for (int i = 0; i <= DEFAULT_NUM_ROWS; i++) {
+        if (S->row_offsets[i] != offsets[i]) matches = 0;
+    }
+
+    for (int p = 0; p < 4; p++) {
+        if (S->col_indices[p] != columns[p] || S->values[p] != values[p]) matches = 0;
+    }
+
+    free_sparse_matrix(S);
+
+    assert(matches);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that malformed row offsets and out-of-range column indices are rejected.
+ */
+int check_sparse_matrix_rejects_malformed() {
+    CMLSparseMatrix* S = create_sparse_matrix(2, DEFAULT_NUM_COLS, 2);
+
+    assert(S != NULL);
+
+    S->row_offsets[1] = 1;
+    S->row_offsets[2] = 2;
+    S->col_indices[0] = 0;
+    S->col_indices[1] = DEFAULT_NUM_COLS - 1;
+
+    int well_formed = check_sparse_matrix(S) == EXIT_SUCCESS;
+
+    S->col_indices[1] = DEFAULT_NUM_COLS;
+    int bad_column = check_sparse_matrix(S) == EXIT_FAILURE;
+
+    S->col_indices[1] = 0;
+    S->row_offsets[1] = 3;
+    int bad_offsets = check_sparse_matrix(S) == EXIT_FAILURE;
+
+    free_sparse_matrix(S);
+
+    assert(well_formed && bad_column && bad_offsets);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that freeing a NULL matrix does not cause errors.
+ */
+int free_null_matrix() {
+    free_matrix(NULL);
+    free_sparse_matrix(NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined matrix tests.
+ */
+int main() {
+    printf("Running Matrix tests...\n");
+
+    // Run the tests
+    run_test(create_matrix_is_zeroed_and_aligned);
+    run_test(create_matrix_fails_on_zero_dimensions);
+    run_test(matrix_view_uses_stride);
+    run_test(matrix_view_rejects_narrow_stride);
+    run_test(matrix_slice_shares_data);
+    run_test(matrix_slice_rejects_out_of_range);
+    run_test(sparse_matrix_from_dense_keeps_nonzeros);
+    run_test(check_sparse_matrix_rejects_malformed);
+    run_test(free_null_matrix);
+
+    printf("----------------\n");
+    printf("Matrix Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "assert.h"
+#include "parallel.h"
+
+/*
+ * The number of tasks to run in each test.
+ */
+#define NUM_TASKS 1000
+
+/*
+ * The number of jobs each concurrent caller submits to a shared context.
+ */
+#define NUM_JOBS 50
+
+/*
+ * The number of times each task has run.
+ */
+static int runs[NUM_TASKS];
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    memset(runs, 0, sizeof(runs));
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/*
+ * Task that records that it has run and adds its index to a shared total.
+ */
+static void record_task(void* arg, int task_index) {
+    __atomic_fetch_add(&runs[task_index], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add((long*) arg, task_index, __ATOMIC_RELAXED);
+}
+
+/*
+ * Define a typed struct describing a caller submitting jobs to a context, and the total its tasks reach.
+ */
+typedef struct {
+    CMLContext* context;
+    long total;
+} ContextCaller;
+
+/*
+ * Task that adds its index to a caller's total.
+ */
+static void add_task(void* arg, int task_index) {
+    __atomic_fetch_add(&((ContextCaller*) arg)->total, task_index, __ATOMIC_RELAXED);
+}
+
+/*
+ * Task that submits a nested job of ten add tasks to its caller's context.
+ */
+static void nested_task(void* arg, int task_index) {
+    (void) task_index;
+
+    parallel_for_in(((ContextCaller*) arg)->context, 10, 4, add_task, arg);
+}
+
+/*
+ * Thread entry point that submits NUM_JOBS jobs of NUM_TASKS add tasks to a caller's context.
+ */
+static void* submit_jobs(void* arg) {
+    ContextCaller* caller = (ContextCaller*) arg;
+
+    for (int job = 0; job < NUM_JOBS; job++) {
+        parallel_for_in(caller->context, NUM_TASKS, context_num_threads(caller->context), add_task, caller);
+    }
+
+    return NULL;
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that every task runs exactly once on a single thread.
+ */
+int parallel_for_runs_each_task_once_serially() {
+    long total = 0;
+
+    parallel_for(NUM_TASKS, 1, record_task, &total);
+
+    for (int i = 0; i < NUM_TASKS; i++) {
+        assert(runs[i] == 1);
+    }
+
+    assert(total == (long) NUM_TASKS * (NUM_TASKS - 1) / 2);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that every task runs exactly once when spread over many threads.
+ */
+int parallel_for_runs_each_task_once_concurrently() {
+    long total = 0;
+
+    parallel_for(NUM_TASKS, 8, record_task, &total);
+
+    for (int i = 0; i < NUM_TASKS; i++) {
+        assert(runs[i] == 1);
+    }
+
+    assert(total == (long) NUM_TASKS * (NUM_TASKS - 1) / 2);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a thread count larger than the task count is handled.
+ */
+int parallel_for_handles_more_threads_than_tasks() {
+    long total = 0;
+
+    parallel_for(3, 16, record_task, &total);
+
+    assert(runs[0] == 1 && runs[1] == 1 && runs[2] == 1);
+    assert(runs[3] == 0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a non-positive thread count resolves to at least one thread.
+ */
+int resolve_num_threads_uses_online_cpus() {
+    assert(resolve_num_threads(0) >= 1);
+    assert(resolve_num_threads(5) == 5);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a context runs every task of repeated jobs exactly once under each placement.
+ */
+int context_runs_each_task_once_under_each_placement() {
+    CMLPlacement placements[3] = {CML_PLACEMENT_ANY, CML_PLACEMENT_CORES, CML_PLACEMENT_NODES};
+
+    for (int p = 0; p < 3; p++) {
+        CMLContext* context = create_context(4, placements[p]);
+        long total = 0;
+
+        assert(context != NULL && context_num_threads(context) == 4);
+
+        memset(runs, 0, sizeof(runs));
+        parallel_for_in(context, NUM_TASKS, 4, record_task, &total);
+        parallel_for_in(context, NUM_TASKS, 16, record_task, &total);
+        free_context(context);
+
+        for (int i = 0; i < NUM_TASKS; i++) {
+            assert(runs[i] == 2);
+        }
+
+        assert(total == (long) NUM_TASKS * (NUM_TASKS - 1));
+    }
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that jobs submitted to one context from several threads at once, and jobs nested within its tasks, all run in full.
+ */
+int context_is_shared_by_concurrent_and_nested_jobs() {
+    CMLContext* context = create_context(3, CML_PLACEMENT_ANY);
+    ContextCaller callers[3] = {{context, 0}, {context, 0}, {context, 0}};
+    pthread_t threads[3];
+
+    assert(context != NULL);
+
+    for (int t = 0; t < 3; t++) {
+        assert(pthread_create(&threads[t], NULL, submit_jobs, &callers[t]) == 0);
+    }
+
+    for (int t = 0; t < 3; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    ContextCaller nested = {context, 0};
+
+    parallel_for_in(context, 100, 3, nested_task, &nested);
+    free_context(context);
+
+    for (int t = 0; t < 3; t++) {
+        assert(callers[t].total == (long) NUM_JOBS * NUM_TASKS * (NUM_TASKS - 1) / 2);
+    }
+
+    assert(nested.total == 100L * 45);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a null context falls back to parallel_for and its own thread count, and is handled by the context functions.
+ */
+int null_context_falls_back_to_parallel_for() {
+    long total = 0;
+
+    parallel_for_in(NULL, NUM_TASKS, 8, record_task, &total);
+
+    for (int i = 0; i < NUM_TASKS; i++) {
+        assert(runs[i] == 1);
+    }
+
+    CMLContext* context = create_context(2, CML_PLACEMENT_ANY);
+
+    assert(context != NULL);
+    assert(resolve_context_threads(NULL, 5) == 5);
+    assert(resolve_context_threads(context, 5) == 2);
+    assert(context_num_threads(NULL) == -1);
+
+    free_context(context);
+    free_context(NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined parallel tests.
+ */
+int main() {
+    printf("Running Parallel tests...\n");
+
+    // Run the tests
+    run_test(parallel_for_runs_each_task_once_serially);
+    run_test(parallel_for_runs_each_task_once_concurrently);
+    run_test(parallel_for_handles_more_threads_than_tasks);
+    run_test(resolve_num_threads_uses_online_cpus);
+    run_test(context_runs_each_task_once_under_each_placement);
+    run_test(context_is_shared_by_concurrent_and_nested_jobs);
+    run_test(null_context_falls_back_to_parallel_for);
+
+    printf("----------------\n");
+    printf("Parallel Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
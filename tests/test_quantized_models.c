@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assert.h"
+#include "distance.h"
+#include "quantized_models.h"
+#include "rng.h"
+
+/*
+ * The number of clusters to fit during tests.
+ */
+#define NUM_CLUSTERS 64
+
+/*
+ * The number of variables of every sample during tests.
+ */
+#define NUM_VARIABLES 16
+
+/*
+ * The number of samples to fit and predict during tests.
+ */
+#define NUM_SAMPLES 8000
+
+/*
+ * The samples and the model fitted to them, shared by every test.
+ */
+static CMLMatrix* X;
+static KMeans* km;
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Helper function to fill a matrix with samples scattered uniformly around NUM_CLUSTERS random centers in [-10, 10]^d.
+ */
+static void fill_blobs(CMLMatrix* samples, CMLRandom* rng) {
+    double centers[NUM_CLUSTERS * NUM_VARIABLES];
+
+    for (int i = 0; i < NUM_CLUSTERS * NUM_VARIABLES; i++) {
+        centers[i] = rng_uniform(rng) * 20.0 - 10.0;
+    }
+
+    for (int i = 0; i < samples->num_rows; i++) {
+        const double* center = centers + rng_below(rng, NUM_CLUSTERS) * NUM_VARIABLES;
+
+        for (int j = 0; j < NUM_VARIABLES; j++) {
+            matrix_row(samples, i)[j] = center[j] + rng_uniform(rng) * 2.0 - 1.0;
+        }
+    }
+}
+
+/*
+ * Setup function to run prior to each test, fitting a model seeded with k-means++ to blob data.
+ */
+void setup() {
+    CMLRandom rng;
+
+    seed_rng(&rng, 42);
+    X = create_matrix(NUM_SAMPLES, NUM_VARIABLES);
+    km = create_k_means_seeded(NUM_CLUSTERS, NUM_VARIABLES, 1.0, 42);
+    total_count++;
+
+    if (X != NULL && km != NULL) {
+        fill_blobs(X, &rng);
+        km->init = KMEANS_INIT_PLUS_PLUS;
+        fit_k_means(km, X, 10, NULL);
+    }
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+    free_k_means(km);
+    free_matrix(X);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that a quantized model takes an eighth of the centroids' memory and labels almost every sample as the full model does.
+ */
+int quantized_labels_agree_with_full_model() {
+    int* labels = (int*) malloc(NUM_SAMPLES * sizeof(int));
+    int* quantized_labels = (int*) malloc(NUM_SAMPLES * sizeof(int));
+    KMeansQ8* qkm = quantize_k_means(km, 0);
+    int agreed = 0;
+
+    assert(labels != NULL && quantized_labels != NULL && qkm != NULL);
+    assert(qkm->k == NUM_CLUSTERS && qkm->num_variables == NUM_VARIABLES && qkm->num_candidates == 8);
+
+    predict_k_means_batch(km, X, labels);
+    predict_k_means_batch_q8(qkm, X, quantized_labels);
+
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        agreed += labels[i] == quantized_labels[i];
+    }
+
+    free_k_means_q8(qkm);
+    free(quantized_labels);
+    free(labels);
+
+    assert(agreed >= NUM_SAMPLES * 99 / 100);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that re-ranking every centroid gives exactly the nearest decoded centroid, whatever the integer distances ranked first.
+ */
+int reranking_every_centroid_is_exact() {
+    double decoded[NUM_CLUSTERS * NUM_VARIABLES];
+    KMeansQ8* qkm = quantize_k_means(km, NUM_CLUSTERS * 2);
+
+    assert(qkm != NULL && qkm->num_candidates == NUM_CLUSTERS);
+
+    KMeansQ8Scratch* scratch = create_k_means_q8_scratch(qkm);
+
+    assert(scratch != NULL);
+
+    for (int c = 0; c < NUM_CLUSTERS; c++) {
+        for (int j = 0; j < NUM_VARIABLES; j++) {
+            decoded[c * NUM_VARIABLES + j] = qkm->offsets[j] + qkm->scale * qkm->codes[c * NUM_VARIABLES + j];
+        }
+    }
+
+    int mismatches = 0;
+
+    for (int i = 0; i < 1000; i++) {
+        mismatches += predict_k_means_q8(qkm, matrix_row(X, i), scratch) != nearest_point(matrix_row(X, i), decoded, NUM_CLUSTERS, NUM_VARIABLES, NULL);
+    }
+
+    free_k_means_q8_scratch(scratch);
+    free_k_means_q8(qkm);
+
+    assert(mismatches == 0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that a multithreaded batch prediction with a single candidate matches single-row prediction.
+ */
+int quantized_batch_matches_single_prediction() {
+    int* labels = (int*) malloc(NUM_SAMPLES * sizeof(int));
+    KMeansQ8* qkm = quantize_k_means(km, 1);
+    KMeansQ8Scratch* scratch = create_k_means_q8_scratch(qkm);
+
+    assert(labels != NULL && qkm != NULL && scratch != NULL);
+
+    qkm->num_threads = 4;
+    predict_k_means_batch_q8(qkm, X, labels);
+
+    int mismatches = 0;
+
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        mismatches += labels[i] != predict_k_means_q8(qkm, matrix_row(X, i), scratch);
+    }
+
+    free_k_means_q8_scratch(scratch);
+    free_k_means_q8(qkm);
+    free(labels);
+
+    assert(mismatches == 0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that quantizing coincident centroids uses a unit scale, and that null models, points and scratches, and scratches too small, are rejected.
+ */
+int quantize_handles_degenerate_models() {
+    KMeans* single = create_k_means_seeded(1, NUM_VARIABLES, 1.0, 7);
+
+    assert(single != NULL);
+
+    KMeansQ8* qkm = quantize_k_means(single, 0);
+
+    assert(qkm != NULL && qkm->scale == 1.0 && qkm->num_candidates == 1);
+
+    KMeansQ8Scratch* scratch = create_k_means_q8_scratch(qkm);
+    KMeansQ8* full = quantize_k_means(km, 0);
+
+    assert(scratch != NULL && full != NULL);
+    assert(predict_k_means_q8(qkm, matrix_row(X, 0), scratch) == 0);
+    assert(predict_k_means_q8(qkm, NULL, scratch) == -1);
+    assert(predict_k_means_q8(qkm, matrix_row(X, 0), NULL) == -1);
+    assert(predict_k_means_q8(full, matrix_row(X, 0), scratch) == -1);
+
+    free_k_means_q8(full);
+    free_k_means_q8(qkm);
+    free_k_means(single);
+
+    assert(quantize_k_means(NULL, 0) == NULL);
+    assert(create_k_means_q8_scratch(NULL) == NULL);
+    assert(predict_k_means_q8(NULL, matrix_row(X, 0), scratch) == -1);
+
+    free_k_means_q8_scratch(scratch);
+    free_k_means_q8(NULL);
+    free_k_means_q8_scratch(NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined quantized model tests.
+ */
+int main() {
+    printf("Running Quantized Model tests...\n");
+
+    // Run the tests
+    run_test(quantized_labels_agree_with_full_model);
+    run_test(reranking_every_centroid_is_exact);
+    run_test(quantized_batch_matches_single_prediction);
+    run_test(quantize_handles_degenerate_models);
+
+    printf("----------------\n");
+    printf("Quantized Model Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include "assert.h"
+#include "rng.h"
+
+/*
+ * The seed to use during tests.
+ */
+#define DEFAULT_SEED 42
+
+/*
+ * The number of draws to make in each test.
+ */
+#define NUM_DRAWS 10000
+
+/*
+ * The generator to use during tests.
+ */
+static CMLRandom rng;
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    seed_rng(&rng, DEFAULT_SEED);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that two generators seeded alike produce the same sequence, and that a different seed diverges.
+ */
+int seeded_generators_are_reproducible() {
+    CMLRandom same;
+    CMLRandom other;
+
+    seed_rng(&same, DEFAULT_SEED);
+    seed_rng(&other, DEFAULT_SEED + 1);
+
+    int differs = 0;
+
+    for (int i = 0; i < NUM_DRAWS; i++) {
+        uint64_t value = rng_next(&rng);
+
+        assert(value == rng_next(&same));
+
+        if (value != rng_next(&other)) differs = 1;
+    }
+
+    assert(differs);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that uniform doubles lie in [0, 1) and average close to one half.
+ */
+int rng_uniform_is_in_unit_interval() {
+    double sum = 0.0;
+
+    for (int i = 0; i < NUM_DRAWS; i++) {
+        double value = rng_uniform(&rng);
+
+        assert(value >= 0.0 && value < 1.0);
+        sum += value;
+    }
+
+    assert(sum / NUM_DRAWS > 0.48 && sum / NUM_DRAWS < 0.52);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that bounded integers stay below the bound and cover every value.
+ */
+int rng_below_covers_range() {
+    int seen[7] = {0};
+
+    for (int i = 0; i < NUM_DRAWS; i++) {
+        uint64_t value = rng_below(&rng, 7);
+
+        assert(value < 7);
+        seen[value]++;
+    }
+
+    for (int i = 0; i < 7; i++) {
+        assert(seen[i] > NUM_DRAWS / 7 / 2);
+    }
+
+    assert(rng_below(&rng, 0) == 0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined random generator tests.
+ */
+int main() {
+    printf("Running RNG tests...\n");
+
+    // Run the tests
+    run_test(seeded_generators_are_reproducible);
+    run_test(rng_uniform_is_in_unit_interval);
+    run_test(rng_below_covers_range);
+
+    printf("----------------\n");
+    printf("RNG Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "assert.h"
+#include "workspace.h"
+
+/*
+ * The workspace to use during tests.
+ */
+static CMLWorkspace* workspace;
+
+/*
+ * The number of tests that succeeded.
+ */
+static int success_count = 0;
+
+/*
+ * The total number of tests run.
+ */
+static int total_count = 0;
+
+/*
+ * Setup function to run prior to each test.
+ */
+void setup() {
+    workspace = create_workspace(0, 2);
+    total_count++;
+}
+
+/*
+ * Teardown function to run after each test.
+ */
+void teardown() {
+    free_workspace(workspace);
+}
+
+/*
+ * This function is called multiple times from main for each user-defined test function.
+ */
+void run_test(int (*testFunction)()) {
+    setup();
+
+    if (testFunction()) success_count++;
+
+    teardown();
+}
+
+/* UNIT TESTS */
+
+/*
+ * Checks that allocations are cache-line aligned, distinct and writable, including past the first block.
+ */
+int workspace_allocations_are_aligned_and_disjoint() {
+    unsigned char* first = (unsigned char*) workspace_alloc(workspace, 100);
+    unsigned char* second = (unsigned char*) workspace_alloc(workspace, 1);
+    unsigned char* third = (unsigned char*) workspace_alloc(workspace, 1 << 20);
+
+    assert(first != NULL && second != NULL && third != NULL);
+    assert((uintptr_t) first % CML_WORKSPACE_ALIGNMENT == 0);
+    assert((uintptr_t) second % CML_WORKSPACE_ALIGNMENT == 0);
+    assert((uintptr_t) third % CML_WORKSPACE_ALIGNMENT == 0);
+
+    memset(first, 1, 100);
+    memset(second, 2, 1);
+    memset(third, 3, 1 << 20);
+
+    assert(first[99] == 1 && second[0] == 2 && third[(1 << 20) - 1] == 3);
+    assert(workspace->num_block_allocations >= 2);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that releasing to a mark frees only the buffers allocated after it, which are then reused.
+ */
+int workspace_release_rewinds_to_mark() {
+    double* kept = (double*) workspace_alloc(workspace, 16 * sizeof(double));
+    size_t mark = workspace_mark(workspace);
+    double* released = (double*) workspace_alloc(workspace, 16 * sizeof(double));
+
+    assert(kept != NULL && released != NULL);
+
+    kept[15] = 42.0;
+    workspace_release(workspace, mark);
+
+    assert(workspace_mark(workspace) == mark);
+    assert(workspace_alloc(workspace, 16 * sizeof(double)) == released);
+    assert(kept[15] == 42.0);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that once emptied, a workspace serves a repeat of the same workload without allocating any more blocks.
+ */
+int workspace_repeated_workload_stops_allocating() {
+    size_t sizes[4] = {1000, 1 << 16, 3 << 18, 12345};
+
+    for (int round = 0; round < 3; round++) {
+        long long allocations = workspace->num_block_allocations;
+        size_t mark = workspace_mark(workspace);
+
+        for (int i = 0; i < 4; i++) {
+            // A nested scope, as in a mini-batch fit labelling each batch.
+            size_t inner = workspace_mark(workspace);
+
+            assert(workspace_alloc(workspace, sizes[i]) != NULL);
+            assert(workspace_alloc(workspace, sizes[i] / 2) != NULL);
+
+            workspace_release(workspace, inner);
+            assert(workspace_alloc(workspace, sizes[i]) != NULL);
+        }
+
+        workspace_release(workspace, mark);
+
+        if (round > 0) assert(workspace->num_block_allocations == allocations);
+    }
+
+    assert(workspace->head != NULL && workspace->head->previous == NULL);
+    assert(workspace->head->capacity >= workspace->peak);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Checks that freeing a NULL workspace does not cause errors.
+ */
+int free_null_workspace() {
+    free_workspace(NULL);
+
+    return TEST_SUCCESS;
+}
+
+/*
+ * Main function to run each of the defined workspace tests.
+ */
+int main() {
+    printf("Running Workspace tests...\n");
+
+    // Run the tests
+    run_test(workspace_allocations_are_aligned_and_disjoint);
+    run_test(workspace_release_rewinds_to_mark);
+    run_test(workspace_repeated_workload_stops_allocating);
+    run_test(free_null_workspace);
+
+    printf("----------------\n");
+    printf("Workspace Tests complete: %d / %d tests successful.\n", success_count, total_count);
+    printf("----------------\n");
+
+    return 0;
+}